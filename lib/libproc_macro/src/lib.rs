@@ -503,79 +503,115 @@ impl fmt::Display for TokenStream {
     }
 }
 
-/// Receive a token stream from the compiler
-pub fn recv_token_stream() -> TokenStream
-{
-    struct Reader<R> {
-        inner: R,
+struct Reader<R> {
+    inner: R,
+}
+impl<R: ::std::io::Read> Reader<R> {
+    fn getb(&mut self) -> Option<u8> {
+        let mut b = [0];
+        match self.inner.read(&mut b)
+        {
+        Ok(1) => Some(b[0]),
+        Ok(0) => panic!("Unexpected EOF reading from stdin"),
+        Ok(_) => panic!("Bad byte count"),
+        Err(e) => panic!("Error reading from stdin - {}", e),
+        }
     }
-    impl<R: ::std::io::Read> Reader<R> {
-        fn getb(&mut self) -> Option<u8> {
-            let mut b = [0];
-            match self.inner.read(&mut b)
-            {
-            Ok(1) => Some(b[0]),
-            Ok(0) => panic!("Unexpected EOF reading from stdin"),
-            Ok(_) => panic!("Bad byte count"),
-            Err(e) => panic!("Error reading from stdin - {}", e),
+    fn get_u128v(&mut self) -> u128 {
+        let mut ofs = 0;
+        let mut raw_rv = 0u128;
+        loop
+        {
+            let b = self.getb().unwrap();
+            raw_rv |= ((b & 0x7F) as u128) << ofs;
+            if b < 128 {
+                break;
             }
+            assert!(ofs < 18);  // at most 18 bytes needed for a i128
+            ofs += 7;
         }
-        fn get_u128v(&mut self) -> u128 {
-            let mut ofs = 0;
-            let mut raw_rv = 0u128;
-            loop
-            {
-                let b = self.getb().unwrap();
-                raw_rv |= ((b & 0x7F) as u128) << ofs;
-                if b < 128 {
-                    break;
-                }
-                assert!(ofs < 18);  // at most 18 bytes needed for a i128
-                ofs += 7;
-            }
-            raw_rv
+        raw_rv
+    }
+    fn get_i128v(&mut self) -> i128 {
+        let raw_rv = self.get_u128v();
+        // Zig-zag encoding (0 = 0, 1 = -1, 2 = 1, ...)
+        if raw_rv & 1 != 0 {
+            -( (raw_rv >> 1) as i128 + 1 )
         }
-        fn get_i128v(&mut self) -> i128 {
-            let raw_rv = self.get_u128v();
-            // Zig-zag encoding (0 = 0, 1 = -1, 2 = 1, ...)
-            if raw_rv & 1 != 0 {
-                -( (raw_rv >> 1) as i128 + 1 )
-            }
-            else {
-                (raw_rv >> 1) as i128
-            }
+        else {
+            (raw_rv >> 1) as i128
+        }
+    }
+    fn get_byte_vec(&mut self) -> Vec<u8> {
+        let size = self.get_u128v();
+        assert!(size < (1<<30));
+        let size = size as usize;
+        let mut buf = vec![0u8; size];
+        match self.inner.read_exact(&mut buf)
+        {
+        Ok(_) => {},
+        Err(e) => panic!("Error reading from stdin get_byte_vec({}) - {}", size, e),
         }
-        fn get_byte_vec(&mut self) -> Vec<u8> {
-            let size = self.get_u128v();
-            assert!(size < (1<<30));
-            let size = size as usize;
-            let mut buf = vec![0u8; size];
-            match self.inner.read_exact(&mut buf)
-            {
-            Ok(_) => {},
-            Err(e) => panic!("Error reading from stdin get_byte_vec({}) - {}", size, e),
-            }
 
-            buf
+        buf
+    }
+    fn get_string(&mut self) -> String {
+        let raw = self.get_byte_vec();
+        String::from_utf8(raw).expect("Invalid UTF-8 passed from compiler")
+    }
+    fn get_f64(&mut self) -> f64 {
+        let mut buf = [0u8; 8];
+        match self.inner.read_exact(&mut buf)
+        {
+        Ok(_) => {},
+        Err(e) => panic!("Error reading from stdin - {}", e),
         }
-        fn get_string(&mut self) -> String {
-            let raw = self.get_byte_vec();
-            String::from_utf8(raw).expect("Invalid UTF-8 passed from compiler")
+        unsafe {
+            ::std::mem::transmute(buf)
         }
-        fn get_f64(&mut self) -> f64 {
-            let mut buf = [0u8; 8];
-            match self.inner.read_exact(&mut buf)
-            {
-            Ok(_) => {},
-            Err(e) => panic!("Error reading from stdin - {}", e),
-            }
-            unsafe {
-                ::std::mem::transmute(buf)
-            }
+    }
+}
+struct Writer<T> {
+    inner: T,
+}
+impl<T: ::std::io::Write> Writer<T> {
+    fn putb(&mut self, v: u8) {
+        let buf = [v];
+        self.inner.write(&buf).expect("");
+    }
+    fn put_u128v(&mut self, mut v: u128) {
+        while v > 128 {
+            self.putb( (v & 0x7F) as u8 | 0x80 );
+            v >>= 7;
+        }
+        self.putb( (v & 0x7F) as u8 );
+    }
+    fn put_i128v(&mut self, v: i128) {
+        if v < 0 {
+            self.put_u128v( (((v + 1) as u128) << 1) | 1 );
         }
+        else {
+            self.put_u128v( (v as u128) << 1 );
+        }
+    }
+    fn put_bytes(&mut self, v: &[u8]) {
+        self.put_u128v(v.len() as u128);
+        self.inner.write(v).expect("");
     }
+    fn put_f64(&mut self, v: f64) {
+        let buf: [u8; 8] = unsafe { ::std::mem::transmute(v) };
+        self.inner.write(&buf).expect("");
+    }
+}
 
+/// Receive a token stream from the compiler
+pub fn recv_token_stream() -> TokenStream
+{
     let mut s = Reader { inner: ::std::io::stdin().lock() };
+    recv_token_stream_from(&mut s)
+}
+fn recv_token_stream_from<R: ::std::io::Read>(s: &mut Reader<R>) -> TokenStream
+{
     let mut toks = Vec::new();
     loop
     {
@@ -614,41 +650,13 @@ pub fn recv_token_stream() -> TokenStream
 /// Send a token stream back to the compiler
 pub fn send_token_stream(ts: TokenStream)
 {
-    struct Writer<T> {
-        inner: T,
-    }
-    impl<T: ::std::io::Write> Writer<T> {
-        fn putb(&mut self, v: u8) {
-            let buf = [v];
-            self.inner.write(&buf).expect("");
-        }
-        fn put_u128v(&mut self, mut v: u128) {
-            while v > 128 {
-                self.putb( (v & 0x7F) as u8 | 0x80 );
-                v >>= 7;
-            }
-            self.putb( (v & 0x7F) as u8 );
-        }
-        fn put_i128v(&mut self, v: i128) {
-            if v < 0 {
-                self.put_u128v( (((v + 1) as u128) << 1) | 1 );
-            }
-            else {
-                self.put_u128v( (v as u128) << 1 );
-            }
-        }
-        fn put_bytes(&mut self, v: &[u8]) {
-            self.put_u128v(v.len() as u128);
-            self.inner.write(v).expect("");
-        }
-        fn put_f64(&mut self, v: f64) {
-            let buf: [u8; 8] = unsafe { ::std::mem::transmute(v) };
-            self.inner.write(&buf).expect("");
-        }
-    }
-
     let mut s = Writer { inner: ::std::io::stdout().lock() };
-
+    send_token_stream_to(&mut s, &ts);
+    drop(s);
+    ::std::io::Write::flush(&mut ::std::io::stdout());
+}
+fn send_token_stream_to<W: ::std::io::Write>(s: &mut Writer<W>, ts: &TokenStream)
+{
     for t in &ts.inner
     {
         //eprintln!("{:?}\r", t);
@@ -669,8 +677,6 @@ pub fn send_token_stream(ts: TokenStream)
 
     // Empty symbol indicates EOF
     s.putb(0); s.putb(0);
-    drop(s);
-    ::std::io::Write::flush(&mut ::std::io::stdout());
 }
 
 pub struct MacroDesc
@@ -683,6 +689,11 @@ pub fn main(macros: &[MacroDesc])
 {
     //::env_logger::init();
 
+    // Server mode is requested through the environment (so older compilers, which don't set it, get the
+    // per-invocation mode, and newer compilers can tell that an older executable doesn't support it)
+    if ::std::env::var_os("MRUSTC_PM_SERVER").is_some() {
+        return run_server(macros);
+    }
     let mac_name = ::std::env::args().nth(1).expect("Was not passed a macro name");
     //eprintln!("Searching for macro {}\r", mac_name);
     for m in macros
@@ -704,3 +715,56 @@ pub fn main(macros: &[MacroDesc])
     panic!("Unknown macro name '{}'", mac_name);
 }
 
+/// Server mode: handle any number of invocations, until stdin is closed
+///
+/// Signals readiness by writing a `1` byte (the per-invocation mode writes `0`). Each request is `u32le length` followed by the macro name and the input token stream, the reply is
+/// `u32le length` followed by a status byte (0 = OK, 1 = unknown macro) and the output token stream.
+fn run_server(macros: &[MacroDesc])
+{
+    use std::io::{Read,Write};
+    let stdin = ::std::io::stdin();
+    let stdout = ::std::io::stdout();
+    let mut input_stream = stdin.lock();
+    let mut output_stream = stdout.lock();
+    output_stream.write_all(&[1]).expect("Writing to stdout");
+    output_stream.flush().expect("Flushing stdout");
+    loop
+    {
+        let mut hdr = [0u8; 4];
+        match input_stream.read_exact(&mut hdr)
+        {
+        Ok(_) => {},
+        Err(ref e) if e.kind() == ::std::io::ErrorKind::UnexpectedEof => break,
+        Err(e) => panic!("Error reading from stdin - {}", e),
+        }
+        let len = (hdr[0] as usize) | (hdr[1] as usize) << 8 | (hdr[2] as usize) << 16 | (hdr[3] as usize) << 24;
+        let mut req = vec![0u8; len];
+        input_stream.read_exact(&mut req).expect("Reading request");
+
+        let mut r = Reader { inner: &req[..] };
+        let mac_name = r.get_string();
+        let mut w = Writer { inner: vec![0u8; 4] };
+        match macros.iter().find(|m| m.name == mac_name)
+        {
+        Some(m) => {
+            let input = recv_token_stream_from(&mut r);
+            debug!("{}: INPUT = `{}`\r", mac_name, input);
+            let output = (m.handler)( input );
+            debug!("{}: OUTPUT = `{}`\r", mac_name, output);
+            w.putb(0);
+            send_token_stream_to(&mut w, &output);
+            },
+        None => {
+            note!("Unknown macro name '{}'", mac_name);
+            w.putb(1);
+            },
+        }
+        let mut rsp = w.inner;
+        let len = rsp.len() - 4;
+        for i in 0 .. 4 {
+            rsp[i] = (len >> (i*8)) as u8;
+        }
+        output_stream.write_all(&rsp).expect("Writing to stdout");
+        output_stream.flush().expect("Flushing stdout");
+    }
+}
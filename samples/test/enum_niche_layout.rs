@@ -0,0 +1,100 @@
+
+use std::mem::size_of;
+
+// Enums with one data variant store the other variants in invalid values of the data (a "niche")
+#[test]
+fn niche_filled_option_sizes()
+{
+    assert_eq!(size_of::<Option<&u32>>(), size_of::<&u32>());
+    assert_eq!(size_of::<Option<&[u8]>>(), size_of::<&[u8]>());
+    assert_eq!(size_of::<Option<Box<u64>>>(), size_of::<Box<u64>>());
+    assert_eq!(size_of::<Option<char>>(), size_of::<char>());
+    assert_eq!(size_of::<Option<fn()>>(), size_of::<fn()>());
+}
+
+// `bool` is emitted as a C `_Bool`, so it can't hold a niche
+#[test]
+fn bool_not_niche_filled()
+{
+    assert!(size_of::<Option<bool>>() > size_of::<bool>());
+    let v = [Some(true), Some(false), None];
+    assert_eq!(v[0], Some(true));
+    assert_eq!(v[1], Some(false));
+    assert_eq!(v[2], None);
+}
+
+fn unwrap_or<T>(v: Option<T>, d: T) -> T {
+    match v
+    {
+    Some(v) => v,
+    None => d,
+    }
+}
+fn noop() {}
+
+#[test]
+fn niche_filled_round_trip()
+{
+    let x = 5u32;
+    assert_eq!(*unwrap_or(Some(&x), &0), 5);
+    assert_eq!(*unwrap_or(None, &7u32), 7);
+
+    assert_eq!(*unwrap_or(Some(Box::new(10u64)), Box::new(0)), 10);
+    assert_eq!(*unwrap_or(None, Box::new(11u64)), 11);
+
+    assert_eq!(unwrap_or(Some('\u{10FFFF}'), 'a'), '\u{10FFFF}');
+    assert_eq!(unwrap_or(None, 'a'), 'a');
+
+    let f: Option<fn()> = Some(noop);
+    assert!(f.is_some());
+    if let Some(f) = f { f(); }
+    let f: Option<fn()> = None;
+    assert!(f.is_none());
+}
+
+// Enums with several dataless variants use consecutive invalid `char` values
+#[derive(PartialEq,Debug)]
+enum CharOrMarker
+{
+    Start,
+    Char(char),
+    End,
+}
+#[test]
+fn multi_variant_char_niche()
+{
+    assert_eq!(size_of::<CharOrMarker>(), size_of::<char>());
+    let v = [CharOrMarker::Start, CharOrMarker::Char('x'), CharOrMarker::End];
+    assert_eq!(v[0], CharOrMarker::Start);
+    assert_eq!(v[1], CharOrMarker::Char('x'));
+    assert_eq!(v[2], CharOrMarker::End);
+}
+
+// Fields are reordered by alignment, so statics must be initialised by field name
+struct Mixed
+{
+    a: u8,
+    b: u64,
+    c: u16,
+    d: &'static str,
+    e: u8,
+}
+static MIXED: Mixed = Mixed { a: 1, b: 0x1234_5678_9ABC_DEF0, c: 0xBEEF, d: "mixed", e: 2 };
+static MIXED_OPT: Option<&'static Mixed> = Some(&MIXED);
+
+#[test]
+fn reordered_struct_static()
+{
+    // Declaration order would need padding after `a`, `c` and `e`
+    assert!(size_of::<Mixed>() <= size_of::<u64>() + size_of::<&str>() + 8);
+    assert_eq!(MIXED.a, 1);
+    assert_eq!(MIXED.b, 0x1234_5678_9ABC_DEF0);
+    assert_eq!(MIXED.c, 0xBEEF);
+    assert_eq!(MIXED.d, "mixed");
+    assert_eq!(MIXED.e, 2);
+    match MIXED_OPT
+    {
+    Some(m) => assert_eq!(m.c, 0xBEEF),
+    None => panic!("MIXED_OPT was None"),
+    }
+}
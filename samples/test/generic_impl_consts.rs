@@ -0,0 +1,40 @@
+
+struct Wrapper<T>(T);
+impl<T> Wrapper<T>
+{
+    const NONE: Option<T> = None;
+    const N: usize = 3;
+    const SIZE: usize = ::std::mem::size_of::<T>();
+    const DOUBLE_SIZE: usize = Wrapper::<T>::SIZE * 2;
+}
+
+// Associated constants in generic impls can only be evaluated once the parameters are known
+#[test]
+fn generic_typed_const()
+{
+    assert!( Wrapper::<u32>::NONE.is_none() );
+    assert!( Wrapper::<String>::NONE.is_none() );
+}
+
+#[test]
+fn non_generic_const_in_generic_impl()
+{
+    assert_eq!(Wrapper::<u8>::N, 3);
+    const M: usize = Wrapper::<()>::N + 1;
+    assert_eq!(M, 4);
+}
+
+fn double_size<T>() -> usize {
+    Wrapper::<T>::DOUBLE_SIZE
+}
+
+// The value differs for each `T`, so is evaluated (and cached) per instantiation
+#[test]
+fn param_dependent_const()
+{
+    assert_eq!(Wrapper::<u8>::SIZE, 1);
+    assert_eq!(Wrapper::<u64>::SIZE, 8);
+    assert_eq!(double_size::<u32>(), 8);
+    assert_eq!(double_size::<[u16; 3]>(), 12);
+}
+
@@ -315,11 +315,22 @@ void Module::add_macro_invocation(MacroInvocation item) {
     this->add_item( false, "", Item( mv$(item) ), ::AST::MetaItems {} );
 }
 void Module::add_macro(bool is_exported, ::std::string name, MacroRulesPtr macro) {
+    // NOTE: `insert` doesn't overwrite, so the first definition is the one found (matching the list order)
+    m_macro_index.insert( ::std::make_pair(name, &*macro) );
     m_macros.push_back( Named<MacroRulesPtr>( mv$(name), mv$(macro), is_exported ) );
 }
 void Module::add_macro_import(::std::string name, const MacroRules& mr) {
+    m_macro_import_index[name] = &mr;
     m_macro_import_res.push_back( NamedNS<const MacroRules*>( mv$(name), &mr, false ) );
 }
+const MacroRules* Module::find_macro(const ::std::string& name) const {
+    auto it = m_macro_index.find(name);
+    return it != m_macro_index.end() ? it->second : nullptr;
+}
+const MacroRules* Module::find_macro_import(const ::std::string& name) const {
+    auto it = m_macro_import_index.find(name);
+    return it != m_macro_import_index.end() ? it->second : nullptr;
+}
 
 Item Item::clone() const
 {
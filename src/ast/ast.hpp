@@ -511,6 +511,9 @@ class Module
 
     ::std::vector< NamedNS<const MacroRules*> > m_macro_import_res; // Vec of imported macros (not serialised)
     ::std::vector< Named<MacroRulesPtr> >  m_macros;
+    // Name lookup for the above two lists, maintained by `add_macro`/`add_macro_import`
+    ::std::unordered_map< ::std::string, const MacroRules*> m_macro_index;  // First definition of each name
+    ::std::unordered_map< ::std::string, const MacroRules*> m_macro_import_index;   // Last import of each name
 
 public:
     struct FileInfo
@@ -574,7 +577,12 @@ public:
 
           NamedList<MacroRulesPtr>&    macros()        { return m_macros; }
     const NamedList<MacroRulesPtr>&    macros()  const { return m_macros; }
-    const ::std::vector<NamedNS<const MacroRules*> >  macro_imports_res() const { return m_macro_import_res; }
+    const ::std::vector<NamedNS<const MacroRules*> >& macro_imports_res() const { return m_macro_import_res; }
+
+    /// Look up a `macro_rules!` defined in this module, returns nullptr if not found
+    const MacroRules* find_macro(const ::std::string& name) const;
+    /// Look up a macro imported into this module (later imports override earlier ones), returns nullptr if not found
+    const MacroRules* find_macro_import(const ::std::string& name) const;
 
 private:
     void resolve_macro_import(const Crate& crate, const ::std::string& modname, const ::std::string& macro_name);
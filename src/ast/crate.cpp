@@ -6,6 +6,7 @@
 #include "../expand/cfg.hpp"
 #include <hir/hir.hpp>  // HIR::Crate
 #include <hir/main_bindings.hpp>    // HIR_Deserialise
+#include <depfile.hpp>
 #include <fstream>
 
 ::std::vector<::std::string>    AST::g_crate_load_dirs = { };
@@ -177,6 +178,7 @@ ExternCrate::ExternCrate(const ::std::string& name, const ::std::string& path):
 {
     TRACE_FUNCTION_F("name=" << name << ", path='" << path << "'");
     m_hir = HIR_Deserialise(path, name);
+    Depfile_AddInput(path);
 
     m_hir->post_load_update(name);
     m_name = m_hir->m_crate_name;
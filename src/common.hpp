@@ -24,6 +24,7 @@
 #include "include/debug.hpp"
 #include "include/rustic.hpp"   // slice and option
 #include "include/compile_error.hpp"
+#include "include/rc_string.hpp"
 
 template<typename T>
 ::std::unique_ptr<T> make_unique_ptr(T&& v) {
@@ -131,6 +132,11 @@ static inline Ordering ord(const ::std::string& l, const ::std::string& r)
     else
         return OrdLess;
 }
+static inline Ordering ord(const RcString& l, const RcString& r)
+{
+    int v = l.compare(r);
+    return (v == 0 ? OrdEqual : (v > 0 ? OrdGreater : OrdLess));
+}
 template<typename T>
 Ordering ord(const T& l, const T& r)
 {
@@ -0,0 +1,66 @@
+/*
+ * MRustC - Rust Compiler
+ * - By John Hodge (Mutabah/thePowersGang)
+ *
+ * depfile.cpp
+ * - Tracking of the files read during compilation (for `-C emit-depfile`)
+ */
+#include <depfile.hpp>
+#include <set>
+#include <mutex>
+#include <fstream>
+
+namespace {
+    ::std::mutex    g_inputs_lock;
+    ::std::set< ::std::string>  g_inputs;
+
+    /// Escape a path for use in a makefile rule
+    struct FmtMakePath {
+        const ::std::string& s;
+        friend ::std::ostream& operator<<(::std::ostream& os, const FmtMakePath& x) {
+            for(char c : x.s)
+            {
+                switch(c)
+                {
+                case ' ':
+                case '#':
+                    os << '\\';
+                    break;
+                case '$':
+                    os << '$';
+                    break;
+                default:
+                    break;
+                }
+                os << c;
+            }
+            return os;
+        }
+    };
+}
+
+void Depfile_AddInput(const ::std::string& path)
+{
+    ::std::lock_guard< ::std::mutex>    lh { g_inputs_lock };
+    g_inputs.insert(path);
+}
+
+bool Depfile_Write(const ::std::string& depfile_path, const ::std::string& target)
+{
+    ::std::lock_guard< ::std::mutex>    lh { g_inputs_lock };
+    ::std::ofstream os(depfile_path);
+    if( !os.is_open() )
+        return false;
+    os << FmtMakePath { target } << ":";
+    for(const auto& p : g_inputs)
+    {
+        os << " \\\n  " << FmtMakePath { p };
+    }
+    os << "\n";
+    // Empty rules for each input, so make doesn't fail if one is removed
+    for(const auto& p : g_inputs)
+    {
+        os << "\n" << FmtMakePath { p } << ":\n";
+    }
+    return static_cast<bool>(os);
+}
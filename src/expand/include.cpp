@@ -12,6 +12,8 @@
 #include <parse/ttstream.hpp>
 #include <parse/lex.hpp>    // Lexer (new files)
 #include <ast/expr.hpp>
+#include <depfile.hpp>
+#include <fstream>
 
 namespace {
 
@@ -106,6 +108,7 @@ class CIncludeBytesExpander:
         if( !is.good() ) {
             ERROR(sp, E0000, "Cannot open file " << file_path << " for include_bytes!");
         }
+        Depfile_AddInput(file_path);
         ::std::stringstream   ss;
         ss << is.rdbuf();
 
@@ -135,6 +138,7 @@ class CIncludeStrExpander:
         if( !is.good() ) {
             ERROR(sp, E0000, "Cannot open file " << file_path << " for include_str!");
         }
+        Depfile_AddInput(file_path);
         ::std::stringstream   ss;
         ss << is.rdbuf();
 
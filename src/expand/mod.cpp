@@ -9,7 +9,7 @@
 #include <ast/crate.hpp>
 #include <main_bindings.hpp>
 #include <synext.hpp>
-#include <map>
+#include <unordered_map>
 #include "macro_rules.hpp"
 #include "../macro_rules/macro_rules.hpp"
 #include "../parse/common.hpp"  // For reparse from macros
@@ -18,8 +18,8 @@
 
 DecoratorDef*   g_decorators_list = nullptr;
 MacroDef*   g_macros_list = nullptr;
-::std::map< ::std::string, ::std::unique_ptr<ExpandDecorator> >  g_decorators;
-::std::map< ::std::string, ::std::unique_ptr<ExpandProcMacro> >  g_macros;
+::std::unordered_map< ::std::string, ::std::unique_ptr<ExpandDecorator> >  g_decorators;
+::std::unordered_map< ::std::string, ::std::unique_ptr<ExpandProcMacro> >  g_macros;
 
 void Expand_Attrs(const ::AST::MetaItems& attrs, AttrStage stage,  ::std::function<void(const ExpandDecorator& d,const ::AST::MetaItem& a)> f);
 void Expand_Mod(::AST::Crate& crate, LList<const AST::Module*> modstack, ::AST::Path modpath, ::AST::Module& mod, unsigned int first_item = 0);
@@ -49,12 +49,12 @@ void ExpandDecorator::unexpected(const Span& sp, const AST::MetaItem& mi, const
 
 void Expand_Attr(const Span& sp, const ::AST::MetaItem& a, AttrStage stage,  ::std::function<void(const Span& sp, const ExpandDecorator& d,const ::AST::MetaItem& a)> f)
 {
-    for( auto& d : g_decorators ) {
-        if( d.first == a.name() ) {
-            DEBUG("#[" << d.first << "] " << (int)d.second->stage() << "-" << (int)stage);
-            if( d.second->stage() == stage ) {
-                f(sp, *d.second, a);
-            }
+    auto it = g_decorators.find(a.name());
+    if( it != g_decorators.end() ) {
+        const auto& d = *it->second;
+        DEBUG("#[" << it->first << "] " << (int)d.stage() << "-" << (int)stage);
+        if( d.stage() == stage ) {
+            f(sp, d, a);
         }
     }
 }
@@ -94,13 +94,11 @@ void Expand_Attrs(::AST::MetaItems& attrs, AttrStage stage,  ::AST::Crate& crate
         return ::std::unique_ptr<TokenStream>();
     }
 
-    for( const auto& m : g_macros )
+    auto it = g_macros.find(name);
+    if( it != g_macros.end() )
     {
-        if( name == m.first )
-        {
-            auto e = m.second->expand(mi_span, crate, input_ident, input_tt, mod);
-            return e;
-        }
+        auto e = it->second->expand(mi_span, crate, input_ident, input_tt, mod);
+        return e;
     }
 
 
@@ -108,34 +106,16 @@ void Expand_Attrs(::AST::MetaItems& attrs, AttrStage stage,  ::AST::Crate& crate
     for(const auto* ll = &modstack; ll; ll = ll->m_prev)
     {
         const auto& mac_mod = *ll->m_item;
-        for( const auto& mr : mac_mod.macros() )
-        {
-            //DEBUG("- " << mr.name);
-            if( mr.name == name )
-            {
-                if( input_ident != "" )
-                    ERROR(mi_span, E0000, "macro_rules! macros can't take an ident");
-
-                auto e = Macro_InvokeRules(name.c_str(), *mr.data, mi_span, mv$(input_tt), mod);
-                return e;
-            }
-        }
-        // Find the last macro of this name (allows later #[macro_use] definitions to override)
-        const MacroRules* last_mac = nullptr;
-        for( const auto& mri : mac_mod.macro_imports_res() )
+        // Local definitions take priority over imports, and later #[macro_use] imports override earlier ones
+        const MacroRules* mac = mac_mod.find_macro(name);
+        if( !mac )
+            mac = mac_mod.find_macro_import(name);
+        if( mac )
         {
-            //DEBUG("- " << mri.name);
-            if( mri.name == name )
-            {
-                if( input_ident != "" )
-                    ERROR(mi_span, E0000, "macro_rules! macros can't take an ident");
+            if( input_ident != "" )
+                ERROR(mi_span, E0000, "macro_rules! macros can't take an ident");
 
-                last_mac = mri.data;
-            }
-        }
-        if( last_mac )
-        {
-            auto e = Macro_InvokeRules(name.c_str(), *last_mac, mi_span, mv$(input_tt), mod);
+            auto e = Macro_InvokeRules(name.c_str(), *mac, mi_span, mv$(input_tt), mod);
             return e;
         }
     }
@@ -1301,10 +1281,9 @@ void Expand(::AST::Crate& crate)
     // 2. Module attributes
     for( auto& a : crate.m_attrs.m_items )
     {
-        for( auto& d : g_decorators ) {
-            if( d.first == a.name() && d.second->stage() == AttrStage::Pre ) {
-                //d.second->handle(a, crate, ::AST::Path(), crate.m_root_module, crate.m_root_module);
-            }
+        auto it = g_decorators.find(a.name());
+        if( it != g_decorators.end() && it->second->stage() == AttrStage::Pre ) {
+            //it->second->handle(a, crate, ::AST::Path(), crate.m_root_module, crate.m_root_module);
         }
     }
 
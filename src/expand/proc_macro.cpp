@@ -19,9 +19,13 @@
 # include <Windows.h>
 #else
 # include <unistd.h>    // read/write/pipe
+# include <fcntl.h>
 # include <spawn.h>
 # include <sys/wait.h>
+# include <cerrno>
 #endif
+#include <map>
+#include <climits>
 
 #define NEWNODE(_ty, ...)   ::AST::ExprNodeP(new ::AST::ExprNode##_ty(__VA_ARGS__))
 
@@ -151,37 +155,80 @@ enum class FragType
     Block = 6,
     Pattern = 7,
 };
+/// A proc-macro executable (`<crate>.hir-plugin`)
+///
+/// The executable is started once in server mode (`MRUSTC_PM_SERVER` set in its environment), and then reused for
+/// every invocation of its macros. Each invocation is a single length-prefixed request/response pair:
+/// - Request: `u32le length`, macro name (length-prefixed bytes), encoded input token stream
+/// - Response: `u32le length`, status (0 = OK, 1 = unknown macro), encoded output token stream
+///
+/// Executables built against an older libproc_macro ignore the environment variable, and start in the per-invocation
+/// mode for the macro named in the first argument (signalled by the ready byte). For those a new process is started
+/// for each invocation (passing the macro name as the argument, and the token streams on stdin/stdout).
+class ProcMacroServer
+{
+    ::std::string   m_executable;
+    enum class Mode {
+        Unknown,    // Not yet started
+        Server,
+        Legacy,
+    }   m_mode = Mode::Unknown;
+#ifdef _WIN32
+#else
+    pid_t   child_pid = 0;
+     int    child_stdin = -1;
+     int    child_stdout = -1;
+    // NOTE: stderr stays as our stderr
+#endif
+
+    ProcMacroServer(::std::string executable):
+        m_executable(::std::move(executable))
+    {
+    }
+public:
+    ProcMacroServer(const ProcMacroServer&) = delete;
+    ~ProcMacroServer();
+
+    /// Get the (possibly already running) server for an executable
+    static ProcMacroServer& get(const Span& sp, const ::std::string& executable);
+
+    /// Run the macro `name` over the encoded token stream `input`
+    /// - Returns false if the macro failed to run (e.g. unknown macro, or the process failed to start)
+    bool invoke(const Span& sp, const ::std::string& name, const ::std::string& input, ::std::string& out_output);
+private:
+    /// Start the executable for macro `name` (optionally requesting server mode), returns its ready byte or -1
+    int start(const Span& sp, const char* name, bool request_server);
+    /// Send the input to a process started in per-invocation mode, and read its output until it exits
+    void run_legacy(const Span& sp, const ::std::string& input, ::std::string& out_output);
+    void stop();
+};
+
 struct ProcMacroInv:
     public TokenStream
 {
     Span    m_parent_span;
     const ::HIR::ProcMacro& m_proc_macro_desc;
+    ProcMacroServer&    m_server;
 
-#ifdef WIN32
-    HANDLE  child_handle;
-    HANDLE  child_stdin;
-    HANDLE  child_stdout;
-#else
-    // POSIX
-    pid_t   child_pid;  // Questionably needed
-     int    child_stdin;
-     int    child_stdout;
-    // NOTE: stderr stays as our stderr
-#endif
+    // Token streams are encoded into memory, and sent/received in one go
+    ::std::string   m_send_buf;
+    ::std::string   m_recv_buf;
+    size_t  m_recv_pos = 0;
     bool    m_eof_hit = false;
 
 public:
-    ProcMacroInv(const Span& sp, const char* executable, const ::HIR::ProcMacro& proc_macro_desc);
+    ProcMacroInv(const Span& sp, ProcMacroServer& server, const ::HIR::ProcMacro& proc_macro_desc);
     ProcMacroInv(const ProcMacroInv&) = delete;
-    ProcMacroInv(ProcMacroInv&&);
+    ProcMacroInv(ProcMacroInv&&) = default;
     ProcMacroInv& operator=(const ProcMacroInv&) = delete;
     ProcMacroInv& operator=(ProcMacroInv&&) = delete;
-    virtual ~ProcMacroInv();
+    virtual ~ProcMacroInv() = default;
 
-    bool check_good();
-    void send_done() {
+    /// Terminate the input, and run the macro (returns false if it couldn't be run)
+    bool send_done() {
         send_symbol("");
-        DEBUG("Input tokens sent");
+        DEBUG("Input tokens encoded (" << m_send_buf.size() << " bytes)");
+        return m_server.invoke(m_parent_span, m_proc_macro_desc.name, m_send_buf, m_recv_buf);
     }
     void send_symbol(const char* val) {
         this->send_u8(static_cast<uint8_t>(TokenClass::Symbol));
@@ -214,8 +261,13 @@ public:
     virtual Ident::Hygiene realGetHygiene() const override;
 private:
     Token realGetToken_();
-    void send_u8(uint8_t v);
-    void send_bytes(const void* val, size_t size);
+    void send_u8(uint8_t v) {
+        m_send_buf.push_back(static_cast<char>(v));
+    }
+    void send_bytes(const void* val, size_t size) {
+        this->send_v128u( static_cast<uint64_t>(size) );
+        m_send_buf.append(static_cast<const char*>(val), size);
+    }
     void send_v128u(uint64_t val);
 
     uint8_t recv_u8();
@@ -252,11 +304,11 @@ ProcMacroInv ProcMacro_Invoke_int(const Span& sp, const ::AST::Crate& crate, con
         ERROR(sp, E0000, "Unable to find referenced proc macro " << mac_path);
     }
 
-    // 2. Get executable and macro name
-    ::std::string   proc_macro_exe_name = (ext_crate.m_filename + "-plugin");
+    // 2. Get executable (started on first use)
+    auto& server = ProcMacroServer::get(sp, ext_crate.m_filename + "-plugin");
 
     // 3. Create ProcMacroInv
-    return ProcMacroInv(sp, proc_macro_exe_name.c_str(), *pmp);
+    return ProcMacroInv(sp, server, *pmp);
 }
 
 
@@ -744,11 +796,10 @@ namespace {
 {
     // 1. Create ProcMacroInv instance
     auto pmi = ProcMacro_Invoke_int(sp, crate, mac_path);
-    if( !pmi.check_good() )
-        return ::std::unique_ptr<TokenStream>();
-    // 2. Feed item as a token stream.
+    // 2. Feed item as a token stream, and run the macro
     Visitor(sp, pmi).visit_struct(item_name, false, i);
-    pmi.send_done();
+    if( !pmi.send_done() )
+        return ::std::unique_ptr<TokenStream>();
     // 3. Return boxed invocation instance
     return box$(pmi);
 }
@@ -756,11 +807,10 @@ namespace {
 {
     // 1. Create ProcMacroInv instance
     auto pmi = ProcMacro_Invoke_int(sp, crate, mac_path);
-    if( !pmi.check_good() )
-        return ::std::unique_ptr<TokenStream>();
-    // 2. Feed item as a token stream.
+    // 2. Feed item as a token stream, and run the macro
     Visitor(sp, pmi).visit_enum(item_name, false, i);
-    pmi.send_done();
+    if( !pmi.send_done() )
+        return ::std::unique_ptr<TokenStream>();
     // 3. Return boxed invocation instance
     return box$(pmi);
 }
@@ -768,20 +818,86 @@ namespace {
 {
     // 1. Create ProcMacroInv instance
     auto pmi = ProcMacro_Invoke_int(sp, crate, mac_path);
-    if( !pmi.check_good() )
-        return ::std::unique_ptr<TokenStream>();
-    // 2. Feed item as a token stream.
+    // 2. Feed item as a token stream, and run the macro
     Visitor(sp, pmi).visit_union(item_name, false, i);
-    pmi.send_done();
+    if( !pmi.send_done() )
+        return ::std::unique_ptr<TokenStream>();
     // 3. Return boxed invocation instance
     return box$(pmi);
 }
 
-ProcMacroInv::ProcMacroInv(const Span& sp, const char* executable, const ::HIR::ProcMacro& proc_macro_desc):
-    m_parent_span(sp),
-    m_proc_macro_desc(proc_macro_desc)
+namespace {
+#ifndef _WIN32
+    bool write_all(int fd, const void* data, size_t len)
+    {
+        const char* p = static_cast<const char*>(data);
+        while( len > 0 )
+        {
+            auto n = write(fd, p, len);
+            if( n < 0 && errno == EINTR )
+                continue ;
+            if( n <= 0 )
+                return false;
+            p += n;
+            len -= n;
+        }
+        return true;
+    }
+    bool read_all(int fd, void* data, size_t len)
+    {
+        char* p = static_cast<char*>(data);
+        while( len > 0 )
+        {
+            auto n = read(fd, p, len);
+            if( n < 0 && errno == EINTR )
+                continue ;
+            if( n <= 0 )
+                return false;
+            p += n;
+            len -= n;
+        }
+        return true;
+    }
+#endif
+    void put_u32le(::std::string& buf, uint32_t v)
+    {
+        for(int i = 0; i < 4; i ++)
+            buf.push_back(static_cast<char>( (v >> (i*8)) & 0xFF ));
+    }
+    uint32_t get_u32le(const uint8_t* b)
+    {
+        return static_cast<uint32_t>(b[0]) | (static_cast<uint32_t>(b[1]) << 8) | (static_cast<uint32_t>(b[2]) << 16) | (static_cast<uint32_t>(b[3]) << 24);
+    }
+}
+
+ProcMacroServer& ProcMacroServer::get(const Span& sp, const ::std::string& executable)
+{
+    // NOTE: Expansion is single-threaded, so no locking is needed
+    static ::std::map< ::std::string, ::std::unique_ptr<ProcMacroServer> >    s_servers;
+    auto it = s_servers.find(executable);
+    if( it == s_servers.end() )
+    {
+        // NOTE: Started on the first invocation, as an executable without server mode needs a macro name
+        auto* server = new ProcMacroServer(executable);
+        it = s_servers.insert(::std::make_pair( executable, ::std::unique_ptr<ProcMacroServer>(server) )).first;
+    }
+    return *it->second;
+}
+ProcMacroServer::~ProcMacroServer()
+{
+    this->stop();
+}
+
+namespace {
+    // Ready bytes written by the executable once it has started
+    const uint8_t   READY_LEGACY = 0;   // Waiting for the input to the macro named in the argument
+    const uint8_t   READY_SERVER = 1;   // Waiting for requests
+}
+/// Start the executable with the macro name as the argument, and wait for it to report that it's ready
+int ProcMacroServer::start(const Span& sp, const char* name, bool request_server)
 {
 #ifdef _WIN32
+    TODO(sp, "Proc macro support on windows");
 #else
      int    stdin_pipes[2];
     if( pipe(stdin_pipes) != 0 )
@@ -795,19 +911,28 @@ ProcMacroInv::ProcMacroInv(const Span& sp, const char* executable, const ::HIR::
         BUG(sp, "Unable to create stdin pipe pair for proc macro, " << strerror(errno));
     }
     this->child_stdout = stdout_pipes[0]; // Read end
+    // Other children (e.g. other proc macro servers) shouldn't hold our ends, or EOF would never be seen
+    fcntl(this->child_stdin, F_SETFD, FD_CLOEXEC);
+    fcntl(this->child_stdout, F_SETFD, FD_CLOEXEC);
 
     posix_spawn_file_actions_t  file_actions;
     posix_spawn_file_actions_init(&file_actions);
     posix_spawn_file_actions_adddup2(&file_actions, stdin_pipes[0], 0);
     posix_spawn_file_actions_adddup2(&file_actions, stdout_pipes[1], 1);
     posix_spawn_file_actions_addclose(&file_actions, stdin_pipes[0]);
-    posix_spawn_file_actions_addclose(&file_actions, stdin_pipes[1]);
-    posix_spawn_file_actions_addclose(&file_actions, stdout_pipes[0]);
     posix_spawn_file_actions_addclose(&file_actions, stdout_pipes[1]);
 
-    char*   argv[3] = { const_cast<char*>(executable), const_cast<char*>(proc_macro_desc.name.c_str()), nullptr };
-    //char*   envp[] = { nullptr };
-    int rv = posix_spawn(&this->child_pid, executable, &file_actions, nullptr, argv, environ);
+    char*   argv[3] = { const_cast<char*>(m_executable.c_str()), const_cast<char*>(name), nullptr };
+    // Server mode is requested through the environment, which older executables ignore
+    ::std::vector<char*>    envp;
+    for(char** e = environ; *e; e ++)
+        if( strncmp(*e, "MRUSTC_PM_SERVER=", 17) != 0 )
+            envp.push_back(*e);
+    char    server_env[] = "MRUSTC_PM_SERVER=1";
+    if( request_server )
+        envp.push_back(server_env);
+    envp.push_back(nullptr);
+    int rv = posix_spawn(&this->child_pid, m_executable.c_str(), &file_actions, nullptr, argv, envp.data());
     if( rv != 0 )
     {
         BUG(sp, "Error in posix_spawn - " << rv);
@@ -818,96 +943,143 @@ ProcMacroInv::ProcMacroInv(const Span& sp, const char* executable, const ::HIR::
     close(stdin_pipes[0]);
     close(stdout_pipes[1]);
 
+    // The child writes a single byte once it's ready for input
+    uint8_t v;
+    if( !read_all(this->child_stdout, &v, 1) )
+    {
+        DEBUG("Unexpected EOF from child");
+        this->stop();
+        return -1;
+    }
+    DEBUG("Child started, value = " << (int)v);
+    return v;
 #endif
 }
-ProcMacroInv::ProcMacroInv(ProcMacroInv&& x):
-    m_parent_span(x.m_parent_span),
-    m_proc_macro_desc(x.m_proc_macro_desc),
-#ifdef _WIN32
-    child_handle(x.child_handle),
-    child_stdin(x.child_stdin),
-    child_stdout(x.child_stdout)
-#else
-    child_pid(x.child_pid),
-    child_stdin(x.child_stdin),
-    child_stdout(x.child_stdout)
-#endif
-{
-#ifdef _WIN32
-#else
-    x.child_pid = 0;
-#endif
-    DEBUG("");
-}
-#if 0
-ProcMacroInv& ProcMacroInv::operator=(ProcMacroInv&& x)
-{
-    m_parent_span = x.m_parent_span;
-#ifdef _WIN32
-#else
-    child_pid = x.child_pid;
-    child_stdin = x.child_stdin;
-    child_stdout = x.child_stdout;
-
-    x.child_pid = 0;
-#endif
-    DEBUG("");
-    return *this;
-}
-#endif
-ProcMacroInv::~ProcMacroInv()
+void ProcMacroServer::stop()
 {
 #ifdef _WIN32
 #else
     if( this->child_pid != 0 )
     {
+        // Closing stdin tells a server to exit
+        close(this->child_stdin);
+        close(this->child_stdout);
         DEBUG("Waiting for child " << this->child_pid << " to terminate");
         int status;
         waitpid(this->child_pid, &status, 0);
-        close(this->child_stdout);
-        close(this->child_stdin);
+        this->child_pid = 0;
     }
 #endif
 }
-bool ProcMacroInv::check_good()
+
+bool ProcMacroServer::invoke(const Span& sp, const ::std::string& name, const ::std::string& input, ::std::string& out_output)
 {
-    char    v;
+    TRACE_FUNCTION_F(m_executable << " " << name);
 #ifdef _WIN32
-    int rv = ReadFile(this->child_stdout, &v, 1, nullptr, nullptr);
+    TODO(sp, "Proc macro support on windows");
 #else
-    int rv = read(this->child_stdout, &v, 1);
-#endif
-    if( rv == 0 )
+    switch(m_mode)
     {
-        DEBUG("Unexpected EOF from child");
-        return false;
+    case Mode::Unknown:
+        switch( this->start(sp, name.c_str(), /*request_server=*/true) )
+        {
+        case READY_SERVER:
+            m_mode = Mode::Server;
+            break;
+        case READY_LEGACY:
+            // Doesn't support server mode, but has started for this macro - so use it for this invocation
+            DEBUG(m_executable << " doesn't support server mode, starting it for each invocation");
+            m_mode = Mode::Legacy;
+            this->run_legacy(sp, input, out_output);
+            return true;
+        default:
+            this->stop();
+            return false;
+        }
+        break;
+    case Mode::Server:
+        break;
+    case Mode::Legacy:
+        // One process per invocation, which exits once the output has been sent
+        if( this->start(sp, name.c_str(), /*request_server=*/false) != READY_LEGACY )
+        {
+            this->stop();
+            return false;
+        }
+        this->run_legacy(sp, input, out_output);
+        return true;
     }
-    if( rv < 0 )
+
+    if( this->child_pid == 0 )
     {
-        DEBUG("Error reading from child, rv=" << rv << " " << strerror(errno));
-        return false;
+        BUG(sp, "Proc macro server " << m_executable << " has already exited");
     }
-    DEBUG("Child started, value = " << (int)v);
-    if( v != 0 )
+
+    // Request: the macro name and the input tokens
+    ::std::string   req;
+    req.reserve(4 + 8 + name.size() + input.size());
+    put_u32le(req, 0);
+    for(uint64_t v = name.size(); ; v >>= 7)
+    {
+        if( v < 128 ) {
+            req.push_back(static_cast<char>(v));
+            break;
+        }
+        req.push_back(static_cast<char>( (v & 0x7F) | 0x80 ));
+    }
+    req += name;
+    req += input;
+    ASSERT_BUG(sp, req.size() - 4 < UINT32_MAX, "Oversized proc macro input");
+    for(int i = 0; i < 4; i ++)
+        req[i] = static_cast<char>( ((req.size() - 4) >> (i*8)) & 0xFF );
+    if( !write_all(this->child_stdin, req.data(), req.size()) )
+        BUG(sp, "Error writing to proc macro server " << m_executable << ", " << strerror(errno));
+
+    // Response: status byte, then the output tokens
+    uint8_t hdr[4];
+    if( !read_all(this->child_stdout, hdr, 4) )
+        BUG(sp, "Unexpected EOF while reading from proc macro server " << m_executable);
+    out_output.resize( get_u32le(hdr) );
+    if( !read_all(this->child_stdout, &out_output[0], out_output.size()) )
+        BUG(sp, "Unexpected EOF while reading from proc macro server " << m_executable);
+    DEBUG("Received " << out_output.size() << " bytes");
+    if( out_output.empty() || out_output[0] != 0 )
+    {
+        DEBUG("Macro " << name << " not found in " << m_executable);
         return false;
+    }
+    out_output.erase(0, 1);
     return true;
+#endif
 }
-void ProcMacroInv::send_u8(uint8_t v)
+
+void ProcMacroServer::run_legacy(const Span& sp, const ::std::string& input, ::std::string& out_output)
 {
-#ifdef _WIN32
-#else
-    if( write(this->child_stdin, &v, 1) != 1 )
-        BUG(m_parent_span, "Error writing to child, " << strerror(errno));
+#ifndef _WIN32
+    if( !write_all(this->child_stdin, input.data(), input.size()) )
+        BUG(sp, "Error writing to child, " << strerror(errno));
+    close(this->child_stdin);
+    this->child_stdin = -1;
+    out_output.clear();
+    char    buf[4096];
+    for(;;)
+    {
+        auto n = read(this->child_stdout, buf, sizeof(buf));
+        if( n < 0 && errno == EINTR )
+            continue ;
+        if( n <= 0 )
+            break;
+        out_output.append(buf, n);
+    }
+    this->stop();
 #endif
 }
-void ProcMacroInv::send_bytes(const void* val, size_t size)
+
+ProcMacroInv::ProcMacroInv(const Span& sp, ProcMacroServer& server, const ::HIR::ProcMacro& proc_macro_desc):
+    m_parent_span(sp),
+    m_proc_macro_desc(proc_macro_desc),
+    m_server(server)
 {
-    this->send_v128u( static_cast<uint64_t>(size) );
-#ifdef _WIN32
-#else
-    if( write(this->child_stdin, val, size) != static_cast<ssize_t>(size) )
-        BUG(m_parent_span, "Error writing to child, " << strerror(errno));
-#endif
 }
 void ProcMacroInv::send_v128u(uint64_t val)
 {
@@ -919,43 +1091,16 @@ void ProcMacroInv::send_v128u(uint64_t val)
 }
 uint8_t ProcMacroInv::recv_u8()
 {
-    uint8_t v;
-#ifdef _WIN32
-    DWORD n;
-    if( !ReadFile(this->child_stdout, &v, 1, &n, nullptr) )
-        BUG(this->m_parent_span, "Unexpected EOF while reading from child process");
-#else
-    if( read(this->child_stdout, &v, 1) != 1 )
-        BUG(this->m_parent_span, "Unexpected EOF while reading from child process");
-#endif
-    return v;
+    if( m_recv_pos >= m_recv_buf.size() )
+        BUG(this->m_parent_span, "Unexpected end of output from proc macro");
+    return static_cast<uint8_t>(m_recv_buf[m_recv_pos++]);
 }
 ::std::string ProcMacroInv::recv_bytes()
 {
     auto len = this->recv_v128u();
-    ASSERT_BUG(this->m_parent_span, len < SIZE_MAX, "Oversized string from child process");
-    ::std::string   val;
-    val.resize(len);
-    size_t  ofs = 0, rem = len;
-    while( rem > 0 )
-    {
-#ifdef _WIN32
-        DWORD n;
-        ReadFile(this->child_stdout, &val[ofs], rem, &n, nullptr);
-#else
-        auto n = read(this->child_stdout, &val[ofs], rem);
-#endif
-        if( n == 0 ) {
-            BUG(this->m_parent_span, "Unexpected EOF while reading from child process");
-        }
-        if( n < 0 ) {
-            BUG(this->m_parent_span, "Error while reading from child process");
-        }
-        assert(static_cast<size_t>(n) <= rem);
-        ofs += n;
-        rem -= n;
-    }
-
+    ASSERT_BUG(this->m_parent_span, len <= m_recv_buf.size() - m_recv_pos, "Oversized string from child process");
+    ::std::string   val = m_recv_buf.substr(m_recv_pos, len);
+    m_recv_pos += len;
     return val;
 }
 uint64_t ProcMacroInv::recv_v128u()
@@ -965,7 +1110,7 @@ uint64_t ProcMacroInv::recv_v128u()
     for(;;)
     {
         auto b = recv_u8();
-        v |= static_cast<uint64_t>(b) << ofs;
+        v |= static_cast<uint64_t>(b & 0x7F) << ofs;
         if( (b & 0x80) == 0 )
             break;
         ofs += 7;
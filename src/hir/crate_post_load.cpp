@@ -22,5 +22,8 @@ void HIR::Crate::post_load_update(const ::std::string& name)
             mac.second->m_source_crate = name;
         }
     }
+
+    // Loaded crates aren't modified, so impl lookups can use an index
+    this->build_impl_indexes();
 }
 
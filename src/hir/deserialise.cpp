@@ -21,16 +21,34 @@ namespace {
     {
     };
 
+    /// Metadata file shared by the not-yet-loaded MIR bodies of a crate
+    struct MetadataSource
+    {
+        ::HIR::serialise::FileReader    file;
+        ::std::string   crate_name;
+        // Applied to each body after it's loaded (set via `HIR::Crate::m_mir_load_hook`)
+        ::std::shared_ptr<::MIR::FunctionLoadHook>  load_hook;
+
+        MetadataSource(const ::std::string& path):
+            file(path),
+            load_hook(::std::make_shared<::MIR::FunctionLoadHook>())
+        {}
+    };
+
     class HirDeserialiser
     {
-        ::std::string m_crate_name;
+        RcString m_crate_name;
         ::HIR::serialise::Reader&   m_in;
+        ::std::shared_ptr<MetadataSource>   m_source;
     public:
-        HirDeserialiser(::HIR::serialise::Reader& in):
-            m_in(in)
+        HirDeserialiser(::HIR::serialise::Reader& in, ::std::shared_ptr<MetadataSource> source):
+            m_crate_name(source->crate_name),
+            m_in(in),
+            m_source(mv$(source))
         {}
 
         ::std::string read_string() { return m_in.read_string(); }
+        RcString read_istring() { return m_source->file.string( static_cast<size_t>(m_in.read_u64c()) ); }
         bool read_bool() { return m_in.read_bool(); }
         size_t deserialise_count() { return m_in.read_count(); }
 
@@ -64,6 +82,21 @@ namespace {
             return rv;
         }
         template<typename V>
+        ::std::unordered_map< RcString,V> deserialise_istrumap()
+        {
+            TRACE_FUNCTION_F("<" << typeid(V).name() << ">");
+            size_t n = m_in.read_count();
+            ::std::unordered_map< RcString, V>   rv;
+            rv.reserve(n);
+            for(size_t i = 0; i < n; i ++)
+            {
+                auto s = read_istring();
+                DEBUG("- " << s);
+                rv.insert( ::std::make_pair( mv$(s), D<V>::des(*this) ) );
+            }
+            return rv;
+        }
+        template<typename V>
         ::std::unordered_multimap< ::std::string,V> deserialise_strummap()
         {
             TRACE_FUNCTION_F("<" << typeid(V).name() << ">");
@@ -240,7 +273,7 @@ namespace {
             if(rv.m_source_crate == "")
             {
                 assert(!m_crate_name.empty());
-                rv.m_source_crate = m_crate_name;
+                rv.m_source_crate = ::std::string(m_crate_name);
             }
             return rv;
         }
@@ -274,10 +307,45 @@ namespace {
             }
             return rv;
         }
+        ::MacroPatOp deserialise_macropatop() {
+            ::MacroPatOp    rv { static_cast< ::MacroPatOp::Type>(m_in.read_tag()) };
+            switch(rv.type)
+            {
+            case ::MacroPatOp::OP_END:
+            case ::MacroPatOp::OP_LOOP_ENTER:
+            case ::MacroPatOp::OP_LOOP_NEXT:
+            case ::MacroPatOp::OP_LOOP_EXIT:
+                break;
+            case ::MacroPatOp::OP_EXPECT_TOK:
+                rv.tok = deserialise_token();
+                break;
+            case ::MacroPatOp::OP_EXPECT_PAT:
+                rv.pat_type = static_cast< ::MacroPatEnt::Type>(m_in.read_tag());
+                rv.idx = static_cast<unsigned int>(m_in.read_count());
+                break;
+            case ::MacroPatOp::OP_IF_TOK:
+                rv.is_equal = m_in.read_bool();
+                rv.tok = deserialise_token();
+                rv.target = static_cast<unsigned int>(m_in.read_count());
+                break;
+            case ::MacroPatOp::OP_IF_PAT:
+                rv.is_equal = m_in.read_bool();
+                rv.pat_type = static_cast< ::MacroPatEnt::Type>(m_in.read_tag());
+                rv.target = static_cast<unsigned int>(m_in.read_count());
+                break;
+            case ::MacroPatOp::OP_JUMP:
+                rv.target = static_cast<unsigned int>(m_in.read_count());
+                break;
+            default:
+                throw "";
+            }
+            return rv;
+        }
         ::MacroRulesArm deserialise_macrorulesarm() {
             ::MacroRulesArm rv;
             rv.m_param_names = deserialise_vec< ::std::string>();
             rv.m_pattern = deserialise_vec_c< ::MacroPatEnt>( [&](){ return deserialise_macropatent(); } );
+            rv.m_compiled = deserialise_vec_c< ::MacroPatOp>( [&](){ return deserialise_macropatop(); } );
             rv.m_contents = deserialise_vec_c< ::MacroExpansionEnt>( [&](){ return deserialise_macroexpansionent(); } );
             return rv;
         }
@@ -328,12 +396,13 @@ namespace {
             ::HIR::ExprPtr  rv;
             if( m_in.read_bool() )
             {
-                rv.m_mir = deserialise_mir();
+                rv.m_mir = ::MIR::FunctionPointer( deserialise_mir_ref() );
             }
             rv.m_erased_types = deserialise_vec< ::HIR::TypeRef>();
             return rv;
         }
-        ::MIR::FunctionPointer deserialise_mir();
+        ::std::unique_ptr<::MIR::FunctionLoader> deserialise_mir_ref();
+        ::MIR::Function deserialise_mir();
         ::MIR::BasicBlock deserialise_mir_basicblock();
         ::MIR::Statement deserialise_mir_statement();
         ::MIR::Terminator deserialise_mir_terminator();
@@ -547,6 +616,7 @@ namespace {
             ::HIR::Function rv {
                 false,
                 deserialise_linkage(),
+                static_cast< ::HIR::Function::InlineHint>( m_in.read_tag() ),
                 static_cast< ::HIR::Function::Receiver>( m_in.read_tag() ),
                 m_in.read_string(),
                 m_in.read_bool(),
@@ -671,6 +741,9 @@ namespace {
     DEF_D( ::std::string,
         return d.read_string(); );
     template<>
+    DEF_D( RcString,
+        return d.read_istring(); );
+    template<>
     DEF_D( bool,
         return d.read_bool(); );
 
@@ -785,8 +858,8 @@ namespace {
     {
         TRACE_FUNCTION;
         // HACK! If the read crate name is empty, replace it with the name we're loaded with
-        auto crate_name = m_in.read_string();
-        auto components = deserialise_vec< ::std::string>();
+        auto crate_name = read_istring();
+        auto components = deserialise_vec< RcString>();
         if( crate_name == "" && components.size() > 0)
         {
             assert(!m_crate_name.empty());
@@ -1020,7 +1093,47 @@ namespace {
         }
     }
 
-    ::MIR::FunctionPointer HirDeserialiser::deserialise_mir()
+    /// Loads a MIR body from its block in the metadata file
+    class MirLoader:
+        public ::MIR::FunctionLoader
+    {
+        ::std::shared_ptr<MetadataSource>   m_source;
+        size_t  m_block;
+    public:
+        MirLoader(::std::shared_ptr<MetadataSource> source, size_t block):
+            m_source(mv$(source)),
+            m_block(block)
+        {}
+        ::MIR::Function* load() override
+        {
+            TRACE_FUNCTION_F(m_source->file.path() << " #" << m_block);
+            ::MIR::Function*    rv;
+            try
+            {
+                ::HIR::serialise::Reader    in { m_source->file, m_block };
+                HirDeserialiser s { in, m_source };
+                rv = new ::MIR::Function( s.deserialise_mir() );
+                if( m_source->load_hook->cb )
+                    m_source->load_hook->cb(*rv);
+            }
+            catch(const ::std::runtime_error& e)
+            {
+                ::std::cerr << "Unable to deserialise MIR from " << m_source->file.path() << ": " << e.what() << ::std::endl;
+                ::std::abort();
+            }
+            // Only needed once, release the file (unmapped once every body is loaded, or the crate is dropped)
+            m_source.reset();
+            return rv;
+        }
+    };
+    ::std::unique_ptr<::MIR::FunctionLoader> HirDeserialiser::deserialise_mir_ref()
+    {
+        size_t block = static_cast<size_t>(m_in.read_u64c());
+        if( block >= m_source->file.block_count() )
+            throw ::std::runtime_error(FMT("MIR block index out of range (" << block << ")"));
+        return ::std::unique_ptr<::MIR::FunctionLoader>(new MirLoader(m_source, block));
+    }
+    ::MIR::Function HirDeserialiser::deserialise_mir()
     {
         TRACE_FUNCTION;
 
@@ -1031,7 +1144,7 @@ namespace {
         rv.drop_flags = deserialise_vec<bool>();
         rv.blocks = deserialise_vec< ::MIR::BasicBlock>( );
 
-        return ::MIR::FunctionPointer( new ::MIR::Function(mv$(rv)) );
+        return rv;
     }
     ::MIR::BasicBlock HirDeserialiser::deserialise_mir_basicblock()
     {
@@ -1166,8 +1279,8 @@ namespace {
         ::HIR::Module   rv;
 
         // m_traits doesn't need to be serialised
-        rv.m_value_items = deserialise_strumap< ::std::unique_ptr< ::HIR::VisEnt< ::HIR::ValueItem> > >();
-        rv.m_mod_items = deserialise_strumap< ::std::unique_ptr< ::HIR::VisEnt< ::HIR::TypeItem> > >();
+        rv.m_value_items = deserialise_istrumap< ::std::unique_ptr< ::HIR::VisEnt< ::HIR::ValueItem> > >();
+        rv.m_mod_items = deserialise_istrumap< ::std::unique_ptr< ::HIR::VisEnt< ::HIR::TypeItem> > >();
 
         return rv;
     }
@@ -1183,7 +1296,8 @@ namespace {
 
         this->m_crate_name = m_in.read_string();
         assert(!this->m_crate_name.empty() && "Empty crate name loaded from metadata");
-        rv.m_crate_name = this->m_crate_name;
+        m_source->crate_name = ::std::string(this->m_crate_name);
+        rv.m_crate_name = m_source->crate_name;
         rv.m_root_module = deserialise_module();
 
         rv.m_type_impls = deserialise_vec< ::HIR::TypeImpl>();
@@ -1225,6 +1339,14 @@ namespace {
 
         rv.m_proc_macros = deserialise_vec< ::HIR::ProcMacro>();
 
+        {
+            size_t n = m_in.read_count();
+            for(size_t i = 0; i < n; i ++)
+            {
+                rv.m_shared_instances.insert( deserialise_path() );
+            }
+        }
+
         return rv;
     }
 }
@@ -1233,10 +1355,12 @@ namespace {
 {
     try
     {
-        ::HIR::serialise::Reader    in{ filename };
-        HirDeserialiser  s { in };
+        auto source = ::std::make_shared<MetadataSource>(filename);
+        ::HIR::serialise::Reader    in{ source->file, source->file.root_block() };
+        HirDeserialiser  s { in, source };
 
         ::HIR::Crate    rv = s.deserialise_crate();
+        rv.m_mir_load_hook = source->load_hook;
 
         return ::HIR::CratePtr( mv$(rv) );
     }
@@ -1204,10 +1204,23 @@ namespace {
     }
 
     bool force_emit = false;
+    auto inline_hint = ::HIR::Function::InlineHint::Default;
     if( const auto* a = attrs.get("inline") )
     {
-        (void)a;
         force_emit = true;
+        inline_hint = ::HIR::Function::InlineHint::Hint;
+        if( a->has_sub_items() )
+        {
+            if( a->items().size() != 1 || !a->items()[0].has_noarg() )
+                ERROR(sp, E0000, "Malformed #[inline] attribute - " << *a);
+            const auto& mode = a->items()[0].name();
+            if( mode == "always" )
+                inline_hint = ::HIR::Function::InlineHint::Always;
+            else if( mode == "never" )
+                inline_hint = ::HIR::Function::InlineHint::Never;
+            else
+                ERROR(sp, E0000, "Unknown #[inline] mode '" << mode << "'");
+        }
     }
 
     ::HIR::Linkage  linkage;
@@ -1245,6 +1258,7 @@ namespace {
     return ::HIR::Function {
         force_emit,
         mv$(linkage),
+        inline_hint,
         receiver,
         f.abi(), f.is_unsafe(), f.is_const(),
         LowerHIR_GenericParams(f.params(), nullptr),    // TODO: If this is a method, then it can add the Self: Sized bound
@@ -85,11 +85,13 @@ namespace HIR {
     }
 }
 
-size_t HIR::Enum::find_variant(const ::std::string& name) const
+namespace {
+template<typename T>
+size_t enum_find_variant(const ::HIR::Enum& enm, const T& name)
 {
-    if( m_data.is_Value() )
+    if( enm.m_data.is_Value() )
     {
-        const auto& e = m_data.as_Value();
+        const auto& e = enm.m_data.as_Value();
         auto it = ::std::find_if(e.variants.begin(), e.variants.end(), [&](const auto& x){ return x.name == name; });
         if( it == e.variants.end() )
             return SIZE_MAX;
@@ -97,7 +99,7 @@ size_t HIR::Enum::find_variant(const ::std::string& name) const
     }
     else
     {
-        const auto& e = m_data.as_Data();
+        const auto& e = enm.m_data.as_Data();
 
         auto it = ::std::find_if(e.begin(), e.end(), [&](const auto& x){ return x.name == name; });
         if( it == e.end() )
@@ -105,6 +107,15 @@ size_t HIR::Enum::find_variant(const ::std::string& name) const
         return it - e.begin();
     }
 }
+}
+size_t HIR::Enum::find_variant(const ::std::string& name) const
+{
+    return enum_find_variant(*this, name);
+}
+size_t HIR::Enum::find_variant(const RcString& name) const
+{
+    return enum_find_variant(*this, name);
+}
 bool HIR::Enum::is_value() const
 {
     return this->m_data.is_Value();
@@ -1076,8 +1087,9 @@ const ::HIR::TypeItem& ::HIR::Crate::get_typeitem_by_path(const Span& sp, const
 
     const ::HIR::Module* mod;
     if( !ignore_crate_name && path.m_crate_name != m_crate_name ) {
-        ASSERT_BUG(sp, m_ext_crates.count(path.m_crate_name) > 0, "Crate '" << path.m_crate_name << "' not loaded for " << path);
-        mod = &m_ext_crates.at(path.m_crate_name).m_data->m_root_module;
+        auto ec_it = m_ext_crates.find(::std::string(path.m_crate_name));
+        ASSERT_BUG(sp, ec_it != m_ext_crates.end(), "Crate '" << path.m_crate_name << "' not loaded for " << path);
+        mod = &ec_it->second.m_data->m_root_module;
     }
     else {
         mod =  &this->m_root_module;
@@ -1114,8 +1126,9 @@ const ::HIR::Module& ::HIR::Crate::get_mod_by_path(const Span& sp, const ::HIR::
     {
         if( path.m_crate_name != m_crate_name )
         {
-            ASSERT_BUG(sp, m_ext_crates.count(path.m_crate_name) > 0, "Crate '" << path.m_crate_name << "' not loaded");
-            return m_ext_crates.at(path.m_crate_name).m_data->m_root_module;
+            auto ec_it = m_ext_crates.find(::std::string(path.m_crate_name));
+            ASSERT_BUG(sp, ec_it != m_ext_crates.end(), "Crate '" << path.m_crate_name << "' not loaded");
+            return ec_it->second.m_data->m_root_module;
         }
         else
         {
@@ -1181,8 +1194,9 @@ const ::HIR::ValueItem& ::HIR::Crate::get_valitem_by_path(const Span& sp, const
     }
     const ::HIR::Module* mod;
     if( !ignore_crate_name && path.m_crate_name != m_crate_name ) {
-        ASSERT_BUG(sp, m_ext_crates.count(path.m_crate_name) > 0, "Crate '" << path.m_crate_name << "' not loaded");
-        mod = &m_ext_crates.at(path.m_crate_name).m_data->m_root_module;
+        auto ec_it = m_ext_crates.find(::std::string(path.m_crate_name));
+        ASSERT_BUG(sp, ec_it != m_ext_crates.end(), "Crate '" << path.m_crate_name << "' not loaded");
+        mod = &ec_it->second.m_data->m_root_module;
     }
     else {
         mod =  &this->m_root_module;
@@ -1219,18 +1233,183 @@ const ::HIR::Function& ::HIR::Crate::get_function_by_path(const Span& sp, const
     }
 }
 
-bool ::HIR::Crate::find_trait_impls(const ::HIR::SimplePath& trait, const ::HIR::TypeRef& type, t_cb_resolve_type ty_res, ::std::function<bool(const ::HIR::TraitImpl&)> callback) const
+namespace {
+    enum class ImplKey {
+        /// Could match any impl
+        Any,
+        /// Only matches impls on generics
+        Blanket,
+        /// Keyed by path (ADT or trait object)
+        Path,
+        /// Keyed by type variant and sub-kind
+        Kind,
+    };
+    /// Get the lookup key for the outermost part of a type
+    ImplKey get_impl_key(const ::HIR::TypeRef& ty, const ::HIR::SimplePath*& out_path, unsigned int& out_kind)
+    {
+        unsigned int sub = 0;
+        TU_MATCHA( (ty.m_data), (te),
+        (Infer,
+            return ImplKey::Any;
+            ),
+        (ErasedType,
+            return ImplKey::Any;
+            ),
+        (Generic,
+            return ImplKey::Blanket;
+            ),
+        (Path,
+            if( te.binding.is_Unbound() )
+                return ImplKey::Any;
+            if( !te.path.m_data.is_Generic() )
+                return ImplKey::Blanket;
+            out_path = &te.path.m_data.as_Generic().m_path;
+            return ImplKey::Path;
+            ),
+        (TraitObject,
+            out_path = &te.m_trait.m_path.m_path;
+            return ImplKey::Path;
+            ),
+        (Primitive,
+            sub = static_cast<unsigned int>(te);
+            ),
+        (Borrow,
+            sub = static_cast<unsigned int>(te.type);
+            ),
+        (Pointer,
+            sub = static_cast<unsigned int>(te.type);
+            ),
+        (Tuple,
+            sub = te.size();
+            ),
+        (Diverge,
+            ),
+        (Array,
+            ),
+        (Slice,
+            ),
+        (Function,
+            ),
+        (Closure,
+            )
+        )
+        out_kind = (static_cast<unsigned int>(ty.m_data.tag()) << 16) | sub;
+        return ImplKey::Kind;
+    }
+}
+
+template<typename T>
+void ::HIR::ImplIndex<T>::add(const T& impl)
+{
+    Ent ent { m_count++, &impl };
+    const ::HIR::SimplePath* path = nullptr;
+    unsigned int kind = 0;
+    switch( get_impl_key(impl.m_type, path, kind) )
+    {
+    case ImplKey::Any:
+    case ImplKey::Blanket:
+        m_blanket.push_back(ent);
+        break;
+    case ImplKey::Path:
+        m_by_path[*path].push_back(ent);
+        break;
+    case ImplKey::Kind:
+        m_by_kind[kind].push_back(ent);
+        break;
+    }
+}
+template<typename T>
+bool ::HIR::ImplIndex<T>::find(const ::HIR::TypeRef& type, t_cb_resolve_type ty_res, ::std::function<bool(const T&)> callback, bool& out_found) const
 {
-    auto its = this->m_trait_impls.equal_range( trait );
-    for( auto it = its.first; it != its.second; ++ it )
+    const auto& key_ty = (type.m_data.is_Infer() || type.m_data.is_Generic() ? ty_res(type) : type);
+    const ::HIR::SimplePath* path = nullptr;
+    unsigned int kind = 0;
+    const t_ents* ents = nullptr;
+    switch( get_impl_key(key_ty, path, kind) )
+    {
+    case ImplKey::Any:
+        return false;
+    case ImplKey::Blanket:
+        break;
+    case ImplKey::Path: {
+        auto it = m_by_path.find(*path);
+        if( it != m_by_path.end() )
+            ents = &it->second;
+        } break;
+    case ImplKey::Kind: {
+        auto it = m_by_kind.find(kind);
+        if( it != m_by_kind.end() )
+            ents = &it->second;
+        } break;
+    }
+
+    // Merge the keyed and blanket lists, so impls are visited in the same order as a full scan
+    auto visit = [&](const Ent& e)->bool {
+        return e.impl->matches_type(type, ty_res) && callback(*e.impl);
+        };
+    auto it_b = m_blanket.begin();
+    if( ents )
     {
-        const auto& impl = it->second;
-        if( impl.matches_type(type, ty_res) ) {
-            if( callback(impl) ) {
+        for(const auto& e : *ents)
+        {
+            for( ; it_b != m_blanket.end() && it_b->order < e.order; ++it_b )
+            {
+                if( visit(*it_b) ) {
+                    out_found = true;
+                    return true;
+                }
+            }
+            if( visit(e) ) {
+                out_found = true;
                 return true;
             }
         }
     }
+    for( ; it_b != m_blanket.end(); ++it_b )
+    {
+        if( visit(*it_b) ) {
+            out_found = true;
+            return true;
+        }
+    }
+    out_found = false;
+    return true;
+}
+
+void ::HIR::Crate::build_impl_indexes()
+{
+    assert(!m_impl_indexes_built);
+    for(const auto& impl : m_type_impls)
+        m_type_impl_index.add(impl);
+    for(const auto& impl : m_trait_impls)
+        m_trait_impl_index[impl.first].add(impl.second);
+    for(const auto& impl : m_marker_impls)
+        m_marker_impl_index[impl.first].add(impl.second);
+    m_impl_indexes_built = true;
+}
+
+bool ::HIR::Crate::find_trait_impls(const ::HIR::SimplePath& trait, const ::HIR::TypeRef& type, t_cb_resolve_type ty_res, ::std::function<bool(const ::HIR::TraitImpl&)> callback) const
+{
+    bool found = false;
+    auto idx_it = m_trait_impl_index.find(trait);
+    if( m_impl_indexes_built && (idx_it == m_trait_impl_index.end() || idx_it->second.find(type, ty_res, callback, found)) )
+    {
+        if( found )
+            return true;
+    }
+    else
+    {
+        auto its = this->m_trait_impls.equal_range( trait );
+        for( auto it = its.first; it != its.second; ++ it )
+        {
+            const auto& impl = it->second;
+            if( impl.matches_type(type, ty_res) ) {
+                if( callback(impl) ) {
+                    return true;
+                }
+            }
+        }
+    }
     for( const auto& ec : this->m_ext_crates )
     {
         if( ec.second.m_data->find_trait_impls(trait, type, ty_res, callback) ) {
@@ -1241,13 +1420,23 @@ bool ::HIR::Crate::find_trait_impls(const ::HIR::SimplePath& trait, const ::HIR:
 }
 bool ::HIR::Crate::find_auto_trait_impls(const ::HIR::SimplePath& trait, const ::HIR::TypeRef& type, t_cb_resolve_type ty_res, ::std::function<bool(const ::HIR::MarkerImpl&)> callback) const
 {
-    auto its = this->m_marker_impls.equal_range( trait );
-    for( auto it = its.first; it != its.second; ++ it )
+    bool found = false;
+    auto idx_it = m_marker_impl_index.find(trait);
+    if( m_impl_indexes_built && (idx_it == m_marker_impl_index.end() || idx_it->second.find(type, ty_res, callback, found)) )
     {
-        const auto& impl = it->second;
-        if( impl.matches_type(type, ty_res) ) {
-            if( callback(impl) ) {
-                return true;
+        if( found )
+            return true;
+    }
+    else
+    {
+        auto its = this->m_marker_impls.equal_range( trait );
+        for( auto it = its.first; it != its.second; ++ it )
+        {
+            const auto& impl = it->second;
+            if( impl.matches_type(type, ty_res) ) {
+                if( callback(impl) ) {
+                    return true;
+                }
             }
         }
     }
@@ -1262,11 +1451,20 @@ bool ::HIR::Crate::find_auto_trait_impls(const ::HIR::SimplePath& trait, const :
 bool ::HIR::Crate::find_type_impls(const ::HIR::TypeRef& type, t_cb_resolve_type ty_res, ::std::function<bool(const ::HIR::TypeImpl&)> callback) const
 {
     // TODO: Restrict which crate is searched based on the type.
-    for( const auto& impl : this->m_type_impls )
+    bool found = false;
+    if( m_impl_indexes_built && m_type_impl_index.find(type, ty_res, callback, found) )
     {
-        if( impl.matches_type(type, ty_res) ) {
-            if( callback(impl) ) {
-                return true;
+        if( found )
+            return true;
+    }
+    else
+    {
+        for( const auto& impl : this->m_type_impls )
+        {
+            if( impl.matches_type(type, ty_res) ) {
+                if( callback(impl) ) {
+                    return true;
+                }
             }
         }
     }
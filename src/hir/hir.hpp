@@ -11,6 +11,7 @@
 
 #include <cassert>
 #include <unordered_map>
+#include <set>
 #include <vector>
 #include <memory>
 
@@ -123,11 +124,19 @@ public:
         //PointerConst,
         Box,
     };
+    /// `#[inline]` attribute, used by the MIR inliner
+    enum class InlineHint {
+        Default,
+        Hint,   // `#[inline]`
+        Always, // `#[inline(always)]`
+        Never,  // `#[inline(never)]`
+    };
 
     typedef ::std::vector< ::std::pair< ::HIR::Pattern, ::HIR::TypeRef> >   args_t;
 
     bool    m_save_code;    // Filled by enumerate, defaults to false
     Linkage m_linkage;
+    InlineHint  m_inline;
 
     Receiver    m_receiver;
     ::std::string   m_abi;
@@ -246,6 +255,7 @@ public:
         return (m_data.is_Data() ? m_data.as_Data().size() : m_data.as_Value().variants.size());
     }
     size_t find_variant(const ::std::string& ) const;
+    size_t find_variant(const RcString& ) const;
 
     /// Returns true if this enum is a C-like enum (has values only)
     bool is_value() const;
@@ -337,9 +347,9 @@ public:
     ::std::vector< ::HIR::SimplePath>   m_traits;
 
     // Contains all values and functions (including type constructors)
-    ::std::unordered_map< ::std::string, ::std::unique_ptr<VisEnt<ValueItem>> > m_value_items;
+    ::std::unordered_map< RcString, ::std::unique_ptr<VisEnt<ValueItem>> > m_value_items;
     // Contains types, traits, and modules
-    ::std::unordered_map< ::std::string, ::std::unique_ptr<VisEnt<TypeItem>> > m_mod_items;
+    ::std::unordered_map< RcString, ::std::unique_ptr<VisEnt<TypeItem>> > m_mod_items;
 
     Module() {}
     Module(const Module&) = delete;
@@ -443,6 +453,35 @@ public:
     }
 };
 
+/// Impls (inherent, or of a single trait) grouped by the outermost part of the implementing type
+/// - Lets impl lookups skip impls that can't match without running the full type match.
+/// - Only built for loaded crates (the impls of the crate being compiled are still being modified)
+template<typename T>
+class ImplIndex
+{
+public:
+    struct Ent {
+        // Position in the original impl list, candidates are visited in this order
+        unsigned int    order;
+        const T*    impl;
+    };
+    typedef ::std::vector<Ent>  t_ents;
+private:
+    unsigned int    m_count = 0;
+    /// Impls on a generic (or unexpanded associated type), these can match anything
+    t_ents  m_blanket;
+    /// Impls on ADTs and trait objects, keyed by the path
+    ::std::map< ::HIR::SimplePath, t_ents>  m_by_path;
+    /// Other types, keyed by the type variant and sub-kind (e.g. the primitive or borrow class)
+    ::std::map<unsigned int, t_ents>    m_by_kind;
+
+public:
+    void add(const T& impl);
+    /// Visit the impls that could match `type` (in the original order), stopping when `callback` returns true
+    /// - Returns false (and visits nothing) if the type doesn't restrict the candidates (e.g. unknown ivars)
+    bool find(const ::HIR::TypeRef& type, t_cb_resolve_type ty_res, ::std::function<bool(const T&)> callback, bool& out_found) const;
+};
+
 class ExternCrate
 {
 public:
@@ -492,10 +531,22 @@ public:
     ::std::vector<ExternLibrary>    m_ext_libs;
     /// Extra paths for the linker
     ::std::vector<::std::string>    m_link_paths;
+    /// Monomorphised functions that this crate's object provides to downstream crates (`-Z share-generics`)
+    ::std::set< ::HIR::Path>    m_shared_instances;
+    /// Fixup for MIR bodies that are loaded on first use (only for loaded crates, set by `ConvertHIR_Bind`)
+    ::std::shared_ptr< ::MIR::FunctionLoadHook> m_mir_load_hook;
+
+    /// Lookup indexes for the impl lists (populated by `post_load_update`, so only for loaded crates)
+    bool    m_impl_indexes_built = false;
+    ImplIndex< ::HIR::TypeImpl> m_type_impl_index;
+    ::std::map< ::HIR::SimplePath, ImplIndex< ::HIR::TraitImpl> >   m_trait_impl_index;
+    ::std::map< ::HIR::SimplePath, ImplIndex< ::HIR::MarkerImpl> >  m_marker_impl_index;
 
     /// Method called to populate runtime state after deserialisation
     /// See hir/crate_post_load.cpp
     void post_load_update(const ::std::string& loaded_name);
+    /// Populate the impl lookup indexes, must only be called once the impl lists won't change
+    void build_impl_indexes();
 
     const ::HIR::SimplePath& get_lang_item_path(const Span& sp, const char* name) const;
     const ::HIR::SimplePath& get_lang_item_path_opt(const char* name) const;
@@ -75,6 +75,12 @@ public:
     ItemPath operator+(const ::std::string& name) const {
         return ItemPath(*this, name.c_str());
     }
+    ItemPath operator+(const RcString& name) const {
+        return ItemPath(*this, name.c_str());
+    }
+    ItemPath operator+(const char* name) const {
+        return ItemPath(*this, name);
+    }
 
     bool operator==(const ::HIR::SimplePath& sp) const {
         if( sp.m_crate_name != "" )  return false;
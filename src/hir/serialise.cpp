@@ -16,9 +16,11 @@ namespace {
     class HirSerialiser
     {
         ::HIR::serialise::Writer&   m_out;
+        ::HIR::serialise::FileWriter&   m_file;
     public:
-        HirSerialiser(::HIR::serialise::Writer& out):
-            m_out( out )
+        HirSerialiser(::HIR::serialise::Writer& out, ::HIR::serialise::FileWriter& file):
+            m_out( out ),
+            m_file( file )
         {}
 
         template<typename V>
@@ -41,6 +43,16 @@ namespace {
             }
         }
         template<typename V>
+        void serialise_strmap(const ::std::unordered_map< RcString,V>& map)
+        {
+            m_out.write_count(map.size());
+            for(const auto& v : map) {
+                DEBUG("- " << v.first);
+                serialise(v.first);
+                serialise(v.second);
+            }
+        }
+        template<typename V>
         void serialise_strmap(const ::std::unordered_multimap< ::std::string,V>& map)
         {
             m_out.write_count(map.size());
@@ -157,7 +169,7 @@ namespace {
         void serialise_simplepath(const ::HIR::SimplePath& path)
         {
             TRACE_FUNCTION_F(path);
-            m_out.write_string(path.m_crate_name);
+            serialise(path.m_crate_name);
             serialise_vec(path.m_components);
         }
         void serialise_pathparams(const ::HIR::PathParams& pp)
@@ -284,6 +296,10 @@ namespace {
             serialise_vec(crate.m_link_paths);
 
             serialise_vec(crate.m_proc_macros);
+
+            m_out.write_count(crate.m_shared_instances.size());
+            for(const auto& p : crate.m_shared_instances)
+                serialise_path(p);
         }
         void serialise(const ::HIR::ExternLibrary& lib)
         {
@@ -377,6 +393,10 @@ namespace {
         void serialise(const ::std::string& v) {
             m_out.write_string(v);
         }
+        void serialise(const RcString& v) {
+            // Interned strings are written via the file's string table
+            m_out.write_u64c(m_file.string_index(v));
+        }
 
         void serialise(const ::MacroRulesPtr& mac)
         {
@@ -400,9 +420,41 @@ namespace {
                 serialise_vec(pe.subpats);
             }
         }
+        void serialise(const ::MacroPatOp& op) {
+            m_out.write_tag( static_cast<int>(op.type) );
+            switch(op.type)
+            {
+            case ::MacroPatOp::OP_END:
+            case ::MacroPatOp::OP_LOOP_ENTER:
+            case ::MacroPatOp::OP_LOOP_NEXT:
+            case ::MacroPatOp::OP_LOOP_EXIT:
+                break;
+            case ::MacroPatOp::OP_EXPECT_TOK:
+                serialise(op.tok);
+                break;
+            case ::MacroPatOp::OP_EXPECT_PAT:
+                m_out.write_tag( static_cast<int>(op.pat_type) );
+                m_out.write_count(op.idx);
+                break;
+            case ::MacroPatOp::OP_IF_TOK:
+                m_out.write_bool(op.is_equal);
+                serialise(op.tok);
+                m_out.write_count(op.target);
+                break;
+            case ::MacroPatOp::OP_IF_PAT:
+                m_out.write_bool(op.is_equal);
+                m_out.write_tag( static_cast<int>(op.pat_type) );
+                m_out.write_count(op.target);
+                break;
+            case ::MacroPatOp::OP_JUMP:
+                m_out.write_count(op.target);
+                break;
+            }
+        }
         void serialise(const ::MacroRulesArm& arm) {
             serialise_vec(arm.m_param_names);
             serialise_vec(arm.m_pattern);
+            serialise_vec(arm.m_compiled);
             serialise_vec(arm.m_contents);
         }
         void serialise(const ::MacroExpansionEnt& ent) {
@@ -476,7 +528,12 @@ namespace {
         {
             m_out.write_bool( (bool)exp.m_mir && save_mir );
             if( exp.m_mir && save_mir ) {
-                serialise(*exp.m_mir);
+                // Bodies get their own (uncompressed) block, so loading the crate only maps them in, and each is
+                // deserialised when first used.
+                ::HIR::serialise::Writer    body_out { false };
+                HirSerialiser   s { body_out, m_file };
+                s.serialise(*exp.m_mir);
+                m_out.write_u64c( m_file.add_block(body_out) );
             }
             serialise_vec( exp.m_erased_types );
         }
@@ -819,6 +876,7 @@ namespace {
             TRACE_FUNCTION_F("_function:");
 
             serialise(fcn.m_linkage);
+            m_out.write_tag( static_cast<int>(fcn.m_inline) );
 
             m_out.write_tag( static_cast<int>(fcn.m_receiver) );
             m_out.write_string(fcn.m_abi);
@@ -999,8 +1057,10 @@ namespace {
 
 void HIR_Serialise(const ::std::string& filename, const ::HIR::Crate& crate)
 {
-    ::HIR::serialise::Writer    out { filename };
-    HirSerialiser  s { out };
+    ::HIR::serialise::FileWriter    file { filename };
+    ::HIR::serialise::Writer    out;
+    HirSerialiser  s { out, file };
     s.serialise_crate(crate);
+    file.write( file.add_block(out) );
 }
 
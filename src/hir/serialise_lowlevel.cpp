@@ -3,34 +3,81 @@
  * - By John Hodge (Mutabah/thePowersGang)
  *
  * hir/serialise_lowlevel.cpp
- * - HIR (De)Serialisation low-level "protocol"
+ * - HIR (De)Serialisation low-level "protocol" and file layout
  */
 #include <debug.hpp>
 #include "serialise_lowlevel.hpp"
 #include <zlib.h>
 #include <fstream>
+#include <iterator>
+#include <algorithm>
 #include <string.h>   // memcpy
 #include <common.hpp>
+#ifndef _WIN32
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <fcntl.h>
+# include <unistd.h>
+#endif
 
 namespace HIR {
 namespace serialise {
 
+namespace {
+    // "\x7FMRUSTC_HIR\x04\0\0\0" - Identifies the file and format version
+    const uint8_t   FILE_MAGIC[16] = { 0x7F, 'M','R','U','S','T','C','_','H','I','R', 0x04, 0,0,0,0 };
+    const uint32_t  BLOCK_FLAG_COMPRESSED = 1;
+
+    void put_u32(::std::vector<uint8_t>& out, uint32_t v) {
+        for(int i = 0; i < 4; i ++)
+            out.push_back(static_cast<uint8_t>(v >> (8*i)));
+    }
+    void put_u64(::std::vector<uint8_t>& out, uint64_t v) {
+        for(int i = 0; i < 8; i ++)
+            out.push_back(static_cast<uint8_t>(v >> (8*i)));
+    }
+    uint32_t get_u32(const uint8_t* p) {
+        uint32_t rv = 0;
+        for(int i = 0; i < 4; i ++)
+            rv |= static_cast<uint32_t>(p[i]) << (8*i);
+        return rv;
+    }
+    uint64_t get_u64(const uint8_t* p) {
+        uint64_t rv = 0;
+        for(int i = 0; i < 8; i ++)
+            rv |= static_cast<uint64_t>(p[i]) << (8*i);
+        return rv;
+    }
+}
+
 class WriterInner
 {
-    ::std::ofstream m_backing;
+    bool    m_compress;
+    ::std::vector<uint8_t>  m_backing;
     z_stream    m_zstream;
     ::std::vector<unsigned char> m_buffer;
 
     unsigned int    m_byte_out_count = 0;
     unsigned int    m_byte_in_count = 0;
 public:
-    WriterInner(const ::std::string& filename);
+    WriterInner(bool compress);
     ~WriterInner();
+    bool is_compressed() const { return m_compress; }
     void write(const void* buf, size_t len);
+    ::std::vector<uint8_t> finish();
+private:
+    void flush_buffer() {
+        size_t bytes = m_buffer.size() - m_zstream.avail_out;
+        m_backing.insert( m_backing.end(), m_buffer.data(), m_buffer.data() + bytes );
+        m_byte_out_count += bytes;
+
+        m_zstream.avail_out = m_buffer.size();
+        m_zstream.next_out = m_buffer.data();
+    }
 };
 
-Writer::Writer(const ::std::string& filename):
-    m_inner( new WriterInner(filename) )
+Writer::Writer(bool compress):
+    m_inner( new WriterInner(compress) )
 {
 }
 Writer::~Writer()
@@ -41,14 +88,24 @@ void Writer::write(const void* buf, size_t len)
 {
     m_inner->write(buf, len);
 }
+::std::vector<uint8_t> Writer::finish()
+{
+    return m_inner->finish();
+}
+bool Writer::is_compressed() const
+{
+    return m_inner->is_compressed();
+}
 
 
-WriterInner::WriterInner(const ::std::string& filename):
-    m_backing( filename, ::std::ios_base::out | ::std::ios_base::binary),
-    m_zstream(),
-    m_buffer( 16*1024 )
-    //m_buffer( 4*1024 )
+WriterInner::WriterInner(bool compress):
+    m_compress(compress),
+    m_zstream()
 {
+    if( !m_compress )
+        return ;
+
+    m_buffer.resize( 16*1024 );
     m_zstream.zalloc = Z_NULL;
     m_zstream.zfree = Z_NULL;
     m_zstream.opaque = Z_NULL;
@@ -63,32 +120,43 @@ WriterInner::WriterInner(const ::std::string& filename):
 }
 WriterInner::~WriterInner()
 {
-    assert( m_zstream.avail_in == 0 );
-
-    // Complete the compression
-    int ret;
-    do
+    if( m_compress )
     {
-        ret = deflate(&m_zstream, Z_FINISH);
-        if(ret == Z_STREAM_ERROR) {
-            ::std::cerr << "ERROR: zlib deflate stream error (cleanup)";
-            abort();
-        }
-        if( m_zstream.avail_out != m_buffer.size() )
-        {
-            size_t rem = m_buffer.size() - m_zstream.avail_out;
-            m_byte_out_count += rem;
-            m_backing.write( reinterpret_cast<char*>(m_buffer.data()), rem );
+        deflateEnd(&m_zstream);
+    }
+}
+::std::vector<uint8_t> WriterInner::finish()
+{
+    if( m_compress )
+    {
+        assert( m_zstream.avail_in == 0 );
 
-            m_zstream.avail_out = m_buffer.size();
-            m_zstream.next_out = m_buffer.data();
-        }
-    } while(ret == Z_OK);
-    deflateEnd(&m_zstream);
+        // Complete the compression
+        int ret;
+        do
+        {
+            ret = deflate(&m_zstream, Z_FINISH);
+            if(ret == Z_STREAM_ERROR) {
+                ::std::cerr << "ERROR: zlib deflate stream error (cleanup)";
+                abort();
+            }
+            if( m_zstream.avail_out != m_buffer.size() )
+            {
+                flush_buffer();
+            }
+        } while(ret == Z_OK);
+    }
+    return mv$(m_backing);
 }
 
 void WriterInner::write(const void* buf, size_t len)
 {
+    if( !m_compress )
+    {
+        const auto* p = reinterpret_cast<const uint8_t*>(buf);
+        m_backing.insert(m_backing.end(), p, p + len);
+        return ;
+    }
     m_zstream.avail_in = len;
     m_zstream.next_in = reinterpret_cast<unsigned char*>( const_cast<void*>(buf) );
 
@@ -109,27 +177,17 @@ void WriterInner::write(const void* buf, size_t len)
         m_byte_in_count += used_this_time;
 
         // If the entire input wasn't consumed, then it was likely due to a lack of output space
-        // - Flush the output buffer to the file
+        // - Flush the output buffer
         if( m_zstream.avail_in > 0 )
         {
-            size_t bytes = m_buffer.size() - m_zstream.avail_out;
-            m_backing.write( reinterpret_cast<char*>(m_buffer.data()), bytes );
-            m_byte_out_count += bytes;
-
-            m_zstream.avail_out = m_buffer.size();
-            m_zstream.next_out = m_buffer.data();
+            flush_buffer();
         }
     }
 
     // Flush stream contents if the output buffer is full.
     while( m_zstream.avail_out == 0 )
     {
-        size_t bytes = m_buffer.size() - m_zstream.avail_out;
-        m_backing.write( reinterpret_cast<char*>(m_buffer.data()), bytes );
-        m_byte_out_count += bytes;
-
-        m_zstream.avail_out = m_buffer.size();
-        m_zstream.next_out = m_buffer.data();
+        flush_buffer();
 
         int ret = deflate(&m_zstream, Z_NO_FLUSH);
         if(ret == Z_STREAM_ERROR)
@@ -138,17 +196,146 @@ void WriterInner::write(const void* buf, size_t len)
 }
 
 
+// --------------------------------------------------------------------
+FileWriter::FileWriter(::std::string path):
+    m_path( mv$(path) )
+{
+}
+size_t FileWriter::string_index(const RcString& s)
+{
+    auto it = m_string_indexes.find(s);
+    if( it != m_string_indexes.end() )
+        return it->second;
+    m_strings.push_back(s);
+    m_string_indexes.insert( ::std::make_pair(s, m_strings.size() - 1) );
+    return m_strings.size() - 1;
+}
+size_t FileWriter::add_block(Writer& w)
+{
+    bool is_compressed = w.is_compressed();
+    m_blocks.push_back(Block { is_compressed, w.finish() });
+    return m_blocks.size() - 1;
+}
+void FileWriter::write(size_t root)
+{
+    // The string table is the last block (written after everything that references it)
+    size_t strings_block;
+    {
+        Writer  w;
+        w.write_u64c(m_strings.size());
+        for(const auto& s : m_strings)
+            w.write_string(s);
+        strings_block = add_block(w);
+    }
+
+    // Header: magic, block count, root index, string table index, then (flags, offset, length) for each block
+    ::std::vector<uint8_t>  header(FILE_MAGIC, FILE_MAGIC + sizeof(FILE_MAGIC));
+    put_u32(header, static_cast<uint32_t>(m_blocks.size()));
+    put_u32(header, static_cast<uint32_t>(root));
+    put_u32(header, static_cast<uint32_t>(strings_block));
+    uint64_t    ofs = header.size() + m_blocks.size() * (4 + 8 + 8);
+    for(const auto& b : m_blocks)
+    {
+        put_u32(header, b.is_compressed ? BLOCK_FLAG_COMPRESSED : 0);
+        put_u64(header, ofs);
+        put_u64(header, b.data.size());
+        ofs += b.data.size();
+    }
+
+    ::std::ofstream os(m_path, ::std::ios_base::out | ::std::ios_base::binary);
+    if( !os.is_open() )
+        throw ::std::runtime_error(FMT("Unable to open " << m_path << " for writing"));
+    os.write(reinterpret_cast<const char*>(header.data()), header.size());
+    for(const auto& b : m_blocks)
+    {
+        os.write(reinterpret_cast<const char*>(b.data.data()), b.data.size());
+    }
+    if( !os )
+        throw ::std::runtime_error(FMT("Error writing " << m_path));
+}
+
+FileReader::FileReader(const ::std::string& path):
+    m_path(path),
+    m_data(nullptr),
+    m_size(0),
+    m_root(0)
+{
+#ifndef _WIN32
+    int fd = open(path.c_str(), O_RDONLY);
+    if( fd < 0 )
+        throw ::std::runtime_error("Unable to open file");
+    struct stat st;
+    if( fstat(fd, &st) == 0 && st.st_size > 0 )
+    {
+        void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if( p != MAP_FAILED )
+        {
+            m_data = static_cast<const uint8_t*>(p);
+            m_size = st.st_size;
+        }
+    }
+    close(fd);
+#endif
+    if( !m_data )
+    {
+        ::std::ifstream is(path, ::std::ios_base::in|::std::ios_base::binary);
+        if( !is.is_open() )
+            throw ::std::runtime_error("Unable to open file");
+        m_fallback.assign( ::std::istreambuf_iterator<char>(is), ::std::istreambuf_iterator<char>() );
+        m_data = m_fallback.data();
+        m_size = m_fallback.size();
+    }
+
+    const size_t header_size = sizeof(FILE_MAGIC) + 4 + 4 + 4;
+    if( m_size < header_size || memcmp(m_data, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0 )
+        throw ::std::runtime_error("Not a metadata file, or from an incompatible version");
+    size_t n_blocks = get_u32(m_data + sizeof(FILE_MAGIC));
+    m_root = get_u32(m_data + sizeof(FILE_MAGIC) + 4);
+    size_t strings_block = get_u32(m_data + sizeof(FILE_MAGIC) + 8);
+    if( m_root >= n_blocks || strings_block >= n_blocks || (m_size - header_size) / (4 + 8 + 8) < n_blocks )
+        throw ::std::runtime_error("Corrupted metadata header");
+    m_blocks.reserve(n_blocks);
+    const uint8_t* p = m_data + header_size;
+    for(size_t i = 0; i < n_blocks; i ++, p += 4 + 8 + 8)
+    {
+        auto b = Block { (get_u32(p) & BLOCK_FLAG_COMPRESSED) != 0, get_u64(p + 4), get_u64(p + 4 + 8) };
+        if( b.ofs > m_size || b.len > m_size - b.ofs )
+            throw ::std::runtime_error("Corrupted metadata block table");
+        m_blocks.push_back(b);
+    }
+
+    // Load (and intern) the string table up-front, all other blocks refer to it
+    {
+        Reader  r { *this, strings_block };
+        size_t n_strings = static_cast<size_t>(r.read_u64c());
+        m_strings.reserve(n_strings);
+        for(size_t i = 0; i < n_strings; i ++)
+            m_strings.push_back( RcString(r.read_string()) );
+    }
+}
+FileReader::~FileReader()
+{
+#ifndef _WIN32
+    if( m_data && m_fallback.empty() )
+    {
+        munmap(const_cast<uint8_t*>(m_data), m_size);
+    }
+#endif
+}
+
+
 // --------------------------------------------------------------------
 class ReaderInner
 {
-    ::std::ifstream m_backing;
+    bool    m_compressed;
+    const uint8_t*  m_data;
+    size_t  m_len;
+    size_t  m_ofs = 0;
     z_stream    m_zstream;
-    ::std::vector<unsigned char> m_buffer;
 
     unsigned int    m_byte_out_count = 0;
-    unsigned int    m_byte_in_count = 0;
 public:
-    ReaderInner(const ::std::string& filename);
+    ReaderInner(const FileReader& file, size_t block);
     ~ReaderInner();
     size_t read(void* buf, size_t len);
 };
@@ -184,8 +371,8 @@ void ReadBuffer::populate(ReaderInner& is)
 }
 
 
-Reader::Reader(const ::std::string& filename):
-    m_inner( new ReaderInner(filename) ),
+Reader::Reader(const FileReader& file, size_t block):
+    m_inner( new ReaderInner(file, block) ),
     m_buffer(1024)
 {
 }
@@ -205,25 +392,26 @@ void Reader::read(void* buf, size_t len)
 
     if( len >= m_buffer.capacity() )
     {
-        m_inner->read(buf, len);
+        used = m_inner->read(buf, len);
     }
     else
     {
         m_buffer.populate( *m_inner );
         used = m_buffer.read(buf, len);
-        if( used != len )
-            throw ::std::runtime_error( FMT("Reader::read - Requested " << len << " bytes from buffer, got " << used) );
     }
+    if( used != len )
+        throw ::std::runtime_error( FMT("Reader::read - Requested " << len << " bytes from buffer, got " << used) );
 }
 
 
-ReaderInner::ReaderInner(const ::std::string& filename):
-    m_backing(filename, ::std::ios_base::in|::std::ios_base::binary),
-    m_zstream(),
-    m_buffer(16*1024)
+ReaderInner::ReaderInner(const FileReader& file, size_t block):
+    m_compressed( file.block_is_compressed(block) ),
+    m_data( file.block_data(block).first ),
+    m_len( file.block_data(block).second ),
+    m_zstream()
 {
-    if( !m_backing.is_open() )
-        throw ::std::runtime_error("Unable to open file");
+    if( !m_compressed )
+        return ;
 
     m_zstream.zalloc = Z_NULL;
     m_zstream.zfree = Z_NULL;
@@ -233,32 +421,30 @@ ReaderInner::ReaderInner(const ::std::string& filename):
     if(ret != Z_OK)
         throw ::std::runtime_error("zlib init failure");
 
-    m_zstream.avail_in = 0;
+    // The whole block is already in memory
+    m_zstream.next_in = const_cast<unsigned char*>(m_data);
+    m_zstream.avail_in = m_len;
 }
 ReaderInner::~ReaderInner()
 {
-    inflateEnd(&m_zstream);
+    if( m_compressed )
+    {
+        inflateEnd(&m_zstream);
+    }
 }
 size_t ReaderInner::read(void* buf, size_t len)
 {
+    if( !m_compressed )
+    {
+        size_t n = ::std::min(len, m_len - m_ofs);
+        memcpy(buf, m_data + m_ofs, n);
+        m_ofs += n;
+        return n;
+    }
+
     m_zstream.avail_out = len;
     m_zstream.next_out = reinterpret_cast<unsigned char*>(buf);
     do {
-        // Reset input buffer if empty
-        if( m_zstream.avail_in == 0 )
-        {
-            m_backing.read( reinterpret_cast<char*>(m_buffer.data()), m_buffer.size() );
-            m_zstream.avail_in = m_backing.gcount();
-            if( m_zstream.avail_in == 0 ) {
-                m_byte_out_count += len  - m_zstream.avail_out;
-                //::std::cerr << "Out of bytes, " << m_zstream.avail_out << " needed" << ::std::endl;
-                return len - m_zstream.avail_out;
-            }
-            m_zstream.next_in = const_cast<unsigned char*>(m_buffer.data());
-
-            m_byte_in_count += m_zstream.avail_in;
-        }
-
         int ret = inflate(&m_zstream, Z_NO_FLUSH);
         if(ret == Z_STREAM_ERROR)
             throw ::std::runtime_error("zlib inflate stream error");
@@ -269,10 +455,14 @@ size_t ReaderInner::read(void* buf, size_t len)
         case Z_DATA_ERROR:
         case Z_MEM_ERROR:
             throw ::std::runtime_error("zlib inflate error");
+        case Z_STREAM_END:
+        case Z_BUF_ERROR:
+            // Out of input
+            m_byte_out_count += len - m_zstream.avail_out;
+            return len - m_zstream.avail_out;
         default:
             break;
         }
-
     } while( m_zstream.avail_out > 0 );
     m_byte_out_count += len;
 
@@ -9,8 +9,13 @@
 
 #include <vector>
 #include <string>
+#include <utility>
 #include <stddef.h>
+#include <stdint.h>
 #include <assert.h>
+#include <unordered_map>
+#include <stdexcept>
+#include <rc_string.hpp>
 
 namespace HIR {
 namespace serialise {
@@ -18,16 +23,20 @@ namespace serialise {
 class WriterInner;
 class ReaderInner;
 
+/// Writes a single block of a metadata file to memory (see `FileWriter`)
 class Writer
 {
     WriterInner*    m_inner;
 public:
-    Writer(const ::std::string& path);
+    Writer(bool compress=true);
     Writer(const Writer&) = delete;
     Writer(Writer&&) = delete;
     ~Writer();
 
     void write(const void* data, size_t count);
+    /// Complete the block, returning the (possibly compressed) data
+    ::std::vector<uint8_t> finish();
+    bool is_compressed() const;
 
     void write_u8(uint8_t v) {
         write(reinterpret_cast<const char*>(&v), 1);
@@ -114,16 +123,22 @@ public:
             write_u16( static_cast<uint16_t>(c) );
         }
     }
-    void write_string(const ::std::string& v) {
-        if(v.size() < 128) {
-            write_u8( static_cast<uint8_t>(v.size()) );
+    void write_string(const char* s, size_t len) {
+        if(len < 128) {
+            write_u8( static_cast<uint8_t>(len) );
         }
         else {
-            assert(v.size() < (1u<<(16+7)));
-            write_u8( static_cast<uint8_t>(128 + (v.size() >> 16)) );
-            write_u16( static_cast<uint16_t>(v.size() & 0xFFFF) );
+            assert(len < (1u<<(16+7)));
+            write_u8( static_cast<uint8_t>(128 + (len >> 16)) );
+            write_u16( static_cast<uint16_t>(len & 0xFFFF) );
         }
-        this->write(v.data(), v.size());
+        this->write(s, len);
+    }
+    void write_string(const ::std::string& v) {
+        write_string(v.data(), v.size());
+    }
+    void write_string(const RcString& v) {
+        write_string(v.c_str(), v.size());
     }
     void write_bool(bool v) {
         write_u8(v ? 0xFF : 0x00);
@@ -131,6 +146,69 @@ public:
 };
 
 
+/// Metadata file: a table of contents followed by independently-readable blocks
+/// - The root block holds the crate, other blocks (e.g. MIR bodies) are referenced from it by index and only
+///   read when needed.
+/// - Interned strings (path components, item names) are stored once in a per-file string table, and referenced
+///   from all blocks by index.
+class FileWriter
+{
+    struct Block {
+        bool    is_compressed;
+        ::std::vector<uint8_t>  data;
+    };
+    ::std::string   m_path;
+    ::std::vector<Block>    m_blocks;
+    ::std::unordered_map<RcString, size_t>  m_string_indexes;
+    ::std::vector<RcString> m_strings;
+public:
+    FileWriter(::std::string path);
+
+    /// Get the string table index for a string (adding it if not already present)
+    size_t string_index(const RcString& s);
+    /// Finish a block and add it to the file, returning its index
+    size_t add_block(Writer& w);
+    /// Write the file out, with `root` as the root block
+    void write(size_t root);
+};
+
+/// Read-only view of a metadata file (memory-mapped where supported)
+class FileReader
+{
+    struct Block {
+        bool    is_compressed;
+        uint64_t    ofs;
+        uint64_t    len;
+    };
+    ::std::string   m_path;
+    const uint8_t*  m_data;
+    size_t  m_size;
+    // Holds the file contents when it couldn't be mapped
+    ::std::vector<uint8_t>  m_fallback;
+    ::std::vector<Block>    m_blocks;
+    size_t  m_root;
+    ::std::vector<RcString> m_strings;
+public:
+    FileReader(const ::std::string& path);
+    FileReader(const FileReader&) = delete;
+    FileReader(FileReader&&) = delete;
+    ~FileReader();
+
+    const ::std::string& path() const { return m_path; }
+    size_t root_block() const { return m_root; }
+    const RcString& string(size_t idx) const {
+        if( idx >= m_strings.size() )
+            throw ::std::runtime_error("String table index out of range");
+        return m_strings[idx];
+    }
+    size_t block_count() const { return m_blocks.size(); }
+    bool block_is_compressed(size_t idx) const { return m_blocks.at(idx).is_compressed; }
+    ::std::pair<const uint8_t*, size_t> block_data(size_t idx) const {
+        const auto& b = m_blocks.at(idx);
+        return ::std::make_pair(m_data + b.ofs, static_cast<size_t>(b.len));
+    }
+};
+
 class ReadBuffer
 {
     ::std::vector<uint8_t>  m_backing;
@@ -148,7 +226,8 @@ class Reader
     ReaderInner*    m_inner;
     ReadBuffer  m_buffer;
 public:
-    Reader(const ::std::string& path);
+    /// Read a block of a metadata file (the file must outlive the reader)
+    Reader(const FileReader& file, size_t block);
     Reader(const Writer&) = delete;
     Reader(Writer&&) = delete;
     ~Reader();
@@ -377,6 +377,52 @@ Ordering HIR::TypeRef::ord(const ::HIR::TypeRef& x) const
     )
     throw "";
 }
+size_t HIR::TypeRef::hash_shallow() const
+{
+    // NOTE: Only uses information that `ord` also compares
+    size_t  rv = static_cast<size_t>(m_data.tag());
+    TU_MATCH_DEF(::HIR::TypeRef::Data, (m_data), (te),
+    (
+        ),
+    (Primitive,
+        rv = rv * 31 + static_cast<size_t>(te);
+        ),
+    (Path,
+        if( const auto* pe = te.path.m_data.opt_Generic() ) {
+            if( !pe->m_path.m_components.empty() )
+                rv = rv * 31 + pe->m_path.m_components.back().hash();
+            rv = rv * 31 + pe->m_params.m_types.size();
+        }
+        else if( const auto* pe = te.path.m_data.opt_UfcsKnown() ) {
+            rv = rv * 31 + ::std::hash<::std::string>()(pe->item);
+            rv = rv * 31 + pe->type->hash_shallow();
+        }
+        ),
+    (Generic,
+        rv = rv * 31 + te.binding;
+        ),
+    (Array,
+        rv = rv * 31 + te.inner->hash_shallow();
+        ),
+    (Slice,
+        rv = rv * 31 + te.inner->hash_shallow();
+        ),
+    (Tuple,
+        rv = rv * 31 + te.size();
+        for(const auto& t : te)
+            rv = rv * 31 + static_cast<size_t>(t.m_data.tag());
+        ),
+    (Borrow,
+        rv = rv * 31 + static_cast<size_t>(te.type);
+        rv = rv * 31 + te.inner->hash_shallow();
+        ),
+    (Pointer,
+        rv = rv * 31 + static_cast<size_t>(te.type);
+        rv = rv * 31 + te.inner->hash_shallow();
+        )
+    )
+    return rv;
+}
 bool ::HIR::TypeRef::contains_generics() const
 {
     struct H {
@@ -264,6 +264,8 @@ public:
     bool operator!=(const ::HIR::TypeRef& x) const { return !(*this == x); }
     bool operator<(const ::HIR::TypeRef& x) const { return ord(x) == OrdLess; }
     Ordering ord(const ::HIR::TypeRef& x) const;
+    /// Cheap hash of the outer layers of the type (equal types always give the same value)
+    size_t hash_shallow() const;
 
     bool contains_generics() const;
 
@@ -47,6 +47,29 @@ namespace {
         }
     };
 
+    /// Raised for expressions that are valid in a constant, but that this (HIR-level) evaluator doesn't handle
+    /// - Constant items that raise this are left for the MIR-based evaluation (see hir_expand/const_eval_full.cpp)
+    struct Unsupported
+    {
+        Span    sp;
+        ::std::string   msg;
+    };
+    #define UNSUPPORTED(span, msg)  do { throw Unsupported { span, FMT(msg) }; } while(0)
+
+    /// Run an evaluation whose result is needed now (e.g. array sizes), reporting unsupported expressions as errors
+    template<typename Fcn>
+    ::HIR::Literal evaluate_required(Fcn f)
+    {
+        try
+        {
+            return f();
+        }
+        catch(const Unsupported& e)
+        {
+            ERROR(e.sp, E0000, e.msg);
+        }
+    }
+
     ::HIR::Literal evaluate_constant(const Span& sp, const ::HIR::Crate& crate, NewvalState newval_state, const ::HIR::ExprPtr& expr, ::HIR::TypeRef exp, ::std::vector< ::HIR::Literal> args={});
 
     ::HIR::Literal clone_literal(const ::HIR::Literal& v)
@@ -267,6 +290,9 @@ namespace {
             void badnode(const ::HIR::ExprNode& node) const {
                 ERROR(node.span(), E0000, "Node " << typeid(node).name() << " not allowed in constant expression");
             }
+            void unsupported(const ::HIR::ExprNode& node) const {
+                UNSUPPORTED(node.span(), "Node " << typeid(node).name() << " not supported by HIR constant evaluation");
+            }
 
             void visit(::HIR::ExprNode_Block& node) override {
                 TRACE_FUNCTION_F("_Block");
@@ -284,26 +310,26 @@ namespace {
                 badnode(node);
             }
             void visit(::HIR::ExprNode_Return& node) override {
-                TODO(node.span(), "ExprNode_Return");
+                unsupported(node);
             }
             void visit(::HIR::ExprNode_Let& node) override {
-                badnode(node);
+                unsupported(node);
             }
             void visit(::HIR::ExprNode_Loop& node) override {
-                badnode(node);
+                unsupported(node);
             }
             void visit(::HIR::ExprNode_LoopControl& node) override {
-                badnode(node);
+                unsupported(node);
             }
             void visit(::HIR::ExprNode_Match& node) override {
-                badnode(node);
+                unsupported(node);
             }
             void visit(::HIR::ExprNode_If& node) override {
-                badnode(node);
+                unsupported(node);
             }
 
             void visit(::HIR::ExprNode_Assign& node) override {
-                badnode(node);
+                unsupported(node);
             }
             void visit(::HIR::ExprNode_BinOp& node) override {
                 TRACE_FUNCTION_F("_BinOp");
@@ -566,7 +592,7 @@ namespace {
                 )
             }
             void visit(::HIR::ExprNode_Deref& node) override {
-                badnode(node);
+                unsupported(node);
             }
             void visit(::HIR::ExprNode_Emplace& node) override {
                 badnode(node);
@@ -622,6 +648,10 @@ namespace {
                 if( fcn.m_args.size() != node.m_args.size() ) {
                     ERROR(node.span(), E0000, "Incorrect argument count for " << node.m_path << " - expected " << fcn.m_args.size() << ", got " << node.m_args.size());
                 }
+                // Intrinsics (and other bodyless functions) are only known to the MIR evaluator
+                if( !fcn.m_code && !fcn.m_code.m_mir ) {
+                    UNSUPPORTED(node.span(), "Call of " << node.m_path << ", which has no body");
+                }
                 auto exp_ret_type = mv$( m_exp_type );
 
                 ::std::vector< ::HIR::Literal>  args;
@@ -655,11 +685,11 @@ namespace {
                 }
             }
             void visit(::HIR::ExprNode_CallValue& node) override {
-                badnode(node);
+                unsupported(node);
             }
             void visit(::HIR::ExprNode_CallMethod& node) override {
                 // TODO: const methods
-                badnode(node);
+                unsupported(node);
             }
             void visit(::HIR::ExprNode_Field& node) override {
                 const auto& sp = node.span();
@@ -710,10 +740,10 @@ namespace {
                         m_rv = mv$( vals[idx] );
                         ),
                     (Enum,
-                        TODO(sp, "Field access on enum variant - " << ty);
+                        UNSUPPORTED(sp, "Field access on enum variant - " << ty);
                         ),
                     (Union,
-                        TODO(sp, "Field access on union - " << ty);
+                        UNSUPPORTED(sp, "Field access on union - " << ty);
                         )
                     )
                     ),
@@ -892,12 +922,12 @@ namespace {
                     const auto& ent = m_crate.get_typeitem_by_path(node.span(), node.m_path.m_path);
                     ASSERT_BUG(node.span(), ent.is_Enum(), "_StructLiteral with m_is_struct clear pointing to a " << ent.tag_str());
 
-                    TODO(node.span(), "Handle Enum _UnitVariant - " << node.m_path);
+                    UNSUPPORTED(node.span(), "Handle Enum _UnitVariant - " << node.m_path);
                 }
             }
             void visit(::HIR::ExprNode_UnionLiteral& node) override {
                 TRACE_FUNCTION_FR("_UnionLiteral - " << node.m_path, m_rv);
-                TODO(node.span(), "_UnionLiteral");
+                UNSUPPORTED(node.span(), "_UnionLiteral");
             }
             void visit(::HIR::ExprNode_Tuple& node) override
             {
@@ -1043,19 +1073,19 @@ namespace {
                 return locals[e];
                 ),
             (Static,
-                TODO(sp, "LValue::Static");
+                UNSUPPORTED(sp, "LValue::Static");
                 ),
             (Field,
-                TODO(sp, "LValue::Field");
+                UNSUPPORTED(sp, "LValue::Field");
                 ),
             (Deref,
-                TODO(sp, "LValue::Deref");
+                UNSUPPORTED(sp, "LValue::Deref");
                 ),
             (Index,
-                TODO(sp, "LValue::Index");
+                UNSUPPORTED(sp, "LValue::Index");
                 ),
             (Downcast,
-                TODO(sp, "LValue::Downcast");
+                UNSUPPORTED(sp, "LValue::Downcast");
                 )
             )
             throw "";
@@ -1173,7 +1203,7 @@ namespace {
                     TU_MATCH_DEF(::HIR::TypeRef::Data, (e.type.m_data), (te),
                     (
                         // NOTE: Can be an unsizing!
-                        TODO(sp, "RValue::Cast to " << e.type << ", val = " << inval);
+                        UNSUPPORTED(sp, "RValue::Cast to " << e.type << ", val = " << inval);
                         ),
                     (Primitive,
                         uint64_t mask;
@@ -1223,7 +1253,7 @@ namespace {
                             }
                             break;
                         default:
-                            TODO(sp, "RValue::Cast to " << e.type << ", val = " << inval);
+                            UNSUPPORTED(sp, "RValue::Cast to " << e.type << ", val = " << inval);
                         }
                         ),
                     // Allow casting any integer value to a pointer (TODO: Ensure that the pointer is sized?)
@@ -1246,7 +1276,7 @@ namespace {
                     ASSERT_BUG(sp, inval_l.tag() == inval_r.tag(), "Mismatched literal types in binop - " << inval_l << " and " << inval_r);
                     TU_MATCH_DEF( ::HIR::Literal, (inval_l, inval_r), (l, r),
                     (
-                        TODO(sp, "RValue::BinOp - " << sa.src << ", val = " << inval_l << " , " << inval_r);
+                        UNSUPPORTED(sp, "RValue::BinOp - " << sa.src << ", val = " << inval_l << " , " << inval_r);
                         ),
                     (Float,
                         switch(e.op)
@@ -1260,14 +1290,14 @@ namespace {
                         case ::MIR::eBinOp::SUB_OV:
                         case ::MIR::eBinOp::MUL_OV:
                         case ::MIR::eBinOp::DIV_OV:
-                            TODO(sp, "RValue::BinOp - " << sa.src << ", val = " << inval_l << " , " << inval_r);
+                            UNSUPPORTED(sp, "RValue::BinOp - " << sa.src << ", val = " << inval_l << " , " << inval_r);
 
                         case ::MIR::eBinOp::BIT_OR :
                         case ::MIR::eBinOp::BIT_AND:
                         case ::MIR::eBinOp::BIT_XOR:
                         case ::MIR::eBinOp::BIT_SHL:
                         case ::MIR::eBinOp::BIT_SHR:
-                            TODO(sp, "RValue::BinOp - " << sa.src << ", val = " << inval_l << " , " << inval_r);
+                            UNSUPPORTED(sp, "RValue::BinOp - " << sa.src << ", val = " << inval_l << " , " << inval_r);
                         // TODO: GT/LT are incorrect for signed integers
                         case ::MIR::eBinOp::EQ: val = ::HIR::Literal( static_cast<uint64_t>(l == r) );  break;
                         case ::MIR::eBinOp::NE: val = ::HIR::Literal( static_cast<uint64_t>(l != r) );  break;
@@ -1289,7 +1319,7 @@ namespace {
                         case ::MIR::eBinOp::SUB_OV:
                         case ::MIR::eBinOp::MUL_OV:
                         case ::MIR::eBinOp::DIV_OV:
-                            TODO(sp, "RValue::BinOp - " << sa.src << ", val = " << inval_l << " , " << inval_r);
+                            UNSUPPORTED(sp, "RValue::BinOp - " << sa.src << ", val = " << inval_l << " , " << inval_r);
 
                         case ::MIR::eBinOp::BIT_OR : val = ::HIR::Literal( l | r );  break;
                         case ::MIR::eBinOp::BIT_AND: val = ::HIR::Literal( l & r );  break;
@@ -1336,16 +1366,16 @@ namespace {
                     }
                     ),
                 (DstMeta,
-                    TODO(sp, "RValue::DstMeta");
+                    UNSUPPORTED(sp, "RValue::DstMeta");
                     ),
                 (DstPtr,
-                    TODO(sp, "RValue::DstPtr");
+                    UNSUPPORTED(sp, "RValue::DstPtr");
                     ),
                 (MakeDst,
                     auto ptr = read_param(e.ptr_val);
                     auto meta = read_param(e.meta_val);
                     if( ! meta.is_Integer() ) {
-                        TODO(sp, "RValue::MakeDst - (non-integral meta) " << ptr << " , " << meta);
+                        UNSUPPORTED(sp, "RValue::MakeDst - (non-integral meta) " << ptr << " , " << meta);
                     }
                     else {
                         val = mv$(ptr);
@@ -1366,7 +1396,7 @@ namespace {
                     val = ::HIR::Literal::make_List( mv$(vals) );
                     ),
                 (Variant,
-                    TODO(sp, "MIR _Variant");
+                    UNSUPPORTED(sp, "MIR _Variant");
                     ),
                 (Struct,
                     ::std::vector< ::HIR::Literal>  vals;
@@ -1433,11 +1463,13 @@ namespace {
                 ),
             (Call,
                 if( !e.fcn.is_Path() )
-                    BUG(sp, "Unexpected terminator - " << block.terminator);
+                    UNSUPPORTED(sp, "Call of a non-path - " << block.terminator);
                 const auto& fcnp = e.fcn.as_Path();
 
                 auto& dst = get_lval(e.ret_val);
                 auto& fcn = get_function(sp, crate, fcnp);
+                if( !fcn.m_code && !fcn.m_code.m_mir )
+                    UNSUPPORTED(sp, "Call of " << fcnp << ", which has no body");
 
                 ::std::vector< ::HIR::Literal>  call_args;
                 call_args.reserve( e.args.size() );
@@ -1580,7 +1612,7 @@ namespace {
                     assert(*e.size);
                     const auto& expr_ptr = *e.size;
                     auto nvs = NewvalState { m_new_values, *m_mod_path, FMT("ty_" << &ty << "$") };
-                    auto val = evaluate_constant(expr_ptr->span(), m_crate, nvs, expr_ptr, ::HIR::CoreType::Usize);
+                    auto val = evaluate_required([&](){ return evaluate_constant(expr_ptr->span(), m_crate, mv$(nvs), expr_ptr, ::HIR::CoreType::Usize); });
                     if( !val.is_Integer() )
                         ERROR(expr_ptr->span(), E0000, "Array size isn't an integer");
                     e.size_val = static_cast<size_t>(val.as_Integer());
@@ -1601,8 +1633,21 @@ namespace {
                 //else
                 //    return ;
 
-                auto nvs = NewvalState { m_new_values, *m_mod_path, FMT(p.get_name() << "$") };
-                item.m_value_res = evaluate_constant(item.m_value->span(), m_crate, nvs, item.m_value, item.m_type.clone(), {});
+                // Constants that can't be evaluated from the HIR (e.g. calling a `const fn` with loops) are left for the
+                // MIR-based evaluator, unless they're needed for an array size or discriminant.
+                auto saved_new_values = m_new_values.size();
+                try
+                {
+                    auto nvs = NewvalState { m_new_values, *m_mod_path, FMT(p.get_name() << "$") };
+                    item.m_value_res = evaluate_constant(item.m_value->span(), m_crate, mv$(nvs), item.m_value, item.m_type.clone(), {});
+                }
+                catch(const Unsupported& e)
+                {
+                    DEBUG("constant: " << p << " deferred to the full evaluation - " << e.sp << ": " << e.msg);
+                    m_new_values.erase(m_new_values.begin() + saved_new_values, m_new_values.end());
+                    item.m_value_res = ::HIR::Literal();
+                    return ;
+                }
 
                 check_lit_type(item.m_value->span(), item.m_type, item.m_value_res);
 
@@ -1617,7 +1662,7 @@ namespace {
                 {
                     if( var.expr )
                     {
-                        auto val = evaluate_constant(var.expr->span(), m_crate, NewvalState { m_new_values, *m_mod_path, FMT(p.get_name() << "$" << var.name << "$") }, var.expr, {});
+                        auto val = evaluate_required([&](){ return evaluate_constant(var.expr->span(), m_crate, NewvalState { m_new_values, *m_mod_path, FMT(p.get_name() << "$" << var.name << "$") }, var.expr, {}); });
                         DEBUG("enum variant: " << p << "::" << var.name << " = " << val);
                         i = val.as_Integer();
                     }
@@ -1662,7 +1707,7 @@ namespace {
                 void visit(::HIR::ExprNode_ArraySized& node) override {
                     assert( node.m_size );
                     NewvalState nvs { m_exp.m_new_values, *m_exp.m_mod_path, FMT("array_" << &node << "$") };
-                    auto val = evaluate_constant_hir(node.span(), m_exp.m_crate, mv$(nvs), *node.m_size, ::HIR::CoreType::Usize, {});
+                    auto val = evaluate_required([&](){ return evaluate_constant_hir(node.span(), m_exp.m_crate, mv$(nvs), *node.m_size, ::HIR::CoreType::Usize, {}); });
                     if( !val.is_Integer() )
                         ERROR(node.span(), E0000, "Array size isn't an integer");
                     node.m_size_val = static_cast<size_t>(val.as_Integer());
@@ -295,7 +295,7 @@ namespace {
                 mv$(params), mv$(trait_params), mv$(closure_type),
                 make_map1(
                     ::std::string("call_once"), ::HIR::TraitImpl::ImplEnt< ::HIR::Function> { false, ::HIR::Function {
-                        false, ::HIR::Linkage {},
+                        false, ::HIR::Linkage {}, ::HIR::Function::InlineHint::Default,
                         ::HIR::Function::Receiver::Value,
                         ABI_RUST, false, false,
                         {},
@@ -333,7 +333,7 @@ namespace {
                 mv$(params), mv$(trait_params), mv$(closure_type),
                 make_map1(
                     ::std::string("call_mut"), ::HIR::TraitImpl::ImplEnt< ::HIR::Function> { false, ::HIR::Function {
-                        false, ::HIR::Linkage {},
+                        false, ::HIR::Linkage {}, ::HIR::Function::InlineHint::Default,
                         ::HIR::Function::Receiver::BorrowUnique,
                         ABI_RUST, false, false,
                         {},
@@ -369,7 +369,7 @@ namespace {
                 mv$(params), mv$(trait_params), mv$(closure_type),
                 make_map1(
                     ::std::string("call"), ::HIR::TraitImpl::ImplEnt< ::HIR::Function> { false, ::HIR::Function {
-                        false, ::HIR::Linkage {},
+                        false, ::HIR::Linkage {}, ::HIR::Function::InlineHint::Default,
                         ::HIR::Function::Receiver::BorrowShared,
                         ABI_RUST, false, false,
                         {},
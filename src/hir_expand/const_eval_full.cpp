@@ -16,6 +16,12 @@
 #include <mir/mir.hpp>
 #include <hir_typeck/common.hpp>    // Monomorph
 #include <mir/helpers.hpp>
+#include <trans/target.hpp>
+#include <memory>
+#include <map>
+#include <mutex>
+#include <cstring>
+#include <cmath>
 
 namespace {
     typedef ::std::vector< ::std::pair< ::std::string, ::HIR::Static> > t_new_values;
@@ -52,8 +58,6 @@ namespace {
         }
     };
 
-    ::HIR::Literal evaluate_constant(const Span& sp, const ::StaticTraitResolve& resolve, NewvalState& newval_state, FmtLambda name, const ::HIR::ExprPtr& expr, MonomorphState ms, ::std::vector< ::HIR::Literal> args);
-
     ::HIR::Literal clone_literal(const ::HIR::Literal& v)
     {
         TU_MATCH(::HIR::Literal, (v), (e),
@@ -228,6 +232,7 @@ namespace {
                 return false;
                 });
             out_ms = MonomorphState {};
+            out_ms.self_ty = &*e.type;
             out_ms.pp_method = &e.params;
             out_ms.pp_impl = &e.impl_params;
             return rv;
@@ -265,6 +270,7 @@ namespace {
                 return false;
                 });
             out_ms = MonomorphState {};
+            out_ms.self_ty = &*e.type;
             out_ms.pp_method = &e.params;
             // TODO: How to get pp_impl here? Needs specialisation magic.
             return rv;
@@ -287,503 +293,1833 @@ namespace {
         }
     }
 
-    ::HIR::Literal evaluate_constant_mir(const Span& sp, const StaticTraitResolve& resolve, NewvalState& newval_state, FmtLambda name, const ::MIR::Function& fcn, MonomorphState ms, ::std::vector< ::HIR::Literal> args)
+    // --------------------------------------------------------------------
+    // Interpreter memory
+    // --------------------------------------------------------------------
+    /// Maximum number of MIR statements/terminators executed for a single item
+    const unsigned int CONST_EVAL_STEP_LIMIT = 10*1000*1000;
+    /// Maximum depth of `const fn` calls
+    const unsigned int CONST_EVAL_CALL_DEPTH_LIMIT = 128;
+
+    size_t target_ptr_size() {
+        return Target_GetCurSpec().m_arch.m_pointer_bits / 8;
+    }
+    bool target_is_big_endian() {
+        return Target_GetCurSpec().m_arch.m_big_endian;
+    }
+
+    /// Size and signedness of integer-like primitives (including `bool` and `char`)
+    bool get_int_info(::HIR::CoreType ct, size_t& out_size, bool& out_signed)
+    {
+        switch(ct)
+        {
+        case ::HIR::CoreType::Bool:
+        case ::HIR::CoreType::U8:   out_size = 1;   out_signed = false; return true;
+        case ::HIR::CoreType::I8:   out_size = 1;   out_signed = true;  return true;
+        case ::HIR::CoreType::U16:  out_size = 2;   out_signed = false; return true;
+        case ::HIR::CoreType::I16:  out_size = 2;   out_signed = true;  return true;
+        case ::HIR::CoreType::Char:
+        case ::HIR::CoreType::U32:  out_size = 4;   out_signed = false; return true;
+        case ::HIR::CoreType::I32:  out_size = 4;   out_signed = true;  return true;
+        case ::HIR::CoreType::U64:  out_size = 8;   out_signed = false; return true;
+        case ::HIR::CoreType::I64:  out_size = 8;   out_signed = true;  return true;
+        case ::HIR::CoreType::U128: out_size = 16;  out_signed = false; return true;
+        case ::HIR::CoreType::I128: out_size = 16;  out_signed = true;  return true;
+        case ::HIR::CoreType::Usize: out_size = target_ptr_size(); out_signed = false; return true;
+        case ::HIR::CoreType::Isize: out_size = target_ptr_size(); out_signed = true;  return true;
+        case ::HIR::CoreType::F32:
+        case ::HIR::CoreType::F64:
+        case ::HIR::CoreType::Str:
+            return false;
+        }
+        return false;
+    }
+    /// Truncate to `size` bytes, then zero/sign extend back to 64 bits (the form used by `HIR::Literal::Integer`)
+    uint64_t canonicalise_int(uint64_t v, size_t size, bool is_signed)
     {
-        TRACE_FUNCTION;
+        if( size >= 8 )
+            return v;
+        unsigned int bits = size * 8;
+        uint64_t mask = (1ull << bits) - 1;
+        v &= mask;
+        if( is_signed && (v >> (bits-1)) )
+            v |= ~mask;
+        return v;
+    }
 
-        ::MIR::TypeResolve  state { sp, resolve, name, ::HIR::TypeRef(), {}, fcn };
+    struct Allocation;
+    typedef ::std::shared_ptr<Allocation>   AllocationPtr;
 
-        ::HIR::Literal  retval;
-        ::std::vector< ::HIR::Literal>  locals( fcn.locals.size() );
+    /// Raw bytes, laid out as the target would lay them out
+    /// - A pointer is stored as its offset within the target allocation, with the allocation itself recorded in
+    ///   `relocs` (keyed by the offset of the pointer). Pointers without a relocation are plain integers.
+    struct Memory
+    {
+        ::std::vector<uint8_t>  bytes;
+        ::std::map<size_t, AllocationPtr>   relocs;
 
-        struct LocalState {
-            typedef ::std::vector< ::HIR::Literal>  t_vec_lit;
-            ::MIR::TypeResolve& state;
-            ::HIR::Literal&  retval;
-            ::std::vector< ::HIR::Literal>&  args;
-            ::std::vector< ::HIR::Literal>&  locals;
+        Memory() {}
+        explicit Memory(size_t size):
+            bytes(size)
+        {}
 
-            LocalState(::MIR::TypeResolve& state, ::HIR::Literal& retval, t_vec_lit& args, t_vec_lit& locals):
-                state(state),
-                retval(retval),
-                args(args),
-                locals(locals)
-            {}
+        size_t size() const { return bytes.size(); }
 
-            ::HIR::Literal& get_lval(const ::MIR::LValue& lv)
-            {
-                TU_MATCHA( (lv), (e),
-                (Return,
-                    return retval;
-                    ),
-                (Local,
-                    if( e >= locals.size() )
-                        MIR_BUG(state, "Local index out of range - " << e << " >= " << locals.size());
-                    return locals[e];
-                    ),
-                (Argument,
-                    if( e.idx >= args.size() )
-                        MIR_BUG(state, "Local index out of range - " << e.idx << " >= " << args.size());
-                    return args[e.idx];
-                    ),
-                (Static,
-                    MIR_TODO(state, "LValue::Static - " << e);
-                    ),
-                (Field,
-                    auto& val = get_lval(*e.val);
-                    MIR_ASSERT(state, val.is_List(), "LValue::Field on non-list literal - " << val.tag_str() << " - " << lv);
-                    auto& vals = val.as_List();
-                    MIR_ASSERT(state, e.field_index < vals.size(), "LValue::Field index out of range");
-                    return vals[ e.field_index ];
-                    ),
-                (Deref,
-                    auto& val = get_lval(*e.val);
-                    TU_MATCH_DEF( ::HIR::Literal, (val), (ve),
-                    (
-                        MIR_TODO(state, "LValue::Deref - " << lv << " { " << val << " }");
-                        ),
-                    (String,
-                        // Just clone the string (hack)
-                        // - TODO: Create a list?
-                        return val;
-                        )
-                    )
-                    ),
-                (Index,
-                    auto& val = get_lval(*e.val);
-                    MIR_ASSERT(state, val.is_List(), "LValue::Index on non-list literal - " << val.tag_str() << " - " << lv);
-                    auto& idx = get_lval(*e.idx);
-                    MIR_ASSERT(state, idx.is_Integer(), "LValue::Index with non-integer index literal - " << idx.tag_str() << " - " << lv);
-                    auto& vals = val.as_List();
-                    auto idx_v = static_cast<size_t>( idx.as_Integer() );
-                    MIR_ASSERT(state, idx_v < vals.size(), "LValue::Index index out of range");
-                    return vals[ idx_v ];
-                    ),
-                (Downcast,
-                    MIR_TODO(state, "LValue::Downcast - " << lv);
-                    )
-                )
-                throw "";
-            }
+        uint64_t read_uint(size_t ofs, size_t size) const {
+            assert(size <= 8);
+            assert(ofs + size <= bytes.size());
+            bool be = target_is_big_endian();
+            uint64_t rv = 0;
+            for(size_t i = 0; i < size; i ++)
+                rv |= static_cast<uint64_t>(bytes[ofs + (be ? size - 1 - i : i)]) << (8*i);
+            return rv;
+        }
+        void write_uint(size_t ofs, size_t size, uint64_t v) {
+            assert(size <= 8);
+            assert(ofs + size <= bytes.size());
+            bool be = target_is_big_endian();
+            for(size_t i = 0; i < size; i ++)
+                bytes[ofs + (be ? size - 1 - i : i)] = static_cast<uint8_t>(v >> (8*i));
+            clear_relocs(ofs, size);
+        }
+
+        const AllocationPtr* get_reloc(size_t ofs) const {
+            auto it = relocs.find(ofs);
+            return it != relocs.end() ? &it->second : nullptr;
+        }
+        void write_pointer(size_t ofs, AllocationPtr target, size_t target_ofs) {
+            write_uint(ofs, target_ptr_size(), target_ofs);
+            relocs[ofs] = mv$(target);
+        }
+        /// Remove all relocations overlapping the given range
+        void clear_relocs(size_t ofs, size_t size) {
+            size_t ptr_size = target_ptr_size();
+            auto it = relocs.lower_bound(ofs >= ptr_size ? ofs - ptr_size + 1 : 0);
+            while( it != relocs.end() && it->first < ofs + size )
+                it = relocs.erase(it);
+        }
+        void copy_from(size_t dst_ofs, const Memory& src, size_t src_ofs, size_t size) {
+            assert(&src != this);
+            assert(dst_ofs + size <= bytes.size());
+            assert(src_ofs + size <= src.bytes.size());
+            ::std::copy(src.bytes.begin() + src_ofs, src.bytes.begin() + src_ofs + size, bytes.begin() + dst_ofs);
+            clear_relocs(dst_ofs, size);
+            for(auto it = src.relocs.lower_bound(src_ofs); it != src.relocs.end() && it->first < src_ofs + size; ++it)
+                relocs[it->first - src_ofs + dst_ofs] = it->second;
+        }
+    };
+    struct Allocation:
+        public Memory
+    {
+        /// Path of the item backing this memory (a static, function or vtable), pointers to it become `BorrowPath`
+        ::std::unique_ptr< ::HIR::Path> item_path;
+        /// Type of a static
+        ::HIR::TypeRef  item_ty;
+        /// Cleared for statics until their value is read
+        bool    is_loaded = true;
+        /// Data from a string literal, borrows of it become `Literal::String`
+        bool    is_string = false;
+        /// Statics created from borrows of this memory, keyed by offset and type
+        ::std::map< ::std::pair<size_t, ::HIR::TypeRef>, ::HIR::Path>   exported;
+
+        Allocation(size_t size):
+            Memory(size)
+        {}
+    };
+
+    uint64_t read_int(const Memory& mem, size_t ofs, size_t size, bool is_signed)
+    {
+        // NOTE: 128-bit integers are only handled to 64 bits (same as `HIR::Literal`)
+        if( size == 16 )
+            return mem.read_uint(ofs + (target_is_big_endian() ? 8 : 0), 8);
+        return canonicalise_int(mem.read_uint(ofs, size), size, is_signed);
+    }
+    void write_int(Memory& mem, size_t ofs, size_t size, bool is_signed, uint64_t v)
+    {
+        if( size == 16 )
+        {
+            bool be = target_is_big_endian();
+            mem.write_uint(ofs + (be ? 8 : 0), 8, v);
+            mem.write_uint(ofs + (be ? 0 : 8), 8, (is_signed && (v >> 63)) ? ~0ull : 0);
+            return ;
+        }
+        mem.write_uint(ofs, size, v);
+    }
+    double read_float(const Memory& mem, size_t ofs, size_t size)
+    {
+        if( size == 4 ) {
+            auto bits = static_cast<uint32_t>(mem.read_uint(ofs, 4));
+            float rv;
+            ::std::memcpy(&rv, &bits, 4);
+            return rv;
+        }
+        else {
+            auto bits = mem.read_uint(ofs, 8);
+            double rv;
+            ::std::memcpy(&rv, &bits, 8);
+            return rv;
+        }
+    }
+    void write_float(Memory& mem, size_t ofs, size_t size, double v)
+    {
+        if( size == 4 ) {
+            float fv = static_cast<float>(v);
+            uint32_t bits;
+            ::std::memcpy(&bits, &fv, 4);
+            mem.write_uint(ofs, 4, bits);
+        }
+        else {
+            uint64_t bits;
+            ::std::memcpy(&bits, &v, 8);
+            mem.write_uint(ofs, 8, bits);
+        }
+    }
+
+    /// A typed value (result of reading a lvalue or constant)
+    struct Value
+    {
+        ::HIR::TypeRef  ty;
+        Memory  mem;
+    };
+    /// Location of a lvalue
+    struct Place
+    {
+        AllocationPtr   alloc;
+        size_t  ofs;
+        ::HIR::TypeRef  ty;
+        /// Metadata for unsized places, the element count of a slice/str or the vtable of a trait object
+        uint64_t    meta_len;
+        AllocationPtr   meta_vtable;
+    };
+
+    enum class MetadataKind {
+        None,
+        Slice,
+        TraitObject,
+    };
+
+    /// State shared by all evaluations in a crate
+    struct EvalCache
+    {
+        struct CachedValue {
+            bool    in_progress = true;
+            ::HIR::TypeRef  ty;
+            ::HIR::Literal  lit;
+            Memory  mem;
+        };
+        struct FieldInfo {
+            size_t  ofs;
+            const ::HIR::TypeRef*   ty;
+        };
+
+        /// Memoised values of constants and statics, keyed by the (monomorphised) path
+        ::std::map< ::HIR::Path, CachedValue>  values;
+        /// Memory for items (statics, functions and vtables)
+        ::std::map< ::HIR::Path, AllocationPtr>    items;
+        /// Field offsets (in declaration order) for struct layouts
+        ::std::map<const StructRepr*, ::std::vector<FieldInfo> > fields;
+        /// Offset of the data in tagged enums
+        ::std::map< ::HIR::TypeRef, size_t>    enum_data_ofs;
+    };
+
+    // --------------------------------------------------------------------
+    // MIR interpreter
+    // --------------------------------------------------------------------
+    class Evaluator
+    {
+        typedef EvalCache::CachedValue  CachedValue;
+        typedef EvalCache::FieldInfo    FieldInfo;
+
+        struct Frame
+        {
+            const ::MIR::TypeResolve&   state;
+            const MonomorphState&   ms;
+            const ::HIR::TypeRef&   ret_ty;
+
+            AllocationPtr   ret;
+            ::std::vector<AllocationPtr>    args;
+            ::std::vector< ::HIR::TypeRef>  arg_tys;
+            // Allocated on first use
+            ::std::vector<AllocationPtr>    locals;
+            ::std::vector<const ::HIR::TypeRef*>    local_tys;
+            ::std::vector< ::HIR::TypeRef>  local_ty_storage;
         };
-        LocalState  local_state( state, retval, args, locals );
 
-        auto get_lval = [&](const ::MIR::LValue& lv) -> ::HIR::Literal& { return local_state.get_lval(lv); };
-        auto read_lval = [&](const ::MIR::LValue& lv) -> ::HIR::Literal {
-            auto& v = get_lval(lv);
-            TU_MATCH_DEF(::HIR::Literal, (v), (e),
+        const Span& sp;
+        const StaticTraitResolve&   m_resolve;
+        EvalCache&  m_cache;
+        NewvalState&    m_newval_state;
+
+        unsigned int    m_steps_left;
+        unsigned int    m_call_depth;
+
+        size_t  m_ptr_size;
+
+    public:
+        Evaluator(const Span& sp, const StaticTraitResolve& resolve, EvalCache& cache, NewvalState& newval_state):
+            sp(sp),
+            m_resolve(resolve),
+            m_cache(cache),
+            m_newval_state(newval_state),
+            m_steps_left(CONST_EVAL_STEP_LIMIT),
+            m_call_depth(0),
+            m_ptr_size(target_ptr_size())
+        {
+        }
+
+        /// Evaluate an anonymous expression (e.g. an enum discriminant)
+        ::HIR::Literal evaluate(FmtLambda name, const ::HIR::ExprPtr& expr, const ::HIR::TypeRef& ty)
+        {
+            static const ::HIR::Function::args_t    s_no_args;
+            if( !expr.m_mir )
+                BUG(sp, "Attempting to evaluate constant expression with no associated code");
+            auto v = run_mir(name, *expr.m_mir, MonomorphState {}, s_no_args, ty.clone(), {});
+            return read_literal(v.mem, 0, ty);
+        }
+        /// Evaluate (or get the memoised value of) a constant/static being visited
+        const CachedValue& evaluate_item(const ::HIR::Path& path, const ::HIR::TypeRef& ty, const ::HIR::ExprPtr& expr)
+        {
+            auto it = m_cache.values.find(path);
+            if( it != m_cache.values.end() )
+                return check_cached(path, it->second);
+            return evaluate_value(path, MonomorphState {}, ty, expr, ::HIR::Literal());
+        }
+        /// Evaluate (or get the memoised value of) a constant used with concrete parameters
+        const ::HIR::Literal& evaluate_path(const ::HIR::Path& path)
+        {
+            return get_value(path).lit;
+        }
+
+    private:
+        // ----
+        // Layout
+        // ----
+        ::HIR::TypeRef monomorph(const MonomorphState& ms, const ::HIR::TypeRef& ty) const
+        {
+            // NOTE: Items in generic impls are evaluated without parameters, so leave their types generic
+            if( !monomorphise_type_needed(ty) || !(ms.self_ty || ms.pp_impl || ms.pp_method) )
+                return ty.clone();
+            auto rv = ms.monomorph(sp, ty);
+            m_resolve.expand_associated_types(sp, rv);
+            return rv;
+        }
+        ::HIR::Path monomorph(const MonomorphState& ms, const ::HIR::Path& path) const
+        {
+            if( !monomorphise_path_needed(path) || !(ms.self_ty || ms.pp_impl || ms.pp_method) )
+                return path.clone();
+            return ms.monomorph(sp, path);
+        }
+
+        void get_size_align(const ::HIR::TypeRef& ty, size_t& out_size, size_t& out_align) const
+        {
+            if( !Target_GetSizeAndAlignOf(sp, m_resolve, ty, out_size, out_align) )
+                ERROR(sp, E0000, "Unable to determine the layout of " << ty << " during constant evaluation");
+        }
+        size_t get_size(const ::HIR::TypeRef& ty) const
+        {
+            size_t  size, align;
+            get_size_align(ty, size, align);
+            return size;
+        }
+
+        MetadataKind get_metadata_kind(const ::HIR::TypeRef& ty) const
+        {
+            TU_MATCH_DEF( ::HIR::TypeRef::Data, (ty.m_data), (te),
             (
-                return mv$(v);
-                ),
-            (Invalid,
-                BUG(sp, "Read of lvalue with Literal::Invalid - " << lv);
-                ),
-            (BorrowPath,
-                return ::HIR::Literal(e.clone());
-                ),
-            (Integer,
-                return ::HIR::Literal(e);
-                ),
-            (Float,
-                return ::HIR::Literal(e);
-                )
-            )
-            };
-        auto const_to_lit = [&](const ::MIR::Constant& c)->::HIR::Literal {
-            TU_MATCH(::MIR::Constant, (c), (e2),
-            (Int,
-                return ::HIR::Literal(static_cast<uint64_t>(e2.v));
+                if( m_resolve.type_is_sized(sp, ty) )
+                    return MetadataKind::None;
+                // Structs with an unsized final field
+                if( ty.m_data.is_Path() && ty.m_data.as_Path().binding.is_Struct() )
+                {
+                    const auto& str = *ty.m_data.as_Path().binding.as_Struct();
+                    const ::HIR::TypeRef* last = nullptr;
+                    if( const auto* se = str.m_data.opt_Tuple() ) {
+                        if( !se->empty() )
+                            last = &se->back().ent;
+                    }
+                    else if( const auto* se = str.m_data.opt_Named() ) {
+                        if( !se->empty() )
+                            last = &se->back().second.ent;
+                    }
+                    if( last ) {
+                        auto inner = monomorphise_type(sp, str.m_params, ty.m_data.as_Path().path.m_data.as_Generic().m_params, *last);
+                        m_resolve.expand_associated_types(sp, inner);
+                        return get_metadata_kind(inner);
+                    }
+                }
+                TODO(sp, "Pointer metadata for " << ty);
                 ),
-            (Uint,
-                return ::HIR::Literal(e2.v);
+            (Primitive,
+                return te == ::HIR::CoreType::Str ? MetadataKind::Slice : MetadataKind::None;
                 ),
-            (Float,
-                return ::HIR::Literal(e2.v);
+            (Slice,
+                return MetadataKind::Slice;
                 ),
-            (Bool,
-                return ::HIR::Literal(static_cast<uint64_t>(e2.v));
+            (TraitObject,
+                return MetadataKind::TraitObject;
                 ),
-            (Bytes,
-                return ::HIR::Literal::make_String({e2.begin(), e2.end()});
+            (Tuple,
+                return MetadataKind::None;
                 ),
-            (StaticString,
-                return ::HIR::Literal(e2);
+            (Array,
+                return MetadataKind::None;
                 ),
-            (Const,
-                MonomorphState  const_ms;
-                // TODO: Monomorph the path? (Not needed... yet)
-                auto ent = get_ent_fullpath(sp, resolve.m_crate, e2.p, EntNS::Value,  const_ms);
-                ASSERT_BUG(sp, ent.is_Constant(), "MIR Constant::Const("<<e2.p<<") didn't point to a Constant - " << ent.tag_str());
-                const auto& c = *ent.as_Constant();
-                // Prefer re-evaluating the MIR.
-                // - Constants insert themselves directly, so this is
-                //   effectively the same thing.
-                // Avoids _BorrowData leftovers.
-                if( c.m_value ) {
-                    return evaluate_constant(sp, resolve, newval_state, FMT_CB(ss, ss << e2.p;), ent.as_Constant()->m_value, {}, {});
-                }
-                else {
-                    auto val = clone_literal( ent.as_Constant()->m_value_res );
-                    ASSERT_BUG(sp, !val.is_Invalid(), "MIR Constant::Const("<<e2.p<<") pointed to invalid Constant - (no mir, no literal)");
-                    // Monomorphise the value according to `const_ms`
-                    monomorph_literal_inplace(sp, val, const_ms);
-                    return val;
-                }
+            (Borrow,
+                return MetadataKind::None;
                 ),
-            (ItemAddr,
-                return ::HIR::Literal::make_BorrowPath( ms.monomorph(sp, e2) );
-                )
-            )
-            throw "";
-            };
-        auto read_param = [&](const ::MIR::Param& p) ->::HIR::Literal {
-            TU_MATCH(::MIR::Param, (p), (e),
-            (LValue,
-                return read_lval(e);
+            (Pointer,
+                return MetadataKind::None;
                 ),
-            (Constant,
-                return const_to_lit(e);
+            (Function,
+                return MetadataKind::None;
                 )
             )
             throw "";
-            };
+        }
 
-        unsigned int cur_block = 0;
-        for(;;)
+        /// Offsets and types of the fields of a struct/tuple (in declaration order)
+        const ::std::vector<FieldInfo>& get_fields(const ::HIR::TypeRef& ty)
         {
-            const auto& block = fcn.blocks[cur_block];
-            unsigned int next_stmt_idx = 0;
-            for(const auto& stmt : block.statements)
-            {
-                state.set_cur_stmt(cur_block, next_stmt_idx++);
+            const auto* repr = Target_GetStructRepr(sp, m_resolve, ty);
+            if( !repr )
+                ERROR(sp, E0000, "Unable to determine the layout of " << ty << " during constant evaluation");
+            auto it = m_cache.fields.find(repr);
+            if( it != m_cache.fields.end() )
+                return it->second;
 
-                if( ! stmt.is_Assign() ) {
-                    //BUG(sp, "Non-assign statement - drop " << stmt.as_Drop().slot);
-                    continue ;
+            ::std::vector<FieldInfo>    rv;
+            size_t  ofs = 0;
+            for(const auto& e : repr->ents)
+            {
+                if( e.field_idx != ~0u )
+                {
+                    if( rv.size() <= e.field_idx )
+                        rv.resize(e.field_idx + 1);
+                    rv[e.field_idx] = FieldInfo { ofs, &e.ty };
                 }
-                const auto& sa = stmt.as_Assign();
-
-                DEBUG(sa.dst << " = " << sa.src);
-                ::HIR::Literal  val;
-                TU_MATCHA( (sa.src), (e),
-                (Use,
-                    val = read_lval(e);
-                    ),
-                (Constant,
-                    val = const_to_lit(e);
-                    ),
-                (SizedArray,
-                    ::std::vector< ::HIR::Literal>  vals;
-                    if( e.count > 0 )
-                    {
-                        vals.reserve( e.count );
-                        val = read_param(e.val);
-                        for(unsigned int i = 1; i < e.count; i++)
-                            vals.push_back( clone_literal(val) );
-                        vals.push_back( mv$(val) );
-                    }
-                    val = ::HIR::Literal::make_List( mv$(vals) );
-                    ),
-                (Borrow,
-                    if( e.type != ::HIR::BorrowType::Shared ) {
-                        MIR_BUG(state, "Only shared borrows are allowed in constants");
-                    }
-                    if( const auto* p = e.val.opt_Deref() ) {
-                        if( p->val->is_Deref() )
-                            MIR_TODO(state, "Undo nested deref coercion - " << *p->val);
-                        val = read_lval(*p->val);
-                    }
-                    else if( const auto* p = e.val.opt_Static() ) {
-                        // Borrow of a static, emit BorrowPath with the same path
-                        val = ::HIR::Literal::make_BorrowPath( p->clone() );
-                    }
-                    else {
-                        auto inner_val = read_lval(e.val);
-
-                        ::HIR::TypeRef  inner_ty;
-                        const auto& inner_ty_r = state.get_lvalue_type(inner_ty, e.val);
-                        if( &inner_ty_r != &inner_ty )
-                            inner_ty = inner_ty_r.clone();
+                ofs += e.size;
+            }
+            return m_cache.fields.insert( ::std::make_pair(repr, mv$(rv)) ).first->second;
+        }
+        ::HIR::TypeRef get_union_field_type(const ::HIR::TypeRef& ty, unsigned int idx) const
+        {
+            const auto& te = ty.m_data.as_Path();
+            const auto& unm = *te.binding.as_Union();
+            ASSERT_BUG(sp, idx < unm.m_variants.size(), "Union field index out of range - " << idx << " for " << ty);
+            auto rv = monomorphise_type(sp, unm.m_params, te.path.m_data.as_Generic().m_params, unm.m_variants[idx].second.ent);
+            m_resolve.expand_associated_types(sp, rv);
+            return rv;
+        }
 
-                        // Create new static containing borrowed data
-                        // NOTE: Doesn't use BorrowData
-                        auto item_path = newval_state.new_static( mv$(inner_ty), mv$(inner_val) );
-                        val = ::HIR::Literal::make_BorrowPath( mv$(item_path) );
-                    }
-                    ),
-                (Cast,
-                    auto inval = read_lval(e.val);
-                    TU_MATCH_DEF(::HIR::TypeRef::Data, (e.type.m_data), (te),
-                    (
-                        // NOTE: Can be an unsizing!
-                        TODO(sp, "RValue::Cast to " << e.type << ", val = " << inval);
-                        ),
-                    (Primitive,
-                        auto cast_to_int = [&inval,&e,&sp](bool is_signed, unsigned bits) {
-                            uint64_t mask = (bits >= 64 ? ~0ull : (1ull << bits) - 1);
-                            uint64_t outval;
-                            TU_IFLET( ::HIR::Literal, inval, Integer, i,
-                                outval = i & mask;
-                                if( bits < 64 && is_signed && (outval >> (bits-1)) )
-                                    outval |= ~mask;
-                            )
-                            else TU_IFLET( ::HIR::Literal, inval, Float, i,
-                                outval = static_cast<uint64_t>(i) & mask;
-                                if( is_signed && i < 0 )
-                                    outval |= ~mask;
-                            )
-                            else {
-                                BUG(sp, "Invalid cast of " << inval.tag_str() << " to " << e.type);
-                            }
-                            return ::HIR::Literal(outval);
-                            };
-                        switch(te)
-                        {
-                        // Integers mask down
-                        case ::HIR::CoreType::I8:   val = cast_to_int(true , 8);    break;
-                        case ::HIR::CoreType::U8:   val = cast_to_int(false, 8);    break;
-                        case ::HIR::CoreType::I16:  val = cast_to_int(true , 16);   break;
-                        case ::HIR::CoreType::U16:  val = cast_to_int(false, 16);   break;
-                        case ::HIR::CoreType::I32:  val = cast_to_int(true , 32);   break;
-                        case ::HIR::CoreType::U32:  val = cast_to_int(false, 32);   break;
-
-                        case ::HIR::CoreType::I64:  val = cast_to_int(true , 64);   break;
-                        case ::HIR::CoreType::U64:  val = cast_to_int(false, 64);   break;
-                        case ::HIR::CoreType::I128: val = cast_to_int(true , 64);   break;
-                        case ::HIR::CoreType::U128: val = cast_to_int(false, 64);   break;
-                        case ::HIR::CoreType::Isize: val = cast_to_int(true , 64);   break;
-                        case ::HIR::CoreType::Usize: val = cast_to_int(false, 64);   break;
-
-                        case ::HIR::CoreType::F32:
-                        case ::HIR::CoreType::F64:
-                            TU_IFLET( ::HIR::Literal, inval, Integer, i,
-                                val = ::HIR::Literal( static_cast<double>(i) );
-                            )
-                            else TU_IFLET( ::HIR::Literal, inval, Float, i,
-                                val = ::HIR::Literal( i );
-                            )
-                            else {
-                                BUG(sp, "Invalid cast of " << inval.tag_str() << " to " << e.type);
-                            }
-                            break;
-                        default:
-                            TODO(sp, "RValue::Cast to " << e.type << ", val = " << inval);
-                        }
-                        ),
-                    // Allow casting any integer value to a pointer (TODO: Ensure that the pointer is sized?)
-                    (Pointer,
-                        TU_IFLET( ::HIR::Literal, inval, Integer, i,
-                            val = ::HIR::Literal(i);
-                        )
-                        else if( inval.is_BorrowData() || inval.is_BorrowPath() ) {
-                            val = mv$(inval);
-                        }
-                        else {
-                            BUG(sp, "Invalid cast of " << inval.tag_str() << " to " << e.type);
-                        }
-                        ),
-                    (Borrow,
-                        if( inval.is_BorrowData() || inval.is_BorrowPath() ) {
-                            val = mv$(inval);
-                        }
-                        else {
-                            BUG(sp, "Invalid cast of " << inval.tag_str() << " to " << e.type);
-                        }
-                        )
-                    )
-                    ),
-                (BinOp,
-                    auto inval_l = read_param(e.val_l);
-                    auto inval_r = read_param(e.val_r);
-                    ASSERT_BUG(sp, inval_l.tag() == inval_r.tag(), "Mismatched literal types in binop - " << inval_l << " and " << inval_r);
-                    TU_MATCH_DEF( ::HIR::Literal, (inval_l, inval_r), (l, r),
-                    (
-                        TODO(sp, "RValue::BinOp - " << sa.src << ", val = " << inval_l << " , " << inval_r);
-                        ),
-                    (Float,
-                        switch(e.op)
-                        {
-                        case ::MIR::eBinOp::ADD:    val = ::HIR::Literal( l + r );  break;
-                        case ::MIR::eBinOp::SUB:    val = ::HIR::Literal( l - r );  break;
-                        case ::MIR::eBinOp::MUL:    val = ::HIR::Literal( l * r );  break;
-                        case ::MIR::eBinOp::DIV:    val = ::HIR::Literal( l / r );  break;
-                        case ::MIR::eBinOp::MOD:
-                        case ::MIR::eBinOp::ADD_OV:
-                        case ::MIR::eBinOp::SUB_OV:
-                        case ::MIR::eBinOp::MUL_OV:
-                        case ::MIR::eBinOp::DIV_OV:
-                            TODO(sp, "RValue::BinOp - " << sa.src << ", val = " << inval_l << " , " << inval_r);
-
-                        case ::MIR::eBinOp::BIT_OR :
-                        case ::MIR::eBinOp::BIT_AND:
-                        case ::MIR::eBinOp::BIT_XOR:
-                        case ::MIR::eBinOp::BIT_SHL:
-                        case ::MIR::eBinOp::BIT_SHR:
-                            TODO(sp, "RValue::BinOp - " << sa.src << ", val = " << inval_l << " , " << inval_r);
-                        // TODO: GT/LT are incorrect for signed integers
-                        case ::MIR::eBinOp::EQ: val = ::HIR::Literal( static_cast<uint64_t>(l == r) );  break;
-                        case ::MIR::eBinOp::NE: val = ::HIR::Literal( static_cast<uint64_t>(l != r) );  break;
-                        case ::MIR::eBinOp::GT: val = ::HIR::Literal( static_cast<uint64_t>(l >  r) );  break;
-                        case ::MIR::eBinOp::GE: val = ::HIR::Literal( static_cast<uint64_t>(l >= r) );  break;
-                        case ::MIR::eBinOp::LT: val = ::HIR::Literal( static_cast<uint64_t>(l <  r) );  break;
-                        case ::MIR::eBinOp::LE: val = ::HIR::Literal( static_cast<uint64_t>(l <= r) );  break;
-                        }
-                        ),
-                    (Integer,
-                        switch(e.op)
-                        {
-                        case ::MIR::eBinOp::ADD:    val = ::HIR::Literal( l + r );  break;
-                        case ::MIR::eBinOp::SUB:    val = ::HIR::Literal( l - r );  break;
-                        case ::MIR::eBinOp::MUL:    val = ::HIR::Literal( l * r );  break;
-                        case ::MIR::eBinOp::DIV:    val = ::HIR::Literal( l / r );  break;
-                        case ::MIR::eBinOp::MOD:    val = ::HIR::Literal( l % r );  break;
-                        case ::MIR::eBinOp::ADD_OV:
-                        case ::MIR::eBinOp::SUB_OV:
-                        case ::MIR::eBinOp::MUL_OV:
-                        case ::MIR::eBinOp::DIV_OV:
-                            TODO(sp, "RValue::BinOp - " << sa.src << ", val = " << inval_l << " , " << inval_r);
-
-                        case ::MIR::eBinOp::BIT_OR : val = ::HIR::Literal( l | r );  break;
-                        case ::MIR::eBinOp::BIT_AND: val = ::HIR::Literal( l & r );  break;
-                        case ::MIR::eBinOp::BIT_XOR: val = ::HIR::Literal( l ^ r );  break;
-                        case ::MIR::eBinOp::BIT_SHL: val = ::HIR::Literal( l << r );  break;
-                        case ::MIR::eBinOp::BIT_SHR: val = ::HIR::Literal( l >> r );  break;
-                        // TODO: GT/LT are incorrect for signed integers
-                        case ::MIR::eBinOp::EQ: val = ::HIR::Literal( static_cast<uint64_t>(l == r) );  break;
-                        case ::MIR::eBinOp::NE: val = ::HIR::Literal( static_cast<uint64_t>(l != r) );  break;
-                        case ::MIR::eBinOp::GT: val = ::HIR::Literal( static_cast<uint64_t>(l >  r) );  break;
-                        case ::MIR::eBinOp::GE: val = ::HIR::Literal( static_cast<uint64_t>(l >= r) );  break;
-                        case ::MIR::eBinOp::LT: val = ::HIR::Literal( static_cast<uint64_t>(l <  r) );  break;
-                        case ::MIR::eBinOp::LE: val = ::HIR::Literal( static_cast<uint64_t>(l <= r) );  break;
-                        }
-                        )
-                    )
-                    ),
-                (UniOp,
-                    auto inval = read_lval(e.val);
-                    TU_IFLET( ::HIR::Literal, inval, Integer, i,
-                        switch( e.op )
-                        {
-                        case ::MIR::eUniOp::INV:
-                            val = ::HIR::Literal( ~i );
-                            break;
-                        case ::MIR::eUniOp::NEG:
-                            val = ::HIR::Literal( -i );
-                            break;
-                        }
-                    )
-                    else TU_IFLET( ::HIR::Literal, inval, Float, i,
-                        switch( e.op )
-                        {
-                        case ::MIR::eUniOp::INV:
-                            BUG(sp, "Invalid invert of Float");
-                            break;
-                        case ::MIR::eUniOp::NEG:
-                            val = ::HIR::Literal( -i );
-                            break;
-                        }
-                    )
-                    else {
-                        BUG(sp, "Invalid invert of " << inval.tag_str());
-                    }
-                    ),
-                (DstMeta,
-                    TODO(sp, "RValue::DstMeta");
-                    ),
-                (DstPtr,
-                    TODO(sp, "RValue::DstPtr");
-                    ),
-                (MakeDst,
-                    auto ptr = read_param(e.ptr_val);
-                    auto meta = read_param(e.meta_val);
-                    if( ! meta.is_Integer() ) {
-                        TODO(sp, "RValue::MakeDst - (non-integral meta) " << ptr << " , " << meta);
-                    }
-                    else {
-                        val = mv$(ptr);
-                    }
-                    ),
-                (Tuple,
-                    ::std::vector< ::HIR::Literal>  vals;
-                    vals.reserve( e.vals.size() );
-                    for(const auto& v : e.vals)
-                        vals.push_back( read_param(v) );
-                    val = ::HIR::Literal::make_List( mv$(vals) );
-                    ),
-                (Array,
-                    ::std::vector< ::HIR::Literal>  vals;
-                    vals.reserve( e.vals.size() );
-                    for(const auto& v : e.vals)
-                        vals.push_back( read_param(v) );
-                    val = ::HIR::Literal::make_List( mv$(vals) );
-                    ),
-                (Variant,
-                    auto ival = read_param(e.val);
-                    val = ::HIR::Literal::make_Variant({ e.index, box$(ival) });
-                    ),
-                (Struct,
-                    ::std::vector< ::HIR::Literal>  vals;
-                    vals.reserve( e.vals.size() );
-                    for(const auto& v : e.vals)
-                        vals.push_back( read_param(v) );
-                    val = ::HIR::Literal::make_List( mv$(vals) );
-                    )
-                )
+        ::HIR::TypeRef get_variant_type(const ::HIR::TypeRef& ty, unsigned int idx) const
+        {
+            const auto& te = ty.m_data.as_Path();
+            const auto& variants = te.binding.as_Enum()->m_data.as_Data();
+            ASSERT_BUG(sp, idx < variants.size(), "Variant index out of range - " << idx << " for " << ty);
+            auto rv = monomorphise_type(sp, te.binding.as_Enum()->m_params, te.path.m_data.as_Generic().m_params, variants[idx].type);
+            m_resolve.expand_associated_types(sp, rv);
+            return rv;
+        }
+        /// Offset of the variant data within an enum
+        /// - Niche-filled enums store the data at the start, tagged enums after the (`u32`) tag
+        size_t get_variant_data_ofs(const ::HIR::TypeRef& ty)
+        {
+            if( Target_GetEnumRepr(sp, m_resolve, ty) )
+                return 0;
+            auto it = m_cache.enum_data_ofs.find(ty);
+            if( it != m_cache.enum_data_ofs.end() )
+                return it->second;
 
-                auto& dst = get_lval(sa.dst);
-                DEBUG("= " << val);
-                dst = mv$(val);
+            size_t  data_align = 1;
+            for(unsigned int i = 0; i < ty.m_data.as_Path().binding.as_Enum()->num_variants(); i ++)
+            {
+                size_t  size, align;
+                get_size_align(get_variant_type(ty, i), size, align);
+                data_align = ::std::max(data_align, align);
             }
-            state.set_cur_stmt_term(cur_block);
-            DEBUG("> " << block.terminator);
-            TU_MATCH_DEF( ::MIR::Terminator, (block.terminator), (e),
-            (
-                BUG(sp, "Unexpected terminator - " << block.terminator);
-                ),
-            (Goto,
-                cur_block = e;
-                ),
-            (Return,
-                return retval;
-                ),
-            (Call,
-                if( !e.fcn.is_Path() )
-                    BUG(sp, "Unexpected terminator - " << block.terminator);
-                const auto& fcnp_raw = e.fcn.as_Path();
-                auto fcnp = ms.monomorph(sp, fcnp_raw);
+            size_t rv = (4 + data_align - 1) / data_align * data_align;
+            m_cache.enum_data_ofs.insert( ::std::make_pair(ty.clone(), rv) );
+            return rv;
+        }
+        /// Location of the niche field (within the enum) of a niche-filled enum
+        void get_niche_field(const ::HIR::TypeRef& ty, const EnumRepr& repr, size_t& out_ofs, size_t& out_size)
+        {
+            auto cur_ty = get_variant_type(ty, repr.data_variant);
+            out_ofs = 0;
+            for(auto idx : repr.field_path)
+            {
+                if( idx == ~0u ) {
+                    // Pointer half of a fat pointer
+                    out_size = m_ptr_size;
+                    return ;
+                }
+                const auto& fields = get_fields(cur_ty);
+                ASSERT_BUG(sp, idx < fields.size(), "Niche field index out of range in " << cur_ty);
+                out_ofs += fields[idx].ofs;
+                auto next_ty = fields[idx].ty->clone();
+                cur_ty = mv$(next_ty);
+            }
+            out_size = get_size(cur_ty);
+        }
 
-                auto& dst = get_lval(e.ret_val);
-                MonomorphState  fcn_ms;
-                auto& fcn = get_function(sp, resolve.m_crate, fcnp, fcn_ms);
+        unsigned int read_variant_index(const Memory& mem, size_t ofs, const ::HIR::TypeRef& ty)
+        {
+            const auto& enm = *ty.m_data.as_Path().binding.as_Enum();
+            if( const auto* e = enm.m_data.opt_Value() )
+            {
+                size_t size = get_size(ty);
+                auto v = mem.read_uint(ofs, size);
+                for(unsigned int i = 0; i < e->variants.size(); i ++)
+                {
+                    if( canonicalise_int(e->variants[i].val, size, false) == v )
+                        return i;
+                }
+                ERROR(sp, E0000, "Invalid discriminant " << v << " for " << ty << " during constant evaluation");
+            }
+            else if( const auto* repr = Target_GetEnumRepr(sp, m_resolve, ty) )
+            {
+                size_t  niche_ofs, niche_size;
+                get_niche_field(ty, *repr, niche_ofs, niche_size);
+                // Valid pointers are never in the niche
+                if( mem.get_reloc(ofs + niche_ofs) )
+                    return repr->data_variant;
+                auto v = mem.read_uint(ofs + niche_ofs, niche_size);
+                if( v >= repr->niche_start && v - repr->niche_start < enm.num_variants() - 1 )
+                {
+                    auto i = static_cast<unsigned int>(v - repr->niche_start);
+                    return i < repr->data_variant ? i : i + 1;
+                }
+                return repr->data_variant;
+            }
+            else
+            {
+                auto v = mem.read_uint(ofs, 4);
+                if( v >= enm.num_variants() )
+                    ERROR(sp, E0000, "Invalid tag " << v << " for " << ty << " during constant evaluation");
+                return static_cast<unsigned int>(v);
+            }
+        }
+        /// Write the tag (or discriminant/niche) of an enum, the data must be written first
+        void write_variant_tag(Memory& mem, size_t ofs, const ::HIR::TypeRef& ty, unsigned int idx)
+        {
+            const auto& enm = *ty.m_data.as_Path().binding.as_Enum();
+            if( const auto* e = enm.m_data.opt_Value() )
+            {
+                ASSERT_BUG(sp, idx < e->variants.size(), "Variant index out of range - " << idx << " for " << ty);
+                mem.write_uint(ofs, get_size(ty), e->variants[idx].val);
+            }
+            else if( const auto* repr = Target_GetEnumRepr(sp, m_resolve, ty) )
+            {
+                if( idx != repr->data_variant )
+                {
+                    size_t  niche_ofs, niche_size;
+                    get_niche_field(ty, *repr, niche_ofs, niche_size);
+                    mem.write_uint(ofs + niche_ofs, niche_size, repr->niche_value(idx));
+                }
+            }
+            else
+            {
+                mem.write_uint(ofs, 4, idx);
+            }
+        }
 
-                ::std::vector< ::HIR::Literal>  call_args;
-                call_args.reserve( e.args.size() );
-                for(const auto& a : e.args)
-                    call_args.push_back( read_param(a) );
-                // TODO: Set m_const during parse and check here
+        // ----
+        // Items and memoised values
+        // ----
+        AllocationPtr get_item_alloc(const ::HIR::Path& path)
+        {
+            auto it = m_cache.items.find(path);
+            if( it != m_cache.items.end() )
+                return it->second;
 
-                // Call by invoking evaluate_constant on the function
+            auto rv = ::std::make_shared<Allocation>(0);
+            rv->item_path = box$( path.clone() );
+            if( const auto* pe = path.m_data.opt_Generic() )
+            {
+                const auto& vi = m_resolve.m_crate.get_valitem_by_path(sp, pe->m_path);
+                if( const auto* s = vi.opt_Static() )
                 {
-                    TRACE_FUNCTION_F("Call const fn " << fcnp << " args={ " << call_args << " }");
-                    dst = evaluate_constant(sp, resolve, newval_state, FMT_CB(ss, ss << fcnp;),  fcn.m_code, mv$(fcn_ms), mv$(call_args));
+                    rv->item_ty = s->m_type.clone();
+                    rv->is_loaded = false;
                 }
-
-                DEBUG("= " << dst);
-                cur_block = e.ret_block;
-                )
-            )
+            }
+            m_cache.items.insert( ::std::make_pair(path.clone(), rv) );
+            return rv;
         }
-    }
-
-    ::HIR::Literal evaluate_constant(const Span& sp, const StaticTraitResolve& resolve, NewvalState& newval_state, FmtLambda name, const ::HIR::ExprPtr& expr, MonomorphState ms, ::std::vector< ::HIR::Literal> args)
-    {
-        if( expr.m_mir ) {
-            return evaluate_constant_mir(sp, resolve, newval_state, name, *expr.m_mir, mv$(ms), mv$(args));
+        AllocationPtr get_vtable(const ::HIR::TypeRef& ty, const ::HIR::GenericPath& trait_path)
+        {
+            return get_item_alloc( ::HIR::Path(ty.clone(), trait_path.clone(), "#vtable") );
         }
-        else {
-            BUG(sp, "Attempting to evaluate constant expression with no associated code");
+        void load_item(Allocation& alloc)
+        {
+            if( alloc.is_loaded )
+                return ;
+            const auto& v = get_value(*alloc.item_path);
+            alloc.bytes = v.mem.bytes;
+            alloc.relocs = v.mem.relocs;
+            alloc.is_loaded = true;
+        }
+        template<typename It>
+        AllocationPtr new_string_alloc(It begin, It end)
+        {
+            auto rv = ::std::make_shared<Allocation>(0);
+            rv->bytes.assign(begin, end);
+            rv->is_string = true;
+            return rv;
+        }
+
+        const CachedValue& check_cached(const ::HIR::Path& path, const CachedValue& v) const
+        {
+            if( v.in_progress )
+                ERROR(sp, E0000, "Recursive use of " << path << " during constant evaluation");
+            return v;
+        }
+        const CachedValue& get_value(const ::HIR::Path& path)
+        {
+            auto it = m_cache.values.find(path);
+            if( it != m_cache.values.end() )
+                return check_cached(path, it->second);
+
+            MonomorphState  ms;
+            auto ent = get_ent_fullpath(sp, m_resolve.m_crate, path, EntNS::Value, ms);
+            if( const auto* e = ent.opt_Constant() )
+            {
+                return evaluate_value(path, ms, (*e)->m_type, (*e)->m_value, (*e)->m_value_res);
+            }
+            else if( const auto* e = ent.opt_Static() )
+            {
+                return evaluate_value(path, ms, (*e)->m_type, (*e)->m_value, (*e)->m_value_res);
+            }
+            else
+            {
+                BUG(sp, path << " doesn't point to a constant or static - " << ent.tag_str());
+            }
+        }
+        const CachedValue& evaluate_value(const ::HIR::Path& path, const MonomorphState& ms, const ::HIR::TypeRef& ty, const ::HIR::ExprPtr& expr, const ::HIR::Literal& lit)
+        {
+            static const ::HIR::Function::args_t    s_no_args;
+            TRACE_FUNCTION_F(path);
+            auto& rv = m_cache.values.insert( ::std::make_pair(path.clone(), CachedValue()) ).first->second;
+            rv.ty = monomorph(ms, ty);
+            // Items from other crates (or already visited) have a literal value, unless they were left for their use sites
+            if( !lit.is_Invalid() )
+            {
+                rv.lit = clone_literal(lit);
+                monomorph_literal_inplace(sp, rv.lit, ms);
+                rv.mem = Memory(get_size(rv.ty));
+                write_literal(rv.mem, 0, rv.ty, rv.lit);
+            }
+            else if( expr.m_mir )
+            {
+                auto v = run_mir(FMT_CB(ss, ss << path;), *expr.m_mir, ms, s_no_args, rv.ty.clone(), {});
+                rv.mem = mv$(v.mem);
+                rv.lit = read_literal(rv.mem, 0, rv.ty);
+            }
+            else
+            {
+                ERROR(sp, E0000, "Value of " << path << " isn't known during constant evaluation");
+            }
+            DEBUG(path << " = " << rv.lit);
+            rv.in_progress = false;
+            return rv;
+        }
+
+        // ----
+        // Conversion to/from literals
+        // ----
+        ::HIR::Literal read_literal(const Memory& mem, size_t ofs, const ::HIR::TypeRef& ty)
+        {
+            TU_MATCH_DEF( ::HIR::TypeRef::Data, (ty.m_data), (te),
+            (
+                TODO(sp, "Convert value of type " << ty << " into a literal");
+                ),
+            (Primitive,
+                size_t  size;
+                bool    is_signed;
+                if( get_int_info(te, size, is_signed) )
+                    return ::HIR::Literal( read_int(mem, ofs, size, is_signed) );
+                switch(te)
+                {
+                case ::HIR::CoreType::F32:  return ::HIR::Literal( read_float(mem, ofs, 4) );
+                case ::HIR::CoreType::F64:  return ::HIR::Literal( read_float(mem, ofs, 8) );
+                default:
+                    BUG(sp, "Read of unsized type " << ty);
+                }
+                ),
+            (Tuple,
+                return read_literal_fields(mem, ofs, ty);
+                ),
+            (Array,
+                size_t stride = get_size(*te.inner);
+                ::std::vector< ::HIR::Literal>  vals;
+                vals.reserve(te.size_val);
+                for(size_t i = 0; i < te.size_val; i ++)
+                    vals.push_back( read_literal(mem, ofs + i * stride, *te.inner) );
+                return ::HIR::Literal::make_List( mv$(vals) );
+                ),
+            (Path,
+                if( te.binding.is_Struct() )
+                {
+                    return read_literal_fields(mem, ofs, ty);
+                }
+                else if( te.binding.is_Enum() )
+                {
+                    auto idx = read_variant_index(mem, ofs, ty);
+                    if( te.binding.as_Enum()->m_data.is_Value() )
+                        return ::HIR::Literal::make_Variant({ idx, box$(::HIR::Literal::make_List({})) });
+                    auto val = read_literal(mem, ofs + get_variant_data_ofs(ty), get_variant_type(ty, idx));
+                    return ::HIR::Literal::make_Variant({ idx, box$(val) });
+                }
+                else
+                {
+                    TODO(sp, "Convert value of type " << ty << " into a literal");
+                }
+                ),
+            (Borrow,
+                return read_literal_pointer(mem, ofs, ty, *te.inner);
+                ),
+            (Pointer,
+                return read_literal_pointer(mem, ofs, ty, *te.inner);
+                ),
+            (Function,
+                const auto* reloc = mem.get_reloc(ofs);
+                if( !reloc || !(*reloc)->item_path )
+                    ERROR(sp, E0000, "Function pointer doesn't point to a function during constant evaluation");
+                return ::HIR::Literal::make_BorrowPath( (*reloc)->item_path->clone() );
+                )
+            )
+            throw "";
+        }
+        ::HIR::Literal read_literal_fields(const Memory& mem, size_t ofs, const ::HIR::TypeRef& ty)
+        {
+            const auto& fields = get_fields(ty);
+            ::std::vector< ::HIR::Literal>  vals;
+            vals.reserve(fields.size());
+            for(const auto& f : fields)
+                vals.push_back( read_literal(mem, ofs + f.ofs, *f.ty) );
+            return ::HIR::Literal::make_List( mv$(vals) );
+        }
+        ::HIR::Literal read_literal_pointer(const Memory& mem, size_t ofs, const ::HIR::TypeRef& ptr_ty, const ::HIR::TypeRef& inner)
+        {
+            auto addr = mem.read_uint(ofs, m_ptr_size);
+            const auto* reloc = mem.get_reloc(ofs);
+            if( !reloc )
+            {
+                if( ptr_ty.m_data.is_Borrow() )
+                    ERROR(sp, E0000, "Reference doesn't point to valid memory during constant evaluation");
+                return ::HIR::Literal(addr);
+            }
+            const auto& alloc = *reloc;
+            if( alloc->item_path )
+            {
+                if( addr != 0 )
+                    TODO(sp, "Borrow of part of " << *alloc->item_path << " in a constant");
+                return ::HIR::Literal::make_BorrowPath( alloc->item_path->clone() );
+            }
+
+            auto kind = get_metadata_kind(inner);
+            uint64_t len = (kind == MetadataKind::Slice ? mem.read_uint(ofs + m_ptr_size, m_ptr_size) : 0);
+            // `str` (and string literals used as byte slices/arrays) is emitted directly
+            bool is_bytes = TU_TEST1(inner.m_data, Slice, .inner->m_data.is_Primitive()) && *inner.m_data.as_Slice().inner == ::HIR::CoreType::U8;
+            if( const auto* ae = inner.m_data.opt_Array() ) {
+                if( *ae->inner == ::HIR::CoreType::U8 ) {
+                    is_bytes = true;
+                    len = ae->size_val;
+                }
+            }
+            if( inner == ::HIR::CoreType::Str || (alloc->is_string && is_bytes) )
+            {
+                if( addr + len > alloc->bytes.size() )
+                    ERROR(sp, E0000, "String data out of bounds during constant evaluation");
+                return ::HIR::Literal::make_String( ::std::string(alloc->bytes.begin() + addr, alloc->bytes.begin() + addr + len) );
+            }
+
+            // Anything else becomes a new static
+            ::HIR::TypeRef  data_ty;
+            switch(kind)
+            {
+            case MetadataKind::None:
+                data_ty = inner.clone();
+                break;
+            case MetadataKind::Slice:
+                if( !inner.m_data.is_Slice() )
+                    TODO(sp, "Borrow of unsized " << inner << " in a constant");
+                data_ty = ::HIR::TypeRef::new_array( inner.m_data.as_Slice().inner->clone(), static_cast<unsigned int>(len) );
+                break;
+            case MetadataKind::TraitObject: {
+                const auto* vtable = mem.get_reloc(ofs + m_ptr_size);
+                ASSERT_BUG(sp, vtable && (*vtable)->item_path && (*vtable)->item_path->m_data.is_UfcsKnown(), "Trait object pointer without a vtable");
+                data_ty = (*vtable)->item_path->m_data.as_UfcsKnown().type->clone();
+                break; }
+            }
+            return ::HIR::Literal::make_BorrowPath( export_static(alloc, addr, data_ty) );
+        }
+        /// Get a static containing the given data (creating it if needed)
+        ::HIR::Path export_static(const AllocationPtr& alloc, size_t ofs, const ::HIR::TypeRef& ty)
+        {
+            auto key = ::std::make_pair(ofs, ty.clone());
+            auto it = alloc->exported.find(key);
+            if( it != alloc->exported.end() )
+                return it->second.clone();
+
+            size_t size = get_size(ty);
+            if( ofs + size > alloc->bytes.size() )
+                ERROR(sp, E0000, "Borrowed data out of bounds during constant evaluation");
+            auto lit = read_literal(*alloc, ofs, ty);
+            auto path = ::HIR::Path( m_newval_state.new_static(ty.clone(), mv$(lit)) );
+            DEBUG("Exported " << ty << " @ " << ofs << " as " << path);
+
+            // Keep the memory, so the new static can be read later in this crate
+            auto item = ::std::make_shared<Allocation>(size);
+            item->copy_from(0, *alloc, ofs, size);
+            item->item_path = box$( path.clone() );
+            item->item_ty = ty.clone();
+            m_cache.items.insert( ::std::make_pair(path.clone(), mv$(item)) );
+
+            alloc->exported.insert( ::std::make_pair(mv$(key), path.clone()) );
+            return path;
+        }
+
+        void write_literal(Memory& mem, size_t ofs, const ::HIR::TypeRef& ty, const ::HIR::Literal& lit)
+        {
+            TU_MATCH_DEF( ::HIR::TypeRef::Data, (ty.m_data), (te),
+            (
+                TODO(sp, "Convert literal " << lit << " into a value of type " << ty);
+                ),
+            (Primitive,
+                size_t  size;
+                bool    is_signed;
+                if( get_int_info(te, size, is_signed) )
+                {
+                    ASSERT_BUG(sp, lit.is_Integer(), "Bad literal for " << ty << " - " << lit);
+                    write_int(mem, ofs, size, is_signed, lit.as_Integer());
+                }
+                else if( te == ::HIR::CoreType::F32 || te == ::HIR::CoreType::F64 )
+                {
+                    ASSERT_BUG(sp, lit.is_Float(), "Bad literal for " << ty << " - " << lit);
+                    write_float(mem, ofs, te == ::HIR::CoreType::F32 ? 4 : 8, lit.as_Float());
+                }
+                else
+                {
+                    BUG(sp, "Write of unsized type " << ty);
+                }
+                ),
+            (Tuple,
+                write_literal_fields(mem, ofs, ty, lit);
+                ),
+            (Array,
+                ASSERT_BUG(sp, lit.is_List() && lit.as_List().size() == te.size_val, "Bad literal for " << ty << " - " << lit);
+                size_t stride = get_size(*te.inner);
+                for(size_t i = 0; i < te.size_val; i ++)
+                    write_literal(mem, ofs + i * stride, *te.inner, lit.as_List()[i]);
+                ),
+            (Path,
+                if( te.binding.is_Struct() )
+                {
+                    write_literal_fields(mem, ofs, ty, lit);
+                }
+                else if( te.binding.is_Enum() )
+                {
+                    ASSERT_BUG(sp, lit.is_Variant(), "Bad literal for " << ty << " - " << lit);
+                    const auto& le = lit.as_Variant();
+                    if( !te.binding.as_Enum()->m_data.is_Value() )
+                        write_literal(mem, ofs + get_variant_data_ofs(ty), get_variant_type(ty, le.idx), *le.val);
+                    write_variant_tag(mem, ofs, ty, le.idx);
+                }
+                else
+                {
+                    TODO(sp, "Convert literal " << lit << " into a value of type " << ty);
+                }
+                ),
+            (Borrow,
+                write_literal_pointer(mem, ofs, *te.inner, lit);
+                ),
+            (Pointer,
+                write_literal_pointer(mem, ofs, *te.inner, lit);
+                ),
+            (Function,
+                ASSERT_BUG(sp, lit.is_BorrowPath(), "Bad literal for " << ty << " - " << lit);
+                mem.write_pointer(ofs, get_item_alloc(lit.as_BorrowPath()), 0);
+                )
+            )
+        }
+        void write_literal_fields(Memory& mem, size_t ofs, const ::HIR::TypeRef& ty, const ::HIR::Literal& lit)
+        {
+            const auto& fields = get_fields(ty);
+            ASSERT_BUG(sp, lit.is_List() && lit.as_List().size() == fields.size(), "Bad literal for " << ty << " - " << lit);
+            for(size_t i = 0; i < fields.size(); i ++)
+                write_literal(mem, ofs + fields[i].ofs, *fields[i].ty, lit.as_List()[i]);
+        }
+        void write_literal_pointer(Memory& mem, size_t ofs, const ::HIR::TypeRef& inner, const ::HIR::Literal& lit)
+        {
+            auto kind = get_metadata_kind(inner);
+            TU_MATCH_DEF( ::HIR::Literal, (lit), (le),
+            (
+                BUG(sp, "Bad literal for a pointer to " << inner << " - " << lit);
+                ),
+            (Integer,
+                mem.write_uint(ofs, m_ptr_size, le);
+                ),
+            (BorrowPath,
+                auto item = get_item_alloc(le);
+                mem.write_pointer(ofs, item, 0);
+                switch(kind)
+                {
+                case MetadataKind::None:
+                    break;
+                case MetadataKind::Slice:
+                    ASSERT_BUG(sp, item->item_ty.m_data.is_Array(), "Borrow of " << le << " as " << inner << " isn't of an array static");
+                    mem.write_uint(ofs + m_ptr_size, m_ptr_size, item->item_ty.m_data.as_Array().size_val);
+                    break;
+                case MetadataKind::TraitObject:
+                    ASSERT_BUG(sp, inner.m_data.is_TraitObject(), "Borrow of " << le << " as " << inner);
+                    mem.write_pointer(ofs + m_ptr_size, get_vtable(item->item_ty, inner.m_data.as_TraitObject().m_trait.m_path), 0);
+                    break;
+                }
+                ),
+            (String,
+                mem.write_pointer(ofs, new_string_alloc(le.begin(), le.end()), 0);
+                if( kind == MetadataKind::Slice )
+                    mem.write_uint(ofs + m_ptr_size, m_ptr_size, le.size());
+                ),
+            (BorrowData,
+                ::HIR::TypeRef  data_ty;
+                switch(kind)
+                {
+                case MetadataKind::None:
+                    data_ty = inner.clone();
+                    break;
+                case MetadataKind::Slice:
+                    ASSERT_BUG(sp, inner.m_data.is_Slice() && le->is_List(), "Bad literal for a pointer to " << inner << " - " << lit);
+                    data_ty = ::HIR::TypeRef::new_array( inner.m_data.as_Slice().inner->clone(), le->as_List().size() );
+                    mem.write_uint(ofs + m_ptr_size, m_ptr_size, le->as_List().size());
+                    break;
+                case MetadataKind::TraitObject:
+                    BUG(sp, "BorrowData of a trait object - " << lit);
+                }
+                auto data = ::std::make_shared<Allocation>(get_size(data_ty));
+                write_literal(*data, 0, data_ty, *le);
+                mem.write_pointer(ofs, mv$(data), 0);
+                )
+            )
+        }
+
+        // ----
+        // Lvalues
+        // ----
+        /// Get the memory of a place, checking that `size` bytes are in bounds
+        Allocation& get_mem(const Place& p, size_t size)
+        {
+            load_item(*p.alloc);
+            if( p.ofs + size > p.alloc->bytes.size() )
+                ERROR(sp, E0000, "Out of bounds memory access during constant evaluation (" << p.ofs << "+" << size << " > " << p.alloc->bytes.size() << ")");
+            return *p.alloc;
+        }
+        Value read_place(const Place& p)
+        {
+            size_t size = get_size(p.ty);
+            const auto& mem = get_mem(p, size);
+            Value   rv { p.ty.clone(), Memory(size) };
+            rv.mem.copy_from(0, mem, p.ofs, size);
+            return rv;
+        }
+        void write_place(const Place& p, const Memory& val)
+        {
+            size_t size = get_size(p.ty);
+            ASSERT_BUG(sp, val.size() == size, "Writing " << val.size() << " bytes to a " << p.ty << " (" << size << " bytes)");
+            get_mem(p, size).copy_from(p.ofs, val, 0, size);
+        }
+
+        AllocationPtr& get_local(Frame& f, unsigned int idx)
+        {
+            MIR_ASSERT(f.state, idx < f.locals.size(), "Local index out of range - " << idx << " >= " << f.locals.size());
+            auto& slot = f.locals[idx];
+            if( !slot )
+                slot = ::std::make_shared<Allocation>( get_size(*f.local_tys[idx]) );
+            return slot;
+        }
+        Place get_place(Frame& f, const ::MIR::LValue& lv)
+        {
+            TU_MATCHA( (lv), (e),
+            (Return,
+                if( !f.ret )
+                    f.ret = ::std::make_shared<Allocation>( get_size(f.ret_ty) );
+                return Place { f.ret, 0, f.ret_ty.clone(), 0, nullptr };
+                ),
+            (Argument,
+                MIR_ASSERT(f.state, e.idx < f.args.size(), "Argument index out of range - " << e.idx << " >= " << f.args.size());
+                return Place { f.args[e.idx], 0, f.arg_tys[e.idx].clone(), 0, nullptr };
+                ),
+            (Local,
+                return Place { get_local(f, e), 0, f.local_tys[e]->clone(), 0, nullptr };
+                ),
+            (Static,
+                auto alloc = get_item_alloc(e);
+                MIR_ASSERT(f.state, !alloc->item_ty.m_data.is_Infer(), "LValue::Static of a non-static - " << e);
+                auto ty = alloc->item_ty.clone();
+                return Place { mv$(alloc), 0, mv$(ty), 0, nullptr };
+                ),
+            (Field,
+                auto base = get_place(f, *e.val);
+                return get_field_place(f, mv$(base), e.field_index);
+                ),
+            (Deref,
+                auto base = get_place(f, *e.val);
+                return deref_place(f, base);
+                ),
+            (Index,
+                auto base = get_place(f, *e.val);
+                auto idx_place = get_place(f, *e.idx);
+                auto idx = get_mem(idx_place, m_ptr_size).read_uint(idx_place.ofs, m_ptr_size);
+
+                const ::HIR::TypeRef* inner;
+                uint64_t count;
+                if( const auto* te = base.ty.m_data.opt_Array() ) {
+                    inner = &*te->inner;
+                    count = te->size_val;
+                }
+                else if( const auto* te = base.ty.m_data.opt_Slice() ) {
+                    inner = &*te->inner;
+                    count = base.meta_len;
+                }
+                else {
+                    MIR_BUG(f.state, "LValue::Index on " << base.ty);
+                }
+                if( idx >= count )
+                    ERROR(sp, E0000, "Index out of bounds during constant evaluation - " << idx << " >= " << count);
+                size_t ofs = base.ofs + idx * get_size(*inner);
+                return Place { mv$(base.alloc), ofs, inner->clone(), 0, nullptr };
+                ),
+            (Downcast,
+                auto base = get_place(f, *e.val);
+                MIR_ASSERT(f.state, base.ty.m_data.is_Path(), "LValue::Downcast on " << base.ty);
+                const auto& te = base.ty.m_data.as_Path();
+                if( te.binding.is_Union() )
+                {
+                    return get_field_place(f, mv$(base), e.variant_index);
+                }
+                MIR_ASSERT(f.state, te.binding.is_Enum() && te.binding.as_Enum()->m_data.is_Data(), "LValue::Downcast on " << base.ty);
+                size_t ofs = base.ofs + get_variant_data_ofs(base.ty);
+                auto ty = get_variant_type(base.ty, e.variant_index);
+                return Place { mv$(base.alloc), ofs, mv$(ty), 0, nullptr };
+                )
+            )
+            throw "";
+        }
+        Place get_field_place(Frame& f, Place base, unsigned int idx)
+        {
+            const auto& ty = base.ty;
+            if( const auto* te = ty.m_data.opt_Array() )
+            {
+                MIR_ASSERT(f.state, idx < te->size_val, "LValue::Field index out of range - " << idx << " on " << ty);
+                size_t ofs = base.ofs + idx * get_size(*te->inner);
+                return Place { mv$(base.alloc), ofs, te->inner->clone(), 0, nullptr };
+            }
+            else if( const auto* te = ty.m_data.opt_Slice() )
+            {
+                if( idx >= base.meta_len )
+                    ERROR(sp, E0000, "Index out of bounds during constant evaluation - " << idx << " >= " << base.meta_len);
+                size_t ofs = base.ofs + idx * get_size(*te->inner);
+                return Place { mv$(base.alloc), ofs, te->inner->clone(), 0, nullptr };
+            }
+            else if( TU_TEST1(ty.m_data, Path, .binding.is_Union()) )
+            {
+                auto field_ty = get_union_field_type(ty, idx);
+                return Place { mv$(base.alloc), base.ofs, mv$(field_ty), 0, nullptr };
+            }
+            else if( ty.m_data.is_Tuple() || TU_TEST1(ty.m_data, Path, .binding.is_Struct()) )
+            {
+                const auto& fields = get_fields(ty);
+                MIR_ASSERT(f.state, idx < fields.size(), "LValue::Field index out of range - " << idx << " on " << ty);
+                return Place { mv$(base.alloc), base.ofs + fields[idx].ofs, fields[idx].ty->clone(), 0, nullptr };
+            }
+            else
+            {
+                MIR_BUG(f.state, "LValue::Field on " << ty);
+            }
+        }
+        Place deref_place(Frame& f, const Place& ptr)
+        {
+            const ::HIR::TypeRef* inner;
+            if( const auto* te = ptr.ty.m_data.opt_Borrow() )
+                inner = &*te->inner;
+            else if( const auto* te = ptr.ty.m_data.opt_Pointer() )
+                inner = &*te->inner;
+            else
+                MIR_TODO(f.state, "LValue::Deref of " << ptr.ty);
+
+            const auto& mem = get_mem(ptr, get_size(ptr.ty));
+            auto addr = mem.read_uint(ptr.ofs, m_ptr_size);
+            const auto* reloc = mem.get_reloc(ptr.ofs);
+            if( !reloc )
+                ERROR(sp, E0000, "Dereference of an integer pointer (" << addr << ") during constant evaluation");
+
+            Place   rv { *reloc, addr, inner->clone(), 0, nullptr };
+            switch( get_metadata_kind(*inner) )
+            {
+            case MetadataKind::None:
+                break;
+            case MetadataKind::Slice:
+                rv.meta_len = mem.read_uint(ptr.ofs + m_ptr_size, m_ptr_size);
+                break;
+            case MetadataKind::TraitObject:
+                if( const auto* vtable = mem.get_reloc(ptr.ofs + m_ptr_size) )
+                    rv.meta_vtable = *vtable;
+                break;
+            }
+            return rv;
+        }
+
+        // ----
+        // Values
+        // ----
+        Value const_to_value(Frame& f, const ::MIR::Constant& c)
+        {
+            TU_MATCHA( (c), (ce),
+            (Int,
+                size_t  size;
+                bool    is_signed;
+                get_int_info(ce.t, size, is_signed);
+                Value   rv { ::HIR::TypeRef(ce.t), Memory(size) };
+                write_int(rv.mem, 0, size, is_signed, static_cast<uint64_t>(ce.v));
+                return rv;
+                ),
+            (Uint,
+                size_t  size;
+                bool    is_signed;
+                get_int_info(ce.t, size, is_signed);
+                Value   rv { ::HIR::TypeRef(ce.t), Memory(size) };
+                write_int(rv.mem, 0, size, is_signed, ce.v);
+                return rv;
+                ),
+            (Float,
+                size_t size = (ce.t == ::HIR::CoreType::F32 ? 4 : 8);
+                Value   rv { ::HIR::TypeRef(ce.t), Memory(size) };
+                write_float(rv.mem, 0, size, ce.v);
+                return rv;
+                ),
+            (Bool,
+                Value   rv { ::HIR::TypeRef(::HIR::CoreType::Bool), Memory(1) };
+                rv.mem.write_uint(0, 1, ce.v ? 1 : 0);
+                return rv;
+                ),
+            (Bytes,
+                auto ty = ::HIR::TypeRef::new_borrow(::HIR::BorrowType::Shared, ::HIR::TypeRef::new_array(::HIR::CoreType::U8, ce.size()));
+                Value   rv { mv$(ty), Memory(m_ptr_size) };
+                rv.mem.write_pointer(0, new_string_alloc(ce.begin(), ce.end()), 0);
+                return rv;
+                ),
+            (StaticString,
+                auto ty = ::HIR::TypeRef::new_borrow(::HIR::BorrowType::Shared, ::HIR::CoreType::Str);
+                Value   rv { mv$(ty), Memory(m_ptr_size * 2) };
+                rv.mem.write_pointer(0, new_string_alloc(ce.begin(), ce.end()), 0);
+                rv.mem.write_uint(m_ptr_size, m_ptr_size, ce.size());
+                return rv;
+                ),
+            (Const,
+                const auto& v = get_value( monomorph(f.ms, ce.p) );
+                return Value { v.ty.clone(), v.mem };
+                ),
+            (ItemAddr,
+                // NOTE: The exact (function pointer) type isn't needed, only the size
+                auto ty = ::HIR::TypeRef::new_pointer(::HIR::BorrowType::Shared, ::HIR::TypeRef::new_unit());
+                Value   rv { mv$(ty), Memory(m_ptr_size) };
+                rv.mem.write_pointer(0, get_item_alloc(monomorph(f.ms, ce)), 0);
+                return rv;
+                )
+            )
+            throw "";
+        }
+        Value read_param(Frame& f, const ::MIR::Param& p)
+        {
+            TU_MATCHA( (p), (e),
+            (LValue,
+                return read_place( get_place(f, e) );
+                ),
+            (Constant,
+                return const_to_value(f, e);
+                )
+            )
+            throw "";
         }
-    }
+
+        Memory do_cast(Frame& f, const Value& src, const ::HIR::TypeRef& dst_ty)
+        {
+            const auto& src_ty = src.ty;
+            Memory  rv( get_size(dst_ty) );
+            if( const auto* dte = dst_ty.m_data.opt_Primitive() )
+            {
+                // Read the source as an integer or a float
+                bool    src_is_float = false;
+                uint64_t    iv = 0;
+                double  fv = 0;
+                if( const auto* ste = src_ty.m_data.opt_Primitive() )
+                {
+                    size_t  size;
+                    bool    is_signed;
+                    if( get_int_info(*ste, size, is_signed) ) {
+                        iv = read_int(src.mem, 0, size, is_signed);
+                        fv = is_signed ? static_cast<double>(static_cast<int64_t>(iv)) : static_cast<double>(iv);
+                    }
+                    else {
+                        src_is_float = true;
+                        fv = read_float(src.mem, 0, src.mem.size());
+                    }
+                }
+                else if( TU_TEST1(src_ty.m_data, Path, .binding.is_Enum()) )
+                {
+                    const auto& enm = *src_ty.m_data.as_Path().binding.as_Enum();
+                    MIR_ASSERT(f.state, enm.m_data.is_Value(), "Cast of a data enum - " << src_ty);
+                    iv = enm.m_data.as_Value().variants[ read_variant_index(src.mem, 0, src_ty) ].val;
+                    fv = static_cast<double>(static_cast<int64_t>(iv));
+                }
+                else if( src_ty.m_data.is_Pointer() || src_ty.m_data.is_Borrow() || src_ty.m_data.is_Function() )
+                {
+                    if( src.mem.get_reloc(0) )
+                        ERROR(sp, E0000, "Cast of a pointer to an integer during constant evaluation");
+                    iv = src.mem.read_uint(0, m_ptr_size);
+                    fv = static_cast<double>(iv);
+                }
+                else
+                {
+                    MIR_TODO(f.state, "Cast " << src_ty << " to " << dst_ty);
+                }
+
+                size_t  size;
+                bool    is_signed;
+                if( get_int_info(*dte, size, is_signed) ) {
+                    if( src_is_float )
+                        iv = is_signed ? static_cast<uint64_t>(static_cast<int64_t>(fv)) : static_cast<uint64_t>(fv);
+                    write_int(rv, 0, size, is_signed, canonicalise_int(iv, size, is_signed));
+                }
+                else {
+                    write_float(rv, 0, rv.size(), fv);
+                }
+            }
+            else if( dst_ty.m_data.is_Pointer() || dst_ty.m_data.is_Borrow() )
+            {
+                const auto& dst_inner = (dst_ty.m_data.is_Pointer() ? *dst_ty.m_data.as_Pointer().inner : *dst_ty.m_data.as_Borrow().inner);
+                auto dst_kind = get_metadata_kind(dst_inner);
+                if( const auto* ste = src_ty.m_data.opt_Primitive() )
+                {
+                    size_t  size;
+                    bool    is_signed;
+                    MIR_ASSERT(f.state, get_int_info(*ste, size, is_signed), "Cast " << src_ty << " to " << dst_ty);
+                    rv.write_uint(0, m_ptr_size, read_int(src.mem, 0, size, is_signed));
+                    return rv;
+                }
+                rv.copy_from(0, src.mem, 0, m_ptr_size);
+                if( dst_kind != MetadataKind::None )
+                {
+                    const ::HIR::TypeRef* src_inner;
+                    if( const auto* ste = src_ty.m_data.opt_Pointer() )
+                        src_inner = &*ste->inner;
+                    else if( const auto* ste = src_ty.m_data.opt_Borrow() )
+                        src_inner = &*ste->inner;
+                    else
+                        MIR_TODO(f.state, "Cast " << src_ty << " to " << dst_ty);
+                    auto src_kind = get_metadata_kind(*src_inner);
+                    if( src_kind == dst_kind )
+                    {
+                        rv.copy_from(m_ptr_size, src.mem, m_ptr_size, m_ptr_size);
+                    }
+                    else if( src_kind != MetadataKind::None )
+                    {
+                        MIR_BUG(f.state, "Cast " << src_ty << " to " << dst_ty);
+                    }
+                    // Unsizing
+                    else if( dst_kind == MetadataKind::Slice )
+                    {
+                        MIR_ASSERT(f.state, src_inner->m_data.is_Array(), "Unsize " << src_ty << " to " << dst_ty);
+                        rv.write_uint(m_ptr_size, m_ptr_size, src_inner->m_data.as_Array().size_val);
+                    }
+                    else
+                    {
+                        MIR_ASSERT(f.state, dst_inner.m_data.is_TraitObject(), "Unsize " << src_ty << " to " << dst_ty);
+                        rv.write_pointer(m_ptr_size, get_vtable(*src_inner, dst_inner.m_data.as_TraitObject().m_trait.m_path), 0);
+                    }
+                }
+            }
+            else if( dst_ty.m_data.is_Function() )
+            {
+                MIR_ASSERT(f.state, src.mem.size() == rv.size(), "Cast " << src_ty << " to " << dst_ty);
+                rv.copy_from(0, src.mem, 0, rv.size());
+            }
+            else
+            {
+                // TODO: CoerceUnsized structs
+                MIR_TODO(f.state, "Cast " << src_ty << " to " << dst_ty);
+            }
+            return rv;
+        }
+
+        Memory do_binop(Frame& f, const Value& l, ::MIR::eBinOp op, const Value& r, const ::HIR::TypeRef& dst_ty)
+        {
+            Memory  rv( get_size(dst_ty) );
+            auto set_bool = [&](bool v) { rv.write_uint(0, 1, v ? 1 : 0); };
+            if( const auto* te = l.ty.m_data.opt_Primitive() )
+            {
+                size_t  size;
+                bool    is_signed;
+                if( get_int_info(*te, size, is_signed) )
+                {
+                    uint64_t lv = read_int(l.mem, 0, size, is_signed);
+                    size_t  r_size;
+                    bool    r_signed;
+                    MIR_ASSERT(f.state, r.ty.m_data.is_Primitive() && get_int_info(r.ty.m_data.as_Primitive(), r_size, r_signed), "BinOp " << l.ty << " with " << r.ty);
+                    uint64_t rv_ = read_int(r.mem, 0, r_size, r_signed);
+                    int64_t ls = static_cast<int64_t>(lv);
+                    int64_t rs = static_cast<int64_t>(rv_);
+                    unsigned int bits = ::std::min<unsigned int>(size * 8, 64);
+
+                    uint64_t    res = 0;
+                    bool    overflowed = false;
+                    switch(op)
+                    {
+                    case ::MIR::eBinOp::ADD:
+                    case ::MIR::eBinOp::ADD_OV:
+                        res = lv + rv_;
+                        if( size < 8 )
+                            overflowed = (canonicalise_int(res, size, is_signed) != res);
+                        else if( is_signed )
+                            overflowed = ((ls ^ static_cast<int64_t>(res)) & (rs ^ static_cast<int64_t>(res))) < 0;
+                        else
+                            overflowed = (res < lv);
+                        break;
+                    case ::MIR::eBinOp::SUB:
+                    case ::MIR::eBinOp::SUB_OV:
+                        res = lv - rv_;
+                        if( size < 8 )
+                            overflowed = (canonicalise_int(res, size, is_signed) != res);
+                        else if( is_signed )
+                            overflowed = ((ls ^ rs) & (ls ^ static_cast<int64_t>(res))) < 0;
+                        else
+                            overflowed = (lv < rv_);
+                        break;
+                    case ::MIR::eBinOp::MUL:
+                    case ::MIR::eBinOp::MUL_OV:
+                        res = lv * rv_;
+                        if( size < 8 )
+                            overflowed = (canonicalise_int(res, size, is_signed) != res);
+                        else if( is_signed )
+                            overflowed = (ls == -1 && rs == INT64_MIN) || (ls != 0 && static_cast<int64_t>(res) / ls != rs);
+                        else
+                            overflowed = (lv != 0 && res / lv != rv_);
+                        break;
+                    case ::MIR::eBinOp::DIV:
+                    case ::MIR::eBinOp::DIV_OV:
+                    case ::MIR::eBinOp::MOD:
+                        if( rv_ == 0 )
+                            ERROR(sp, E0000, "Division by zero during constant evaluation");
+                        if( is_signed )
+                        {
+                            if( rs == -1 && canonicalise_int(lv, size, true) == canonicalise_int(1ull << (bits-1), size, true) )
+                                ERROR(sp, E0000, "Overflow in division during constant evaluation");
+                            res = static_cast<uint64_t>(op == ::MIR::eBinOp::MOD ? ls % rs : ls / rs);
+                        }
+                        else
+                        {
+                            res = (op == ::MIR::eBinOp::MOD ? lv % rv_ : lv / rv_);
+                        }
+                        break;
+                    case ::MIR::eBinOp::BIT_OR:     res = lv | rv_; break;
+                    case ::MIR::eBinOp::BIT_AND:    res = lv & rv_; break;
+                    case ::MIR::eBinOp::BIT_XOR:    res = lv ^ rv_; break;
+                    case ::MIR::eBinOp::BIT_SHL:
+                        res = lv << (rv_ % bits);
+                        break;
+                    case ::MIR::eBinOp::BIT_SHR:
+                        res = is_signed ? static_cast<uint64_t>(ls >> (rv_ % bits)) : lv >> (rv_ % bits);
+                        break;
+                    case ::MIR::eBinOp::EQ: set_bool(lv == rv_);    return rv;
+                    case ::MIR::eBinOp::NE: set_bool(lv != rv_);    return rv;
+                    case ::MIR::eBinOp::GT: set_bool(is_signed ? ls >  rs : lv >  rv_);  return rv;
+                    case ::MIR::eBinOp::GE: set_bool(is_signed ? ls >= rs : lv >= rv_);  return rv;
+                    case ::MIR::eBinOp::LT: set_bool(is_signed ? ls <  rs : lv <  rv_);  return rv;
+                    case ::MIR::eBinOp::LE: set_bool(is_signed ? ls <= rs : lv <= rv_);  return rv;
+                    }
+                    switch(op)
+                    {
+                    case ::MIR::eBinOp::ADD_OV:
+                    case ::MIR::eBinOp::SUB_OV:
+                    case ::MIR::eBinOp::MUL_OV:
+                        if( overflowed )
+                            ERROR(sp, E0000, "Arithmetic overflow during constant evaluation - " << lv << " op" << static_cast<int>(op) << " " << rv_ << " (" << l.ty << ")");
+                        break;
+                    default:
+                        break;
+                    }
+                    write_int(rv, 0, size, is_signed, canonicalise_int(res, size, is_signed));
+                    return rv;
+                }
+                else if( *te == ::HIR::CoreType::F32 || *te == ::HIR::CoreType::F64 )
+                {
+                    MIR_ASSERT(f.state, r.ty == l.ty, "BinOp " << l.ty << " with " << r.ty);
+                    double lv = read_float(l.mem, 0, l.mem.size());
+                    double rv_ = read_float(r.mem, 0, r.mem.size());
+                    double  res;
+                    switch(op)
+                    {
+                    case ::MIR::eBinOp::ADD:
+                    case ::MIR::eBinOp::ADD_OV: res = lv + rv_;    break;
+                    case ::MIR::eBinOp::SUB:
+                    case ::MIR::eBinOp::SUB_OV: res = lv - rv_;    break;
+                    case ::MIR::eBinOp::MUL:
+                    case ::MIR::eBinOp::MUL_OV: res = lv * rv_;    break;
+                    case ::MIR::eBinOp::DIV:
+                    case ::MIR::eBinOp::DIV_OV: res = lv / rv_;    break;
+                    case ::MIR::eBinOp::MOD:    res = ::std::fmod(lv, rv_);    break;
+                    case ::MIR::eBinOp::EQ: set_bool(lv == rv_);    return rv;
+                    case ::MIR::eBinOp::NE: set_bool(lv != rv_);    return rv;
+                    case ::MIR::eBinOp::GT: set_bool(lv >  rv_);    return rv;
+                    case ::MIR::eBinOp::GE: set_bool(lv >= rv_);    return rv;
+                    case ::MIR::eBinOp::LT: set_bool(lv <  rv_);    return rv;
+                    case ::MIR::eBinOp::LE: set_bool(lv <= rv_);    return rv;
+                    default:
+                        MIR_BUG(f.state, "Invalid float operation " << static_cast<int>(op));
+                    }
+                    write_float(rv, 0, rv.size(), res);
+                    return rv;
+                }
+            }
+            else if( l.ty.m_data.is_Pointer() || l.ty.m_data.is_Borrow() || l.ty.m_data.is_Function() )
+            {
+                MIR_ASSERT(f.state, l.mem.size() == r.mem.size(), "BinOp " << l.ty << " with " << r.ty);
+                bool is_equal = (l.mem.bytes == r.mem.bytes && l.mem.relocs == r.mem.relocs);
+                switch(op)
+                {
+                case ::MIR::eBinOp::EQ: set_bool(is_equal);    return rv;
+                case ::MIR::eBinOp::NE: set_bool(!is_equal);   return rv;
+                default:
+                    break;
+                }
+            }
+            MIR_TODO(f.state, "BinOp " << static_cast<int>(op) << " on " << l.ty);
+        }
+
+        Memory eval_rvalue(Frame& f, const ::HIR::TypeRef& dst_ty, const ::MIR::RValue& rval)
+        {
+            TU_MATCHA( (rval), (e),
+            (Use,
+                return read_place( get_place(f, e) ).mem;
+                ),
+            (Constant,
+                return const_to_value(f, e).mem;
+                ),
+            (SizedArray,
+                Memory  rv( get_size(dst_ty) );
+                if( e.count > 0 )
+                {
+                    auto val = read_param(f, e.val);
+                    size_t stride = val.mem.size();
+                    for(unsigned int i = 0; i < e.count; i ++)
+                        rv.copy_from(i * stride, val.mem, 0, stride);
+                }
+                return rv;
+                ),
+            (Borrow,
+                auto p = get_place(f, e.val);
+                Memory  rv( get_size(dst_ty) );
+                rv.write_pointer(0, p.alloc, p.ofs);
+                if( rv.size() > m_ptr_size )
+                {
+                    if( p.meta_vtable )
+                        rv.write_pointer(m_ptr_size, p.meta_vtable, 0);
+                    else
+                        rv.write_uint(m_ptr_size, m_ptr_size, p.meta_len);
+                }
+                return rv;
+                ),
+            (Cast,
+                auto src = read_place( get_place(f, e.val) );
+                return do_cast(f, src, monomorph(f.ms, e.type));
+                ),
+            (BinOp,
+                auto l = read_param(f, e.val_l);
+                auto r = read_param(f, e.val_r);
+                return do_binop(f, l, e.op, r, dst_ty);
+                ),
+            (UniOp,
+                auto v = read_place( get_place(f, e.val) );
+                MIR_ASSERT(f.state, v.ty.m_data.is_Primitive(), "UniOp on " << v.ty);
+                auto ct = v.ty.m_data.as_Primitive();
+                size_t  size;
+                bool    is_signed;
+                if( get_int_info(ct, size, is_signed) )
+                {
+                    auto iv = read_int(v.mem, 0, size, is_signed);
+                    switch(e.op)
+                    {
+                    case ::MIR::eUniOp::INV:
+                        iv = (ct == ::HIR::CoreType::Bool ? iv ^ 1 : ~iv);
+                        break;
+                    case ::MIR::eUniOp::NEG:
+                        iv = -iv;
+                        break;
+                    }
+                    write_int(v.mem, 0, size, is_signed, iv);
+                }
+                else
+                {
+                    MIR_ASSERT(f.state, e.op == ::MIR::eUniOp::NEG, "Invalid invert of " << v.ty);
+                    write_float(v.mem, 0, v.mem.size(), -read_float(v.mem, 0, v.mem.size()));
+                }
+                return mv$(v.mem);
+                ),
+            (DstMeta,
+                auto p = get_place(f, e.val);
+                Memory  rv( get_size(dst_ty) );
+                const ::HIR::TypeRef* inner = nullptr;
+                if( const auto* te = p.ty.m_data.opt_Borrow() )
+                    inner = &*te->inner;
+                else if( const auto* te = p.ty.m_data.opt_Pointer() )
+                    inner = &*te->inner;
+                else
+                    MIR_BUG(f.state, "DstMeta on " << p.ty);
+                // NOTE: Used on pointers to arrays for generic unsizing
+                if( const auto* te = inner->m_data.opt_Array() )
+                    rv.write_uint(0, m_ptr_size, te->size_val);
+                else
+                    rv.copy_from(0, get_mem(p, m_ptr_size * 2), p.ofs + m_ptr_size, m_ptr_size);
+                return rv;
+                ),
+            (DstPtr,
+                auto p = get_place(f, e.val);
+                Memory  rv( m_ptr_size );
+                rv.copy_from(0, get_mem(p, m_ptr_size), p.ofs, m_ptr_size);
+                return rv;
+                ),
+            (MakeDst,
+                auto ptr = read_param(f, e.ptr_val);
+                auto meta = read_param(f, e.meta_val);
+                Memory  rv( get_size(dst_ty) );
+                MIR_ASSERT(f.state, rv.size() == m_ptr_size * 2, "MakeDst to " << dst_ty);
+                rv.copy_from(0, ptr.mem, 0, m_ptr_size);
+                rv.copy_from(m_ptr_size, meta.mem, 0, m_ptr_size);
+                return rv;
+                ),
+            (Tuple,
+                return eval_fields(f, dst_ty, e.vals);
+                ),
+            (Array,
+                Memory  rv( get_size(dst_ty) );
+                if( !e.vals.empty() )
+                {
+                    size_t stride = rv.size() / e.vals.size();
+                    for(size_t i = 0; i < e.vals.size(); i ++)
+                    {
+                        auto v = read_param(f, e.vals[i]);
+                        rv.copy_from(i * stride, v.mem, 0, v.mem.size());
+                    }
+                }
+                return rv;
+                ),
+            (Variant,
+                auto v = read_param(f, e.val);
+                Memory  rv( get_size(dst_ty) );
+                MIR_ASSERT(f.state, dst_ty.m_data.is_Path(), "Variant with type " << dst_ty);
+                const auto& te = dst_ty.m_data.as_Path();
+                if( te.binding.is_Union() )
+                {
+                    rv.copy_from(0, v.mem, 0, v.mem.size());
+                }
+                else
+                {
+                    if( te.binding.as_Enum()->m_data.is_Data() )
+                        rv.copy_from(get_variant_data_ofs(dst_ty), v.mem, 0, v.mem.size());
+                    write_variant_tag(rv, 0, dst_ty, e.index);
+                }
+                return rv;
+                ),
+            (Struct,
+                return eval_fields(f, dst_ty, e.vals);
+                )
+            )
+            throw "";
+        }
+        Memory eval_fields(Frame& f, const ::HIR::TypeRef& dst_ty, const ::std::vector< ::MIR::Param>& vals)
+        {
+            Memory  rv( get_size(dst_ty) );
+            const auto& fields = get_fields(dst_ty);
+            MIR_ASSERT(f.state, fields.size() == vals.size(), "Value count mismatch for " << dst_ty << " - " << vals.size() << " != " << fields.size());
+            for(size_t i = 0; i < vals.size(); i ++)
+            {
+                auto v = read_param(f, vals[i]);
+                rv.copy_from(fields[i].ofs, v.mem, 0, v.mem.size());
+            }
+            return rv;
+        }
+
+        // ----
+        // Calls
+        // ----
+        Value call_function(const ::HIR::Path& path, ::std::vector<Value> args)
+        {
+            MonomorphState  fcn_ms;
+            const auto& fcn = get_function(sp, m_resolve.m_crate, path, fcn_ms);
+            if( !fcn.m_code.m_mir )
+                ERROR(sp, E0000, "Call of " << path << " during constant evaluation, but it has no MIR");
+            if( m_call_depth >= CONST_EVAL_CALL_DEPTH_LIMIT )
+                ERROR(sp, E0000, "Call depth limit (" << CONST_EVAL_CALL_DEPTH_LIMIT << ") reached during constant evaluation, calling " << path);
+            auto ret_ty = monomorph(fcn_ms, fcn.m_return);
+
+            TRACE_FUNCTION_F("Call const fn " << path);
+            m_call_depth ++;
+            auto rv = run_mir(FMT_CB(ss, ss << path;), *fcn.m_code.m_mir, fcn_ms, fcn.m_args, mv$(ret_ty), mv$(args));
+            m_call_depth --;
+            return rv;
+        }
+        Memory call_intrinsic(Frame& f, const ::std::string& name, const ::HIR::PathParams& params, ::std::vector<Value> args, const ::HIR::TypeRef& ret_ty)
+        {
+            auto ty_param = [&](unsigned int idx) {
+                MIR_ASSERT(f.state, idx < params.m_types.size(), "Missing type parameter for intrinsic " << name);
+                return monomorph(f.ms, params.m_types[idx]);
+                };
+            Memory  rv( get_size(ret_ty) );
+            if( name == "size_of" )
+            {
+                rv.write_uint(0, m_ptr_size, get_size(ty_param(0)));
+            }
+            else if( name == "min_align_of" || name == "align_of" || name == "pref_align_of" )
+            {
+                size_t  size, align;
+                get_size_align(ty_param(0), size, align);
+                rv.write_uint(0, m_ptr_size, align);
+            }
+            else if( name == "needs_drop" )
+            {
+                rv.write_uint(0, 1, m_resolve.type_needs_drop_glue(sp, ty_param(0)) ? 1 : 0);
+            }
+            else if( name == "transmute" )
+            {
+                MIR_ASSERT(f.state, args.size() == 1, "transmute takes one argument");
+                if( args[0].mem.size() != rv.size() )
+                    ERROR(sp, E0000, "transmute between types of different sizes - " << args[0].ty << " to " << ret_ty);
+                rv = mv$(args[0].mem);
+            }
+            else if( name == "abort" || name == "unreachable" )
+            {
+                ERROR(sp, E0000, "Call of intrinsic `" << name << "` during constant evaluation");
+            }
+            else
+            {
+                MIR_TODO(f.state, "Intrinsic `" << name << "` during constant evaluation");
+            }
+            return rv;
+        }
+
+        Value run_mir(FmtLambda name, const ::MIR::Function& fcn, const MonomorphState& ms, const ::HIR::Function::args_t& arg_defs, ::HIR::TypeRef ret_ty, ::std::vector<Value> args)
+        {
+            ::MIR::TypeResolve  state { sp, m_resolve, name, ret_ty, arg_defs, fcn };
+            Frame   f { state, ms, ret_ty, nullptr, {}, {}, {}, {}, {} };
+
+            f.args.reserve(args.size());
+            f.arg_tys.reserve(args.size());
+            for(auto& a : args)
+            {
+                auto alloc = ::std::make_shared<Allocation>(0);
+                alloc->bytes = mv$(a.mem.bytes);
+                alloc->relocs = mv$(a.mem.relocs);
+                f.args.push_back( mv$(alloc) );
+                f.arg_tys.push_back( mv$(a.ty) );
+            }
+            f.locals.resize( fcn.locals.size() );
+            f.local_tys.reserve( fcn.locals.size() );
+            f.local_ty_storage.reserve( fcn.locals.size() );
+            for(const auto& ty : fcn.locals)
+            {
+                if( monomorphise_type_needed(ty) ) {
+                    f.local_ty_storage.push_back( monomorph(ms, ty) );
+                    f.local_tys.push_back( &f.local_ty_storage.back() );
+                }
+                else {
+                    f.local_tys.push_back( &ty );
+                }
+            }
+
+            unsigned int cur_block = 0;
+            for(;;)
+            {
+                MIR_ASSERT(state, cur_block < fcn.blocks.size(), "Block index out of range");
+                const auto& block = fcn.blocks[cur_block];
+                unsigned int next_stmt_idx = 0;
+                for(const auto& stmt : block.statements)
+                {
+                    state.set_cur_stmt(cur_block, next_stmt_idx++);
+                    count_step(state);
+
+                    // NOTE: Drops, drop flags and scope ends have no effect on constants
+                    if( const auto* se = stmt.opt_Assign() )
+                    {
+                        DEBUG(se->dst << " = " << se->src);
+                        auto dst = get_place(f, se->dst);
+                        auto val = eval_rvalue(f, dst.ty, se->src);
+                        write_place(dst, val);
+                    }
+                    else if( stmt.is_Asm() )
+                    {
+                        ERROR(sp, E0000, "Inline assembly during constant evaluation");
+                    }
+                }
+                state.set_cur_stmt_term(cur_block);
+                count_step(state);
+                DEBUG("> " << block.terminator);
+                TU_MATCH_DEF( ::MIR::Terminator, (block.terminator), (e),
+                (
+                    ERROR(sp, E0000, "Panic during constant evaluation - " << state);
+                    ),
+                (Incomplete,
+                    MIR_BUG(state, "Unexpected terminator - " << block.terminator);
+                    ),
+                (Goto,
+                    cur_block = e;
+                    ),
+                (Return,
+                    if( !f.ret )
+                        f.ret = ::std::make_shared<Allocation>( get_size(f.ret_ty) );
+                    return Value { mv$(ret_ty), Memory(*f.ret) };
+                    ),
+                (If,
+                    auto p = get_place(f, e.cond);
+                    cur_block = (get_mem(p, 1).read_uint(p.ofs, 1) != 0 ? e.bb0 : e.bb1);
+                    ),
+                (Switch,
+                    auto p = get_place(f, e.val);
+                    MIR_ASSERT(state, TU_TEST1(p.ty.m_data, Path, .binding.is_Enum()), "Switch on " << p.ty);
+                    auto idx = read_variant_index(get_mem(p, get_size(p.ty)), p.ofs, p.ty);
+                    MIR_ASSERT(state, idx < e.targets.size(), "Switch target out of range");
+                    cur_block = e.targets[idx];
+                    ),
+                (SwitchValue,
+                    auto p = get_place(f, e.val);
+                    cur_block = e.def_target;
+                    TU_MATCHA( (e.values), (ve),
+                    (Unsigned,
+                        auto v = read_place(p);
+                        auto iv = v.mem.read_uint(0, ::std::min<size_t>(v.mem.size(), 8));
+                        for(size_t i = 0; i < ve.size(); i ++)
+                            if( ve[i] == iv )
+                                cur_block = e.targets[i];
+                        ),
+                    (Signed,
+                        auto v = read_place(p);
+                        size_t  size;
+                        bool    is_signed;
+                        MIR_ASSERT(state, v.ty.m_data.is_Primitive() && get_int_info(v.ty.m_data.as_Primitive(), size, is_signed), "SwitchValue on " << v.ty);
+                        auto iv = static_cast<int64_t>(read_int(v.mem, 0, size, true));
+                        for(size_t i = 0; i < ve.size(); i ++)
+                            if( ve[i] == iv )
+                                cur_block = e.targets[i];
+                        ),
+                    (String,
+                        auto str_place = deref_place(f, p);
+                        const auto& mem = get_mem(str_place, str_place.meta_len);
+                        ::std::string   s { mem.bytes.begin() + str_place.ofs, mem.bytes.begin() + str_place.ofs + str_place.meta_len };
+                        for(size_t i = 0; i < ve.size(); i ++)
+                            if( ve[i] == s )
+                                cur_block = e.targets[i];
+                        )
+                    )
+                    ),
+                (Call,
+                    ::std::vector<Value>    call_args;
+                    call_args.reserve( e.args.size() );
+                    for(const auto& a : e.args)
+                        call_args.push_back( read_param(f, a) );
+
+                    auto dst = get_place(f, e.ret_val);
+                    TU_MATCHA( (e.fcn), (fe),
+                    (Value,
+                        auto ptr = read_place( get_place(f, fe) );
+                        const auto* reloc = ptr.mem.get_reloc(0);
+                        if( !reloc || !(*reloc)->item_path )
+                            ERROR(sp, E0000, "Call through an invalid function pointer during constant evaluation");
+                        auto fcn_path = (*reloc)->item_path->clone();
+                        write_place(dst, call_function(fcn_path, mv$(call_args)).mem);
+                        ),
+                    (Path,
+                        auto fcn_path = monomorph(ms, fe);
+                        write_place(dst, call_function(fcn_path, mv$(call_args)).mem);
+                        ),
+                    (Intrinsic,
+                        write_place(dst, call_intrinsic(f, fe.name, fe.params, mv$(call_args), dst.ty));
+                        )
+                    )
+                    cur_block = e.ret_block;
+                    )
+                )
+            }
+        }
+        void count_step(const ::MIR::TypeResolve& state)
+        {
+            if( m_steps_left == 0 )
+                ERROR(sp, E0000, "Constant evaluation exceeded the step limit (" << CONST_EVAL_STEP_LIMIT << ") - " << state);
+            m_steps_left --;
+        }
+    };
+
+    /// Returns true if the MIR for a constant refers to impl/method generics (so can only be evaluated once used with concrete types)
+    bool mir_needs_monomorph(const ::MIR::Function& fcn)
+    {
+        auto constant_needs = [](const ::MIR::Constant& c)->bool {
+            if( const auto* e = c.opt_Const() )
+                return monomorphise_path_needed(e->p);
+            if( const auto* e = c.opt_ItemAddr() )
+                return monomorphise_path_needed(*e);
+            return false;
+            };
+        auto param_needs = [&](const ::MIR::Param& p)->bool {
+            return p.is_Constant() && constant_needs(p.as_Constant());
+            };
+        auto params_need = [&](const ::std::vector< ::MIR::Param>& ps)->bool {
+            return ::std::any_of(ps.begin(), ps.end(), param_needs);
+            };
+
+        for(const auto& ty : fcn.locals)
+            if( monomorphise_type_needed(ty) )
+                return true;
+        for(const auto& bb : fcn.blocks)
+        {
+            for(const auto& stmt : bb.statements)
+            {
+                const auto* se = stmt.opt_Assign();
+                if( !se )
+                    continue ;
+                bool rv = false;
+                TU_MATCHA( (se->src), (e),
+                (Use, ),
+                (Constant, rv = constant_needs(e); ),
+                (SizedArray, rv = param_needs(e.val); ),
+                (Borrow, ),
+                (Cast, rv = monomorphise_type_needed(e.type); ),
+                (BinOp, rv = param_needs(e.val_l) || param_needs(e.val_r); ),
+                (UniOp, ),
+                (DstMeta, ),
+                (DstPtr, ),
+                (MakeDst, rv = param_needs(e.ptr_val) || param_needs(e.meta_val); ),
+                (Tuple, rv = params_need(e.vals); ),
+                (Array, rv = params_need(e.vals); ),
+                (Variant, rv = monomorphise_genericpath_needed(e.path) || param_needs(e.val); ),
+                (Struct, rv = monomorphise_genericpath_needed(e.path) || params_need(e.vals); )
+                )
+                if( rv )
+                    return true;
+            }
+            if( const auto* te = bb.terminator.opt_Call() )
+            {
+                if( params_need(te->args) )
+                    return true;
+                if( const auto* fe = te->fcn.opt_Path() )
+                    if( monomorphise_path_needed(*fe) )
+                        return true;
+                if( const auto* fe = te->fcn.opt_Intrinsic() )
+                    for(const auto& ty : fe->params.m_types)
+                        if( monomorphise_type_needed(ty) )
+                            return true;
+            }
+        }
+        return false;
+    }
 
     void check_lit_type(const Span& sp, const ::HIR::TypeRef& type,  ::HIR::Literal& lit)
     {
@@ -861,6 +2197,7 @@ namespace {
 
         const ::HIR::ItemPath*  m_mod_path;
         t_new_values    m_new_values;
+        EvalCache   m_eval_cache;
 
     public:
         Expander(const ::HIR::Crate& crate):
@@ -904,10 +2241,17 @@ namespace {
         void visit_constant(::HIR::ItemPath p, ::HIR::Constant& item) override
         {
             visit_type(item.m_type);
-            if( item.m_value )
+            // Constants in generic impls/traits that depend on the parameters are left for their (monomorphised) use sites
+            if( item.m_value && (monomorphise_type_needed(item.m_type) || (item.m_value.m_mir && mir_needs_monomorph(*item.m_value.m_mir))) )
+            {
+                DEBUG("constant: " << item.m_type << " - generic, not evaluated");
+                visit_expr(item.m_value);
+            }
+            else if( item.m_value )
             {
                 auto nvs = NewvalState { m_new_values, *m_mod_path, FMT(p.get_name() << "$") };
-                item.m_value_res = evaluate_constant(item.m_value->span(), m_resolve, nvs, FMT_CB(ss, ss << p;), item.m_value, {}, {});
+                Evaluator   eval { item.m_value->span(), m_resolve, m_eval_cache, nvs };
+                item.m_value_res = clone_literal( eval.evaluate_item(p.get_full_path(), item.m_type, item.m_value).lit );
 
                 check_lit_type(item.m_value->span(), item.m_type, item.m_value_res);
                 DEBUG("constant: " << item.m_type <<  " = " << item.m_value_res);
@@ -920,7 +2264,8 @@ namespace {
             if( item.m_value )
             {
                 auto nvs = NewvalState { m_new_values, *m_mod_path, FMT(p.get_name() << "$") };
-                item.m_value_res = evaluate_constant(item.m_value->span(), m_resolve, nvs, FMT_CB(ss, ss << p;), item.m_value, {}, {});
+                Evaluator   eval { item.m_value->span(), m_resolve, m_eval_cache, nvs };
+                item.m_value_res = clone_literal( eval.evaluate_item(p.get_full_path(), item.m_type, item.m_value).lit );
                 DEBUG("static: " << item.m_type <<  " = " << item.m_value_res);
                 visit_expr(item.m_value);
             }
@@ -933,7 +2278,8 @@ namespace {
                     if( var.expr )
                     {
                         auto nvs = NewvalState { m_new_values, *m_mod_path, FMT(p.get_name() << "$" << var.name << "$") };
-                        auto val = evaluate_constant(var.expr->span(), m_resolve, nvs, FMT_CB(ss, ss << p;), var.expr, {}, {});
+                        Evaluator   eval { var.expr->span(), m_resolve, m_eval_cache, nvs };
+                        auto val = eval.evaluate(FMT_CB(ss, ss << p;), var.expr, var.expr->m_res_type);
                         DEBUG("Enum value " << p << " - " << var.name << " = " << val);
                         // TODO: Save this value? Or just do the above to
                         // validate?
@@ -943,6 +2289,17 @@ namespace {
             ::HIR::Visitor::visit_enum(p, item);
         }
     };
+
+    /// Evaluator state for constants left for their use sites (see `ConvertHIR_ConstantEvaluateFull_Monomorph`)
+    struct UseSiteState
+    {
+        ::std::mutex    lock;
+        const ::HIR::Crate* crate = nullptr;
+        ::std::unique_ptr<StaticTraitResolve>   resolve;
+        /// Values are memoised by their monomorphised path, so this is a per-instantiation cache
+        EvalCache   cache;
+    };
+    UseSiteState    s_use_site_state;
 }   // namespace
 
 void ConvertHIR_ConstantEvaluateFull(::HIR::Crate& crate)
@@ -950,3 +2307,29 @@ void ConvertHIR_ConstantEvaluateFull(::HIR::Crate& crate)
     Expander    exp { crate };
     exp.visit_crate( crate );
 }
+
+const ::HIR::Literal& ConvertHIR_ConstantEvaluateFull_Monomorph(const ::HIR::Crate& crate, const Span& sp, const ::HIR::Path& path)
+{
+    TRACE_FUNCTION_F(path);
+    ASSERT_BUG(sp, !monomorphise_path_needed(path), "Evaluating constant with unknown parameters - " << path);
+    auto& state = s_use_site_state;
+    // NOTE: Called from the (parallel) MIR cleanup passes
+    ::std::lock_guard< ::std::mutex>    lh { state.lock };
+    if( state.crate != &crate )
+    {
+        state.crate = &crate;
+        state.resolve.reset( new StaticTraitResolve(crate) );
+        state.cache = EvalCache();
+    }
+
+    // Nothing can be added to the crate at this point, so values that need a new static can't be used
+    t_new_values    new_values;
+    ::HIR::ItemPath root_path { crate.m_crate_name };
+    auto nvs = NewvalState { new_values, root_path, "const#" };
+    Evaluator   eval { sp, *state.resolve, state.cache, nvs };
+    const auto& rv = eval.evaluate_path(path);
+    if( !new_values.empty() )
+        TODO(sp, "Constant " << path << " needs a new static when evaluated at its use site");
+    DEBUG(path << " = " << rv);
+    return rv;
+}
@@ -7,8 +7,11 @@
  */
 #pragma once
 
+struct Span;
 namespace HIR {
     class Crate;
+    class Path;
+    class Literal;
 };
 
 extern void HIR_Expand_AnnotateUsage(::HIR::Crate& crate);
@@ -18,3 +21,6 @@ extern void HIR_Expand_UfcsEverything(::HIR::Crate& crate);
 extern void HIR_Expand_Reborrows(::HIR::Crate& crate);
 extern void HIR_Expand_ErasedType(::HIR::Crate& crate);
 extern void ConvertHIR_ConstantEvaluateFull(::HIR::Crate& crate);
+/// Get the value of a constant that could only be evaluated once its impl/method parameters are known
+/// - `path` must be fully monomorphised, values are memoised per instantiation
+extern const ::HIR::Literal& ConvertHIR_ConstantEvaluateFull_Monomorph(const ::HIR::Crate& crate, const Span& sp, const ::HIR::Path& path);
@@ -249,7 +249,7 @@ namespace {
                 }
 
                 auto vtable_sp = trait_path;
-                vtable_sp.m_components.back() += "#vtable";
+                vtable_sp.m_components.back() = vtable_sp.m_components.back() + "#vtable";
                 auto vtable_params = impl.m_trait_args.clone();
                 for(const auto& ty : tr.m_type_indexes) {
                     ::HIR::Path path( impl.m_type.clone(), mv$(trait_gpath), ty.first );
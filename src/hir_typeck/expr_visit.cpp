@@ -4,6 +4,7 @@
 #include <hir/expr.hpp>
 #include <hir/visitor.hpp>
 #include "expr_visit.hpp"
+#include <parallel.hpp>
 
 namespace {
     void Typecheck_Code(const typeck::ModuleState& ms, t_args& args, const ::HIR::TypeRef& result_type, ::HIR::ExprPtr& expr) {
@@ -11,15 +12,43 @@ namespace {
         Typecheck_Code_CS(ms, args, result_type, expr);
     }
 
+    /// An expression queued to be checked on a worker thread
+    struct Job
+    {
+        ::typeck::ModuleState   ms;
+        // NOTE: `nullptr` if the expression has no arguments (`tmp_args` is used instead)
+        t_args* args;
+        t_args  tmp_args;
+        ::HIR::TypeRef  result_type;
+        ::HIR::ExprPtr* expr;
+        SpanMessageBuffer   messages;
+    };
 
     class OuterVisitor:
         public ::HIR::Visitor
     {
         ::typeck::ModuleState m_ms;
+        // If non-null, expressions are queued here instead of being checked immediately
+        ::std::vector<Job>* m_jobs;
     public:
-        OuterVisitor(::HIR::Crate& crate):
-            m_ms(crate)
+        OuterVisitor(::HIR::Crate& crate, ::std::vector<Job>* jobs):
+            m_ms(crate),
+            m_jobs(jobs)
+        {
+        }
+
+    private:
+        void check_code(t_args* args, const ::HIR::TypeRef& result_type, ::HIR::ExprPtr& expr)
         {
+            if( m_jobs )
+            {
+                m_jobs->push_back(Job { m_ms, args, {}, result_type.clone(), &expr, {} });
+            }
+            else
+            {
+                t_args  tmp;
+                Typecheck_Code(m_ms, args ? *args : tmp, result_type, expr);
+            }
         }
 
 
@@ -80,9 +109,8 @@ namespace {
             TU_IFLET(::HIR::TypeRef::Data, ty.m_data, Array, e,
                 this->visit_type( *e.inner );
                 DEBUG("Array size " << ty);
-                t_args  tmp;
                 if( e.size ) {
-                    Typecheck_Code( m_ms, tmp, ::HIR::TypeRef(::HIR::CoreType::Usize), *e.size );
+                    this->check_code( nullptr, ::HIR::TypeRef(::HIR::CoreType::Usize), *e.size );
                 }
             )
             else {
@@ -97,7 +125,7 @@ namespace {
             if( item.m_code )
             {
                 DEBUG("Function code " << p);
-                Typecheck_Code( m_ms, item.m_args, item.m_return, item.m_code );
+                this->check_code( &item.m_args, item.m_return, item.m_code );
             }
             else
             {
@@ -109,8 +137,7 @@ namespace {
             if( item.m_value )
             {
                 DEBUG("Static value " << p);
-                t_args  tmp;
-                Typecheck_Code(m_ms, tmp, item.m_type, item.m_value);
+                this->check_code(nullptr, item.m_type, item.m_value);
             }
         }
         void visit_constant(::HIR::ItemPath p, ::HIR::Constant& item) override {
@@ -118,8 +145,7 @@ namespace {
             if( item.m_value )
             {
                 DEBUG("Const value " << p);
-                t_args  tmp;
-                Typecheck_Code(m_ms, tmp, item.m_type, item.m_value);
+                this->check_code(nullptr, item.m_type, item.m_value);
             }
         }
         void visit_enum(::HIR::ItemPath p, ::HIR::Enum& item) override {
@@ -135,8 +161,7 @@ namespace {
                     DEBUG("Enum value " << p << " - " << var.name);
                     if( var.expr )
                     {
-                        t_args  tmp;
-                        Typecheck_Code(m_ms, tmp, enum_type, var.expr);
+                        this->check_code(nullptr, enum_type, var.expr);
                     }
                 }
             }
@@ -144,8 +169,40 @@ namespace {
     };
 }
 
-void Typecheck_Expressions(::HIR::Crate& crate)
+void Typecheck_Expressions(::HIR::Crate& crate, unsigned int num_jobs)
 {
-    OuterVisitor    visitor { crate };
-    visitor.visit_crate( crate );
+    if( num_jobs <= 1 )
+    {
+        OuterVisitor    visitor { crate, nullptr };
+        visitor.visit_crate( crate );
+        return ;
+    }
+
+    // Collect all expressions first, then check them on worker threads
+    // - Diagnostics are buffered per-expression and printed in source order.
+    ::std::vector<Job>  jobs;
+    {
+        OuterVisitor    visitor { crate, &jobs };
+        visitor.visit_crate( crate );
+    }
+    DEBUG(jobs.size() << " expressions to check");
+
+    Parallel_Pipeline(num_jobs, jobs.size(),
+        [&](size_t idx) {
+            auto& job = jobs[idx];
+            SpanMessageCapture  _(job.messages);
+            try
+            {
+                Typecheck_Code(job.ms, job.args ? *job.args : job.tmp_args, job.result_type, *job.expr);
+            }
+            catch(const ::std::runtime_error& )
+            {
+                // Errors are reported (and compilation stopped) when the buffer is flushed
+                if( !job.messages.is_fatal )
+                    throw ;
+            }
+        },
+        [&](size_t idx) {
+            jobs[idx].messages.flush();
+        });
 }
@@ -6,6 +6,12 @@
  * - Typecheck helpers
  */
 #include "helpers.hpp"
+#include <mutex>
+
+namespace {
+    /// Guards `TraitMarkings::auto_impls` (a cache populated during lookup)
+    ::std::mutex    s_auto_impls_lock;
+}
 
 // --------------------------------------------------------------------
 // HMTypeInferrence
@@ -2348,7 +2354,7 @@ bool TraitResolution::find_trait_impls_crate(const Span& sp,
     if( m_crate.get_trait_by_path(sp, trait).m_is_marker )
     {
         // Detect recursion and return true if detected
-        static ::std::vector< ::std::tuple< const ::HIR::SimplePath*, const ::HIR::PathParams*, const ::HIR::TypeRef*> >    stack;
+        static thread_local ::std::vector< ::std::tuple< const ::HIR::SimplePath*, const ::HIR::PathParams*, const ::HIR::TypeRef*> >    stack;
         for(const auto& ent : stack ) {
             if( *::std::get<0>(ent) != trait )
                 continue ;
@@ -2395,15 +2401,19 @@ bool TraitResolution::find_trait_impls_crate(const Span& sp,
 
         // NOTE: `markings` is only set if there's no type params to a path type
         // - Cache populated after destructure
+        // - The cache is shared between threads when expressions are checked in parallel
         if( markings )
         {
+            ::std::unique_lock<::std::mutex>    lh { s_auto_impls_lock };
             auto it = markings->auto_impls.find( trait );
             if( it != markings->auto_impls.end() )
             {
                 if( ! it->second.conditions.empty() ) {
                     TODO(sp, "Conditional auto trait impl");
                 }
-                else if( it->second.is_impled ) {
+                bool is_impled = it->second.is_impled;
+                lh.unlock();
+                if( is_impled ) {
                     return callback( ImplRef(&type, params_ptr, &null_assoc), ::HIR::Compare::Equal );
                 }
                 else {
@@ -2487,6 +2497,7 @@ bool TraitResolution::find_trait_impls_crate(const Span& sp,
         {
             if( markings ) {
                 ASSERT_BUG(sp, cmp == ::HIR::Compare::Equal, "Auto trait with no params returned a fuzzy match from destructure");
+                ::std::lock_guard<::std::mutex>   lh { s_auto_impls_lock };
                 markings->auto_impls.insert( ::std::make_pair(trait, ::HIR::TraitMarkings::AutoMarking { {}, true }) );
             }
             return callback( ImplRef(&type, params_ptr, &null_assoc), cmp );
@@ -2494,6 +2505,7 @@ bool TraitResolution::find_trait_impls_crate(const Span& sp,
         else
         {
             if( markings ) {
+                ::std::lock_guard<::std::mutex>   lh { s_auto_impls_lock };
                 markings->auto_impls.insert( ::std::make_pair(trait, ::HIR::TraitMarkings::AutoMarking { {}, false }) );
             }
             return false;
@@ -7,5 +7,7 @@ namespace HIR {
 };
 
 extern void Typecheck_ModuleLevel(::HIR::Crate& crate);
-extern void Typecheck_Expressions(::HIR::Crate& crate);
+extern void Typecheck_Expressions(::HIR::Crate& crate, unsigned int num_jobs=1);
 extern void Typecheck_Expressions_Validate(::HIR::Crate& crate);
+/// Memoise trait resolution results across the whole crate (only valid once the crate's items/impls are final)
+extern void Typecheck_EnableSharedCache(const ::HIR::Crate& crate);
@@ -6,7 +6,60 @@
  * - Non-inferred type checking
  */
 #include "static.hpp"
+#include "main_bindings.hpp"
 #include <algorithm>
+#include <sharded_cache.hpp>
+
+namespace {
+    /// Key for the `find_impl` cache
+    struct ImplQuery
+    {
+        ::HIR::SimplePath   trait;
+        bool    has_params;
+        ::HIR::PathParams   params;
+        ::HIR::TypeRef  type;
+        bool    dont_handoff_to_specialised;
+
+        Ordering ord(const ImplQuery& x) const {
+            ORD(type, x.type);
+            ORD(trait, x.trait);
+            ORD(has_params, x.has_params);
+            ORD(params, x.params);
+            return ::ord(dont_handoff_to_specialised, x.dont_handoff_to_specialised);
+        }
+        bool operator<(const ImplQuery& x) const { return ord(x) == OrdLess; }
+        size_t hash_shallow() const {
+            return type.hash_shallow() * 31 + (trait.m_components.empty() ? 0 : trait.m_components.back().hash());
+        }
+    };
+}
+struct StaticTraitResolve_SharedCache
+{
+    ShardedCache<::HIR::TypeRef, bool>  type_is_copy;
+    ShardedCache<::HIR::TypeRef, bool>  type_needs_drop_glue;
+    /// Queries that found no candidate impls (callbacks can reject candidates, so positive answers can't be cached)
+    ShardedCache<ImplQuery, bool>   find_impl_none;
+    /// Fully expanded forms of types containing associated types
+    ShardedCache<::HIR::TypeRef, ::HIR::TypeRef>    expanded_types;
+};
+
+namespace {
+    ::std::mutex    s_shared_caches_lock;
+    ::std::map<const ::HIR::Crate*, ::std::unique_ptr<StaticTraitResolve_SharedCache>>  s_shared_caches;
+}
+void Typecheck_EnableSharedCache(const ::HIR::Crate& crate)
+{
+    ::std::lock_guard<::std::mutex> lh { s_shared_caches_lock };
+    auto& ent = s_shared_caches[&crate];
+    if( !ent )
+        ent.reset(new StaticTraitResolve_SharedCache);
+}
+StaticTraitResolve_SharedCache* StaticTraitResolve::get_shared_cache(const ::HIR::Crate& crate)
+{
+    ::std::lock_guard<::std::mutex> lh { s_shared_caches_lock };
+    auto it = s_shared_caches.find(&crate);
+    return it != s_shared_caches.end() ? it->second.get() : nullptr;
+}
 
 void StaticTraitResolve::prep_indexes()
 {
@@ -93,6 +146,35 @@ bool StaticTraitResolve::find_impl(
     ) const
 {
     TRACE_FUNCTION_F(trait_path << FMT_CB(os, if(trait_params) { os << *trait_params; } else { os << "<?>"; }) << " for " << type);
+    if( use_shared_cache() && !monomorphise_type_needed(type) && !(trait_params && monomorphise_pathparams_needed(*trait_params)) )
+    {
+        ImplQuery   query { trait_path, trait_params != nullptr, trait_params ? trait_params->clone() : ::HIR::PathParams(), type.clone(), dont_handoff_to_specialised };
+        if( m_shared_cache->find_impl_none.find(query) )
+        {
+            DEBUG("Cached - No impl");
+            return false;
+        }
+        bool found_any = false;
+        bool rv = this->find_impl__uncached(sp, trait_path, trait_params, type, [&](ImplRef impl, bool is_fuzzed) {
+            found_any = true;
+            return found_cb(mv$(impl), is_fuzzed);
+            }, dont_handoff_to_specialised);
+        if( !found_any )
+        {
+            m_shared_cache->find_impl_none.insert(mv$(query), true);
+        }
+        return rv;
+    }
+    return this->find_impl__uncached(sp, trait_path, trait_params, type, mv$(found_cb), dont_handoff_to_specialised);
+}
+bool StaticTraitResolve::find_impl__uncached(
+    const Span& sp,
+    const ::HIR::SimplePath& trait_path, const ::HIR::PathParams* trait_params,
+    const ::HIR::TypeRef& type,
+    t_cb_find_impl found_cb,
+    bool dont_handoff_to_specialised
+    ) const
+{
     auto cb_ident = [](const ::HIR::TypeRef&ty)->const ::HIR::TypeRef& { return ty; };
 
     static ::HIR::PathParams    null_params;
@@ -369,7 +451,7 @@ bool StaticTraitResolve::find_impl(
             return rv;
 
         // Detect recursion and return true if detected
-        static ::std::vector< ::std::tuple< const ::HIR::SimplePath*, const ::HIR::PathParams*, const ::HIR::TypeRef*> >    stack;
+        static thread_local ::std::vector< ::std::tuple< const ::HIR::SimplePath*, const ::HIR::PathParams*, const ::HIR::TypeRef*> >    stack;
         for(const auto& ent : stack ) {
             if( *::std::get<0>(ent) != trait_path )
                 continue ;
@@ -839,6 +921,20 @@ bool StaticTraitResolve::find_impl__check_crate(
 void StaticTraitResolve::expand_associated_types(const Span& sp, ::HIR::TypeRef& input) const
 {
     TRACE_FUNCTION_F(input);
+    // Only types that contain associated types (non-generic paths) are worth caching
+    if( use_shared_cache() && visit_ty_with(input, [](const auto& ty){ return ty.m_data.is_Path() && !ty.m_data.as_Path().path.m_data.is_Generic(); }) )
+    {
+        if( const auto* expanded = m_shared_cache->expanded_types.find(input) )
+        {
+            DEBUG("Cached - " << *expanded);
+            input = expanded->clone();
+            return ;
+        }
+        auto key = input.clone();
+        this->expand_associated_types_inner(sp, input);
+        m_shared_cache->expanded_types.insert(mv$(key), input.clone());
+        return ;
+    }
     this->expand_associated_types_inner(sp, input);
 }
 bool StaticTraitResolve::expand_associated_types_single(const Span& sp, ::HIR::TypeRef& input) const
@@ -1364,6 +1460,12 @@ bool StaticTraitResolve::type_is_copy(const Span& sp, const ::HIR::TypeRef& ty)
         return rv;
         ),
     (Path,
+        if( use_shared_cache() )
+        {
+            if( const auto* rv = m_shared_cache->type_is_copy.find(ty) )
+                return *rv;
+        }
+        else
         {
             auto it = m_copy_cache.find(ty);
             if( it != m_copy_cache.end() )
@@ -1371,7 +1473,10 @@ bool StaticTraitResolve::type_is_copy(const Span& sp, const ::HIR::TypeRef& ty)
         }
         auto pp = ::HIR::PathParams();
         bool rv = this->find_impl(sp, m_lang_Copy, &pp, ty, [&](auto , bool){ return true; }, true);
-        m_copy_cache.insert(::std::make_pair( ty.clone(), rv ));
+        if( use_shared_cache() )
+            m_shared_cache->type_is_copy.insert(ty.clone(), rv);
+        else
+            m_copy_cache.insert(::std::make_pair( ty.clone(), rv ));
         return rv;
         ),
     (Diverge,
@@ -1721,6 +1826,18 @@ bool StaticTraitResolve::can_unsize(const Span& sp, const ::HIR::TypeRef& dst_ty
 }
 
 bool StaticTraitResolve::type_needs_drop_glue(const Span& sp, const ::HIR::TypeRef& ty) const
+{
+    if( ty.m_data.is_Path() && use_shared_cache() )
+    {
+        if( const auto* rv = m_shared_cache->type_needs_drop_glue.find(ty) )
+            return *rv;
+        bool rv = type_needs_drop_glue__uncached(sp, ty);
+        m_shared_cache->type_needs_drop_glue.insert(ty.clone(), rv);
+        return rv;
+    }
+    return type_needs_drop_glue__uncached(sp, ty);
+}
+bool StaticTraitResolve::type_needs_drop_glue__uncached(const Span& sp, const ::HIR::TypeRef& ty) const
 {
     // If `T: Copy`, then it can't need drop glue
     if( type_is_copy(sp, ty) )
@@ -11,6 +11,9 @@
 #include "common.hpp"
 #include "impl_ref.hpp"
 
+/// Memoised answers shared by every `StaticTraitResolve` on a crate (see `Typecheck_EnableSharedCache`)
+struct StaticTraitResolve_SharedCache;
+
 class StaticTraitResolve
 {
 public:
@@ -34,12 +37,20 @@ public:
 
 private:
     mutable ::std::map< ::HIR::TypeRef, bool >  m_copy_cache;
+    /// Crate-wide cache (null if not enabled), only used when there are no generics in scope
+    StaticTraitResolve_SharedCache* m_shared_cache;
+
+    static StaticTraitResolve_SharedCache* get_shared_cache(const ::HIR::Crate& crate);
+    bool use_shared_cache() const {
+        return m_shared_cache && !m_impl_generics && !m_item_generics;
+    }
 
 public:
     StaticTraitResolve(const ::HIR::Crate& crate):
         m_crate(crate),
         m_impl_generics(nullptr),
-        m_item_generics(nullptr)
+        m_item_generics(nullptr),
+        m_shared_cache(get_shared_cache(crate))
     {
         m_lang_Copy = m_crate.get_lang_item_path_opt("copy");
         m_lang_Drop = m_crate.get_lang_item_path_opt("drop");
@@ -120,6 +131,13 @@ public:
         ) const;
 
 private:
+    bool find_impl__uncached(
+        const Span& sp,
+        const ::HIR::SimplePath& trait_path, const ::HIR::PathParams* trait_params,
+        const ::HIR::TypeRef& type,
+        t_cb_find_impl found_cb,
+        bool dont_handoff_to_specialised
+        ) const;
     bool find_impl__check_bound(
         const Span& sp,
         const ::HIR::SimplePath& trait_path, const ::HIR::PathParams* trait_params,
@@ -183,6 +201,9 @@ public:
 
     /// Returns `true` if the passed type either implements Drop, or contains a type that implements Drop
     bool type_needs_drop_glue(const Span& sp, const ::HIR::TypeRef& ty) const;
+private:
+    bool type_needs_drop_glue__uncached(const Span& sp, const ::HIR::TypeRef& ty) const;
+public:
 
     const ::HIR::TypeRef* is_type_owned_box(const ::HIR::TypeRef& ty) const;
     const ::HIR::TypeRef* is_type_phantom_data(const ::HIR::TypeRef& ty) const;
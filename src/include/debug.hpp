@@ -5,7 +5,7 @@
 #include <cassert>
 #include <functional>
 
-extern int g_debug_indent_level;
+extern thread_local int g_debug_indent_level;
 
 #ifndef DISABLE_DEBUG
 # define INDENT()    do { g_debug_indent_level += 1; assert(g_debug_indent_level<300); } while(0)
@@ -25,6 +25,9 @@ extern int g_debug_indent_level;
 
 extern bool debug_enabled();
 extern ::std::ostream& debug_output(int indent, const char* function);
+/// Name of the current compiler phase (per-thread, so worker threads must copy it from their parent)
+extern const ::std::string& debug_get_phase();
+extern void debug_set_phase(const ::std::string& name);
 
 struct RepeatLitStr
 {
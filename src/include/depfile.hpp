@@ -0,0 +1,17 @@
+/*
+ * MRustC - Rust Compiler
+ * - By John Hodge (Mutabah/thePowersGang)
+ *
+ * include/depfile.hpp
+ * - Tracking of the files read during compilation (for `-C emit-depfile`)
+ */
+#pragma once
+#include <string>
+
+/// Record that a file was read as input to the compilation (source file, `include!` target, extern crate)
+/// - Safe to call from multiple threads.
+extern void Depfile_AddInput(const ::std::string& path);
+
+/// Write a makefile-style dependency file, listing every recorded input as a prerequisite of `target`
+/// - Returns false if the file couldn't be written.
+extern bool Depfile_Write(const ::std::string& depfile_path, const ::std::string& target);
@@ -0,0 +1,56 @@
+/*
+ * MRustC - Rust Compiler
+ * - By John Hodge (Mutabah/thePowersGang)
+ *
+ * include/jobserver.hpp
+ * - GNU make compatible jobserver (limits the number of concurrent jobs across processes)
+ * - Shared by mrustc (C compiler invocations) and minicargo (crate builds)
+ */
+#pragma once
+
+#include <string>
+#include <memory>
+#include <mutex>
+#include <functional>
+
+/// A pool of job tokens shared with child processes using the GNU make jobserver protocol
+///
+/// Every running job needs a token. One token is implicit (owned by the process itself), the rest are
+/// single bytes read from (and written back to) a pipe that is inherited by child processes.
+class Jobserver
+{
+    int m_read_fd;
+    int m_write_fd;
+    // Set when the descriptor was opened by this process (the fifo form), so is closed on destruction
+    bool    m_owns_fd;
+    ::std::string   m_makeflags;
+
+    ::std::mutex    m_lock;
+    bool    m_implicit_free;
+
+    Jobserver(int read_fd, int write_fd, bool owns_fd, ::std::string makeflags);
+public:
+    /// A held token, returned to the pool by `Jobserver::release`
+    struct Token
+    {
+        bool    is_implicit;
+        char    value;
+    };
+
+    ~Jobserver();
+
+    /// Connect to the jobserver advertised in `MAKEFLAGS` (if any)
+    static ::std::unique_ptr<Jobserver> from_environment();
+    /// Create a new pool of `num_jobs` tokens
+    /// - Returns nullptr if the platform doesn't support it
+    static ::std::unique_ptr<Jobserver> create(unsigned num_jobs);
+
+    /// Block until a token is available
+    Token acquire();
+    /// Wait for a token, giving up (returning false) once `should_stop` returns true (checked periodically)
+    bool acquire(Token& out_tok, ::std::function<bool()> should_stop);
+    void release(Token tok);
+
+    /// Value of `MAKEFLAGS` to pass to child processes so they share this pool
+    const ::std::string& makeflags() const { return m_makeflags; }
+};
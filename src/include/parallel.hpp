@@ -0,0 +1,33 @@
+/*
+ * MRustC - Rust Compiler
+ * - By John Hodge (Mutabah/thePowersGang)
+ *
+ * include/parallel.hpp
+ * - Helpers for running independent work items on multiple threads
+ */
+#pragma once
+#include <functional>
+#include <vector>
+#include <cstddef>
+
+/// Call `cb` for every index in `0 .. count`, using up to `num_jobs` threads (including the calling thread)
+/// - With `num_jobs <= 1` this is a plain loop on the calling thread.
+/// - If a callback throws, the remaining items are skipped and the exception is re-thrown on the calling thread.
+/// - Items are handed out by a work-stealing scheduler (each thread starts with a contiguous run of items).
+extern void Parallel_ForEach(unsigned int num_jobs, size_t count, ::std::function<void(size_t)> cb);
+
+/// Call `cb` for every index in `0 .. deps.size()`, only starting an item once every item listed in `deps[idx]`
+/// has finished.
+/// - The dependencies must not form a cycle.
+/// - With `num_jobs <= 1` the items run on the calling thread (in index order where the dependencies allow).
+extern void Parallel_ForEachGraph(unsigned int num_jobs, const ::std::vector< ::std::vector<size_t> >& deps, ::std::function<void(size_t)> cb);
+
+/// Run `produce` for every index on `num_jobs` worker threads, and `consume` on the calling thread in ascending
+/// index order (each one as soon as its `produce` call has finished).
+/// - Producers are kept at most a few items ahead of the consumer, bounding the number of live results.
+extern void Parallel_Pipeline(unsigned int num_jobs, size_t count, ::std::function<void(size_t)> produce, ::std::function<void(size_t)> consume);
+
+/// Index of the current thread within the active `Parallel_*` call
+/// - The calling thread is 0, workers are numbered from 1 and are always less than `num_jobs + 1`.
+/// - Parallel operations must not be nested (the indexes would overlap).
+extern unsigned int Parallel_WorkerIndex();
@@ -1,20 +1,40 @@
 /*
+ * MRustC - Rust Compiler
+ * - By John Hodge (Mutabah/thePowersGang)
+ *
+ * include/rc_string.hpp
+ * - Interned immutable string
  */
 #pragma once
 
 #include <cstring>
 #include <ostream>
+#include <atomic>
+#include <string>
+#include <functional>
 
+/// Immutable interned string (symbol)
+///
+/// All strings are deduplicated through a global table (and are never freed), so two `RcString`s are equal exactly
+/// when they share storage, and copying one is a refcount increment. Used for names that are compared and hashed
+/// frequently (e.g. path components). The hash is computed once on creation.
 class RcString
 {
-    unsigned int*   m_ptr;
-    unsigned int    m_len;
+    struct Inner {
+        ::std::atomic<unsigned int> refcount;
+        unsigned int    len;
+        size_t  hash;
+        // Followed by the NUL-terminated string data
+    };
+    Inner*  m_ptr;
+
+    static Inner* alloc(const char* s, size_t len, size_t hash);
+    const char* data() const { return reinterpret_cast<const char*>(m_ptr + 1); }
 public:
     RcString():
-        m_ptr(nullptr),
-        m_len(0)
+        m_ptr(nullptr)
     {}
-    RcString(const char* s, unsigned int len);
+    RcString(const char* s, size_t len);
     RcString(const char* s):
         RcString(s, ::std::strlen(s))
     {
@@ -24,18 +44,25 @@ public:
     {
     }
 
+    /// Hash of the string contents (the same for all strings with the same contents)
+    static size_t hash_bytes(const char* s, size_t len);
+
+    /// Look up an already-interned string without adding it to the table
+    /// - Returns an empty string if there's no match (so lookups keyed by it will miss)
+    static RcString find_interned(const char* s, size_t len);
+    static RcString find_interned(const ::std::string& s) {
+        return find_interned(s.data(), s.size());
+    }
+
     RcString(const RcString& x):
-        m_ptr(x.m_ptr),
-        m_len(x.m_len)
+        m_ptr(x.m_ptr)
     {
-        if( m_ptr ) *m_ptr += 1;
+        if( m_ptr ) m_ptr->refcount.fetch_add(1, ::std::memory_order_relaxed);
     }
     RcString(RcString&& x):
-        m_ptr(x.m_ptr),
-        m_len(x.m_len)
+        m_ptr(x.m_ptr)
     {
         x.m_ptr = nullptr;
-        x.m_len = 0;
     }
 
     ~RcString();
@@ -46,8 +73,7 @@ public:
         {
             this->~RcString();
             m_ptr = x.m_ptr;
-            m_len = x.m_len;
-            if( m_ptr ) *m_ptr += 1;
+            if( m_ptr ) m_ptr->refcount.fetch_add(1, ::std::memory_order_relaxed);
         }
         return *this;
     }
@@ -57,27 +83,71 @@ public:
         {
             this->~RcString();
             m_ptr = x.m_ptr;
-            m_len = x.m_len;
             x.m_ptr = nullptr;
-            x.m_len = 0;
         }
         return *this;
     }
 
 
     const char* c_str() const {
-        if( m_len > 0 )
-        {
-            return reinterpret_cast<const char*>(m_ptr + 1);
-        }
-        else
-        {
-            return "";
-        }
+        return m_ptr ? data() : "";
+    }
+    size_t size() const {
+        return m_ptr ? m_ptr->len : 0;
+    }
+    bool empty() const {
+        return m_ptr == nullptr;
+    }
+    const char* begin() const { return c_str(); }
+    const char* end() const { return c_str() + size(); }
+    size_t hash() const {
+        return m_ptr ? m_ptr->hash : 0;
     }
-    bool operator==(const RcString& s) const { return *this == s.c_str(); }
+    explicit operator ::std::string() const {
+        return ::std::string(c_str(), size());
+    }
+
+    /// Lexicographic (byte-wise, same as std::string) comparison, returns <0, 0, or >0
+    int compare(const RcString& x) const;
+    int compare(const char* s, size_t len) const;
+
+    bool operator==(const RcString& x) const {
+        // Strings are interned, so equal contents means the same storage
+        return m_ptr == x.m_ptr;
+    }
+    bool operator!=(const RcString& x) const { return !(*this == x); }
+    bool operator<(const RcString& x) const { return this->compare(x) < 0; }
+    bool operator>(const RcString& x) const { return this->compare(x) > 0; }
+    bool operator<=(const RcString& x) const { return this->compare(x) <= 0; }
+    bool operator>=(const RcString& x) const { return this->compare(x) >= 0; }
+
     bool operator==(const char* s) const;
+    bool operator!=(const char* s) const { return !(*this == s); }
+    bool operator==(const ::std::string& s) const { return this->compare(s.data(), s.size()) == 0; }
+    bool operator!=(const ::std::string& s) const { return !(*this == s); }
+    bool operator<(const ::std::string& s) const { return this->compare(s.data(), s.size()) < 0; }
+    friend bool operator==(const char* s, const RcString& x) { return x == s; }
+    friend bool operator!=(const char* s, const RcString& x) { return x != s; }
+    friend bool operator==(const ::std::string& s, const RcString& x) { return x == s; }
+    friend bool operator!=(const ::std::string& s, const RcString& x) { return x != s; }
+    friend bool operator<(const ::std::string& s, const RcString& x) { return x.compare(s.data(), s.size()) > 0; }
+
+    friend ::std::string operator+(const ::std::string& a, const RcString& b) { return a + b.c_str(); }
+    friend ::std::string operator+(const char* a, const RcString& b) { return a + ::std::string(b.c_str(), b.size()); }
+    friend ::std::string operator+(const RcString& a, const char* b) { return ::std::string(a.c_str(), a.size()) + b; }
+    friend ::std::string operator+(const RcString& a, const ::std::string& b) { return ::std::string(a.c_str(), a.size()) + b; }
+
     friend ::std::ostream& operator<<(::std::ostream& os, const RcString& x) {
         return os << x.c_str();
     }
 };
+
+namespace std {
+    template<>
+    struct hash<RcString>
+    {
+        size_t operator()(const RcString& s) const noexcept {
+            return s.hash();
+        }
+    };
+}
@@ -0,0 +1,63 @@
+/*
+ * MRustC - Rust Compiler
+ * - By John Hodge (Mutabah/thePowersGang)
+ *
+ * include/sharded_cache.hpp
+ * - Memoisation map shared between threads
+ */
+#pragma once
+#include <map>
+#include <mutex>
+#include <cstddef>
+
+/// Default shard selection, uses the key's `hash_shallow` method
+template<typename K>
+struct ShardedCache_HashShallow {
+    size_t operator()(const K& key) const { return key.hash_shallow(); }
+};
+
+/// Map of memoised results that can be used from multiple threads at once
+///
+/// The entries are split over `NUM_SHARDS` independently locked maps (picked by `ShardHash`), so threads working on
+/// different keys rarely wait on each other. Entries are never removed (except by `clear`), so references to stored
+/// values stay valid.
+///
+/// `ShardHash` must return the same value for keys that compare equal, it doesn't need to be a good hash (each shard
+/// is an ordered map).
+template<typename K, typename V, typename ShardHash=ShardedCache_HashShallow<K>>
+class ShardedCache
+{
+    static const size_t NUM_SHARDS = 16;
+    struct Shard {
+        mutable ::std::mutex    lock;
+        ::std::map<K, V>    map;
+    };
+    Shard   m_shards[NUM_SHARDS];
+
+    Shard& shard(const K& key) { return m_shards[ShardHash()(key) % NUM_SHARDS]; }
+    const Shard& shard(const K& key) const { return m_shards[ShardHash()(key) % NUM_SHARDS]; }
+public:
+    /// Look up a memoised value, returns nullptr if not present
+    const V* find(const K& key) const {
+        const auto& s = shard(key);
+        ::std::lock_guard<::std::mutex> lh { s.lock };
+        auto it = s.map.find(key);
+        return it != s.map.end() ? &it->second : nullptr;
+    }
+    /// Store a value, returning the stored value
+    /// - If another thread stored a value for the same key first, that value is kept (and returned)
+    const V& insert(K key, V value) {
+        auto& s = shard(key);
+        ::std::lock_guard<::std::mutex> lh { s.lock };
+        return s.map.insert( ::std::make_pair(::std::move(key), ::std::move(value)) ).first->second;
+    }
+    /// Remove all entries
+    /// - Must not be called while other threads are using the cache (or holding references to values)
+    void clear() {
+        for(auto& s : m_shards)
+        {
+            ::std::lock_guard<::std::mutex> lh { s.lock };
+            s.map.clear();
+        }
+    }
+};
@@ -10,6 +10,7 @@
 #include <rc_string.hpp>
 #include <functional>
 #include <memory>
+#include <string>
 
 enum ErrorType
 {
@@ -58,6 +59,32 @@ struct Span
     friend ::std::ostream& operator<<(::std::ostream& os, const Span& sp);
 };
 
+/// Span messages (errors, warnings, notes) collected for later output
+struct SpanMessageBuffer
+{
+    ::std::string   text;
+    /// Set if a bug or error was recorded (the compile must stop once the buffer is flushed)
+    bool    is_fatal = false;
+
+    /// Write the collected messages to stderr, stopping compilation if a fatal message was recorded
+    void flush();
+};
+/// While in scope, span messages raised on the current thread are collected in a buffer instead of being printed
+/// - Allows work done out of order (e.g. on worker threads) to report its diagnostics in source order.
+/// - `Span::bug` and `Span::error` return instead of aborting, leaving the `BUG`/`ERROR` macros to throw.
+class SpanMessageCapture
+{
+    SpanMessageBuffer*  m_prev;
+public:
+    SpanMessageCapture(SpanMessageBuffer& buf);
+    SpanMessageCapture(const SpanMessageCapture&) = delete;
+    ~SpanMessageCapture();
+};
+
+/// Set a function to run (once, on the failing thread) just before a BUG or ERROR stops compilation
+/// - Used to write reports that would otherwise be lost when the process aborts
+extern void Span_SetStopHook(void (*hook)());
+
 template<typename T>
 struct Spanned
 {
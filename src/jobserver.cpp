@@ -0,0 +1,211 @@
+/*
+ * MRustC - Rust Compiler
+ * - By John Hodge (Mutabah/thePowersGang)
+ *
+ * jobserver.cpp
+ * - GNU make compatible jobserver (limits the number of concurrent jobs across processes)
+ * - Shared by mrustc and minicargo, so only depends on the standard library
+ */
+#ifdef _WIN32
+# define _CRT_SECURE_NO_WARNINGS    // Allows use of getenv
+#endif
+#include <jobserver.hpp>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#ifndef _WIN32
+# include <unistd.h>
+# include <fcntl.h>
+# include <poll.h>
+# include <cerrno>
+#endif
+
+Jobserver::Jobserver(int read_fd, int write_fd, bool owns_fd, ::std::string makeflags):
+    m_read_fd(read_fd),
+    m_write_fd(write_fd),
+    m_owns_fd(owns_fd),
+    m_makeflags(::std::move(makeflags)),
+    m_implicit_free(true)
+{
+}
+Jobserver::~Jobserver()
+{
+    // NOTE: Inherited/created pipe descriptors are left open, child processes may still be referencing them
+    // - A fifo is opened by path in each process, so this process's descriptor can be closed.
+#ifndef _WIN32
+    if( m_owns_fd )
+        close(m_read_fd);
+#endif
+}
+
+::std::unique_ptr<Jobserver> Jobserver::from_environment()
+{
+#ifdef _WIN32
+    // TODO: Windows make uses a named semaphore (`--jobserver-auth=<name>`)
+    return nullptr;
+#else
+    const char* makeflags = getenv("MAKEFLAGS");
+    if( !makeflags )
+        return nullptr;
+
+    // The last instance of the option is the one to use (older versions of make use `--jobserver-fds`)
+    const char* opt_pos = nullptr;
+    const char* auth = nullptr;
+    for(const char* opt : { "--jobserver-fds=", "--jobserver-auth=" })
+    {
+        for(const char* p = strstr(makeflags, opt); p; p = strstr(p+1, opt))
+        {
+            if( !opt_pos || p > opt_pos )
+            {
+                opt_pos = p;
+                auth = p + strlen(opt);
+            }
+        }
+    }
+    if( !auth )
+        return nullptr;
+    ::std::string   auth_str { auth, auth + strcspn(auth, " ") };
+
+    int read_fd, write_fd;
+    if( auth_str.compare(0, 5, "fifo:") == 0 )
+    {
+        // make 4.4+ - A named pipe
+        read_fd = open(auth_str.c_str() + 5, O_RDWR|O_CLOEXEC);
+        if( read_fd < 0 )
+        {
+            ::std::cerr << "warning: Unable to open jobserver fifo " << auth_str.substr(5) << ", ignoring" << ::std::endl;
+            return nullptr;
+        }
+        write_fd = read_fd;
+    }
+    else
+    {
+        if( sscanf(auth_str.c_str(), "%d,%d", &read_fd, &write_fd) != 2 )
+        {
+            ::std::cerr << "warning: Malformed jobserver option '" << auth_str << "' in MAKEFLAGS, ignoring" << ::std::endl;
+            return nullptr;
+        }
+        // If the parent make didn't consider this a recursive invocation, the descriptors are closed
+        if( fcntl(read_fd, F_GETFD) < 0 || fcntl(write_fd, F_GETFD) < 0 )
+        {
+            ::std::cerr << "warning: jobserver unavailable (the make rule should be marked with '+'), ignoring" << ::std::endl;
+            return nullptr;
+        }
+    }
+    // Child processes are given the same MAKEFLAGS as this process
+    bool is_fifo = (read_fd == write_fd);
+    return ::std::unique_ptr<Jobserver>(new Jobserver(read_fd, write_fd, is_fifo, makeflags));
+#endif
+}
+
+::std::unique_ptr<Jobserver> Jobserver::create(unsigned num_jobs)
+{
+#ifdef _WIN32
+    return nullptr;
+#else
+    int fds[2];
+    // NOTE: Not close-on-exec, child processes inherit the descriptors
+    if( pipe(fds) != 0 )
+    {
+        perror("pipe");
+        return nullptr;
+    }
+    // The pipe holds all but the implicit token
+    for(unsigned i = 1; i < num_jobs; i ++)
+    {
+        char tok = '+';
+        if( write(fds[1], &tok, 1) != 1 )
+        {
+            perror("write");
+            close(fds[0]);
+            close(fds[1]);
+            return nullptr;
+        }
+    }
+    ::std::string   fd_str = ::std::to_string(fds[0]) + "," + ::std::to_string(fds[1]);
+    // Both spellings, so older versions of make also pick it up
+    auto makeflags = "-j" + ::std::to_string(num_jobs) + " --jobserver-fds=" + fd_str + " --jobserver-auth=" + fd_str;
+    return ::std::unique_ptr<Jobserver>(new Jobserver(fds[0], fds[1], false, ::std::move(makeflags)));
+#endif
+}
+
+Jobserver::Token Jobserver::acquire()
+{
+    {
+        ::std::lock_guard<::std::mutex> lh { m_lock };
+        if( m_implicit_free )
+        {
+            m_implicit_free = false;
+            return Token { true, 0 };
+        }
+    }
+#ifdef _WIN32
+    throw ::std::runtime_error("Jobserver not supported");
+#else
+    for(;;)
+    {
+        char    tok;
+        auto rv = read(m_read_fd, &tok, 1);
+        if( rv == 1 )
+            return Token { false, tok };
+        if( rv < 0 && errno == EINTR )
+            continue ;
+        throw ::std::runtime_error(rv == 0 ? "Jobserver pipe closed" : strerror(errno));
+    }
+#endif
+}
+bool Jobserver::acquire(Token& out_tok, ::std::function<bool()> should_stop)
+{
+    {
+        ::std::lock_guard<::std::mutex> lh { m_lock };
+        if( m_implicit_free )
+        {
+            m_implicit_free = false;
+            out_tok = Token { true, 0 };
+            return true;
+        }
+    }
+#ifndef _WIN32
+    while( !should_stop() )
+    {
+        struct pollfd   pfd = { m_read_fd, POLLIN, 0 };
+        int rv = poll(&pfd, 1, /*timeout_ms=*/100);
+        if( rv < 0 && errno != EINTR )
+            return false;
+        if( rv <= 0 )
+            continue ;
+        // NOTE: Another process may have taken the token since the poll, which just delays this thread
+        char    tok;
+        auto n = read(m_read_fd, &tok, 1);
+        if( n == 1 )
+        {
+            out_tok = Token { false, tok };
+            return true;
+        }
+        if( n == 0 || (n < 0 && errno != EINTR && errno != EAGAIN) )
+            return false;
+    }
+#endif
+    return false;
+}
+void Jobserver::release(Token tok)
+{
+    if( tok.is_implicit )
+    {
+        ::std::lock_guard<::std::mutex> lh { m_lock };
+        m_implicit_free = true;
+        return ;
+    }
+#ifndef _WIN32
+    while( write(m_write_fd, &tok.value, 1) != 1 )
+    {
+        if( errno != EINTR )
+        {
+            perror("jobserver write");
+            break;
+        }
+    }
+#endif
+}
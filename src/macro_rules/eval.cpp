@@ -93,79 +93,35 @@ private:
     CapturedVal& get_cap(const ::std::vector<unsigned int>& iterations, unsigned int name_idx);
 };
 
-/// Simple pattern entry for macro_rules! arm patterns
-TAGGED_UNION( SimplePatEnt, End,
-    // End of the pattern stream
-    (End, struct{}),
-    // Expect a specific token
-    (ExpectTok, Token),
-    // Expect a pattern match
-    (ExpectPat, struct {
-        MacroPatEnt::Type   type;
-        unsigned int    idx;
-        }),
-    // Compare the head of the input stream and poke the pattern stream
-    (IfTok, struct {
-        bool is_equal;
-        Token   tok;
-        }),
-    // Compare the head of the input stream and poke the pattern stream
-    (IfPat, struct {
-        bool is_equal;
-        MacroPatEnt::Type   type;
-        })
-    );
+/// Matching state for an arm, walks the arm's compiled pattern (`MacroRulesArm::m_compiled`)
 class MacroPatternStream
 {
-    const ::std::vector<MacroPatEnt>*   m_pattern;
-    // Position in each nested pattern
-    ::std::vector<unsigned int> m_pos;
+    const ::std::vector<MacroPatOp>*    m_ops;
+    unsigned int    m_pos;
     // Iteration index of each active loop level
     ::std::vector<unsigned int> m_loop_iterations;
-
-    ::std::vector<SimplePatEnt> m_stack;
-    unsigned int    m_skip_count;
-
-    SimplePatEnt    m_peek_cache;
-    bool m_peek_cache_valid = false;
-
-    bool m_break_if_not = false;
-    bool m_condition_fired = false;
+    // Jump target of the last returned `If*` operation
+    unsigned int    m_if_target;
 public:
-    MacroPatternStream(const ::std::vector<MacroPatEnt>& pattern):
-        m_pattern(&pattern),
-        m_pos({0})
+    MacroPatternStream(const MacroRulesArm& arm):
+        m_ops(&arm.m_compiled),
+        m_pos(0),
+        m_if_target(0)
     {
+        assert( !m_ops->empty() );
     }
 
-    /// Get the next pattern entry
-    SimplePatEnt next();
-
-    const SimplePatEnt& peek() {
-        if( !m_peek_cache_valid ) {
-            m_peek_cache = next();
-            m_peek_cache_valid = true;
-        }
-        return m_peek_cache;
-    }
+    /// Get the next pattern operation (End, Expect*, or If*)
+    const MacroPatOp& next();
 
     /// Inform the stream that the `if` rule that was just returned succeeded
-    void if_succeeded();
+    void if_succeeded() {
+        m_pos = m_if_target;
+    }
     /// Get the current loop iteration count
     const ::std::vector<unsigned int>& get_loop_iters() const {
         return m_loop_iterations;
     }
-
-private:
-    SimplePatEnt emit_loop_start(const MacroPatEnt& pat);
-
-    SimplePatEnt emit_seq(SimplePatEnt v1, SimplePatEnt v2) {
-        assert( m_stack.empty() );
-        m_stack.push_back( mv$(v2) );
-        return v1;
-    }
-
-    void break_loop();
 };
 
 // === Prototypes ===
@@ -312,225 +268,47 @@ bool ParameterMappings::dec_count(const ::std::vector<unsigned int>& iterations,
 // MacroPatternStream
 // ------------------------------------
 
-SimplePatEnt MacroPatternStream::next()
+const MacroPatOp& MacroPatternStream::next()
 {
-    TRACE_FUNCTION_F("m_pos=[" << m_pos << "], m_stack.size()=" << m_stack.size());
-    assert(m_pos.size() >= 1);
-
-    if( m_peek_cache_valid ) {
-        m_peek_cache_valid = false;
-        return mv$(m_peek_cache);
-    }
-
-    // Pop off the generation stack
-    if( ! m_stack.empty() ) {
-        auto rv = mv$(m_stack.back());
-        m_stack.pop_back();
-        return rv;
-    }
-
-    if( m_break_if_not && ! m_condition_fired ) {
-        // Break out of the current loop then continue downwards.
-        break_loop();
-    }
-
-    m_skip_count = 0;
-    m_break_if_not = false;
-    m_condition_fired = false;
-
-    const MacroPatEnt*  parent_pat = nullptr;
-    decltype(m_pattern) parent_ents = nullptr;
-    const auto* ents = m_pattern;
-    for(unsigned int i = 0; i < m_pos.size() - 1; i ++)
+    for(;;)
     {
-        auto idx = m_pos[i];
-        //DEBUG(i << " idx=" << idx << " ents->size()=" << ents->size());
-        assert( idx < ents->size() );
-        assert( (*ents)[idx].type == MacroPatEnt::PAT_LOOP );
-        parent_pat = &(*ents)[idx];
-        parent_ents = ents;
-        ents = &parent_pat->subpats;
-    }
-
-    DEBUG( (m_pos.size()-1) << " " << m_pos.back() << " / " << ents->size());
-    if( m_pos.back() < ents->size() )
-    {
-        const auto& pat = ents->at( m_pos.back() );
-
-        if( pat.type == MacroPatEnt::PAT_LOOP ) {
-            DEBUG("Enter " << pat);
-            // Increase level, return entry control
-            m_pos.push_back( 0 );
-            m_loop_iterations.push_back( 0 );
-
-            if( pat.name == "*" )
-            {
-                return emit_loop_start(pat);
-            }
-            else
-            {
-                // If the name is "+" then this is should always be entered, so just recurse
-                assert( pat.name == "+" );
-                return next();
-            }
-        }
-        else if( pat.type == MacroPatEnt::PAT_TOKEN ) {
-            m_pos.back() += 1;
-            return SimplePatEnt::make_ExpectTok( pat.tok.clone() );
-        }
-        else {
-            m_pos.back() += 1;
-            return SimplePatEnt::make_ExpectPat({ pat.type, pat.name_index });
-        }
-    }
-    else
-    {
-        if( parent_pat )
+        assert( m_pos < m_ops->size() );
+        const auto& op = (*m_ops)[m_pos];
+        switch(op.type)
         {
-            // Last entry in a loop - return the breakout control
-            // - Reset the loop back to the start
-            m_pos.back() = 0;
+        case MacroPatOp::OP_END:
+            // Stays at the end
+            return op;
+        case MacroPatOp::OP_JUMP:
+            m_pos = op.target;
+            break;
+        case MacroPatOp::OP_LOOP_ENTER:
+            m_loop_iterations.push_back(0);
+            m_pos ++;
+            break;
+        case MacroPatOp::OP_LOOP_NEXT:
+            assert( !m_loop_iterations.empty() );
             m_loop_iterations.back() += 1;
-
-            // - Emit break conditions
-            if( parent_pat->tok == TOK_NULL ) {
-                // Loop separator is TOK_NULL - get the first token of the loop and use it.
-                // - This shares the code that controls if a loop is entered
-                DEBUG("No separator");
-                return emit_loop_start(*parent_pat);
-            }
-            else {
-                // If the next token is the same as the separator emit: Expect(separator), ShouldEnter
-
-                auto i = m_pos[ m_pos.size() - 2 ] + 1;
-                if( i < parent_ents->size() )
-                {
-                    DEBUG("sep = " << parent_pat->tok << ", next = " << parent_ents->at(i) << ", start = " << ents->at(0));
-                    if( parent_ents->at(i).type == MacroPatEnt::PAT_TOKEN && parent_pat->tok == parent_ents->at(i).tok )
-                    {
-                        DEBUG("MAGIC: Reverse conditions for case where sep==next");
-                        //  > Mark to skip the next token after the end of the loop
-                        m_skip_count = 1;
-                        // - Yeild `EXPECT sep` then the entry condition of this loop
-                        auto pat = emit_loop_start(*parent_pat);
-                        m_stack.push_back( mv$(pat) );
-                        return SimplePatEnt::make_ExpectTok( parent_pat->tok.clone() );
-                    }
-                }
-                // - Yeild `IF NOT sep BREAK` and `EXPECT sep`
-                DEBUG("Separator = " << parent_pat->tok);
-                return emit_seq(
-                    SimplePatEnt::make_IfTok({ false, parent_pat->tok.clone() }),
-                    SimplePatEnt::make_ExpectTok( parent_pat->tok.clone() )
-                    );
-            }
-        }
-        else
-        {
-            // End of the input sequence
-            return SimplePatEnt::make_End({});
-        }
-    }
-}
-
-namespace {
-    void get_loop_entry_pats(const MacroPatEnt& pat,  ::std::vector<const MacroPatEnt*>& entry_pats)
-    {
-        assert( pat.type == MacroPatEnt::PAT_LOOP );
-
-        // If this pattern is a loop, get the entry concrete patterns for it
-        // - Otherwise, just
-        unsigned int i = 0;
-        while( i < pat.subpats.size() && pat.subpats[i].type == MacroPatEnt::PAT_LOOP )
-        {
-            const auto& cur_pat = pat.subpats[i];
-            bool is_optional = (cur_pat.name == "*");
-
-            get_loop_entry_pats(cur_pat, entry_pats);
-
-            if( !is_optional )
-            {
-                // Non-optional loop, MUST be entered, so return after recursing
-                return ;
-            }
-            // Optional, so continue the loop.
-            i ++;
-        }
-
-        // First non-loop pattern
-        if( i < pat.subpats.size() )
-        {
-            entry_pats.push_back( &pat.subpats[i] );
-        }
-    }
-} // namespace
-
-/// Returns (and primes m_stack) the rules to control the start of a loop
-/// This code emits rules to break out of the loop if the entry conditions are not met
-SimplePatEnt MacroPatternStream::emit_loop_start(const MacroPatEnt& pat)
-{
-    // Find the next non-loop pattern to control if this loop should be entered
-    ::std::vector<const MacroPatEnt*> m_entry_pats;
-
-    get_loop_entry_pats(pat, m_entry_pats);
-    DEBUG("m_entry_pats = [" << FMT_CB(ss, for(const auto* p : m_entry_pats) { ss << *p << ","; }) << "]");
-
-    struct H {
-        static SimplePatEnt get_if(bool flag, const MacroPatEnt& mpe) {
-            if( mpe.type == MacroPatEnt::PAT_TOKEN )
-                return SimplePatEnt::make_IfTok({ flag, mpe.tok.clone() });
-            else
-                return SimplePatEnt::make_IfPat({ flag, mpe.type });
-        }
-    };
-
-    const auto* entry_pat = m_entry_pats.back();
-    m_entry_pats.pop_back();
-    if( m_entry_pats.size() > 0 )
-    {
-        DEBUG("Multiple entry possibilities, reversing condition");
-        m_break_if_not = true;
-        for(auto pat_ptr : m_entry_pats)
-        {
-            m_stack.push_back( H::get_if(true, *pat_ptr) );
+            m_pos ++;
+            break;
+        case MacroPatOp::OP_LOOP_EXIT:
+            assert( !m_loop_iterations.empty() );
+            m_loop_iterations.pop_back();
+            m_pos ++;
+            break;
+        case MacroPatOp::OP_IF_TOK:
+        case MacroPatOp::OP_IF_PAT:
+            m_if_target = op.target;
+            m_pos ++;
+            return op;
+        case MacroPatOp::OP_EXPECT_TOK:
+        case MacroPatOp::OP_EXPECT_PAT:
+            m_pos ++;
+            return op;
         }
-        return H::get_if(true, *entry_pat);
-    }
-    else
-    {
-        // Emit an if based on it
-        return H::get_if(false, *entry_pat);
     }
 }
 
-void MacroPatternStream::if_succeeded()
-{
-    if( m_break_if_not )
-    {
-        m_condition_fired = true;
-    }
-    else
-    {
-        break_loop();
-    }
-}
-void MacroPatternStream::break_loop()
-{
-    DEBUG("- Break out of loop, m_skip_count = " << m_skip_count);
-    // Break out of an active loop (pop level and increment parent level)
-    assert( m_pos.size() >= 1 );
-    // - This should never be called when on the top level
-    assert( m_pos.size() != 1 );
-
-    // HACK: Clear the stack if an if succeeded
-    m_stack.clear();
-
-    m_pos.pop_back();
-    m_pos.back() += 1 + m_skip_count;
-
-    m_loop_iterations.pop_back();
-}
-
 // ----------------------------------------------------------------
 /// State for MacroExpander and Macro_InvokeRules_CountSubstUses
 class MacroExpandState
@@ -749,7 +527,6 @@ InterpolatedFragment Macro_HandlePatternCap(TokenStream& lex, MacroPatEnt::Type
     return ::std::unique_ptr<TokenStream>( ret_ptr );
 }
 
-#if 1
 // Collection of functions that consume a specific fragment type from a token stream
 // - Does very loose consuming
 namespace
@@ -1838,64 +1615,55 @@ unsigned int Macro_InvokeRules_MatchPattern(const Span& sp, const MacroRules& ru
 {
     TRACE_FUNCTION;
 
-    struct ActiveArm {
-        unsigned int    index;
-        MacroPatternStream  pat_stream;
-        TokenStreamRO   in_stream;
-    };
-
-    ::std::vector<size_t>   matches;
-    for(size_t i = 0; i < rules.m_rules.size(); i ++)
+    // Find the first arm that matches, using a read-only walk of the input (fragments are skipped instead of parsed)
+    // - The fragment parsers are then only run for the selected arm
+    const auto base_lex = TokenStreamRO(input);
+    size_t i;
+    for(i = 0; i < rules.m_rules.size(); i ++)
     {
-        auto lex = TokenStreamRO(input);
-        auto arm_stream = MacroPatternStream(rules.m_rules[i].m_pattern);
+        auto lex = base_lex.clone();
+        auto arm_stream = MacroPatternStream(rules.m_rules[i]);
 
         bool fail = false;
         for(;;)
         {
-            auto pat = arm_stream.next();
-            if(pat.is_End())
+            const auto& op = arm_stream.next();
+            DEBUG(i << " " << op);
+            if( op.type == MacroPatOp::OP_END )
             {
-                DEBUG(i << " End");
                 if( lex.next() != TOK_EOF )
                     fail = true;
                 break;
             }
-            else if( const auto* e = pat.opt_IfPat() )
+            else if( op.type == MacroPatOp::OP_IF_PAT )
             {
-                DEBUG(i << " IfPat(" << (e->is_equal ? "==" : "!=") << " ?" << e->type << ")");
                 auto lc = lex.clone();
-                if( consume_from_frag(lc, e->type) == e->is_equal )
+                if( consume_from_frag(lc, op.pat_type) == op.is_equal )
                 {
                     DEBUG("- Succeeded");
                     arm_stream.if_succeeded();
                 }
             }
-            else if( const auto* e = pat.opt_IfTok() )
+            else if( op.type == MacroPatOp::OP_IF_TOK )
             {
-                DEBUG(i << " IfTok(" << (e->is_equal ? "==" : "!=") << " ?" << e->tok << ")");
-                const auto& tok = lex.next_tok();
-                if( (tok == e->tok) == e->is_equal )
+                if( (lex.next_tok() == op.tok) == op.is_equal )
                 {
                     DEBUG("- Succeeded");
                     arm_stream.if_succeeded();
                 }
             }
-            else if( const auto* e = pat.opt_ExpectTok() )
+            else if( op.type == MacroPatOp::OP_EXPECT_TOK )
             {
-                const auto& tok = lex.next_tok();
-                DEBUG(i << " ExpectTok(" << *e << ") == " << tok);
-                if( tok != *e )
+                if( lex.next_tok() != op.tok )
                 {
                     fail = true;
                     break;
                 }
                 lex.consume();
             }
-            else if( const auto* e = pat.opt_ExpectPat() )
+            else if( op.type == MacroPatOp::OP_EXPECT_PAT )
             {
-                DEBUG(i << " ExpectPat(" << e->type << " => $" << e->idx << ")");
-                if( !consume_from_frag(lex, e->type) )
+                if( !consume_from_frag(lex, op.pat_type) )
                 {
                     fail = true;
                     break;
@@ -1903,405 +1671,90 @@ unsigned int Macro_InvokeRules_MatchPattern(const Span& sp, const MacroRules& ru
             }
             else
             {
-                // Unreachable.
+                BUG(sp, "Unexpected " << op << " from pattern stream");
             }
         }
 
-
         if( ! fail )
         {
-            matches.push_back(i);
             DEBUG(i << " MATCHED");
+            break;
         }
-        else
-        {
-            DEBUG(i << " FAILED");
-        }
+        DEBUG(i << " FAILED");
     }
 
-    if( matches.size() == 0 )
+    if( i == rules.m_rules.size() )
     {
         // ERROR!
         TODO(sp, "No arm matched");
     }
-    else
-    {
-        // yay!
-
-        // NOTE: There can be multiple arms active, take the first.
-        auto i = matches[0];
-
-        auto lex = TTStreamO(sp, mv$(input));
-        SET_MODULE(lex, mod);
-        auto arm_stream = MacroPatternStream(rules.m_rules[i].m_pattern);
-
-        struct Capture {
-            unsigned int    binding_idx;
-            ::std::vector<unsigned int> iterations;
-            unsigned int    cap_idx;
-        };
-        ::std::vector<InterpolatedFragment> captures;
-        ::std::vector<Capture>  capture_info;
-
-        for(;;)
-        {
-            auto pat = arm_stream.next();
-            if(pat.is_End())
-            {
-                break;
-            }
-            else if( const auto* e = pat.opt_IfPat() )
-            {
-                DEBUG(i << " IfPat(" << (e->is_equal ? "==" : "!=") << " ?" << e->type << ")");
-                if( Macro_TryPatternCap(lex, e->type) == e->is_equal )
-                {
-                    DEBUG("- Succeeded");
-                    arm_stream.if_succeeded();
-                }
-            }
-            else if( const auto* e = pat.opt_IfTok() )
-            {
-                DEBUG(i << " IfTok(" << (e->is_equal ? "==" : "!=") << " ?" << e->tok << ")");
-                auto tok = lex.getToken();
-                if( (tok == e->tok) == e->is_equal )
-                {
-                    DEBUG("- Succeeded");
-                    arm_stream.if_succeeded();
-                }
-                lex.putback( mv$(tok) );
-            }
-            else if( const auto* e = pat.opt_ExpectTok() )
-            {
-                auto tok = lex.getToken();
-                DEBUG(i << " ExpectTok(" << *e << ") == " << tok);
-                if( tok != *e )
-                {
-                    ERROR(sp, E0000, "Expected token in match arm");
-                    break;
-                }
-            }
-            else if( const auto* e = pat.opt_ExpectPat() )
-            {
-                DEBUG(i << " ExpectPat(" << e->type << " => $" << e->idx << ")");
 
-                auto cap = Macro_HandlePatternCap(lex, e->type);
-
-                unsigned int cap_idx = captures.size();
-                captures.push_back( mv$(cap) );
-                capture_info.push_back( Capture { e->idx, arm_stream.get_loop_iters(), cap_idx } );
-            }
-            else
-            {
-                // Unreachable.
-            }
-        }
-
-        for(const auto& cap : capture_info)
-        {
-            bound_tts.insert( cap.binding_idx, cap.iterations, mv$(captures[cap.cap_idx]) );
-        }
-        return i;
-    }
-}
-#else
-unsigned int Macro_InvokeRules_MatchPattern(const Span& sp, const MacroRules& rules, TokenTree input, AST::Module& mod,  ParameterMappings& bound_tts)
-{
-    TRACE_FUNCTION;
-    Span    sp;// = input.span();
+    auto lex = TTStreamO(sp, mv$(input));
+    SET_MODULE(lex, mod);
+    auto arm_stream = MacroPatternStream(rules.m_rules[i]);
 
     struct Capture {
         unsigned int    binding_idx;
         ::std::vector<unsigned int> iterations;
         unsigned int    cap_idx;
     };
-    struct ActiveArm {
-        unsigned int    index;
-        ::std::vector<Capture>  captures;
-        MacroPatternStream  stream;
-    };
-    // - List of active rules (rules that haven't yet failed)
-    ::std::vector< ActiveArm > active_arms;
-    active_arms.reserve( rules.m_rules.size() );
-    for(unsigned int i = 0; i < rules.m_rules.size(); i ++)
-    {
-        active_arms.push_back( ActiveArm { i, {}, MacroPatternStream(rules.m_rules[i].m_pattern) } );
-    }
-
-    // - List of captured values
     ::std::vector<InterpolatedFragment> captures;
+    ::std::vector<Capture>  capture_info;
 
-    TTStreamO   lex(sp, mv$(input) );
-    SET_MODULE(lex, mod);
-    while(true)
+    for(;;)
     {
-        DEBUG("--- ---");
-        // 1. Get concrete patterns for all active rules (i.e. no If* patterns)
-        ::std::vector<SimplePatEnt> arm_pats;
-        for(auto& arm : active_arms)
+        const auto& op = arm_stream.next();
+        DEBUG(i << " " << op);
+        if( op.type == MacroPatOp::OP_END )
         {
-            auto idx = arm.index;
-            SimplePatEnt pat;
-            // Consume all If* rules
-            do
-            {
-                pat = arm.stream.next();
-                TU_IFLET( SimplePatEnt, pat, IfPat, e,
-                    DEBUG(idx << " IfPat(" << (e.is_equal ? "==" : "!=") << " ?" << e.type << ")");
-                    if( Macro_TryPatternCap(lex, e.type) == e.is_equal )
-                    {
-                        DEBUG("- Succeeded");
-                        arm.stream.if_succeeded();
-                    }
-                )
-                else TU_IFLET( SimplePatEnt, pat, IfTok, e,
-                    DEBUG(idx << " IfTok(" << (e.is_equal ? "==" : "!=") << " ?" << e.tok << ")");
-                    auto tok = lex.getToken();
-                    if( (tok == e.tok) == e.is_equal )
-                    {
-                        DEBUG("- Succeeded");
-                        arm.stream.if_succeeded();
-                    }
-                    lex.putback( mv$(tok) );
-                )
-                else {
-                    break;
-                }
-            } while( pat.is_IfPat() || pat.is_IfTok() );
-
-            TU_MATCH( SimplePatEnt, (pat), (e),
-            (IfPat, BUG(sp, "IfTok unexpected here");),
-            (IfTok, BUG(sp, "IfTok unexpected here");),
-            (ExpectTok,
-                DEBUG(idx << " ExpectTok(" << e << ")");
-                ),
-            (ExpectPat,
-                DEBUG(idx << " ExpectPat(" << e.type << " => $" << e.idx << ")");
-                ),
-            (End,
-                DEBUG(idx << " End");
-                )
-            )
-            arm_pats.push_back( mv$(pat) );
+            break;
         }
-        assert( arm_pats.size() == active_arms.size() );
-
-        // 2. Prune imposible arms
-        for(unsigned int i = 0, j = 0; i < arm_pats.size(); )
+        else if( op.type == MacroPatOp::OP_IF_PAT )
         {
-            auto idx = active_arms[i].index;
-            const auto& pat = arm_pats[i];
-            bool fail = false;
-
-            TU_MATCH( SimplePatEnt, (pat), (e),
-            (IfPat, BUG(sp, "IfTok unexpected here");),
-            (IfTok, BUG(sp, "IfTok unexpected here");),
-            (ExpectTok,
-                auto tok = lex.getToken();
-                DEBUG(j<<"="<<idx << " ExpectTok(" << e << ") == " << tok);
-                fail = !(tok == e);
-                lex.putback( mv$(tok) );
-                ),
-            (ExpectPat,
-                DEBUG(j<<"="<<idx << " ExpectPat(" << e.type << " => $" << e.idx << ")");
-                fail = !Macro_TryPatternCap(lex, e.type);
-                ),
-            (End,
-                DEBUG(j<<"="<<idx << " End");
-                fail = !(lex.lookahead(0) == TOK_EOF);
-                )
-            )
-            if( fail ) {
-                DEBUG("- Failed arm " << active_arms[i].index);
-                arm_pats.erase( arm_pats.begin() + i );
-                active_arms.erase( active_arms.begin() + i );
-            }
-            else {
-                i ++;
+            if( Macro_TryPatternCap(lex, op.pat_type) == op.is_equal )
+            {
+                DEBUG("- Succeeded");
+                arm_stream.if_succeeded();
             }
-            j ++;
-        }
-
-        if( arm_pats.size() == 0 ) {
-            auto tok = lex.getToken();
-            ERROR(tok.get_pos(), E0000, "No rules expected " << tok);
         }
-
-        // 3. If there is a token pattern in the list, take that arm (and any other token arms)
-        const SimplePatEnt* tok_pat = nullptr;
-        unsigned int ident_pat_idx = arm_pats.size();
-        bool has_non_ident_pat = false;
-        for( unsigned int i = 0; i < arm_pats.size(); i ++ )
-        {
-            const auto& pat = arm_pats[i];
-            TU_IFLET(SimplePatEnt, pat, ExpectTok, e,
-                if( tok_pat ) {
-                    if( e != tok_pat->as_ExpectTok() )
-                        ERROR(lex.getPosition(), E0000, "Incompatible macro arms - " << tok_pat->as_ExpectTok() << " vs " << e);
-                }
-                else {
-                    tok_pat = &pat;
-                }
-            )
-            else TU_IFLET(SimplePatEnt, pat, ExpectPat, e,
-                if( e.type == MacroPatEnt::PAT_IDENT ) {
-                    ident_pat_idx = i;
-                }
-                else {
-                    has_non_ident_pat = true;
-                }
-            )
-        }
-
-        if( tok_pat )
+        else if( op.type == MacroPatOp::OP_IF_TOK )
         {
             auto tok = lex.getToken();
-            const auto& e = tok_pat->as_ExpectTok();
-            // NOTE: This should never fail.
-            if( tok != e ) {
-                ERROR(lex.getPosition(), E0000, "Unexpected " << tok << ", expected " << e);
+            if( (tok == op.tok) == op.is_equal )
+            {
+                DEBUG("- Succeeded");
+                arm_stream.if_succeeded();
             }
+            lex.putback( mv$(tok) );
         }
-        else
+        else if( op.type == MacroPatOp::OP_EXPECT_TOK )
         {
-            if( has_non_ident_pat && ident_pat_idx < arm_pats.size() )
-            {
-                // For all :ident patterns present, check the next rule.
-                // - If this rule would fail, remove the arm.
-                bool ident_rule_kept = false;
-                for( unsigned int i = 0; i < arm_pats.size(); )
-                {
-                    bool discard = false;
-                    const auto& pat = arm_pats[i];
-                    const auto& e = pat.as_ExpectPat();
-                    if( e.type == MacroPatEnt::PAT_IDENT )
-                    {
-                        const auto& next = active_arms[i].stream.peek();
-                        TU_MATCHA( (next), (ne),
-                        (IfPat, TODO(sp, "Handle IfPat following a conflicting :ident");),
-                        (IfTok, TODO(sp, "IfTok following a conflicting :ident");),
-                        (ExpectTok,
-                            if( ne.type() != lex.lookahead(1) ) {
-                                DEBUG("Discard active arm " << i << " due to next token mismatch");
-                                discard = true;
-                            }
-                            else {
-                                ident_rule_kept = true;
-                            }
-                            ),
-                        (ExpectPat,
-                            TODO(sp, "Handle ExpectPat following a conflicting :ident");
-                            ),
-                        (End, TODO(sp, "Handle End following a conflicting :ident"); )
-                        )
-                    }
-
-                    if( discard ) {
-                        arm_pats.erase( arm_pats.begin() + i );
-                        active_arms.erase( active_arms.begin() + i );
-                    }
-                    else {
-                        ++ i;
-                    }
-                }
-
-                // If there are any remaining ident rules, erase the non-ident rules.
-                if( ident_rule_kept ) {
-                    // If no rules were discarded, remove the non-ident rules
-                    for( unsigned int i = 0; i < arm_pats.size(); )
-                    {
-                        if( arm_pats[i].as_ExpectPat().type != MacroPatEnt::PAT_IDENT ) {
-                            arm_pats.erase( arm_pats.begin() + i );
-                            active_arms.erase( active_arms.begin() + i );
-                        }
-                        else {
-                            ++ i;
-                        }
-                    }
-                }
-                assert(arm_pats.size() > 0);
-                assert(arm_pats.size() == active_arms.size());
-            }
-
-            // 3. Check that all remaining arms are the same pattern.
-            const auto& active_pat = arm_pats[0];
-            for(unsigned int i = 1; i < arm_pats.size(); i ++)
+            auto tok = lex.getToken();
+            if( tok != op.tok )
             {
-                if( active_pat.tag() != arm_pats[i].tag() ) {
-                    ERROR(lex.getPosition(), E0000, "Incompatible macro arms "
-                        << "- " << active_arms[0].index << " SimplePatEnt::" << active_pat.tag_str()
-                        << " vs " << active_arms[i].index<<  " SimplePatEnt::" << arm_pats[i].tag_str()
-                        );
-                }
-                TU_MATCH( SimplePatEnt, (active_pat, arm_pats[i]), (e1, e2),
-                (IfPat, BUG(sp, "IfPat unexpected here");),
-                (IfTok, BUG(sp, "IfTok unexpected here");),
-                (ExpectTok,
-                    BUG(sp, "ExpectTok unexpected here");
-                    ),
-                (ExpectPat,
-                    // Can fail, as :expr and :stmt overlap in their trigger set
-                    if( e1.type != e2.type ) {
-                        ERROR(lex.getPosition(), E0000, "Incompatible macro arms - mismatched patterns " << e1.type << " and " << e2.type);
-                    }
-                    ),
-                (End,
-                    )
-                )
+                ERROR(sp, E0000, "Expected token in match arm");
             }
+        }
+        else if( op.type == MacroPatOp::OP_EXPECT_PAT )
+        {
+            auto cap = Macro_HandlePatternCap(lex, op.pat_type);
 
-            // 4. Apply patterns.
-            TU_MATCH( SimplePatEnt, (arm_pats[0]), (e),
-            (End,
-                auto tok = lex.getToken();
-                if( tok.type() != TOK_EOF ) {
-                    ERROR(lex.getPosition(), E0000, "Unexpected " << tok << ", expected TOK_EOF");
-                }
-                // NOTE: There can be multiple arms active, take the first.
-                for(const auto& cap : active_arms[0].captures)
-                {
-                    bound_tts.insert( cap.binding_idx, cap.iterations, mv$(captures[cap.cap_idx]) );
-                }
-                return active_arms[0].index;
-                ),
-            (IfPat, BUG(sp, "IfPat unexpected here");),
-            (IfTok, BUG(sp, "IfTok unexpected here");),
-            (ExpectTok,
-                BUG(sp, "ExpectTok should have been handled already");
-                ),
-            (ExpectPat,
-                struct H {
-                    static bool is_prefix(const ::std::vector<unsigned>& needle, const ::std::vector<unsigned>& haystack) {
-                        if( needle.size() > haystack.size() ) {
-                            return false;
-                        }
-                        else {
-                            for(unsigned int i = 0; i < needle.size(); i ++) {
-                                if(needle[i] != haystack[i])
-                                    return false;
-                            }
-                            return true;
-                        }
-                    }
-                };
-
-                auto cap = Macro_HandlePatternCap(lex, e.type);
-
-                unsigned int cap_idx = captures.size();
-                captures.push_back( mv$(cap) );
-                for(unsigned int i = 0; i < active_arms.size(); i ++)
-                {
-                    auto& arm = active_arms[i];
-                    const auto& pat_e = arm_pats[i].as_ExpectPat();
-                    arm.captures.push_back( Capture { pat_e.idx, arm.stream.get_loop_iters(), cap_idx } );
-                }
-                )
-            )
+            unsigned int cap_idx = captures.size();
+            captures.push_back( mv$(cap) );
+            capture_info.push_back( Capture { op.idx, arm_stream.get_loop_iters(), cap_idx } );
         }
+        else
+        {
+            BUG(sp, "Unexpected " << op << " from pattern stream");
+        }
+    }
 
-        // Keep looping - breakout is handled in 'End' above
+    for(const auto& cap : capture_info)
+    {
+        bound_tts.insert( cap.binding_idx, cap.iterations, mv$(captures[cap.cap_idx]) );
     }
+    return i;
 }
-#endif
 
 void Macro_InvokeRules_CountSubstUses(ParameterMappings& bound_tts, const ::std::vector<MacroExpansionEnt>& contents)
 {
@@ -103,6 +103,37 @@ struct MacroPatEnt:
     SERIALISABLE_PROTOTYPES();
 };
 
+/// Operation in the compiled form of an arm's pattern
+///
+/// Loops are flattened into conditional jumps, so matching an arm is a walk along this list instead of re-deriving
+/// the loop entry/exit conditions from the `MacroPatEnt` tree on each invocation.
+struct MacroPatOp
+{
+    enum Type {
+        OP_END, // End of the pattern, input must be exhausted
+        OP_EXPECT_TOK,  // Consume `tok`
+        OP_EXPECT_PAT,  // Consume a `pat_type` fragment (captured as parameter `idx`)
+        OP_IF_TOK,  // Jump to `target` if `(next token == tok) == is_equal`
+        OP_IF_PAT,  // Jump to `target` if `(next token can start a pat_type) == is_equal`
+        OP_JUMP,    // Jump to `target`
+        OP_LOOP_ENTER,  // Push a new loop iteration counter
+        OP_LOOP_NEXT,   // Increment the innermost loop iteration counter
+        OP_LOOP_EXIT,   // Pop the innermost loop iteration counter
+    } type;
+    MacroPatEnt::Type   pat_type = MacroPatEnt::PAT_TOKEN;
+    unsigned int    idx = 0;
+    bool    is_equal = false;
+    unsigned int    target = 0;
+    Token   tok;
+
+    MacroPatOp(Type type):
+        type(type)
+    {
+    }
+
+    friend ::std::ostream& operator<<(::std::ostream& os, const MacroPatOp& x);
+};
+
 /// An expansion arm within a macro_rules! blcok
 struct MacroRulesArm:
     public Serialisable
@@ -112,6 +143,8 @@ struct MacroRulesArm:
 
     /// Patterns
     ::std::vector<MacroPatEnt>  m_pattern;
+    /// Compiled form of `m_pattern` (see `Macro_CompilePattern`)
+    ::std::vector<MacroPatOp>   m_compiled;
 
     /// Rule contents
     ::std::vector<MacroExpansionEnt> m_contents;
@@ -158,5 +191,6 @@ public:
 
 extern ::std::unique_ptr<TokenStream>   Macro_InvokeRules(const char *name, const MacroRules& rules, const Span& sp, TokenTree input, AST::Module& mod);
 extern MacroRulesPtr    Parse_MacroRules(TokenStream& lex);
+extern ::std::vector<MacroPatOp>    Macro_CompilePattern(const ::std::vector<MacroPatEnt>& pattern);
 
 #endif // MACROS_HPP_INCLUDED
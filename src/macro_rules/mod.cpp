@@ -256,6 +256,22 @@ SERIALISE_TYPE_S(MacroPatEnt, {
     }
     return os;
 }
+::std::ostream& operator<<(::std::ostream& os, const MacroPatOp& x)
+{
+    switch(x.type)
+    {
+    case MacroPatOp::OP_END:        os << "End";    break;
+    case MacroPatOp::OP_EXPECT_TOK: os << "ExpectTok(" << x.tok << ")";    break;
+    case MacroPatOp::OP_EXPECT_PAT: os << "ExpectPat(" << x.pat_type << " => $" << x.idx << ")";    break;
+    case MacroPatOp::OP_IF_TOK: os << "IfTok(" << (x.is_equal ? "==" : "!=") << " " << x.tok << ") goto " << x.target;    break;
+    case MacroPatOp::OP_IF_PAT: os << "IfPat(" << (x.is_equal ? "==" : "!=") << " ?" << x.pat_type << ") goto " << x.target; break;
+    case MacroPatOp::OP_JUMP:   os << "goto " << x.target;    break;
+    case MacroPatOp::OP_LOOP_ENTER: os << "LoopEnter"; break;
+    case MacroPatOp::OP_LOOP_NEXT:  os << "LoopNext";  break;
+    case MacroPatOp::OP_LOOP_EXIT:  os << "LoopExit";  break;
+    }
+    return os;
+}
 
 SERIALISE_TU(MacroExpansionEnt, "MacroExpansionEnt", e,
 (Token,
@@ -451,6 +451,202 @@ void enumerate_names(const ::std::vector<MacroPatEnt>& pats, ::std::vector< ::st
     }
 }
 
+namespace {
+    /// Get the patterns that can start an iteration of a loop (looking through leading optional loops)
+    void get_loop_entry_pats(const MacroPatEnt& pat,  ::std::vector<const MacroPatEnt*>& entry_pats)
+    {
+        assert( pat.type == MacroPatEnt::PAT_LOOP );
+
+        unsigned int i = 0;
+        while( i < pat.subpats.size() && pat.subpats[i].type == MacroPatEnt::PAT_LOOP )
+        {
+            const auto& cur_pat = pat.subpats[i];
+            bool is_optional = (cur_pat.name == "*");
+
+            get_loop_entry_pats(cur_pat, entry_pats);
+
+            if( !is_optional )
+            {
+                // Non-optional loop, MUST be entered, so return after recursing
+                return ;
+            }
+            // Optional, so continue the loop.
+            i ++;
+        }
+
+        // First non-loop pattern
+        if( i < pat.subpats.size() )
+        {
+            entry_pats.push_back( &pat.subpats[i] );
+        }
+    }
+
+    class PatternCompiler
+    {
+        ::std::vector<MacroPatOp>   m_ops;
+    public:
+        ::std::vector<MacroPatOp> compile(const ::std::vector<MacroPatEnt>& pattern)
+        {
+            compile_seq(pattern);
+            m_ops.push_back( MacroPatOp(MacroPatOp::OP_END) );
+            return mv$(m_ops);
+        }
+    private:
+        unsigned int cur_pos() const {
+            return m_ops.size();
+        }
+        unsigned int push(MacroPatOp op) {
+            m_ops.push_back( mv$(op) );
+            return m_ops.size() - 1;
+        }
+        unsigned int push_jump(MacroPatOp::Type ty, unsigned int target=0) {
+            auto op = MacroPatOp(ty);
+            op.target = target;
+            return push( mv$(op) );
+        }
+        unsigned int push_if(bool is_equal, const MacroPatEnt& pat) {
+            if( pat.type == MacroPatEnt::PAT_TOKEN ) {
+                auto op = MacroPatOp(MacroPatOp::OP_IF_TOK);
+                op.tok = pat.tok.clone();
+                op.is_equal = is_equal;
+                return push( mv$(op) );
+            }
+            else {
+                auto op = MacroPatOp(MacroPatOp::OP_IF_PAT);
+                op.pat_type = pat.type;
+                op.is_equal = is_equal;
+                return push( mv$(op) );
+            }
+        }
+
+        void compile_seq(const ::std::vector<MacroPatEnt>& ents)
+        {
+            for(size_t i = 0; i < ents.size(); i ++)
+            {
+                const auto& pat = ents[i];
+                if( pat.type == MacroPatEnt::PAT_LOOP ) {
+                    const auto* next = (i+1 < ents.size() ? &ents[i+1] : nullptr);
+                    if( compile_loop(pat, next) ) {
+                        // The loop consumed the following token on exit
+                        i ++;
+                    }
+                }
+                else if( pat.type == MacroPatEnt::PAT_TOKEN ) {
+                    auto op = MacroPatOp(MacroPatOp::OP_EXPECT_TOK);
+                    op.tok = pat.tok.clone();
+                    push( mv$(op) );
+                }
+                else {
+                    auto op = MacroPatOp(MacroPatOp::OP_EXPECT_PAT);
+                    op.pat_type = pat.type;
+                    op.idx = pat.name_index;
+                    push( mv$(op) );
+                }
+            }
+        }
+
+        void set_targets(const ::std::vector<unsigned int>& ops, unsigned int target) {
+            for(auto idx : ops)
+                m_ops[idx].target = target;
+        }
+
+        /// Emit the conditions that decide if an iteration of `pat` starts
+        /// - Jumps that start the iteration are added to `enter`, the ones that leave the loop to `exit`
+        void compile_loop_entry(const MacroPatEnt& pat, ::std::vector<unsigned int>& enter, ::std::vector<unsigned int>& exit)
+        {
+            ::std::vector<const MacroPatEnt*> entry_pats;
+            get_loop_entry_pats(pat, entry_pats);
+            DEBUG("entry_pats = [" << FMT_CB(ss, for(const auto* p : entry_pats) { ss << *p << ","; }) << "]");
+
+            if( entry_pats.size() == 0 ) {
+                // Nothing can start an iteration, never enter
+                exit.push_back( push_jump(MacroPatOp::OP_JUMP) );
+            }
+            else if( entry_pats.size() == 1 ) {
+                exit.push_back( push_if(false, *entry_pats[0]) );
+                enter.push_back( push_jump(MacroPatOp::OP_JUMP) );
+            }
+            else {
+                // Multiple entry possibilities, enter if any of them match
+                for(const auto* ep : entry_pats) {
+                    enter.push_back( push_if(true, *ep) );
+                }
+                exit.push_back( push_jump(MacroPatOp::OP_JUMP) );
+            }
+        }
+
+        /// Compile a loop, returns true if the loop also handled `next` (done when the separator is the same token
+        /// as the one following the loop, as the separator can't be distinguished from the end of the loop)
+        bool compile_loop(const MacroPatEnt& pat, const MacroPatEnt* next)
+        {
+            TRACE_FUNCTION_F(pat);
+            ::std::vector<unsigned int> enter;
+            ::std::vector<unsigned int> exit;
+            ::std::vector<unsigned int> exit_skip;
+
+            push_jump(MacroPatOp::OP_LOOP_ENTER);
+            if( pat.name == "*" ) {
+                compile_loop_entry(pat, enter, exit);
+            }
+            else {
+                // `+` loops always run at least once
+                assert( pat.name == "+" );
+            }
+
+            auto body = cur_pos();
+            compile_seq(pat.subpats);
+            push_jump(MacroPatOp::OP_LOOP_NEXT);
+
+            bool sep_is_next = false;
+            if( pat.tok == TOK_NULL ) {
+                // No separator, use the loop's first pattern to check for another iteration
+                compile_loop_entry(pat, enter, exit);
+            }
+            else if( next && next->type == MacroPatEnt::PAT_TOKEN && next->tok == pat.tok ) {
+                DEBUG("Separator is the same as the following token");
+                // Consume the separator then check if the loop continues, if it doesn't then the token following the
+                // loop has already been consumed.
+                sep_is_next = true;
+                auto op = MacroPatOp(MacroPatOp::OP_EXPECT_TOK);
+                op.tok = pat.tok.clone();
+                push( mv$(op) );
+                compile_loop_entry(pat, enter, exit_skip);
+            }
+            else {
+                auto op = MacroPatOp(MacroPatOp::OP_IF_TOK);
+                op.tok = pat.tok.clone();
+                op.is_equal = false;
+                exit.push_back( push(mv$(op)) );
+                op = MacroPatOp(MacroPatOp::OP_EXPECT_TOK);
+                op.tok = pat.tok.clone();
+                push( mv$(op) );
+                push_jump(MacroPatOp::OP_JUMP, body);
+            }
+            set_targets(enter, body);
+
+            set_targets(exit, cur_pos());
+            push_jump(MacroPatOp::OP_LOOP_EXIT);
+            if( sep_is_next )
+            {
+                auto op = MacroPatOp(MacroPatOp::OP_EXPECT_TOK);
+                op.tok = next->tok.clone();
+                push( mv$(op) );
+                auto j = push_jump(MacroPatOp::OP_JUMP);
+                set_targets(exit_skip, cur_pos());
+                push_jump(MacroPatOp::OP_LOOP_EXIT);
+                m_ops[j].target = cur_pos();
+            }
+            return sep_is_next;
+        }
+    };
+}
+
+/// Compile the pattern of an arm into a flat list of match operations
+::std::vector<MacroPatOp> Macro_CompilePattern(const ::std::vector<MacroPatEnt>& pattern)
+{
+    return PatternCompiler().compile(pattern);
+}
+
 /// Parse an entire macro_rules! block into a format that exec.cpp can use
 MacroRulesPtr Parse_MacroRules(TokenStream& lex)
 {
@@ -480,6 +676,7 @@ MacroRulesPtr Parse_MacroRules(TokenStream& lex)
         MacroRulesArm   arm = MacroRulesArm( mv$(rule.m_pattern), mv$(rule.m_contents) );
 
         enumerate_names(arm.m_pattern,  arm.m_param_names);
+        arm.m_compiled = Macro_CompilePattern(arm.m_pattern);
 
         rule_arms.push_back( mv$(arm) );
     }
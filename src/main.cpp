@@ -7,8 +7,12 @@
  */
 #include <iostream>
 #include <iomanip>
+#include <fstream>
 #include <string>
 #include <set>
+#include <chrono>
+#include <ctime>
+#include <cstdlib>
 #include "parse/lex.hpp"
 #include "parse/parseerror.hpp"
 #include "ast/ast.hpp"
@@ -16,6 +20,7 @@
 #include <serialiser_texttree.hpp>
 #include <cstring>
 #include <main_bindings.hpp>
+#include <depfile.hpp>
 #include "resolve/main_bindings.hpp"
 #include "hir/main_bindings.hpp"
 #include "hir_conv/main_bindings.hpp"
@@ -27,6 +32,14 @@
 
 #include "expand/cfg.hpp"
 
+#ifdef _WIN32
+# define NOGDI  // Don't include GDI functions (defines some macros that collide with mrustc ones)
+# include <Windows.h>
+#else
+# include <sys/resource.h>
+# include <unistd.h>
+#endif
+
 // Hacky default target
 #ifdef _MSC_VER
 # if defined(_X64)
@@ -56,9 +69,9 @@
 # error "Unable to detect a suitable default target"
 #endif
 
-int g_debug_indent_level = 0;
-bool g_debug_enabled = true;
-::std::string g_cur_phase;
+thread_local int g_debug_indent_level = 0;
+thread_local bool g_debug_enabled = true;
+thread_local ::std::string g_cur_phase;
 ::std::set< ::std::string>    g_debug_disable_map;
 
 void init_debug_list()
@@ -140,6 +153,15 @@ bool debug_enabled()
 {
     return g_debug_enabled;
 }
+const ::std::string& debug_get_phase()
+{
+    return g_cur_phase;
+}
+void debug_set_phase(const ::std::string& name)
+{
+    g_cur_phase = name;
+    g_debug_enabled = debug_enabled_update();
+}
 ::std::ostream& debug_output(int indent, const char* function)
 {
     return ::std::cout << g_cur_phase << "- " << RepeatLitStr { " ", indent } << function << ": ";
@@ -168,8 +190,16 @@ struct ProgramParams
 
     unsigned opt_level = 0;
     bool emit_debug_info = false;
+    /// Number of worker threads for parallelised phases
+    unsigned num_jobs = 1;
+    /// Number of worker threads used for "Typecheck Expressions"
+    unsigned typeck_jobs = 1;
 
     bool test_harness = false;
+    /// Report the time and memory used by each phase (`--timings`)
+    bool timings = false;
+    /// Created once a library's metadata has been written, before the C compiler runs (`--metadata-ready <file>`)
+    ::std::string   metadata_ready_file;
 
     ::std::vector<const char*> lib_search_dirs;
     ::std::vector<const char*> libraries;
@@ -185,23 +215,191 @@ struct ProgramParams
     } debug;
     struct {
         ::std::string   emit_build_command;
+        ::std::string   emit_depfile;
+        unsigned int    codegen_units = 1;
+        bool    share_generics = false;
+        ::std::string   object_cache_dir;
+        uint64_t    object_cache_size = 1024ull*1024*1024;
     } codegen;
 
     ProgramParams(int argc, char *argv[]);
 };
 
+/// Process resource usage at a point in time
+struct ResourceSample
+{
+    ::std::chrono::steady_clock::time_point wall;
+    /// User+system time of all threads (and finished child processes, i.e. the C compiler), in seconds
+    double  cpu;
+    /// Resident set size in KiB (0 if unknown)
+    long    rss_kb;
+
+    static ResourceSample now()
+    {
+        ResourceSample  rv;
+        rv.wall = ::std::chrono::steady_clock::now();
+#ifdef _WIN32
+        FILETIME    ft_create, ft_exit, ft_kernel, ft_user;
+        GetProcessTimes(GetCurrentProcess(), &ft_create, &ft_exit, &ft_kernel, &ft_user);
+        auto to_s = [](const FILETIME& ft){ return static_cast<double>((static_cast<uint64_t>(ft.dwHighDateTime) << 32) | ft.dwLowDateTime) / 1e7; };
+        rv.cpu = to_s(ft_kernel) + to_s(ft_user);
+        // TODO: GetProcessMemoryInfo (needs psapi)
+        rv.rss_kb = 0;
+#else
+        auto cpu_time = [](int who) {
+            struct rusage   ru;
+            getrusage(who, &ru);
+            return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 + ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+            };
+        rv.cpu = cpu_time(RUSAGE_SELF) + cpu_time(RUSAGE_CHILDREN);
+        // - Current RSS is only available from procfs
+        rv.rss_kb = 0;
+        ::std::ifstream statm("/proc/self/statm");
+        long size_pages, rss_pages;
+        if( statm >> size_pages >> rss_pages )
+            rv.rss_kb = rss_pages * (sysconf(_SC_PAGESIZE) / 1024);
+#endif
+        return rv;
+    }
+    /// Peak resident set size of the process in KiB (0 if unknown)
+    static long peak_rss_kb()
+    {
+#ifdef _WIN32
+        return 0;
+#else
+        struct rusage   ru;
+        getrusage(RUSAGE_SELF, &ru);
+# ifdef __APPLE__
+        return ru.ru_maxrss / 1024; // Bytes on macOS
+# else
+        return ru.ru_maxrss;
+# endif
+#endif
+    }
+};
+/// Per-phase resource usage, collected by `CompilePhase` when `--timings` is passed
+struct PhaseTimings
+{
+    struct Entry
+    {
+        ::std::string   name;
+        double  wall;
+        double  cpu;
+        long    rss_kb;
+        long    rss_delta_kb;
+    };
+    bool    enabled = false;
+    ResourceSample  start;
+    ::std::vector<Entry>    phases;
+    /// Phase that is currently running (reported as incomplete if compilation stops during it)
+    const char* cur_phase = nullptr;
+    ResourceSample  cur_start;
+    /// Output path for the JSON report
+    ::std::string   json_path;
+    /// Set once the report has been written (it's written from whichever exit path is taken first)
+    bool    reported = false;
+
+    void add(const char* name, const ResourceSample& before, const ResourceSample& after)
+    {
+        phases.push_back(Entry {
+            name,
+            ::std::chrono::duration<double>(after.wall - before.wall).count(),
+            after.cpu - before.cpu,
+            after.rss_kb,
+            after.rss_kb - before.rss_kb
+            });
+    }
+
+    /// Print a table of the recorded phases (and the totals) and write the same as JSON to `json_path`
+    void report(::std::ostream& os)
+    {
+        if( !enabled || reported )
+            return ;
+        reported = true;
+        auto end = ResourceSample::now();
+        if( cur_phase )
+        {
+            add(cur_phase, cur_start, end);
+            phases.back().name += " (incomplete)";
+            cur_phase = nullptr;
+        }
+        double  total_wall = ::std::chrono::duration<double>(end.wall - start.wall).count();
+        double  total_cpu = end.cpu - start.cpu;
+        long    peak_rss_kb = ResourceSample::peak_rss_kb();
+
+        size_t  name_width = 5;
+        for(const auto& e : phases)
+            if( e.name.size() > name_width )
+                name_width = e.name.size();
+
+        os << ::std::left << ::std::setw(name_width) << "Phase" << ::std::right
+            << "  " << ::std::setw(9) << "Wall (s)" << "  " << ::std::setw(9) << "CPU (s)"
+            << "  " << ::std::setw(10) << "RSS (MiB)" << "  " << ::std::setw(10) << "dRSS (MiB)"
+            << ::std::endl;
+        os << ::std::fixed;
+        for(const auto& e : phases)
+        {
+            os << ::std::left << ::std::setw(name_width) << e.name << ::std::right
+                << "  " << ::std::setw(9) << ::std::setprecision(3) << e.wall << "  " << ::std::setw(9) << e.cpu
+                << "  " << ::std::setw(10) << ::std::setprecision(1) << e.rss_kb / 1024.0 << "  " << ::std::setw(10) << e.rss_delta_kb / 1024.0
+                << ::std::endl;
+        }
+        os << ::std::left << ::std::setw(name_width) << "Total" << ::std::right
+            << "  " << ::std::setw(9) << ::std::setprecision(3) << total_wall << "  " << ::std::setw(9) << total_cpu
+            << "  " << ::std::setw(10) << ::std::setprecision(1) << peak_rss_kb / 1024.0 << "  (peak)"
+            << ::std::endl;
+
+        ::std::ofstream js(json_path);
+        if( !js.is_open() ) {
+            ::std::cerr << "warning: Unable to open " << json_path << " for writing" << ::std::endl;
+            return ;
+        }
+        js << ::std::fixed << ::std::setprecision(6);
+        js << "{\n  \"phases\": [\n";
+        for(size_t i = 0; i < phases.size(); i ++)
+        {
+            const auto& e = phases[i];
+            js << "    {\"name\": \"";
+            for(char c : e.name) {
+                if( c == '"' || c == '\\' )
+                    js << '\\';
+                js << c;
+            }
+            js << "\", \"wall_s\": " << e.wall << ", \"cpu_s\": " << e.cpu
+                << ", \"rss_kib\": " << e.rss_kb << ", \"rss_delta_kib\": " << e.rss_delta_kb << "}"
+                << (i + 1 < phases.size() ? "," : "") << "\n";
+        }
+        js << "  ],\n";
+        js << "  \"total\": {\"wall_s\": " << total_wall << ", \"cpu_s\": " << total_cpu << ", \"peak_rss_kib\": " << peak_rss_kb << "}\n";
+        js << "}\n";
+    }
+} g_phase_timings;
+
+/// Write the timings report when compilation stops early (`exit`, or a BUG/ERROR that is about to abort)
+void timings_report_on_exit()
+{
+    g_phase_timings.report(::std::cout);
+    ::std::cout << ::std::flush;
+}
+
 template <typename Rv, typename Fcn>
 Rv CompilePhase(const char *name, Fcn f) {
     ::std::cout << name << ": V V V" << ::std::endl;
-    g_cur_phase = name;
-    g_debug_enabled = debug_enabled_update();
-    auto start = clock();
+    debug_set_phase(name);
+    if( g_phase_timings.enabled ) {
+        g_phase_timings.cur_phase = name;
+        g_phase_timings.cur_start = ResourceSample::now();
+    }
+    auto start_cpu = clock();
     auto rv = f();
-    auto end = clock();
-    g_cur_phase = "";
-    g_debug_enabled = debug_enabled_update();
+    auto end_cpu = clock();
+    debug_set_phase("");
+    if( g_phase_timings.enabled ) {
+        g_phase_timings.add(name, g_phase_timings.cur_start, ResourceSample::now());
+        g_phase_timings.cur_phase = nullptr;
+    }
 
-    ::std::cout <<"(" << ::std::fixed << ::std::setprecision(2) << static_cast<double>(end - start) / static_cast<double>(CLOCKS_PER_SEC) << " s) ";
+    ::std::cout <<"(" << ::std::fixed << ::std::setprecision(2) << static_cast<double>(end_cpu - start_cpu) / static_cast<double>(CLOCKS_PER_SEC) << " s) ";
     ::std::cout << name << ": DONE";
     ::std::cout << ::std::endl;
     return rv;
@@ -211,12 +409,38 @@ void CompilePhaseV(const char *name, Fcn f) {
     CompilePhase<int>(name, [&]() { f(); return 0; });
 }
 
+/// Tell the build tool (e.g. minicargo) that the crate's metadata is complete, so dependent crates can start
+void signal_metadata_ready(const ::std::string& marker_path)
+{
+    ::std::ofstream os(marker_path);
+    if( !os.is_open() ) {
+        ::std::cerr << "warning: Unable to create " << marker_path << ::std::endl;
+    }
+}
+
 /// main!
 int main(int argc, char *argv[])
 {
     init_debug_list();
+    auto start_time = ::std::chrono::steady_clock::now();
     ProgramParams   params(argc, argv);
 
+    // Report the per-phase timings however compilation finishes
+    struct TimingsReport {
+        ~TimingsReport() {
+            g_phase_timings.report(::std::cout);
+        }
+    } timings_report;
+    if( params.timings )
+    {
+        g_phase_timings.enabled = true;
+        g_phase_timings.start = ResourceSample::now();
+        g_phase_timings.start.wall = start_time;
+        g_phase_timings.json_path = params.outfile + ".timings.json";
+        ::std::atexit(timings_report_on_exit);
+        Span_SetStopHook(timings_report_on_exit);
+    }
+
     // Set up cfg values
     Cfg_SetValue("rust_compiler", "mrustc");
     Cfg_SetValueCb("feature", [&params](const ::std::string& s) {
@@ -465,7 +689,7 @@ int main(int argc, char *argv[])
             });
         // Check the rest of the expressions (including function bodies)
         CompilePhaseV("Typecheck Expressions", [&]() {
-            Typecheck_Expressions(*hir_crate);
+            Typecheck_Expressions(*hir_crate, params.typeck_jobs);
             });
         // === HIR Expansion ===
         // Annotate how each node's result is used
@@ -503,7 +727,7 @@ int main(int argc, char *argv[])
 
         // Lower expressions into MIR
         CompilePhaseV("Lower MIR", [&]() {
-            HIR_GenerateMIR(*hir_crate);
+            HIR_GenerateMIR(*hir_crate, params.num_jobs);
             });
 
         CompilePhaseV("Dump MIR", [&]() {
@@ -513,7 +737,7 @@ int main(int argc, char *argv[])
 
         // Validate the MIR
         CompilePhaseV("MIR Validate", [&]() {
-            MIR_CheckCrate(*hir_crate);
+            MIR_CheckCrate(*hir_crate, params.num_jobs);
             });
 
         // Second shot of constant evaluation (with full type information)
@@ -525,20 +749,23 @@ int main(int argc, char *argv[])
             HIR_Dump( os, *hir_crate );
             });
 
+        // The crate's items and impls are final from here on, so trait resolution answers can be shared
+        Typecheck_EnableSharedCache(*hir_crate);
+
         // - Expand constants in HIR and virtualise calls
         CompilePhaseV("MIR Cleanup", [&]() {
-            MIR_CleanupCrate(*hir_crate);
+            MIR_CleanupCrate(*hir_crate, params.num_jobs);
             });
         if( params.debug.full_validate_early || getenv("MRUSTC_FULL_VALIDATE_PREOPT") )
         {
             CompilePhaseV("MIR Validate Full Early", [&]() {
-                MIR_CheckCrate_Full(*hir_crate);
+                MIR_CheckCrate_Full(*hir_crate, params.num_jobs);
                 });
         }
 
         // Optimise the MIR
         CompilePhaseV("MIR Optimise", [&]() {
-            MIR_OptimiseCrate(*hir_crate, params.debug.disable_mir_optimisations);
+            MIR_OptimiseCrate(*hir_crate, params.debug.disable_mir_optimisations, params.num_jobs);
             });
 
         CompilePhaseV("Dump MIR", [&]() {
@@ -546,13 +773,13 @@ int main(int argc, char *argv[])
             MIR_Dump( os, *hir_crate );
             });
         CompilePhaseV("MIR Validate PO", [&]() {
-            MIR_CheckCrate(*hir_crate);
+            MIR_CheckCrate(*hir_crate, params.num_jobs);
             });
         // - Exhaustive MIR validation (follows every code path and checks variable validity)
         // > DEBUGGING ONLY
         CompilePhaseV("MIR Validate Full", [&]() {
             if( params.debug.full_validate || getenv("MRUSTC_FULL_VALIDATE") )
-                MIR_CheckCrate_Full(*hir_crate);
+                MIR_CheckCrate_Full(*hir_crate, params.num_jobs);
             });
 
         if( params.last_stage == ProgramParams::STAGE_MIR ) {
@@ -565,6 +792,17 @@ int main(int argc, char *argv[])
         // - Require codegen (public or used by an exported function)
         TransOptions    trans_opt;
         trans_opt.build_command_file = params.codegen.emit_build_command;
+        trans_opt.codegen_units = params.codegen.codegen_units;
+        trans_opt.object_cache_dir = params.codegen.object_cache_dir;
+        trans_opt.object_cache_size = params.codegen.object_cache_size;
+        trans_opt.num_jobs = params.num_jobs;
+        // Shared instances are weak symbols, which MSVC doesn't support for functions
+        if( params.codegen.share_generics && Target_GetCurSpec().m_codegen_mode == CodegenMode::Msvc ) {
+            ::std::cerr << "warning: -Z share-generics is not supported with MSVC, ignoring" << ::std::endl;
+        }
+        else {
+            trans_opt.share_generics = params.codegen.share_generics;
+        }
         trans_opt.opt_level = params.opt_level;
         for(const char* libdir : params.lib_search_dirs ) {
             // Store these paths for use in final linking.
@@ -589,26 +827,45 @@ int main(int argc, char *argv[])
         case ::AST::Crate::Type::RustLib: {
             #if 1
             // Generate a .o
-            TransList   items = CompilePhase<TransList>("Trans Enumerate", [&]() { return Trans_Enumerate_Public(*hir_crate); });
+            TransList   items = CompilePhase<TransList>("Trans Enumerate", [&]() { return Trans_Enumerate_Public(*hir_crate, trans_opt); });
+            if( params.metadata_ready_file != "" )
+            {
+                // Pipelined build: Dependent crates only need the metadata, so save it (and let the caller know)
+                // before running the C compiler.
+                // - Codegen only reads the crate, so this doesn't change the output.
+                CompilePhaseV("HIR Serialise", [&]() { HIR_Serialise(params.outfile, *hir_crate); });
+                signal_metadata_ready(params.metadata_ready_file);
+            }
             CompilePhaseV("Trans Codegen", [&]() { Trans_Codegen(params.outfile + ".o", trans_opt, *hir_crate, items, false); });
             #endif
 
             // Save a loadable HIR dump
-            CompilePhaseV("HIR Serialise", [&]() {
-                //HIR_Serialise(params.outfile + ".meta", *hir_crate);
-                HIR_Serialise(params.outfile, *hir_crate);
-                });
+            if( params.metadata_ready_file == "" )
+            {
+                CompilePhaseV("HIR Serialise", [&]() {
+                    //HIR_Serialise(params.outfile + ".meta", *hir_crate);
+                    HIR_Serialise(params.outfile, *hir_crate);
+                    });
+            }
 
             // Link metatdata and object into a .rlib
             break; }
         case ::AST::Crate::Type::RustDylib: {
             #if 1
             // Generate a .o
-            TransList   items = CompilePhase<TransList>("Trans Enumerate", [&]() { return Trans_Enumerate_Public(*hir_crate); });
+            TransList   items = CompilePhase<TransList>("Trans Enumerate", [&]() { return Trans_Enumerate_Public(*hir_crate, trans_opt); });
+            if( params.metadata_ready_file != "" )
+            {
+                CompilePhaseV("HIR Serialise", [&]() { HIR_Serialise(params.outfile, *hir_crate); });
+                signal_metadata_ready(params.metadata_ready_file);
+            }
             CompilePhaseV("Trans Codegen", [&]() { Trans_Codegen(params.outfile + ".o", trans_opt, *hir_crate, items, false); });
             #endif
             // Save a loadable HIR dump
-            CompilePhaseV("HIR Serialise", [&]() { HIR_Serialise(params.outfile, *hir_crate); });
+            if( params.metadata_ready_file == "" )
+            {
+                CompilePhaseV("HIR Serialise", [&]() { HIR_Serialise(params.outfile, *hir_crate); });
+            }
 
             // Generate a .so/.dll
             // TODO: Codegen and include the metadata in a non-loadable segment
@@ -620,10 +877,10 @@ int main(int argc, char *argv[])
             // Needs: An executable (the actual macro handler), metadata (for `extern crate foo;`)
             // Can just emit the metadata and do miri?
             // - Requires MIR for EVERYTHING, not feasable.
-            TransList items = CompilePhase<TransList>("Trans Enumerate", [&]() { return Trans_Enumerate_Public(*hir_crate); });
+            TransList items = CompilePhase<TransList>("Trans Enumerate", [&]() { return Trans_Enumerate_Public(*hir_crate, trans_opt); });
             CompilePhaseV("Trans Codegen", [&]() { Trans_Codegen(params.outfile + ".o", trans_opt, *hir_crate, items, false); });
 
-            TransList items2 = CompilePhase<TransList>("Trans Enumerate", [&]() { return Trans_Enumerate_Main(*hir_crate); });
+            TransList items2 = CompilePhase<TransList>("Trans Enumerate", [&]() { return Trans_Enumerate_Main(*hir_crate, trans_opt); });
             CompilePhaseV("Trans Codegen", [&]() { Trans_Codegen(params.outfile + "-plugin", trans_opt, *hir_crate, items2, true); });
 
             hir_crate->m_lang_items.clear();    // Make sure that we're not exporting any lang items
@@ -632,12 +889,20 @@ int main(int argc, char *argv[])
         case ::AST::Crate::Type::Executable:
             // Generate a binary
             // - Enumerate items for translation
-            TransList items = CompilePhase<TransList>("Trans Enumerate", [&]() { return Trans_Enumerate_Main(*hir_crate); });
+            TransList items = CompilePhase<TransList>("Trans Enumerate", [&]() { return Trans_Enumerate_Main(*hir_crate, trans_opt); });
             // - Perform codegen
             CompilePhaseV("Trans Codegen", [&]() { Trans_Codegen(params.outfile, trans_opt, *hir_crate, items, true); });
             // - Invoke linker?
             break;
         }
+
+        if( params.codegen.emit_depfile != "" )
+        {
+            if( !Depfile_Write(params.codegen.emit_depfile, params.outfile) ) {
+                ::std::cerr << "Unable to write depfile " << params.codegen.emit_depfile << ::std::endl;
+                return 1;
+            }
+        }
     }
     catch(unsigned int) {}
     //catch(const CompileError::Base& e)
@@ -709,6 +974,26 @@ ProgramParams::ProgramParams(int argc, char *argv[])
                     this->libraries.push_back( arg+1 );
                 }
                 continue ;
+            // "-j <n>" : Number of worker threads for parallel phases
+            case 'j': {
+                const char* val;
+                if( arg[1] == '\0' ) {
+                    if( i == argc - 1 ) {
+                        ::std::cerr << "Option " << arg << " requires an argument" << ::std::endl;
+                        exit(1);
+                    }
+                    val = argv[++i];
+                }
+                else {
+                    val = arg+1;
+                }
+                int n = ::std::atoi(val);
+                if( n <= 0 ) {
+                    ::std::cerr << "Invalid job count '" << val << "'" << ::std::endl;
+                    exit(1);
+                }
+                this->num_jobs = n;
+                } continue;
             case 'C': {
                 ::std::string optname;
                 ::std::string optval;
@@ -731,6 +1016,39 @@ ProgramParams::ProgramParams(int argc, char *argv[])
                 if( optname == "emit-build-command" ) {
                     this->codegen.emit_build_command = optval;
                 }
+                // `-C emit-depfile=<file>` - Write a makefile-style list of every file read (sources, included files, extern crates)
+                else if( optname == "emit-depfile" ) {
+                    if( optval == "" ) {
+                        ::std::cerr << "-C emit-depfile requires a path" << ::std::endl;
+                        exit(1);
+                    }
+                    this->codegen.emit_depfile = optval;
+                }
+                else if( optname == "codegen-units" ) {
+                    int n = ::std::atoi(optval.c_str());
+                    if( n <= 0 ) {
+                        ::std::cerr << "Invalid value for codegen-units: '" << optval << "'" << ::std::endl;
+                        exit(1);
+                    }
+                    this->codegen.codegen_units = n;
+                }
+                else if( optname == "object-cache" ) {
+                    if( optval == "" ) {
+                        ::std::cerr << "Option -C object-cache requires a directory" << ::std::endl;
+                        exit(1);
+                    }
+                    this->codegen.object_cache_dir = optval;
+                }
+                else if( optname == "object-cache-size" ) {
+                    // Size limit in MiB
+                    char* end;
+                    auto n = ::std::strtoull(optval.c_str(), &end, 10);
+                    if( optval == "" || *end != '\0' || n == 0 ) {
+                        ::std::cerr << "Invalid value for object-cache-size: '" << optval << "'" << ::std::endl;
+                        exit(1);
+                    }
+                    this->codegen.object_cache_size = n * 1024*1024;
+                }
                 else {
                     ::std::cerr << "Unknown codegen option: '" << optname << "'" << ::std::endl;
                     exit(1);
@@ -758,6 +1076,9 @@ ProgramParams::ProgramParams(int argc, char *argv[])
                 else if( optname == "full-validate-early" ) {
                     this->debug.full_validate_early = true;
                 }
+                else if( optname == "share-generics" ) {
+                    this->codegen.share_generics = true;
+                }
                 else {
                     ::std::cerr << "Unknown debug option: '" << optname << "'" << ::std::endl;
                     exit(1);
@@ -934,9 +1255,35 @@ ProgramParams::ProgramParams(int argc, char *argv[])
                     exit(1);
                 }
             }
+            // `--typeck-jobs <n>`  - Check function bodies on `n` threads
+            else if( strcmp(arg, "--typeck-jobs") == 0 ) {
+                if( i == argc - 1 ) {
+                    ::std::cerr << "Flag " << arg << " requires an argument" << ::std::endl;
+                    exit(1);
+                }
+                const char* val = argv[++i];
+                int n = ::std::atoi(val);
+                if( n <= 0 ) {
+                    ::std::cerr << "Invalid job count '" << val << "'" << ::std::endl;
+                    exit(1);
+                }
+                this->typeck_jobs = n;
+            }
             else if( strcmp(arg, "--test") == 0 ) {
                 this->test_harness = true;
             }
+            // `--timings`  - Print the time/memory used by each phase, and write it to `<outfile>.timings.json`
+            else if( strcmp(arg, "--timings") == 0 ) {
+                this->timings = true;
+            }
+            // `--metadata-ready <file>`    - Pipelined builds: write the .hir first, and create `<file>` before compiling the C code
+            else if( strcmp(arg, "--metadata-ready") == 0 ) {
+                if( i == argc - 1 ) {
+                    ::std::cerr << "Flag " << arg << " requires an argument" << ::std::endl;
+                    exit(1);
+                }
+                this->metadata_ready_file = argv[++i];
+            }
             else {
                 ::std::cerr << "Unknown option '" << arg << "'" << ::std::endl;
                 exit(1);
@@ -28,7 +28,7 @@ namespace {
             else
             {
                 auto vtable_ty_spath = trait_path.m_path.m_path;
-                vtable_ty_spath.m_components.back() += "#vtable";
+                vtable_ty_spath.m_components.back() = vtable_ty_spath.m_components.back() + "#vtable";
                 const auto& vtable_ref = state.m_resolve.m_crate.get_struct_by_path(state.sp, vtable_ty_spath);
                 // Copy the param set from the trait in the trait object
                 ::HIR::PathParams   vtable_params = trait_path.m_path.m_params.clone();
@@ -880,12 +880,11 @@ void MIR_Validate(const StaticTraitResolve& resolve, const ::HIR::ItemPath& path
 
 // --------------------------------------------------------------------
 
-void MIR_CheckCrate(/*const*/ ::HIR::Crate& crate)
+void MIR_CheckCrate(/*const*/ ::HIR::Crate& crate, unsigned int num_jobs)
 {
-    ::MIR::OuterVisitor    ov(crate, [](const auto& res, const auto& p, auto& expr, const auto& args, const auto& ty)
+    ::MIR::visit_crate_mir(crate, num_jobs, [](const auto& res, const auto& p, auto& expr, const auto& args, const auto& ty)
         {
             MIR_Validate(res, p, *expr.m_mir, args, ty);
         }
         );
-    ov.visit_crate( crate );
 }
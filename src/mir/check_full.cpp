@@ -1045,13 +1045,12 @@ void MIR_Validate_Full(const StaticTraitResolve& resolve, const ::HIR::ItemPath&
 
 // --------------------------------------------------------------------
 
-void MIR_CheckCrate_Full(/*const*/ ::HIR::Crate& crate)
+void MIR_CheckCrate_Full(/*const*/ ::HIR::Crate& crate, unsigned int num_jobs)
 {
-    ::MIR::OuterVisitor    ov(crate, [](const auto& res, const auto& p, auto& expr, const auto& args, const auto& ty)
+    ::MIR::visit_crate_mir(crate, num_jobs, [](const auto& res, const auto& p, auto& expr, const auto& args, const auto& ty)
         {
             MIR_Validate_Full(res, p, *expr.m_mir, args, ty);
         }
         );
-    ov.visit_crate( crate );
 }
 
@@ -11,6 +11,7 @@
  */
 #include "main_bindings.hpp"
 #include "mir.hpp"
+#include <hir_expand/main_bindings.hpp>   // ConvertHIR_ConstantEvaluateFull_Monomorph
 #include <hir/visitor.hpp>
 #include <hir_typeck/static.hpp>
 #include <mir/helpers.hpp>
@@ -75,7 +76,7 @@ namespace {
         const auto& trait = *te.m_trait.m_trait_ptr;
 
         auto vtable_ty_spath = te.m_trait.m_path.m_path;
-        vtable_ty_spath.m_components.back() += "#vtable";
+        vtable_ty_spath.m_components.back() = vtable_ty_spath.m_components.back() + "#vtable";
         const auto& vtable_ref = resolve.m_crate.get_struct_by_path(sp, vtable_ty_spath);
         // Copy the param set from the trait in the trait object
         ::HIR::PathParams   vtable_params = te.m_trait.m_path.m_params.clone();
@@ -92,15 +93,24 @@ namespace {
 
 const ::HIR::Literal* MIR_Cleanup_GetConstant(const Span& sp, const StaticTraitResolve& resolve, const ::HIR::Path& path,  ::HIR::TypeRef& out_ty)
 {
+    // Constants that depend on impl/method parameters aren't evaluated until their use site is monomorphised
+    auto get_value = [&](const ::HIR::Literal& lit)->const ::HIR::Literal* {
+        if( !lit.is_Invalid() )
+            return &lit;
+        if( monomorphise_path_needed(path) )
+        {
+            DEBUG(path << " contains a generic, leaving until monomorphised");
+            return nullptr;
+        }
+        return &ConvertHIR_ConstantEvaluateFull_Monomorph(resolve.m_crate, sp, path);
+        };
     TU_MATCHA( (path.m_data), (pe),
     (Generic,
         const auto& constant = resolve.m_crate.get_constant_by_path(sp, pe.m_path);
         if( pe.m_params.m_types.size() != 0 )
             TODO(sp, "Generic constants - " << path);
         out_ty = constant.m_type.clone();
-        if( constant.m_value_res.is_Invalid() )
-            return nullptr;
-        return &constant.m_value_res;
+        return get_value(constant.m_value_res);
         ),
     (UfcsUnknown,
         BUG(sp, "UfcsUnknown in MIR - " << path);
@@ -158,12 +168,12 @@ const ::HIR::Literal* MIR_Cleanup_GetConstant(const Span& sp, const StaticTraitR
             {
                 ASSERT_BUG(sp, best_impl->m_constants.find(pe.item) != best_impl->m_constants.end(), "Item '" << pe.item << "' missing in impl for " << path);
                 const auto& val = best_impl->m_constants.find(pe.item)->second.data;
-                return &val.m_value_res;
+                return get_value(val.m_value_res);
             }
             else
             {
                 // No impl found at all, use the default in the trait
-                return &trait_cdef.m_value_res;
+                return get_value(trait_cdef.m_value_res);
             }
         }
         ),
@@ -184,9 +194,16 @@ const ::HIR::Literal* MIR_Cleanup_GetConstant(const Span& sp, const StaticTraitR
         {
             const auto& val = best_impl->m_constants.find(pe.item)->second.data;
             if( monomorphise_type_needed(val.m_type) )
-                TODO(sp, "Monomorphise constant type - " << val.m_type << " for " << path);
-            out_ty = val.m_type.clone();
-            return &val.m_value_res;
+            {
+                auto monomorph_cb = monomorphise_type_get_cb(sp, &*pe.type, &pe.impl_params, &pe.params);
+                out_ty = monomorphise_type_with(sp, val.m_type, monomorph_cb);
+                resolve.expand_associated_types(sp, out_ty);
+            }
+            else
+            {
+                out_ty = val.m_type.clone();
+            }
+            return get_value(val.m_value_res);
         }
         )
     )
@@ -653,7 +670,7 @@ bool MIR_Cleanup_Unsize_GetMetadata(const ::MIR::TypeResolve& state, MirMutator&
 
             // Obtain vtable type `::"path"::to::Trait#vtable`
             auto vtable_ty_spath = trait_path.m_path.m_path;
-            vtable_ty_spath.m_components.back() += "#vtable";
+            vtable_ty_spath.m_components.back() = vtable_ty_spath.m_components.back() + "#vtable";
             const auto& vtable_ref = state.m_crate.get_struct_by_path(state.sp, vtable_ty_spath);
             // Copy the param set from the trait in the trait object
             ::HIR::PathParams   vtable_params = trait_path.m_path.m_params.clone();
@@ -1201,11 +1218,10 @@ void MIR_Cleanup(const StaticTraitResolve& resolve, const ::HIR::ItemPath& path,
     }
 }
 
-void MIR_CleanupCrate(::HIR::Crate& crate)
+void MIR_CleanupCrate(::HIR::Crate& crate, unsigned int num_jobs)
 {
-    ::MIR::OuterVisitor    ov { crate, [&](const auto& res, const auto& p, auto& expr_ptr, const auto& args, const auto& ty){
+    ::MIR::visit_crate_mir(crate, num_jobs, [&](const auto& res, const auto& p, auto& expr_ptr, const auto& args, const auto& ty){
             MIR_Cleanup(res, p, *expr_ptr.m_mir, args, ty);
-        } };
-    ov.visit_crate(crate);
+        });
 }
 
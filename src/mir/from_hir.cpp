@@ -1801,7 +1801,7 @@ namespace {
                 {
                     m_builder.end_block(::MIR::Terminator::make_Call({
                         next_block, panic_block,
-                        res.clone(), ::MIR::CallTarget::make_Intrinsic({ gpath.m_path.m_components.back(), gpath.m_params.clone() }),
+                        res.clone(), ::MIR::CallTarget::make_Intrinsic({ ::std::string(gpath.m_path.m_components.back()), gpath.m_params.clone() }),
                         mv$(values)
                         }));
                 }
@@ -2409,11 +2409,10 @@ namespace {
 
 // --------------------------------------------------------------------
 
-void HIR_GenerateMIR(::HIR::Crate& crate)
+void HIR_GenerateMIR(::HIR::Crate& crate, unsigned int num_jobs)
 {
-    ::MIR::OuterVisitor    ov { crate, [&](const auto& res, const auto& p, auto& expr_ptr, const auto& args, const auto& ty){
+    ::MIR::visit_crate_mir(crate, num_jobs, [&](const auto& res, const auto& p, auto& expr_ptr, const auto& args, const auto& ty){
             expr_ptr.m_mir = LowerMIR(res, p, expr_ptr, ty, args);
-        } };
-    ov.visit_crate(crate);
+        });
 }
 
@@ -521,9 +521,9 @@ namespace
 {
     struct ValueLifetime
     {
-        ::std::vector<bool> stmt_bitmap;
+        ::MIR::ValueLifetime    lifetime;
         ValueLifetime(size_t stmt_count):
-            stmt_bitmap(stmt_count)
+            lifetime(stmt_count)
         {}
 
         void fill(const ::std::vector<size_t>& block_offsets, size_t bb, size_t first_stmt, size_t last_stmt)
@@ -532,9 +532,9 @@ namespace
             DEBUG("bb" << bb << " : " << first_stmt << "--" << last_stmt);
             assert(first_stmt <= limit);
             assert(last_stmt <= limit);
-            for(size_t stmt = first_stmt; stmt <= last_stmt; stmt++)
+            if( first_stmt <= last_stmt )
             {
-                stmt_bitmap[block_offsets[bb] + stmt] = true;
+                lifetime.set_range(block_offsets[bb] + first_stmt, block_offsets[bb] + last_stmt);
             }
         }
 
@@ -544,11 +544,11 @@ namespace
             while(name.size() < 3+1+3)
                 name += " ";
             DEBUG(name << " : " << FMT_CB(os,
-                for(unsigned int j = 0; j < this->stmt_bitmap.size(); j++)
+                for(unsigned int j = 0; j < block_offsets.back(); j++)
                 {
                     if(j != 0 && ::std::find(block_offsets.begin(), block_offsets.end(), j) != block_offsets.end())
                         os << "|";
-                    os << (this->stmt_bitmap[j] ? "X" : " ");
+                    os << (this->lifetime.valid_at(j) ? "X" : " ");
                 }
                 ));
         }
@@ -657,7 +657,7 @@ void MIR_Helper_GetLifetimes_DetermineValueLifetime(::MIR::TypeResolve& state, c
     rv.m_block_offsets = mv$(block_offsets);
     rv.m_slots.reserve( slot_lifetimes.size() );
     for(auto& lft : slot_lifetimes)
-        rv.m_slots.push_back( ::MIR::ValueLifetime(mv$(lft.stmt_bitmap)) );
+        rv.m_slots.push_back( mv$(lft.lifetime) );
     return rv;
 }
 void MIR_Helper_GetLifetimes_DetermineValueLifetime(
@@ -814,7 +814,7 @@ void MIR_Helper_GetLifetimes_DetermineValueLifetime(
             m_block_offsets(block_offsets),
             m_lifetimes(vl),
 
-            m_visited_statements( m_lifetimes.stmt_bitmap.size() )
+            m_visited_statements( m_lifetimes.lifetime.statement_count() )
         {
             ::HIR::TypeRef  tmp;
             m_is_copy = m_mir_res.m_resolve.type_is_copy(mir_res.sp, m_mir_res.get_lvalue_type(tmp, lv));
@@ -988,7 +988,7 @@ void MIR_Helper_GetLifetimes_DetermineValueLifetime(
         }
     };
 
-    ::std::vector<bool> use_bitmap(vl.stmt_bitmap.size());  // Bitmap of locations where this value is used.
+    ::std::vector<bool> use_bitmap(vl.lifetime.statement_count());  // Bitmap of locations where this value is used.
     {
         size_t  pos = 0;
         for(const auto& bb : fcn.blocks)
@@ -1023,7 +1023,7 @@ void MIR_Helper_GetLifetimes_DetermineValueLifetime(
 
         if( runner.m_visited_statements.at( block_offsets.at(bb_idx) + 0 ) )
         {
-            if( vl.stmt_bitmap.at( block_offsets.at(bb_idx) + 0) )
+            if( vl.lifetime.valid_at( block_offsets.at(bb_idx) + 0) )
             {
                 DEBUG("Looped (to already valid)");
                 state.mark_read(0);
@@ -1080,7 +1080,7 @@ void MIR_Helper_GetLifetimes_DetermineValueLifetime(
 #endif
 
         // Special case for when doing multiple runs on the same output
-        if( vl.stmt_bitmap.at( block_offsets.at(bb_idx) + 0) )
+        if( vl.lifetime.valid_at( block_offsets.at(bb_idx) + 0) )
         {
             DEBUG("Already valid in BB" << bb_idx);
             state.mark_read(0);
@@ -1114,7 +1114,7 @@ void MIR_Helper_GetLifetimes_DetermineValueLifetime(
             auto bb_idx = it->first;
             auto& state = it->second;
             // If the target of this loopback is valid, then the entire route to the loopback must have been valid
-            if( vl.stmt_bitmap.at( block_offsets.at(bb_idx) + 0) )
+            if( vl.lifetime.valid_at( block_offsets.at(bb_idx) + 0) )
             {
                 change = true;
                 DEBUG("Looped (now valid)");
@@ -1180,7 +1180,7 @@ void MIR_Helper_GetLifetimes_DetermineValueLifetime(
             return this->end == Position { ~0u, ~0u };
         }
     };
-    static unsigned NEXT_INDEX = 0;
+    static thread_local unsigned NEXT_INDEX = 0;
     struct State
     {
         unsigned int index = 0;
@@ -8,6 +8,7 @@
 #pragma once
 #include <vector>
 #include <functional>
+#include <cstdint>
 #include <hir_typeck/static.hpp>
 
 namespace HIR {
@@ -118,41 +119,95 @@ public:
 // --------------------------------------------------------------------
 // MIR_Helper_GetLifetimes
 // --------------------------------------------------------------------
+/// Set of statements (indexed by `ValueLifetimes::m_block_offsets`) in which a value is valid
+///
+/// Stored as a bitmap covering only the words between the first and last valid statements, so short-lived values
+/// (the vast majority) are cheap to store and compare even in very large functions.
 class ValueLifetime
 {
-    ::std::vector<bool> statements;
+    size_t  m_statement_count;
+    /// Word index of `m_words[0]`
+    size_t  m_first_word;
+    /// Bitmap of statements `m_first_word*64 ..`, empty if the value is never valid
+    ::std::vector<uint64_t> m_words;
 
 public:
-    ValueLifetime(::std::vector<bool> stmts):
-        statements( mv$(stmts) )
+    ValueLifetime(size_t statement_count):
+        m_statement_count(statement_count),
+        m_first_word(0)
     {}
 
+    size_t statement_count() const {
+        return m_statement_count;
+    }
     bool valid_at(size_t ofs) const {
-        return statements.at(ofs);
+        assert(ofs < m_statement_count);
+        size_t  w = ofs / 64;
+        if( w < m_first_word || w - m_first_word >= m_words.size() )
+            return false;
+        return (m_words[w - m_first_word] >> (ofs % 64)) & 1;
     }
 
     // true if this value is used at any point
     bool is_used() const {
-        for(auto v : statements)
-            if( v )
-                return true;
-        return false;
+        // NOTE: Words are only added when a bit is set
+        return !m_words.empty();
     }
     bool overlaps(const ValueLifetime& x) const {
-        assert(statements.size() == x.statements.size());
-        for(unsigned int i = 0; i < statements.size(); i ++)
+        assert(m_statement_count == x.m_statement_count);
+        size_t  start = ::std::max(m_first_word, x.m_first_word);
+        size_t  end = ::std::min(m_first_word + m_words.size(), x.m_first_word + x.m_words.size());
+        for(size_t w = start; w < end; w ++)
         {
-            if( statements[i] && x.statements[i] )
+            if( m_words[w - m_first_word] & x.m_words[w - x.m_first_word] )
                 return true;
         }
         return false;
     }
     void unify(const ValueLifetime& x) {
-        assert(statements.size() == x.statements.size());
-        for(unsigned int i = 0; i < statements.size(); i ++)
+        assert(m_statement_count == x.m_statement_count);
+        if( x.m_words.empty() )
+            return ;
+        this->reserve_words(x.m_first_word, x.m_first_word + x.m_words.size());
+        for(size_t i = 0; i < x.m_words.size(); i ++)
+        {
+            m_words[x.m_first_word + i - m_first_word] |= x.m_words[i];
+        }
+    }
+    /// Mark the statements `first` to `last` (inclusive) as valid
+    void set_range(size_t first, size_t last) {
+        assert(first <= last);
+        assert(last < m_statement_count);
+        size_t  first_w = first / 64;
+        size_t  last_w = last / 64;
+        this->reserve_words(first_w, last_w + 1);
+        for(size_t w = first_w; w <= last_w; w ++)
+        {
+            uint64_t    mask = ~uint64_t(0);
+            if( w == first_w )
+                mask &= ~uint64_t(0) << (first % 64);
+            if( w == last_w )
+                mask &= ~uint64_t(0) >> (63 - last % 64);
+            m_words[w - m_first_word] |= mask;
+        }
+    }
+private:
+    /// Extend the stored window to include words `first_w .. end_w`
+    void reserve_words(size_t first_w, size_t end_w) {
+        if( m_words.empty() )
+        {
+            m_first_word = first_w;
+            m_words.resize(end_w - first_w);
+            return ;
+        }
+        if( first_w < m_first_word )
+        {
+            m_words.insert(m_words.begin(), m_first_word - first_w, 0);
+            m_first_word = first_w;
+        }
+        if( end_w > m_first_word + m_words.size() )
         {
-            if( x.statements[i] )
-                statements[i] = true;
+            m_words.resize(end_w - m_first_word);
         }
     }
 };
@@ -12,10 +12,11 @@ namespace HIR {
 class Crate;
 }
 
-extern void HIR_GenerateMIR(::HIR::Crate& crate);
+// NOTE: `num_jobs` is the number of threads used to process function bodies
+extern void HIR_GenerateMIR(::HIR::Crate& crate, unsigned int num_jobs=1);
 extern void MIR_Dump(::std::ostream& sink, const ::HIR::Crate& crate);
-extern void MIR_CheckCrate(/*const*/ ::HIR::Crate& crate);
-extern void MIR_CheckCrate_Full(/*const*/ ::HIR::Crate& crate);
+extern void MIR_CheckCrate(/*const*/ ::HIR::Crate& crate, unsigned int num_jobs=1);
+extern void MIR_CheckCrate_Full(/*const*/ ::HIR::Crate& crate, unsigned int num_jobs=1);
 
-extern void MIR_CleanupCrate(::HIR::Crate& crate);
-extern void MIR_OptimiseCrate(::HIR::Crate& crate, bool minimal_optimisations);
+extern void MIR_CleanupCrate(::HIR::Crate& crate, unsigned int num_jobs=1);
+extern void MIR_OptimiseCrate(::HIR::Crate& crate, bool minimal_optimisations, unsigned int num_jobs=1);
@@ -3,17 +3,46 @@
  * - By John Hodge (Mutabah/thePowersGang)
  *
  * mir/mir_ptr.cpp
- * - Destructor for MIR function pointers (cold path code)
+ * - Destructor and lazy loading for MIR function pointers (cold path code)
  */
 #include "mir_ptr.hpp"
 #include "mir.hpp"
+#include <mutex>
+#include <cstdint>
 
+namespace {
+    // Loads can happen from any worker thread. Each pointer is guarded by one of a fixed set of locks, so loads of
+    // different functions (mostly) don't wait on each other.
+    const size_t    NUM_LOAD_LOCKS = 64;
+    ::std::mutex    s_load_locks[NUM_LOAD_LOCKS];
+
+    ::std::mutex& load_lock(const void* p) {
+        return s_load_locks[ (reinterpret_cast<uintptr_t>(p) / sizeof(void*)) % NUM_LOAD_LOCKS ];
+    }
+}
+
+::MIR::FunctionLoader::~FunctionLoader()
+{
+}
 
 void ::MIR::FunctionPointer::reset()
 {
-    if( this->ptr ) {
-        delete this->ptr;
-        this->ptr = nullptr;
+    auto* p = this->ptr.exchange(nullptr);
+    if( p ) {
+        delete p;
     }
+    this->loader.reset();
 }
 
+::MIR::Function* ::MIR::FunctionPointer::load() const
+{
+    ::std::lock_guard<::std::mutex> lh { load_lock(this) };
+    // Another thread may have loaded it while this one was waiting
+    auto* rv = this->ptr.load(::std::memory_order_acquire);
+    if( !rv )
+    {
+        rv = this->loader->load();
+        this->ptr.store(rv, ::std::memory_order_release);
+    }
+    return rv;
+}
@@ -6,39 +6,71 @@
  * - Pointer to a blob of MIR
  */
 #pragma once
-
+#include <atomic>
+#include <memory>
+#include <functional>
 
 namespace MIR {
 
 class Function;
 
+/// Deferred source of a function's MIR (e.g. a body in a loaded crate's metadata)
+class FunctionLoader
+{
+public:
+    virtual ~FunctionLoader();
+    /// Produce the function, called at most once
+    virtual ::MIR::Function* load() = 0;
+};
+
+/// Fixup applied to each function produced by the loaders of one source (e.g. binding the paths in a loaded crate's
+/// MIR to the items of the crate being compiled). Shared by the source's loaders and the crate that owns them.
+struct FunctionLoadHook
+{
+    ::std::function<void(::MIR::Function&)> cb;
+};
+
 class FunctionPointer
 {
-    ::MIR::Function*    ptr;
+    mutable ::std::atomic< ::MIR::Function*>    ptr;
+    // NOTE: Only changed while the pointer is exclusively owned, so can be checked without locking
+    ::std::unique_ptr<FunctionLoader>   loader;
 public:
     FunctionPointer(): ptr(nullptr) {}
     FunctionPointer(::MIR::Function* p): ptr(p) {}
-    FunctionPointer(FunctionPointer&& x): ptr(x.ptr) { x.ptr = nullptr; }
+    FunctionPointer(::std::unique_ptr<FunctionLoader> l): ptr(nullptr), loader(::std::move(l)) {}
+    FunctionPointer(FunctionPointer&& x): ptr(x.ptr.exchange(nullptr)), loader(::std::move(x.loader)) {}
 
     ~FunctionPointer() {
         reset();
     }
     FunctionPointer& operator=(FunctionPointer&& x) {
         reset();
-        ptr = x.ptr;
-        x.ptr = nullptr;
+        ptr = x.ptr.exchange(nullptr);
+        loader = ::std::move(x.loader);
         return *this;
     }
 
     void reset();
 
-    ::MIR::Function* operator->() { return ptr; }
-    ::MIR::Function& operator*() { return *ptr; }
-    const ::MIR::Function* operator->() const { return ptr; }
-    const ::MIR::Function& operator*() const { return *ptr; }
+    /// Check if the function is yet to be loaded (accessing it will load it)
+    bool is_pending() const { return loader && ptr.load(::std::memory_order_acquire) == nullptr; }
+
+    ::MIR::Function* operator->() { return get(); }
+    ::MIR::Function& operator*() { return *get(); }
+    const ::MIR::Function* operator->() const { return get(); }
+    const ::MIR::Function& operator*() const { return *get(); }
 
-    operator bool() const { return ptr != nullptr; }
+    operator bool() const { return loader || ptr.load(::std::memory_order_relaxed) != nullptr; }
+
+private:
+    ::MIR::Function* get() const {
+        auto* rv = ptr.load(::std::memory_order_acquire);
+        if( !rv && loader )
+            rv = load();
+        return rv;
+    }
+    ::MIR::Function* load() const;
 };
 
 }
-
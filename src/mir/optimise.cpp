@@ -15,6 +15,11 @@
 #include <mir/visit_crate_mir.hpp>
 #include <algorithm>
 #include <iomanip>
+#include <unordered_map>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <parallel.hpp>
 #include <trans/target.hpp>
 
 #include <hir/expr.hpp> // HACK
@@ -281,7 +286,9 @@ namespace {
             return monomorphise_type_get_cb(sp, self_ty, &impl_params, fcn_params, nullptr);
         }
     };
-    const ::MIR::Function* get_called_mir(const ::MIR::TypeResolve& state, const ::HIR::Path& path, ParamsSet& params)
+    /// Locate the MIR for the function called by `path`
+    /// - `out_fcn` (if non-null) is set to the definition that the MIR belongs to
+    const ::MIR::Function* get_called_mir(const ::MIR::TypeResolve& state, const ::HIR::Path& path, ParamsSet& params, const ::HIR::Function** out_fcn=nullptr)
     {
         TU_MATCHA( (path.m_data), (pe),
         (Generic,
@@ -289,6 +296,8 @@ namespace {
             if( fcn.m_code.m_mir )
             {
                 params.fcn_params = &pe.m_params;
+                if( out_fcn )
+                    *out_fcn = &fcn;
                 return &*fcn.m_code.m_mir;
             }
             ),
@@ -362,13 +371,21 @@ namespace {
                 params.impl_params.m_types = mv$(best_impl_params);
                 DEBUG("Found impl" << impl.m_params.fmt_args() << " " << impl.m_type);
                 if( fit->second.data.m_code.m_mir )
+                {
+                    if( out_fcn )
+                        *out_fcn = &fit->second.data;
                     return &*fit->second.data.m_code.m_mir;
+                }
             }
             else
             {
                 params.impl_params = pe.trait.m_params.clone();
                 if( ve.m_code.m_mir )
+                {
+                    if( out_fcn )
+                        *out_fcn = &ve;
                     return &*ve.m_code.m_mir;
+                }
             }
             return nullptr;
             ),
@@ -393,6 +410,8 @@ namespace {
                 params.self_ty = &*pe.type;
                 params.fcn_params = &pe.params;
                 params.impl_params = pe.impl_params.clone();
+                if( out_fcn )
+                    *out_fcn = &fit->second.data;
                 return &*fit->second.data.m_code.m_mir;
             }
             return nullptr;
@@ -404,6 +423,41 @@ namespace {
         return nullptr;
     }
 
+    /// Bodies being optimised by `MIR_OptimiseCrate`
+    /// - Each task (a set of mutually recursive bodies) runs on a single thread, after the tasks for its callees.
+    struct CrateOptimiseState
+    {
+        ::std::unordered_map<const ::MIR::Function*, size_t>    task_of_body;
+        ::std::unique_ptr< ::std::atomic<bool>[] >  task_done;
+    };
+    const CrateOptimiseState*   s_crate_optimise = nullptr;
+    thread_local size_t t_optimise_task = 0;
+
+    /// Check if a body can be read (for inlining) without racing with another thread
+    bool can_read_called_mir(const ::MIR::Function* fcn)
+    {
+        if( !s_crate_optimise )
+            return true;
+        auto it = s_crate_optimise->task_of_body.find(fcn);
+        // Not being optimised (e.g. from another crate)
+        if( it == s_crate_optimise->task_of_body.end() )
+            return true;
+        return it->second == t_optimise_task || s_crate_optimise->task_done[it->second];
+    }
+    /// Check if `callee` is (possibly mutually) recursive with the body being optimised
+    /// - Mutual recursion is only known when run from `MIR_OptimiseCrate`, otherwise the inlining budget bounds it.
+    bool is_recursive_call(const ::MIR::Function& caller, const ::MIR::Function* callee)
+    {
+        if( callee == &caller )
+            return true;
+        if( !s_crate_optimise )
+            return false;
+        auto it = s_crate_optimise->task_of_body.find(callee);
+        if( it == s_crate_optimise->task_of_body.end() )
+            return false;
+        return it->second == t_optimise_task;
+    }
+
 
     void visit_terminator_target_mut(::MIR::Terminator& term, ::std::function<void(::MIR::BasicBlockId&)> cb) {
         TU_MATCHA( (term), (e),
@@ -493,7 +547,8 @@ namespace {
 }
 
 bool MIR_Optimise_BlockSimplify(::MIR::TypeResolve& state, ::MIR::Function& fcn);
-bool MIR_Optimise_Inlining(::MIR::TypeResolve& state, ::MIR::Function& fcn, bool minimal);
+unsigned int MIR_Optimise_InliningBudget(const ::MIR::Function& fcn);
+bool MIR_Optimise_Inlining(::MIR::TypeResolve& state, ::MIR::Function& fcn, bool minimal, unsigned int& budget);
 bool MIR_Optimise_PropagateSingleAssignments(::MIR::TypeResolve& state, ::MIR::Function& fcn);
 bool MIR_Optimise_PropagateKnownValues(::MIR::TypeResolve& state, ::MIR::Function& fcn);
 bool MIR_Optimise_DeTemporary(::MIR::TypeResolve& state, ::MIR::Function& fcn); // Eliminate useless temporaries
@@ -514,7 +569,8 @@ void MIR_OptimiseMin(const StaticTraitResolve& resolve, const ::HIR::ItemPath& p
     TRACE_FUNCTION_F(path);
     ::MIR::TypeResolve   state { sp, resolve, FMT_CB(ss, ss << path;), ret_type, args, fcn };
 
-    while( MIR_Optimise_Inlining(state, fcn, true) )
+    auto inline_budget = MIR_Optimise_InliningBudget(fcn);
+    while( MIR_Optimise_Inlining(state, fcn, true, inline_budget) )
     {
         MIR_Cleanup(resolve, path, fcn, args, ret_type);
         //MIR_Dump_Fcn(::std::cout, fcn);
@@ -543,6 +599,7 @@ void MIR_Optimise(const StaticTraitResolve& resolve, const ::HIR::ItemPath& path
     TRACE_FUNCTION_F(path);
     ::MIR::TypeResolve   state { sp, resolve, FMT_CB(ss, ss << path;), ret_type, args, fcn };
 
+    auto inline_budget = MIR_Optimise_InliningBudget(fcn);
     bool change_happened;
     unsigned int pass_num = 0;
     do
@@ -612,7 +669,7 @@ void MIR_Optimise(const StaticTraitResolve& resolve, const ::HIR::ItemPath& path
         // >> Inline short functions
         if( !change_happened )
         {
-            bool inline_happened = MIR_Optimise_Inlining(state, fcn, false);
+            bool inline_happened = MIR_Optimise_Inlining(state, fcn, false, inline_budget);
             if( inline_happened )
             {
                 // Apply cleanup again (as monomorpisation in inlining may have exposed a vtable call)
@@ -756,48 +813,141 @@ bool MIR_Optimise_BlockSimplify(::MIR::TypeResolve& state, ::MIR::Function& fcn)
 
 
 // --------------------------------------------------------------------
-// If two temporaries don't overlap in lifetime (blocks in which they're valid), unify the two
+// Inline calls to small functions (and `#[inline(always)]` functions)
 // --------------------------------------------------------------------
-bool MIR_Optimise_Inlining(::MIR::TypeResolve& state, ::MIR::Function& fcn, bool minimal)
+namespace {
+    // Size (roughly, statements in the generated code) below which a call is always worth inlining
+    const unsigned int INLINE_THRESHOLD = 10;
+    // Extra size allowed for each constant argument (constant propagation will likely remove code)
+    const unsigned int INLINE_CONST_ARG_BONUS = 4;
+    // Minimum amount that inlining can grow a function by
+    const unsigned int INLINE_BUDGET_MIN = 200;
+
+    /// Estimate the size of a function's body (in statements and the work done by terminators)
+    unsigned int inline_cost(const ::MIR::Function& fcn)
+    {
+        unsigned int rv = 0;
+        for(const auto& bb : fcn.blocks)
+        {
+            for(const auto& stmt : bb.statements)
+            {
+                TU_MATCHA( (stmt), (se),
+                (Assign,
+                    rv += 1;
+                    ),
+                (Asm,
+                    rv += 1;
+                    ),
+                (SetDropFlag,
+                    rv += 1;
+                    ),
+                (Drop,
+                    // Drop glue is a call
+                    rv += 3;
+                    ),
+                (ScopeEnd,
+                    )
+                )
+            }
+            TU_MATCHA( (bb.terminator), (te),
+            (Incomplete,
+                ),
+            (Return,
+                ),
+            (Diverge,
+                ),
+            (Panic,
+                ),
+            (Goto,
+                ),
+            (If,
+                rv += 1;
+                ),
+            (Switch,
+                rv += 1 + te.targets.size() / 4;
+                ),
+            (SwitchValue,
+                rv += 1 + te.targets.size() / 4;
+                ),
+            (Call,
+                rv += 3 + te.args.size();
+                )
+            )
+        }
+        return rv;
+    }
+
+    /// Functions containing `asm!` are never inlined (operand names and labels could collide)
+    bool contains_asm(const ::MIR::Function& fcn)
+    {
+        for(const auto& bb : fcn.blocks)
+            for(const auto& stmt : bb.statements)
+                if( stmt.is_Asm() )
+                    return true;
+        return false;
+    }
+}
+
+unsigned int MIR_Optimise_InliningBudget(const ::MIR::Function& fcn)
 {
-    TRACE_FUNCTION;
+    // Allow a function to at most double in size (with a minimum for small functions that call large ones)
+    return ::std::max(INLINE_BUDGET_MIN, inline_cost(fcn));
+}
+
+bool MIR_Optimise_Inlining(::MIR::TypeResolve& state, ::MIR::Function& fcn, bool minimal, unsigned int& budget)
+{
+    TRACE_FUNCTION_F("budget=" << budget);
 
     struct H
     {
-        static bool can_inline(const ::HIR::Path& path, const ::MIR::Function& fcn, bool minimal)
+        /// Returns the cost charged to the budget if the call should be inlined, or 0 if it shouldn't
+        static unsigned int can_inline(const ::MIR::Function& caller, const ::MIR::Terminator::Data_Call& te, const ::MIR::Function& fcn, ::HIR::Function::InlineHint hint, bool minimal, unsigned int budget)
         {
-            // TODO: If the function is marked as `inline(always)`, then inline it regardless of the contents
-
-            if( minimal ) {
-                return false;
+            // Never inline recursive calls (direct or within the same component of the call graph)
+            if( is_recursive_call(caller, &fcn) )
+            {
+                DEBUG("Recursive");
+                return 0;
             }
-
-            // TODO: If the function is marked as `inline(never)`, then don't inline
-
-            // TODO: Allow functions that are just a switch on an input.
-            if( fcn.blocks.size() == 1 )
+            if( hint == ::HIR::Function::InlineHint::Never )
             {
-                return fcn.blocks[0].statements.size() < 10 && ! fcn.blocks[0].terminator.is_Goto();
+                DEBUG("#[inline(never)]");
+                return 0;
             }
-            else if( fcn.blocks.size() == 3 && fcn.blocks[0].terminator.is_Call() )
+            // A minimal optimisation pass only inlines `#[inline(always)]` functions
+            if( minimal && hint != ::HIR::Function::InlineHint::Always ) {
+                return 0;
+            }
+            if( contains_asm(fcn) )
             {
-                const auto& blk0_te = fcn.blocks[0].terminator.as_Call();
-                if( !(fcn.blocks[1].terminator.is_Diverge() || fcn.blocks[1].terminator.is_Return()) )
-                    return false;
-                if( !(fcn.blocks[2].terminator.is_Diverge() || fcn.blocks[2].terminator.is_Return()) )
-                    return false;
-                if( fcn.blocks[0].statements.size() + fcn.blocks[1].statements.size() + fcn.blocks[2].statements.size() > 10 )
-                    return false;
-                // Detect and avoid simple recursion.
-                // - This won't detect mutual recursion - that also needs prevention.
-                if( blk0_te.fcn.is_Path() && blk0_te.fcn.as_Path() == path )
-                    return false;
-                return true;
+                DEBUG("Contains asm!");
+                return 0;
             }
-            else
+
+            auto cost = ::std::max(1u, inline_cost(fcn));
+            // Even `#[inline(always)]` is limited by the budget (to bound inlining through recursive calls that
+            // aren't known about, e.g. in monomorphised code).
+            if( cost > budget )
             {
-                return false;
+                DEBUG("Cost " << cost << " exceeds remaining budget " << budget);
+                return 0;
             }
+            if( hint == ::HIR::Function::InlineHint::Always )
+                return cost;
+
+            // Inlining removes the call itself, and constant arguments will likely let some of the body be removed
+            unsigned int threshold = INLINE_THRESHOLD + 3 + te.args.size();
+            for(const auto& a : te.args)
+                if( a.is_Constant() )
+                    threshold += INLINE_CONST_ARG_BONUS;
+            if( hint == ::HIR::Function::InlineHint::Hint )
+                threshold *= 2;
+            if( cost > threshold )
+            {
+                DEBUG("Cost " << cost << " exceeds threshold " << threshold);
+                return 0;
+            }
+            return cost;
         }
     };
     struct Cloner
@@ -1158,20 +1308,25 @@ bool MIR_Optimise_Inlining(::MIR::TypeResolve& state, ::MIR::Function& fcn, bool
             const auto& path = te->fcn.as_Path();
 
             Cloner  cloner { state.sp, state.m_resolve, *te };
-            const auto* called_mir = get_called_mir(state, path,  cloner.params);
+            const ::HIR::Function*  called_fcn = nullptr;
+            const auto* called_mir = get_called_mir(state, path,  cloner.params, &called_fcn);
             if( !called_mir )
                 continue ;
+            if( !can_read_called_mir(called_mir) )
+            {
+                DEBUG("Can't inline " << path << " - still being optimised");
+                continue ;
+            }
 
-            // Check the size of the target function.
-            // Inline IF:
-            // - First BB ends with a call and total count is 3
-            // - Statement count smaller than 10
-            if( ! H::can_inline(path, *called_mir, minimal) )
+            // Check the size of the target function against the remaining budget
+            auto cost = H::can_inline(fcn, *te, *called_mir, called_fcn->m_inline, minimal, budget);
+            if( cost == 0 )
             {
                 DEBUG("Can't inline " << path);
                 continue ;
             }
-            DEBUG(state << fcn.blocks[i].terminator);
+            budget -= cost;
+            DEBUG(state << fcn.blocks[i].terminator << " (cost " << cost << ", budget now " << budget << ")");
             TRACE_FUNCTION_F("Inline " << path);
 
             // Allocate a temporary for the return value
@@ -3144,9 +3299,9 @@ void MIR_SortBlocks(const StaticTraitResolve& resolve, const ::HIR::ItemPath& pa
 }
 
 
-void MIR_OptimiseCrate(::HIR::Crate& crate, bool do_minimal_optimisation)
+void MIR_OptimiseCrate(::HIR::Crate& crate, bool do_minimal_optimisation, unsigned int num_jobs)
 {
-    ::MIR::OuterVisitor ov { crate, [do_minimal_optimisation](const auto& res, const auto& p, auto& expr, const auto& args, const auto& ty)
+    auto cb = [do_minimal_optimisation](const auto& res, const auto& p, auto& expr, const auto& args, const auto& ty)
         {
             if( ! dynamic_cast<::HIR::ExprNode_Block*>(expr.get()) ) {
                 return ;
@@ -3157,8 +3312,131 @@ void MIR_OptimiseCrate(::HIR::Crate& crate, bool do_minimal_optimisation)
             else {
                 MIR_Optimise(res, p, *expr.m_mir, args, ty);
             }
-        }
         };
-    ov.visit_crate(crate);
+    // Inlining reads the MIR of the called function, so callees are optimised (and shrunk) before their callers.
+    // - This also finds mutually recursive functions, which the inliner avoids.
+    auto bodies = ::MIR::enumerate_crate_mir(crate);
+    ::MIR::CrateBodyVisitor bv { crate, num_jobs };
+
+    ::std::unordered_map<const ::MIR::Function*, size_t>    body_idx;
+    for(size_t i = 0; i < bodies.size(); i ++)
+    {
+        if( bodies[i].expr->m_mir )
+            body_idx.insert( ::std::make_pair(&*bodies[i].expr->m_mir, i) );
+    }
+
+    // - Obtain the (local) call graph
+    ::std::vector< ::std::vector<size_t> >  callees(bodies.size());
+    Parallel_ForEach(num_jobs, bodies.size(), [&](size_t idx) {
+        bv.visit(bodies[idx], [&](const auto& res, const auto& p, auto& expr, const auto& args, const auto& ty) {
+            if( ! dynamic_cast<::HIR::ExprNode_Block*>(expr.get()) ) {
+                return ;
+            }
+            static Span sp;
+            const auto& fcn = *expr.m_mir;
+            ::MIR::TypeResolve   state { sp, res, FMT_CB(ss, ss << p;), ty, args, fcn };
+            for(unsigned int i = 0; i < fcn.blocks.size(); i ++)
+            {
+                state.set_cur_stmt_term(i);
+                const auto* te = fcn.blocks[i].terminator.opt_Call();
+                if( !te || !te->fcn.is_Path() )
+                    continue ;
+                ParamsSet   params;
+                const auto* called_mir = get_called_mir(state, te->fcn.as_Path(), params);
+                auto it = body_idx.find(called_mir);
+                if( it != body_idx.end() )
+                    callees[idx].push_back(it->second);
+            }
+            });
+        });
+
+    // - Group mutually recursive bodies into tasks (using Tarjan's algorithm)
+    // > Components are completed callees-first, and each component is run on a single thread.
+    const size_t    NONE = SIZE_MAX;
+    ::std::vector<size_t>   task_of(bodies.size(), NONE);
+    size_t  n_tasks = 0;
+    {
+        ::std::vector<size_t>   index(bodies.size(), NONE);
+        ::std::vector<size_t>   lowlink(bodies.size());
+        ::std::vector<bool> on_stack(bodies.size());
+        ::std::vector<size_t>   stack;
+        ::std::vector< ::std::pair<size_t,size_t> > call_stack; // (body, next callee)
+        size_t  next_index = 0;
+        auto push = [&](size_t v) {
+            index[v] = lowlink[v] = next_index ++;
+            stack.push_back(v);
+            on_stack[v] = true;
+            call_stack.push_back( ::std::make_pair(v, 0) );
+            };
+        for(size_t root = 0; root < bodies.size(); root ++)
+        {
+            if( index[root] != NONE )
+                continue ;
+            push(root);
+            while( !call_stack.empty() )
+            {
+                size_t v = call_stack.back().first;
+                size_t& next = call_stack.back().second;
+                if( next < callees[v].size() )
+                {
+                    size_t w = callees[v][next ++];
+                    if( index[w] == NONE ) {
+                        push(w);
+                    }
+                    else if( on_stack[w] ) {
+                        lowlink[v] = ::std::min(lowlink[v], index[w]);
+                    }
+                    continue ;
+                }
+                if( lowlink[v] == index[v] )
+                {
+                    size_t w;
+                    do {
+                        w = stack.back();
+                        stack.pop_back();
+                        on_stack[w] = false;
+                        task_of[w] = n_tasks;
+                    } while( w != v );
+                    n_tasks ++;
+                }
+                call_stack.pop_back();
+                if( !call_stack.empty() )
+                {
+                    size_t u = call_stack.back().first;
+                    lowlink[u] = ::std::min(lowlink[u], lowlink[v]);
+                }
+            }
+        }
+    }
+    ::std::vector< ::std::vector<size_t> >  task_bodies(n_tasks);
+    ::std::vector< ::std::vector<size_t> >  task_deps(n_tasks);
+    for(size_t i = 0; i < bodies.size(); i ++)
+    {
+        auto t = task_of[i];
+        task_bodies[t].push_back(i);
+        for(auto c : callees[i])
+        {
+            auto ct = task_of[c];
+            if( ct != t && ::std::find(task_deps[t].begin(), task_deps[t].end(), ct) == task_deps[t].end() )
+                task_deps[t].push_back(ct);
+        }
+    }
+    DEBUG(bodies.size() << " bodies in " << n_tasks << " tasks");
+
+    CrateOptimiseState  pstate;
+    pstate.task_done.reset( new ::std::atomic<bool>[n_tasks] );
+    for(size_t t = 0; t < n_tasks; t ++)
+        pstate.task_done[t] = false;
+    for(const auto& e : body_idx)
+        pstate.task_of_body.insert( ::std::make_pair(e.first, task_of[e.second]) );
+
+    s_crate_optimise = &pstate;
+    Parallel_ForEachGraph(num_jobs, task_deps, [&](size_t t) {
+        t_optimise_task = t;
+        for(auto idx : task_bodies[t])
+            bv.visit(bodies[idx], cb);
+        pstate.task_done[t] = true;
+        });
+    s_crate_optimise = nullptr;
 }
 
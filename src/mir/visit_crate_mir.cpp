@@ -7,6 +7,7 @@
  */
 #include "visit_crate_mir.hpp"
 #include <hir/expr.hpp>
+#include <parallel.hpp>
 
 // NOTE: This is left here to ensure that any expressions that aren't handled by higher code cause a failure
 void MIR::OuterVisitor::visit_expr(::HIR::ExprPtr& exp)
@@ -101,3 +102,76 @@ void MIR::OuterVisitor::visit_trait_impl(const ::HIR::SimplePath& trait_path, ::
     auto _ = this->m_resolve.set_impl_generics(impl.m_params);
     ::HIR::Visitor::visit_trait_impl(trait_path, impl);
 }
+
+::std::vector<MIR::CrateBody> MIR::enumerate_crate_mir(::HIR::Crate& crate)
+{
+    ::std::vector<CrateBody>    rv;
+    OuterVisitor    ov { crate, [&](const auto& res, const auto& p, auto& expr, const auto& args, const auto& ty) {
+        rv.push_back(CrateBody {
+            FMT(p),
+            &expr,
+            // NOTE: Bodies without arguments are passed a temporary list
+            args.empty() ? nullptr : &args,
+            ty.clone(),
+            res.m_impl_generics,
+            res.m_item_generics
+            });
+        } };
+    ov.visit_crate(crate);
+    return rv;
+}
+
+MIR::CrateBodyVisitor::CrateBodyVisitor(const ::HIR::Crate& crate, unsigned int num_jobs):
+    m_crate(crate),
+    m_resolvers(num_jobs + 1)
+{
+}
+void MIR::CrateBodyVisitor::visit(const CrateBody& body, const OuterVisitor::cb_t& cb)
+{
+    static const ::HIR::Function::args_t    empty_args;
+
+    auto idx = Parallel_WorkerIndex();
+    assert(idx < m_resolvers.size());
+    auto& resolve_ptr = m_resolvers[idx];
+    if( !resolve_ptr )
+        resolve_ptr.reset(new StaticTraitResolve(m_crate));
+    auto& resolve = *resolve_ptr;
+
+    ::HIR::ItemPath ip(body.path);
+    auto run = [&]() {
+        cb(resolve, ip, *body.expr, body.args ? *body.args : empty_args, body.ret_type);
+        };
+    auto run_with_item = [&]() {
+        if( body.item_generics ) {
+            auto _ = resolve.set_item_generics(*body.item_generics);
+            run();
+        }
+        else {
+            run();
+        }
+        };
+    if( body.impl_generics ) {
+        auto _ = resolve.set_impl_generics(*body.impl_generics);
+        run_with_item();
+    }
+    else {
+        run_with_item();
+    }
+}
+
+void MIR::visit_crate_mir(::HIR::Crate& crate, unsigned int num_jobs, OuterVisitor::cb_t cb)
+{
+    if( num_jobs <= 1 )
+    {
+        OuterVisitor    ov { crate, cb };
+        ov.visit_crate(crate);
+        return ;
+    }
+
+    auto bodies = enumerate_crate_mir(crate);
+    DEBUG(bodies.size() << " bodies");
+    CrateBodyVisitor    bv { crate, num_jobs };
+    Parallel_ForEach(num_jobs, bodies.size(), [&](size_t idx) {
+        bv.visit(bodies[idx], cb);
+        });
+}
@@ -8,6 +8,7 @@
 #pragma once
 #include <hir/visitor.hpp>
 #include <hir_typeck/static.hpp>
+#include <memory>
 
 namespace MIR {
 
@@ -43,5 +44,35 @@ public:
     void visit_trait_impl(const ::HIR::SimplePath& trait_path, ::HIR::TraitImpl& impl) override;
 };
 
+/// A MIR-containing body found by `enumerate_crate_mir`, with enough context to process it later
+struct CrateBody
+{
+    ::std::string   path;
+    ::HIR::ExprPtr* expr;
+    // NOTE: `nullptr` for bodies without arguments
+    const ::HIR::Function::args_t*  args;
+    ::HIR::TypeRef  ret_type;
+
+    ::HIR::GenericParams*   impl_generics;
+    ::HIR::GenericParams*   item_generics;
+};
+/// Collect every body in the crate (in the same order as `OuterVisitor` visits them)
+extern ::std::vector<CrateBody> enumerate_crate_mir(::HIR::Crate& crate);
+
+/// Calls a visitor callback for bodies from `enumerate_crate_mir`, from within a `Parallel_*` call
+/// - Holds a `StaticTraitResolve` for each worker thread.
+class CrateBodyVisitor
+{
+    const ::HIR::Crate& m_crate;
+    ::std::vector< ::std::unique_ptr<StaticTraitResolve> >  m_resolvers;
+public:
+    CrateBodyVisitor(const ::HIR::Crate& crate, unsigned int num_jobs);
+
+    void visit(const CrateBody& body, const OuterVisitor::cb_t& cb);
+};
+
+/// Call `cb` for every body in the crate, using up to `num_jobs` threads
+/// - When run in parallel, the callback must only modify the body it was passed.
+extern void visit_crate_mir(::HIR::Crate& crate, unsigned int num_jobs, OuterVisitor::cb_t cb);
 
 }   // namespace MIR
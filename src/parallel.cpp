@@ -0,0 +1,337 @@
+/*
+ * MRustC - Rust Compiler
+ * - By John Hodge (Mutabah/thePowersGang)
+ *
+ * parallel.cpp
+ * - Helpers for running independent work items on multiple threads
+ */
+#include <parallel.hpp>
+#include <debug.hpp>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <algorithm>
+#include <cassert>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+
+namespace {
+    thread_local unsigned int   t_worker_index = 0;
+
+    /// Debug state of the thread starting a parallel operation, applied to each worker
+    struct WorkerContext
+    {
+        ::std::string   phase;
+        int indent_level;
+
+        WorkerContext():
+            phase( debug_get_phase() ),
+            indent_level( g_debug_indent_level )
+        {
+        }
+        void enter(unsigned int idx) const
+        {
+            t_worker_index = idx;
+            debug_set_phase(phase);
+            g_debug_indent_level = indent_level;
+        }
+    };
+
+    /// Records the first exception raised by any thread
+    struct ErrorSlot
+    {
+        ::std::mutex    lock;
+        ::std::exception_ptr    error;
+        ::std::atomic<bool> failed { false };
+
+        void set(::std::exception_ptr e)
+        {
+            ::std::lock_guard<::std::mutex> lh { lock };
+            if( !error )
+                error = e;
+            failed = true;
+        }
+        void rethrow()
+        {
+            if( error )
+                ::std::rethrow_exception(error);
+        }
+    };
+}
+
+namespace {
+    /// Work-stealing queues of ready items, one per thread
+    /// - A thread runs items from the front of its own queue, and when that is empty takes the most
+    ///   recently queued item from the back of another thread's queue.
+    class StealingScheduler
+    {
+        struct Queue
+        {
+            ::std::mutex    lock;
+            ::std::deque<size_t>    items;
+        };
+        ::std::vector<Queue>    m_queues;
+
+        ::std::mutex    m_idle_lock;
+        ::std::condition_variable   m_idle_cv;
+        ::std::atomic<size_t>   m_num_queued { 0 };
+        ::std::atomic<size_t>   m_num_outstanding;
+
+    public:
+        StealingScheduler(unsigned int num_threads, size_t count):
+            m_queues(num_threads),
+            m_num_outstanding(count)
+        {
+        }
+
+        void push(unsigned int thread_idx, size_t item)
+        {
+            {
+                auto& q = m_queues[thread_idx];
+                ::std::lock_guard<::std::mutex> lh { q.lock };
+                q.items.push_back(item);
+            }
+            m_num_queued ++;
+            this->wake_all();
+        }
+        /// Mark an item as completed (after any items it released have been pushed)
+        void item_done()
+        {
+            if( -- m_num_outstanding == 0 )
+                this->wake_all();
+        }
+        void wake_all()
+        {
+            ::std::lock_guard<::std::mutex> lh { m_idle_lock };
+            m_idle_cv.notify_all();
+        }
+
+        /// Obtain the next item for this thread, blocking until one is ready
+        /// - Returns false once every item has been completed (or `stop` is set)
+        bool pop(unsigned int thread_idx, size_t& out_item, const ::std::atomic<bool>& stop)
+        {
+            for(;;)
+            {
+                if( this->try_pop(thread_idx, out_item) )
+                    return true;
+                ::std::unique_lock<::std::mutex>    lh { m_idle_lock };
+                m_idle_cv.wait(lh, [&](){ return stop || m_num_queued > 0 || m_num_outstanding == 0; });
+                if( stop || (m_num_queued == 0 && m_num_outstanding == 0) )
+                    return false;
+            }
+        }
+    private:
+        bool try_pop(unsigned int thread_idx, size_t& out_item)
+        {
+            {
+                auto& q = m_queues[thread_idx];
+                ::std::lock_guard<::std::mutex> lh { q.lock };
+                if( !q.items.empty() )
+                {
+                    out_item = q.items.front();
+                    q.items.pop_front();
+                    m_num_queued --;
+                    return true;
+                }
+            }
+            for(size_t i = 1; i < m_queues.size(); i ++)
+            {
+                auto& q = m_queues[(thread_idx + i) % m_queues.size()];
+                ::std::lock_guard<::std::mutex> lh { q.lock };
+                if( !q.items.empty() )
+                {
+                    out_item = q.items.back();
+                    q.items.pop_back();
+                    m_num_queued --;
+                    return true;
+                }
+            }
+            return false;
+        }
+    };
+}
+
+unsigned int Parallel_WorkerIndex()
+{
+    return t_worker_index;
+}
+
+void Parallel_ForEach(unsigned int num_jobs, size_t count, ::std::function<void(size_t)> cb)
+{
+    if( num_jobs <= 1 || count <= 1 )
+    {
+        for(size_t i = 0; i < count; i ++)
+            cb(i);
+        return ;
+    }
+
+    Parallel_ForEachGraph(num_jobs, ::std::vector< ::std::vector<size_t> >(count), ::std::move(cb));
+}
+
+void Parallel_ForEachGraph(unsigned int num_jobs, const ::std::vector< ::std::vector<size_t> >& deps, ::std::function<void(size_t)> cb)
+{
+    const size_t    count = deps.size();
+    const unsigned int  num_threads = static_cast<unsigned int>( ::std::max<size_t>(1, ::std::min<size_t>(num_jobs, count)) );
+
+    // Reverse the dependency lists, so finishing an item can release the items waiting on it
+    ::std::vector< ::std::vector<size_t> >  dependents(count);
+    ::std::unique_ptr< ::std::atomic<size_t>[] >  pending( new ::std::atomic<size_t>[count] );
+    for(size_t i = 0; i < count; i ++)
+    {
+        pending[i] = deps[i].size();
+        for(auto d : deps[i])
+        {
+            assert(d < count);
+            dependents[d].push_back(i);
+        }
+    }
+
+    WorkerContext   ctxt;
+    ErrorSlot   err;
+    StealingScheduler   sched(num_threads, count);
+
+    // Initially-ready items are split into contiguous runs, one per thread
+    {
+        ::std::vector<size_t>   ready;
+        for(size_t i = 0; i < count; i ++)
+            if( pending[i] == 0 )
+                ready.push_back(i);
+        for(size_t i = 0; i < ready.size(); i ++)
+            sched.push(i * num_threads / ready.size(), ready[i]);
+    }
+
+    auto worker = [&](unsigned int thread_idx) {
+        size_t  idx;
+        while( !err.failed && sched.pop(thread_idx, idx, err.failed) )
+        {
+            try
+            {
+                cb(idx);
+            }
+            catch(...)
+            {
+                err.set( ::std::current_exception() );
+                sched.wake_all();
+                break;
+            }
+            for(auto d : dependents[idx])
+            {
+                if( --pending[d] == 0 )
+                    sched.push(thread_idx, d);
+            }
+            sched.item_done();
+        }
+        };
+
+    ::std::vector< ::std::thread>   threads;
+    for(unsigned int i = 1; i < num_threads; i ++)
+    {
+        threads.push_back(::std::thread([&,i]() {
+            ctxt.enter(i);
+            worker(i);
+            }));
+    }
+    worker(0);
+    for(auto& t : threads)
+        t.join();
+    err.rethrow();
+}
+
+void Parallel_Pipeline(unsigned int num_jobs, size_t count, ::std::function<void(size_t)> produce, ::std::function<void(size_t)> consume)
+{
+    if( num_jobs <= 1 )
+    {
+        for(size_t i = 0; i < count; i ++)
+        {
+            produce(i);
+            consume(i);
+        }
+        return ;
+    }
+
+    // How far ahead of the consumer the producers are allowed to get
+    const size_t    window = 8 * num_jobs;
+
+    WorkerContext   ctxt;
+    ErrorSlot   err;
+    ::std::mutex    lock;
+    ::std::condition_variable   cv_done;    // Signalled when an item is produced
+    ::std::condition_variable   cv_space;   // Signalled when an item is consumed
+    ::std::vector<bool> done(count);
+    size_t  next_idx = 0;
+    size_t  n_consumed = 0;
+
+    auto worker = [&]() {
+        for(;;)
+        {
+            size_t  idx;
+            {
+                ::std::unique_lock<::std::mutex>    lh { lock };
+                cv_space.wait(lh, [&](){ return err.failed || next_idx >= count || next_idx < n_consumed + window; });
+                if( err.failed || next_idx >= count )
+                    break;
+                idx = next_idx ++;
+            }
+            try
+            {
+                produce(idx);
+            }
+            catch(...)
+            {
+                err.set( ::std::current_exception() );
+            }
+            {
+                ::std::lock_guard<::std::mutex> lh { lock };
+                done[idx] = true;
+            }
+            cv_done.notify_all();
+        }
+        cv_done.notify_all();
+        };
+
+    ::std::vector< ::std::thread>   threads;
+    for(unsigned int i = 0; i < num_jobs && i < count; i ++)
+    {
+        threads.push_back(::std::thread([&,i]() {
+            ctxt.enter(1 + i);
+            worker();
+            }));
+    }
+
+    for(size_t i = 0; i < count && !err.failed; i ++)
+    {
+        {
+            ::std::unique_lock<::std::mutex>    lh { lock };
+            cv_done.wait(lh, [&](){ return err.failed || done[i]; });
+            if( err.failed )
+                break;
+        }
+        try
+        {
+            consume(i);
+        }
+        catch(...)
+        {
+            err.set( ::std::current_exception() );
+        }
+        {
+            ::std::lock_guard<::std::mutex> lh { lock };
+            n_consumed = i + 1;
+        }
+        cv_space.notify_all();
+    }
+    if( err.failed )
+    {
+        // Wake any producers waiting for space
+        ::std::lock_guard<::std::mutex> lh { lock };
+        cv_space.notify_all();
+    }
+
+    for(auto& t : threads)
+        t.join();
+    err.rethrow();
+}
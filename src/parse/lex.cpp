@@ -9,41 +9,94 @@
 #include "tokentree.hpp"
 #include "parseerror.hpp"
 #include "../common.hpp"
+#include <depfile.hpp>
 #include <cassert>
 #include <iostream>
 #include <cstdlib>  // strtol
 #include <typeinfo>
 #include <algorithm>    // std::count
 #include <cctype>
+#include <cstring>  // memchr
+#include <fstream>
+#include <iterator>
+#ifndef _WIN32
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <fcntl.h>
+# include <unistd.h>
+#endif
 //#define TRACE_CHARS
 //#define TRACE_RAW_TOKENS
 
+SourceFile::SourceFile(const ::std::string& filename):
+    m_data(nullptr),
+    m_size(0)
+{
+#ifndef _WIN32
+    int fd = open(filename.c_str(), O_RDONLY);
+    if( fd < 0 )
+        throw ::std::runtime_error("Unable to open file '" + filename + "'");
+    struct stat st;
+    if( fstat(fd, &st) == 0 && st.st_size > 0 )
+    {
+        void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if( p != MAP_FAILED )
+        {
+            m_data = static_cast<const char*>(p);
+            m_size = st.st_size;
+        }
+    }
+    close(fd);
+#endif
+    if( !m_data )
+    {
+        ::std::ifstream is(filename, ::std::ios_base::in|::std::ios_base::binary);
+        if( !is.is_open() )
+            throw ::std::runtime_error("Unable to open file '" + filename + "'");
+        m_fallback.assign( ::std::istreambuf_iterator<char>(is), ::std::istreambuf_iterator<char>() );
+        m_data = m_fallback.data();
+        m_size = m_fallback.size();
+    }
+}
+SourceFile::SourceFile(SourceFile&& x):
+    m_data(x.m_data),
+    m_size(x.m_size),
+    m_fallback(mv$(x.m_fallback))
+{
+    x.m_data = nullptr;
+    x.m_size = 0;
+}
+SourceFile::~SourceFile()
+{
+#ifndef _WIN32
+    if( m_data && m_fallback.empty() && m_size > 0 )
+    {
+        munmap(const_cast<char*>(m_data), m_size);
+    }
+#endif
+}
+
 Lexer::Lexer(const ::std::string& filename):
     m_path(filename.c_str()),
     m_line(1),
     m_line_ofs(0),
-    m_istream(filename.c_str()),
+    m_file(filename),
+    m_pos(0),
     m_last_char_valid(false),
     m_hygiene( Ident::Hygiene::new_scope() )
 {
-    if( !m_istream.is_open() )
-    {
-        throw ::std::runtime_error("Unable to open file '" + filename + "'");
-    }
+    Depfile_AddInput(filename);
     // Consume the BOM
-    if( this->getc_byte() == '\xef' )
+    const char* data = m_file.data();
+    if( m_file.size() > 0 && data[0] == '\xef' )
     {
-        if( this->getc_byte() != '\xbb' ) {
+        if( m_file.size() < 2 || data[1] != '\xbb' ) {
             throw ::std::runtime_error("Incomplete BOM - missing \\xBB in second position");
         }
-        if( this->getc_byte() != '\xbf' ) {
+        if( m_file.size() < 3 || data[2] != '\xbf' ) {
             throw ::std::runtime_error("Incomplete BOM - missing \\xBF in second position");
         }
-        m_line_ofs = 0;
-    }
-    else
-    {
-        m_istream.unget();
+        m_pos = 3;
     }
 }
 
@@ -313,6 +366,7 @@ Token Lexer::getTokenInt()
             return Token(TOK_NEWLINE);
         if( ch.isspace() )
         {
+            this->getc_ascii_while([](char c){ return c == ' ' || c == '\t' || c == '\r'; }, nullptr);
             while( (ch = this->getc()).isspace() && ch != '\n' )
                 ;
             this->ungetc();
@@ -589,9 +643,10 @@ Token Lexer::getTokenInt()
                     is_pdoc = true;
                     ch = this->getc();
                 }
-                while(ch != '\n' && ch != '\r')
+                if(ch != '\n' && ch != '\r')
                 {
                     str += ch;
+                    this->getc_until_eol(str);
                     ch = this->getc();
                 }
                 this->ungetc();
@@ -810,6 +865,8 @@ Token Lexer::getTokenInt_Identifier(Codepoint leader, Codepoint leader2)
     while( issym(ch) )
     {
         str += ch;
+        if( !m_last_char_valid )
+            this->getc_ascii_while([](char c){ return ::std::isalnum(static_cast<uint8_t>(c)) || c == '_'; }, &str);
         ch = this->getc();
     }
 
@@ -935,10 +992,10 @@ uint32_t Lexer::parseEscape(char enclosing)
 
 char Lexer::getc_byte()
 {
-    int rv = m_istream.get();
-    if( rv == EOF || m_istream.eof() )
+    if( m_pos >= m_file.size() )
         throw Lexer::EndOfFile();
 
+    char rv = m_file.data()[m_pos++];
     if( rv == '\n' )
     {
         m_line ++;
@@ -947,6 +1004,38 @@ char Lexer::getc_byte()
 
     return rv;
 }
+/// Consume (and optionally append to `out`) a run of ASCII characters matching `pred`
+/// - `pred` must not accept newlines (line tracking isn't done)
+void Lexer::getc_ascii_while(bool (*pred)(char), ::std::string* out)
+{
+    assert(!m_last_char_valid);
+    const char* start = m_file.data() + m_pos;
+    const char* end = m_file.data() + m_file.size();
+    const char* p = start;
+    while( p != end && pred(*p) )
+        p ++;
+    size_t len = p - start;
+    if( out )
+        out->append(start, len);
+    m_pos += len;
+    m_line_ofs += len;
+}
+/// Consume (and append to `out`) all characters up to the next `\r` or `\n`
+void Lexer::getc_until_eol(::std::string& out)
+{
+    assert(!m_last_char_valid);
+    const char* start = m_file.data() + m_pos;
+    size_t avail = m_file.size() - m_pos;
+    // `memchr` is usually vectorised, so is far faster than a byte loop
+    const char* nl = static_cast<const char*>( ::std::memchr(start, '\n', avail) );
+    size_t len = nl ? nl - start : avail;
+    if( const char* cr = static_cast<const char*>( ::std::memchr(start, '\r', len) ) )
+        len = cr - start;
+    out.append(start, len);
+    m_pos += len;
+    // Column is in codepoints, so don't count UTF-8 continuation bytes
+    m_line_ofs += ::std::count_if(start, start + len, [](char c){ return (static_cast<uint8_t>(c) & 0xC0) != 0x80; });
+}
 Codepoint Lexer::getc()
 {
     if( m_last_char_valid )
@@ -9,7 +9,7 @@
 #define LEX_HPP_INCLUDED
 
 #include <string>
-#include <fstream>
+#include <vector>
 #include "tokenstream.hpp"
 
 struct Codepoint {
@@ -32,6 +32,23 @@ extern Token Lex_FindReservedWord(const ::std::string& s);
 
 typedef Codepoint   uchar;
 
+/// Read-only contents of a source file, memory-mapped where possible
+class SourceFile
+{
+    const char* m_data;
+    size_t  m_size;
+    // Used if the file couldn't be mapped
+    ::std::vector<char> m_fallback;
+public:
+    SourceFile(const ::std::string& filename);
+    SourceFile(const SourceFile&) = delete;
+    SourceFile(SourceFile&& x);
+    ~SourceFile();
+
+    const char* data() const { return m_data; }
+    size_t size() const { return m_size; }
+};
+
 class Lexer:
     public TokenStream
 {
@@ -39,7 +56,8 @@ class Lexer:
     unsigned int m_line;
     unsigned int m_line_ofs;
 
-    ::std::ifstream m_istream;
+    SourceFile  m_file;
+    size_t  m_pos;
     bool    m_last_char_valid;
     Codepoint   m_last_char;
     ::std::vector<Token>    m_next_tokens;
@@ -69,6 +87,9 @@ private:
     }
 
     void ungetc();
+    // Fast paths, operating directly on the file data (can't be used with an ungot character)
+    void getc_ascii_while(bool (*pred)(char), ::std::string* out);
+    void getc_until_eol(::std::string& out);
     Codepoint getc_num();
     Codepoint getc();
     Codepoint getc_cp();
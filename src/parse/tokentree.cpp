@@ -10,21 +10,25 @@
 
 TokenTree TokenTree::clone() const
 {
-    if( m_subtrees.size() == 0 ) {
-        return TokenTree(m_hygiene, m_tok.clone());
-    }
-    else {
+    TokenTree   rv { m_hygiene, m_tok.clone() };
+    rv.m_subtrees = m_subtrees;
+    return rv;
+}
+void TokenTree::make_unique()
+{
+    if( this->is_shared() )
+    {
         ::std::vector< TokenTree>   ents;
-        ents.reserve( m_subtrees.size() );
-        for(const auto& sub : m_subtrees)
+        ents.reserve( m_subtrees->size() );
+        for(const auto& sub : *m_subtrees)
             ents.push_back( sub.clone() );
-        return TokenTree( m_hygiene, mv$(ents) );
+        m_subtrees = ::std::make_shared< ::std::vector<TokenTree>>( mv$(ents) );
     }
 }
 
 ::std::ostream& operator<<(::std::ostream& os, const TokenTree& tt)
 {
-    if( tt.m_subtrees.size() == 0 )
+    if( tt.size() == 0 )
     {
         switch(tt.m_tok.type())
         {
@@ -44,7 +48,7 @@ TokenTree TokenTree::clone() const
         os << "/*" << tt.m_hygiene << " TT*/";
         // NOTE: All TTs (except the outer tt on a macro invocation) include the grouping
         bool first = true;
-        for(const auto& i : tt.m_subtrees) {
+        for(const auto& i : *tt.m_subtrees) {
             if(!first)
                 os << " ";
             os << i;
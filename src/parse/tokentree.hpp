@@ -11,12 +11,17 @@
 #include "token.hpp"
 #include <ident.hpp>
 #include <vector>
+#include <memory>
 
+/// A tree of tokens (e.g. the input to a macro)
+///
+/// Sub-tree lists are shared between clones, and only copied when modified through a non-const accessor. So cloning
+/// (e.g. when a macro capture is used multiple times) costs one token instead of the whole tree.
 class TokenTree
 {
     Ident::Hygiene m_hygiene;
     Token   m_tok;
-    ::std::vector<TokenTree>    m_subtrees;
+    ::std::shared_ptr< ::std::vector<TokenTree> >   m_subtrees;
 public:
     virtual ~TokenTree() {}
     TokenTree() {}
@@ -37,7 +42,7 @@ public:
     }
     TokenTree(Ident::Hygiene hygiene, ::std::vector<TokenTree> subtrees):
         m_hygiene( ::std::move(hygiene) ),
-        m_subtrees( ::std::move(subtrees) )
+        m_subtrees( subtrees.empty() ? nullptr : ::std::make_shared< ::std::vector<TokenTree>>(::std::move(subtrees)) )
     {
     }
 
@@ -47,15 +52,22 @@ public:
         return m_tok.type() != TOK_NULL;
     }
     unsigned int size() const {
-        return m_subtrees.size();
+        return m_subtrees ? m_subtrees->size() : 0;
     }
-    const TokenTree& operator[](unsigned int idx) const { assert(idx < m_subtrees.size()); return m_subtrees[idx]; }
-          TokenTree& operator[](unsigned int idx)       { assert(idx < m_subtrees.size()); return m_subtrees[idx]; }
+    /// Returns true if the sub-tree list is shared with another tree (so must not be modified in-place)
+    bool is_shared() const {
+        return m_subtrees && m_subtrees.use_count() > 1;
+    }
+    const TokenTree& operator[](unsigned int idx) const { assert(idx < size()); return (*m_subtrees)[idx]; }
+          TokenTree& operator[](unsigned int idx)       { assert(idx < size()); make_unique(); return (*m_subtrees)[idx]; }
     const Token& tok() const { return m_tok; }
           Token& tok()       { return m_tok; }
     const Ident::Hygiene& hygiene() const { return m_hygiene; }
 
     friend ::std::ostream& operator<<(::std::ostream& os, const TokenTree& tt);
+private:
+    /// Ensure that the sub-tree list isn't shared (copying it if it is)
+    void make_unique();
 };
 
 #endif // TOKENTREE_HPP_INCLUDED
@@ -69,7 +69,7 @@ TTStreamO::TTStreamO(Span parent, TokenTree input_tt):
     m_input_tt( mv$(input_tt) ),
     m_parent_span( new Span(mv$(parent)) )
 {
-    m_stack.push_back( ::std::make_pair(0, nullptr) );
+    m_stack.push_back( StackEnt { 0, nullptr, true } );
 }
 TTStreamO::~TTStreamO()
 {
@@ -79,27 +79,37 @@ Token TTStreamO::realGetToken()
     while(m_stack.size() > 0)
     {
         // If current index is above TT size, go up
-        unsigned int& idx = m_stack.back().first;
-        TokenTree& tree = (m_stack.back().second ? *m_stack.back().second : m_input_tt);
+        auto& ent = m_stack.back();
+        unsigned int& idx = ent.idx;
+        TokenTree& tree = (ent.tree ? *ent.tree : m_input_tt);
 
         if(idx == 0 && tree.is_token()) {
             idx ++;
             m_last_pos = tree.tok().get_pos();
             m_hygiene_ptr = &tree.hygiene();
-            return mv$(tree.tok());
+            if( ent.is_owned )
+                return mv$(tree.tok());
+            else
+                return tree.tok().clone();
         }
 
         if(idx < tree.size())
         {
-            TokenTree& subtree = tree[idx];
+            // If the sub-tree list is shared with another tree (e.g. a captured fragment that is used again), tokens
+            // are cloned out of it instead of moved.
+            bool is_owned = ent.is_owned && !tree.is_shared();
+            const TokenTree& subtree = static_cast<const TokenTree&>(tree)[idx];
             idx ++;
             if( subtree.size() == 0 ) {
                 m_last_pos = subtree.tok().get_pos();
                 m_hygiene_ptr = &subtree.hygiene();
-                return mv$( subtree.tok() );
+                if( is_owned )
+                    return mv$( const_cast<TokenTree&>(subtree).tok() );
+                else
+                    return subtree.tok().clone();
             }
             else {
-                m_stack.push_back( ::std::make_pair(0, &subtree) );
+                m_stack.push_back( StackEnt { 0, const_cast<TokenTree*>(&subtree), is_owned } );
             }
         }
         else {
@@ -37,7 +37,13 @@ class TTStreamO:
 {
     Position    m_last_pos;
     TokenTree   m_input_tt;
-    ::std::vector< ::std::pair<unsigned int, TokenTree*> > m_stack;
+    struct StackEnt {
+        unsigned int    idx;
+        TokenTree*  tree;
+        /// Set if this tree's storage is only referenced by this stream (so tokens can be moved out)
+        bool    is_owned;
+    };
+    ::std::vector<StackEnt> m_stack;
     const Ident::Hygiene*   m_hygiene_ptr = nullptr;
 public:
     ::std::shared_ptr<Span> m_parent_span;
@@ -1,44 +1,128 @@
 /*
+ * MRustC - Rust Compiler
+ * - By John Hodge (Mutabah/thePowersGang)
+ *
+ * rc_string.cpp
+ * - Interned immutable string
  */
 #include <rc_string.hpp>
 #include <cstring>
 #include <iostream>
+#include <new>
+#include <mutex>
+#include <unordered_map>
 
-RcString::RcString(const char* s, unsigned int len):
-    m_ptr(nullptr),
-    m_len(len)
+namespace {
+    /// Table of interned strings, keyed by hash
+    /// - Entries are never removed (the table holds a reference), so interned strings live until exit.
+    struct InternTable
+    {
+        ::std::mutex    lock;
+        ::std::unordered_multimap<size_t, RcString> strings;
+    };
+    InternTable& intern_table()
+    {
+        static InternTable  s_table;
+        return s_table;
+    }
+}
+
+size_t RcString::hash_bytes(const char* s, size_t len)
+{
+    // FNV-1a
+    size_t h = 14695981039346656037ull;
+    for(size_t i = 0; i < len; i ++)
+    {
+        h ^= static_cast<unsigned char>(s[i]);
+        h *= 1099511628211ull;
+    }
+    return len == 0 ? 0 : h;
+}
+
+RcString::Inner* RcString::alloc(const char* s, size_t len, size_t hash)
+{
+    char* buf = new char[sizeof(Inner) + len + 1];
+    auto* rv = new (buf) Inner;
+    rv->refcount.store(1, ::std::memory_order_relaxed);
+    rv->len = static_cast<unsigned int>(len);
+    rv->hash = hash;
+    char* data_mut = buf + sizeof(Inner);
+    ::std::memcpy(data_mut, s, len);
+    data_mut[len] = '\0';
+    return rv;
+}
+
+RcString::RcString(const char* s, size_t len):
+    m_ptr(nullptr)
+{
+    if( len == 0 )
+        return ;
+
+    auto hash = hash_bytes(s, len);
+    auto& table = intern_table();
+    ::std::lock_guard<::std::mutex> lh { table.lock };
+    auto range = table.strings.equal_range(hash);
+    for(auto it = range.first; it != range.second; ++it)
+    {
+        if( it->second.compare(s, len) == 0 )
+        {
+            *this = it->second;
+            return ;
+        }
+    }
+    m_ptr = alloc(s, len, hash);
+    table.strings.insert( ::std::make_pair(hash, *this) );
+}
+RcString RcString::find_interned(const char* s, size_t len)
 {
-    if( len > 0 )
+    RcString    rv;
+    if( len == 0 )
+        return rv;
+
+    auto hash = hash_bytes(s, len);
+    auto& table = intern_table();
+    ::std::lock_guard<::std::mutex> lh { table.lock };
+    auto range = table.strings.equal_range(hash);
+    for(auto it = range.first; it != range.second; ++it)
     {
-        m_ptr = new unsigned int[1 + (len+1 + sizeof(unsigned int)-1) / sizeof(unsigned int)];
-        *m_ptr = 1;
-        char* data_mut = reinterpret_cast<char*>(m_ptr + 1);
-        for(unsigned int j = 0; j < len; j ++ )
-            data_mut[j] = s[j];
-        data_mut[len] = '\0';
+        if( it->second.compare(s, len) == 0 )
+        {
+            rv = it->second;
+            break;
+        }
     }
+    return rv;
 }
 RcString::~RcString()
 {
     if(m_ptr)
     {
-        *m_ptr -= 1;
-        //::std::cout << "RcString(\"" << *this << "\") - " << *m_ptr << " refs left" << ::std::endl;
-        if( *m_ptr == 0 )
+        auto prev = m_ptr->refcount.fetch_sub(1, ::std::memory_order_acq_rel);
+        if( prev == 1 )
         {
-            delete[] m_ptr;
-            m_ptr = nullptr;
+            m_ptr->~Inner();
+            delete[] reinterpret_cast<char*>(m_ptr);
         }
+        m_ptr = nullptr;
     }
 }
+
+int RcString::compare(const char* s, size_t len) const
+{
+    size_t my_len = this->size();
+    int rv = ::std::memcmp(this->c_str(), s, my_len < len ? my_len : len);
+    if( rv != 0 )
+        return rv;
+    return my_len < len ? -1 : (my_len > len ? 1 : 0);
+}
+int RcString::compare(const RcString& x) const
+{
+    if( m_ptr == x.m_ptr )
+        return 0;
+    return this->compare(x.c_str(), x.size());
+}
 bool RcString::operator==(const char* s) const
 {
-    if( m_len == 0 )
-        return *s == '\0';
-    auto m = this->c_str();
-    do {
-        if( *m != *s )
-            return false;
-    } while( *m++ != '\0' && *s++ != '\0' );
-    return true;
+    size_t len = ::std::strlen(s);
+    return this->size() == len && ::std::memcmp(this->c_str(), s, len) == 0;
 }
@@ -664,7 +664,7 @@ namespace {
     void Resolve_Absolute_Path_BindAbsolute__hir_from_import(Context& context, const Span& sp, bool is_value, AST::Path& path, const ::HIR::SimplePath& p)
     {
         TRACE_FUNCTION_FR("path="<<path<<", p="<<p, path);
-        const auto& ext_crate = context.m_crate.m_extern_crates.at(p.m_crate_name);
+        const auto& ext_crate = context.m_crate.m_extern_crates.at(::std::string(p.m_crate_name));
         const ::HIR::Module* hmod = &ext_crate.m_hir->m_root_module;
         for(unsigned int i = 0; i < p.m_components.size() - 1; i ++)
         {
@@ -687,10 +687,10 @@ namespace {
                 auto pb = ::AST::PathBinding::make_EnumVar({nullptr, static_cast<unsigned>(var_idx), &e});
 
                 // Construct output path (with same set of parameters)
-                AST::Path   rv( p.m_crate_name, {} );
+                AST::Path   rv( ::std::string(p.m_crate_name), {} );
                 rv.nodes().reserve( p.m_components.size() );
                 for(const auto& c : p.m_components)
-                    rv.nodes().push_back( AST::PathNode(c) );
+                    rv.nodes().push_back( AST::PathNode(::std::string(c)) );
                 rv.nodes().back().args() = mv$( path.nodes().back().args() );
                 rv.bind( mv$(pb) );
                 path = mv$(rv);
@@ -765,10 +765,10 @@ namespace {
         }
 
         // Construct output path (with same set of parameters)
-        AST::Path   rv( p.m_crate_name, {} );
+        AST::Path   rv( ::std::string(p.m_crate_name), {} );
         rv.nodes().reserve( p.m_components.size() );
         for(const auto& c : p.m_components)
-            rv.nodes().push_back( AST::PathNode(c) );
+            rv.nodes().push_back( AST::PathNode(::std::string(c)) );
         rv.nodes().back().args() = mv$( path.nodes().back().args() );
         rv.bind( mv$(pb) );
         path = mv$(rv);
@@ -796,16 +796,16 @@ namespace {
         {
             auto& n = path_abs.nodes[i];
             assert(hmod);
-            auto it = hmod->m_mod_items.find(n.name());
+            auto it = hmod->m_mod_items.find( RcString::find_interned(n.name()) );
             if( it == hmod->m_mod_items.end() )
                 ERROR(sp, E0000, "Couldn't find path component '" << n.name() << "' of " << path);
 
             TU_MATCH(::HIR::TypeItem, (it->second->ent), (e),
             (Import,
                 // - Update path then restart
-                auto newpath = AST::Path(e.path.m_crate_name, {});
+                auto newpath = AST::Path(::std::string(e.path.m_crate_name), {});
                 for(const auto& n : e.path.m_components)
-                    newpath.nodes().push_back( AST::PathNode(n) );
+                    newpath.nodes().push_back( AST::PathNode(::std::string(n)) );
                 for(unsigned int j = i + 1; j < path.nodes().size(); j ++)
                     newpath.nodes().push_back( mv$(path.nodes()[j]) );
                 path = mv$(newpath);
@@ -902,13 +902,15 @@ namespace {
         }
 
         const auto& name = path_abs.nodes.back().name();
+        // NOTE: Not interned if no item anywhere has this name (so the lookups below miss)
+        auto name_rc = RcString::find_interned(name);
         switch(mode)
         {
         // TODO: Don't bind to a Module if LookupMode::Type
         case Context::LookupMode::Namespace:
         case Context::LookupMode::Type:
             {
-                auto v = hmod->m_mod_items.find(name);
+                auto v = hmod->m_mod_items.find(name_rc);
                 if( v != hmod->m_mod_items.end() ) {
                     TU_MATCH(::HIR::TypeItem, (v->second->ent), (e),
                     (Import,
@@ -944,7 +946,7 @@ namespace {
 
         case Context::LookupMode::PatternValue:
             {
-                auto v = hmod->m_value_items.find(name);
+                auto v = hmod->m_value_items.find(name_rc);
                 if( v != hmod->m_value_items.end() ) {
                     TU_MATCH_DEF(::HIR::ValueItem, (v->second->ent), (e),
                     (
@@ -976,7 +978,7 @@ namespace {
         case Context::LookupMode::Constant:
         case Context::LookupMode::Variable:
             {
-                auto v = hmod->m_value_items.find(name);
+                auto v = hmod->m_value_items.find(name_rc);
                 if( v != hmod->m_value_items.end() ) {
                     TU_MATCH(::HIR::ValueItem, (v->second->ent), (e),
                     (Import,
@@ -1258,13 +1260,14 @@ void Resolve_Absolute_Path(/*const*/ Context& context, const Span& sp, Context::
                     if( !pe.module_ ) {
                         assert( pe.hir );
                         const auto& mod = *pe.hir;
+                        auto name_rc = RcString::find_interned(name);
 
                         switch( e.nodes.size() == 2 ? mode : Context::LookupMode::Namespace )
                         {
                         case Context::LookupMode::Namespace:
                         case Context::LookupMode::Type:
                             // TODO: Restrict if ::Type
-                            if( mod.m_mod_items.find(name) != mod.m_mod_items.end() ) {
+                            if( mod.m_mod_items.find(name_rc) != mod.m_mod_items.end() ) {
                                 found = true;
                             }
                             break;
@@ -1272,7 +1275,7 @@ void Resolve_Absolute_Path(/*const*/ Context& context, const Span& sp, Context::
                             TODO(sp, "Check " << p << " for an item named " << name << " (Pattern)");
                         case Context::LookupMode::Constant:
                         case Context::LookupMode::Variable:
-                            if( mod.m_value_items.find(name) != mod.m_value_items.end() ) {
+                            if( mod.m_value_items.find(name_rc) != mod.m_value_items.end() ) {
                                 found = true;
                             }
                             break;
@@ -45,10 +45,10 @@ namespace {
     AST::Path hir_to_ast(const HIR::SimplePath& p) {
         // The crate name here has to be non-empty, because it's external.
         assert( p.m_crate_name != "" );
-        AST::Path   rv( p.m_crate_name, {} );
+        AST::Path   rv( ::std::string(p.m_crate_name), {} );
         rv.nodes().reserve( p.m_components.size() );
         for(const auto& n : p.m_components)
-            rv.nodes().push_back( AST::PathNode(n) );
+            rv.nodes().push_back( AST::PathNode(::std::string(n)) );
         return rv;
     }
 }   // namespace
@@ -287,7 +287,7 @@ void Resolve_Index_Module_Wildcard__glob_in_hir_mod(const Span& sp, const AST::C
                 p = hir_to_ast( ve.ent.as_Import().path );
             }
             else {
-                p = path + it.first;
+                p = path + ::std::string(it.first);
             }
             TU_MATCHA( (ve.ent), (e),
             (Import,
@@ -312,7 +312,7 @@ void Resolve_Index_Module_Wildcard__glob_in_hir_mod(const Span& sp, const AST::C
                 p.bind( ::AST::PathBinding::make_TypeAlias({nullptr}) );
                 )
             )
-            _add_item_type( sp, dst_mod, it.first, is_pub, mv$(p), false );
+            _add_item_type( sp, dst_mod, ::std::string(it.first), is_pub, mv$(p), false );
         }
     }
     for(const auto& it : hmod.m_value_items) {
@@ -324,8 +324,8 @@ void Resolve_Index_Module_Wildcard__glob_in_hir_mod(const Span& sp, const AST::C
                 const auto& spath = ve.ent.as_Import().path;
                 p = hir_to_ast( spath );
 
-                ASSERT_BUG(sp, crate.m_extern_crates.count(spath.m_crate_name) == 1, "Crate " << spath.m_crate_name << " is not loaded");
-                const auto* hmod = &crate.m_extern_crates.at(spath.m_crate_name).m_hir->m_root_module;
+                ASSERT_BUG(sp, crate.m_extern_crates.count(::std::string(spath.m_crate_name)) == 1, "Crate " << spath.m_crate_name << " is not loaded");
+                const auto* hmod = &crate.m_extern_crates.at(::std::string(spath.m_crate_name)).m_hir->m_root_module;
                 for(unsigned int i = 0; i < spath.m_components.size()-1; i ++) {
                     const auto& it = hmod->m_mod_items.at( spath.m_components[i] );
                     if(it->ent.is_Enum()) {
@@ -342,7 +342,7 @@ void Resolve_Index_Module_Wildcard__glob_in_hir_mod(const Span& sp, const AST::C
                     vep = &hmod->m_value_items.at( spath.m_components.back() )->ent;
             }
             else {
-                p = path + it.first;
+                p = path + ::std::string(it.first);
             }
             if( vep )
             {
@@ -358,17 +358,17 @@ void Resolve_Index_Module_Wildcard__glob_in_hir_mod(const Span& sp, const AST::C
                     ),
                 // TODO: What if these refer to an enum variant?
                 (StructConstant,
-                    p.bind( ::AST::PathBinding::make_Struct({ nullptr, &crate.m_extern_crates.at(e.ty.m_crate_name).m_hir->get_typeitem_by_path(sp, e.ty, true).as_Struct() }) );
+                    p.bind( ::AST::PathBinding::make_Struct({ nullptr, &crate.m_extern_crates.at(::std::string(e.ty.m_crate_name)).m_hir->get_typeitem_by_path(sp, e.ty, true).as_Struct() }) );
                     ),
                 (StructConstructor,
-                    p.bind( ::AST::PathBinding::make_Struct({ nullptr, &crate.m_extern_crates.at(e.ty.m_crate_name).m_hir->get_typeitem_by_path(sp, e.ty, true).as_Struct() }) );
+                    p.bind( ::AST::PathBinding::make_Struct({ nullptr, &crate.m_extern_crates.at(::std::string(e.ty.m_crate_name)).m_hir->get_typeitem_by_path(sp, e.ty, true).as_Struct() }) );
                     ),
                 (Function,
                     p.bind( ::AST::PathBinding::make_Function({nullptr}) );
                     )
                 )
             }
-            _add_item_value( sp, dst_mod, it.first, is_pub, mv$(p), false );
+            _add_item_value( sp, dst_mod, ::std::string(it.first), is_pub, mv$(p), false );
         }
     }
 }
@@ -550,14 +550,14 @@ void Resolve_Index_Module_Normalise_Path_ext(const ::AST::Crate& crate, const Sp
 
     for(unsigned int i = start; i < info.nodes.size() - 1; i ++)
     {
-        auto it = hmod->m_mod_items.find( info.nodes[i].name() );
+        auto it = hmod->m_mod_items.find( RcString::find_interned(info.nodes[i].name()) );
         if( it == hmod->m_mod_items.end() ) {
             ERROR(sp, E0000,  "Couldn't find node " << i << " of path " << path);
         }
         const auto* item_ptr = &it->second->ent;
         if( item_ptr->is_Import() ) {
             const auto& e = item_ptr->as_Import();
-            const auto& ec = crate.m_extern_crates.at( e.path.m_crate_name );
+            const auto& ec = crate.m_extern_crates.at( ::std::string(e.path.m_crate_name) );
             if( e.path.m_components.size() == 0 ) {
                 hmod = &ec.m_hir->m_root_module;
                 continue ;
@@ -589,7 +589,7 @@ void Resolve_Index_Module_Normalise_Path_ext(const ::AST::Crate& crate, const Sp
     {
     case IndexName::Type:
     case IndexName::Namespace: {
-        auto it_m = hmod->m_mod_items.find( lastnode.name() );
+        auto it_m = hmod->m_mod_items.find( RcString::find_interned(lastnode.name()) );
         if( it_m != hmod->m_mod_items.end() )
         {
             TU_IFLET( ::HIR::TypeItem, it_m->second->ent, Import, e,
@@ -602,7 +602,7 @@ void Resolve_Index_Module_Normalise_Path_ext(const ::AST::Crate& crate, const Sp
         }
         } break;
     case IndexName::Value: {
-        auto it_v = hmod->m_value_items.find( lastnode.name() );
+        auto it_v = hmod->m_value_items.find( RcString::find_interned(lastnode.name()) );
         if( it_v != hmod->m_value_items.end() )
         {
             TU_IFLET( ::HIR::ValueItem, it_v->second->ent, Import, e,
@@ -491,7 +491,7 @@ namespace {
 
     const void* get_hir_modenum_by_path(const Span& sp, const ::AST::Crate& crate, const ::HIR::SimplePath& path, bool& is_enum)
     {
-        const auto* hmod = &crate.m_extern_crates.at( path.m_crate_name ).m_hir->m_root_module;
+        const auto* hmod = &crate.m_extern_crates.at( ::std::string(path.m_crate_name) ).m_hir->m_root_module;
         for(const auto& node : path.m_components)
         {
             auto it = hmod->m_mod_items.find(node);
@@ -538,7 +538,7 @@ namespace {
     const ::HIR::Module* hmod = &hmodr;
     for(unsigned int i = start; i < nodes.size() - 1; i ++)
     {
-        auto it = hmod->m_mod_items.find(nodes[i].name());
+        auto it = hmod->m_mod_items.find( RcString::find_interned(nodes[i].name()) );
         if( it == hmod->m_mod_items.end() ) {
             // BZZT!
             ERROR(span, E0000, "Unable to find path component " << nodes[i].name() << " in " << path);
@@ -591,13 +591,13 @@ namespace {
     }
     if( allow != Lookup::Value )
     {
-        auto it = hmod->m_mod_items.find(nodes.back().name());
+        auto it = hmod->m_mod_items.find( RcString::find_interned(nodes.back().name()) );
         if( it != hmod->m_mod_items.end() ) {
             const auto* item_ptr = &it->second->ent;
             DEBUG("E : " << nodes.back().name() << " = " << item_ptr->tag_str());
             if( item_ptr->is_Import() ) {
                 const auto& e = item_ptr->as_Import();
-                const auto& ec = crate.m_extern_crates.at( e.path.m_crate_name );
+                const auto& ec = crate.m_extern_crates.at( ::std::string(e.path.m_crate_name) );
                 // This doesn't need to recurse - it can just do a single layer (as no Import should refer to another)
                 if( e.is_variant ) {
                     auto p = e.path;
@@ -638,14 +638,14 @@ namespace {
     }
     if( allow != Lookup::Type )
     {
-        auto it2 = hmod->m_value_items.find(nodes.back().name());
+        auto it2 = hmod->m_value_items.find( RcString::find_interned(nodes.back().name()) );
         if( it2 != hmod->m_value_items.end() ) {
             const auto* item_ptr = &it2->second->ent;
             DEBUG("E : " << nodes.back().name() << " = " << item_ptr->tag_str());
             if( item_ptr->is_Import() ) {
                 const auto& e = item_ptr->as_Import();
                 // This doesn't need to recurse - it can just do a single layer (as no Import should refer to another)
-                const auto& ec = crate.m_extern_crates.at( e.path.m_crate_name );
+                const auto& ec = crate.m_extern_crates.at( ::std::string(e.path.m_crate_name) );
                 if( e.is_variant ) {
                     auto p = e.path;
                     p.m_components.pop_back();
@@ -667,12 +667,12 @@ namespace {
                 ),
             // TODO: What happens if these two refer to an enum constructor?
             (StructConstant,
-                ASSERT_BUG(span, crate.m_extern_crates.count(e.ty.m_crate_name), "Crate '" << e.ty.m_crate_name << "' not loaded for " << e.ty);
-                return ::AST::PathBinding::make_Struct({ nullptr, &crate.m_extern_crates.at(e.ty.m_crate_name).m_hir->get_typeitem_by_path(span, e.ty, true).as_Struct() });
+                ASSERT_BUG(span, crate.m_extern_crates.count(::std::string(e.ty.m_crate_name)), "Crate '" << e.ty.m_crate_name << "' not loaded for " << e.ty);
+                return ::AST::PathBinding::make_Struct({ nullptr, &crate.m_extern_crates.at(::std::string(e.ty.m_crate_name)).m_hir->get_typeitem_by_path(span, e.ty, true).as_Struct() });
                 ),
             (StructConstructor,
-                ASSERT_BUG(span, crate.m_extern_crates.count(e.ty.m_crate_name), "Crate '" << e.ty.m_crate_name << "' not loaded for " << e.ty);
-                return ::AST::PathBinding::make_Struct({ nullptr, &crate.m_extern_crates.at(e.ty.m_crate_name).m_hir->get_typeitem_by_path(span, e.ty, true).as_Struct() });
+                ASSERT_BUG(span, crate.m_extern_crates.count(::std::string(e.ty.m_crate_name)), "Crate '" << e.ty.m_crate_name << "' not loaded for " << e.ty);
+                return ::AST::PathBinding::make_Struct({ nullptr, &crate.m_extern_crates.at(::std::string(e.ty.m_crate_name)).m_hir->get_typeitem_by_path(span, e.ty, true).as_Struct() });
                 ),
             (Function,
                 return ::AST::PathBinding::make_Function({ nullptr });
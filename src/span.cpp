@@ -7,6 +7,8 @@
  */
 #include <functional>
 #include <iostream>
+#include <sstream>
+#include <atomic>
 #include <span.hpp>
 #include <parse/lex.hpp>
 #include <common.hpp>
@@ -40,9 +42,20 @@ Span::Span():
 }
 
 namespace {
+    thread_local SpanMessageBuffer* t_message_buffer = nullptr;
+    ::std::atomic<void(*)()>    s_stop_hook { nullptr };
+
+    void run_stop_hook()
+    {
+        // Exchange so the hook runs once, even if several threads fail at the same time
+        if( auto* hook = s_stop_hook.exchange(nullptr) )
+            hook();
+    }
+
     void print_span_message(const Span& sp, ::std::function<void(::std::ostream&)> tag, ::std::function<void(::std::ostream&)> msg)
     {
-        auto& sink = ::std::cerr;
+        ::std::ostringstream    buffered;
+        ::std::ostream& sink = t_message_buffer ? buffered : ::std::cerr;
         sink << sp.filename << ":" << sp.start_line << ": ";
         tag(sink);
         sink << ":";
@@ -54,21 +67,39 @@ namespace {
             sink << parent->filename << ":" << parent->start_line << ": note: From here" << ::std::endl;
             parent = parent->outer_span.get();
         }
+        if( t_message_buffer )
+        {
+            t_message_buffer->text += buffered.str();
+        }
+    }
+    void stop_on_error()
+    {
+        run_stop_hook();
+#ifndef _WIN32
+        abort();
+#else
+        exit(1);
+#endif
     }
 }
 void Span::bug(::std::function<void(::std::ostream&)> msg) const
 {
     print_span_message(*this, [](auto& os){os << "BUG";}, msg);
+    if( t_message_buffer ) {
+        t_message_buffer->is_fatal = true;
+        return ;
+    }
+    run_stop_hook();
     abort();
 }
 
 void Span::error(ErrorType tag, ::std::function<void(::std::ostream&)> msg) const {
     print_span_message(*this, [&](auto& os){os << "error:" << tag;}, msg);
-#ifndef _WIN32
-    abort();
-#else
-    exit(1);
-#endif
+    if( t_message_buffer ) {
+        t_message_buffer->is_fatal = true;
+        return ;
+    }
+    stop_on_error();
 }
 void Span::warning(WarningType tag, ::std::function<void(::std::ostream&)> msg) const {
     print_span_message(*this, [&](auto& os){os << "warning" << tag;}, msg);
@@ -77,6 +108,31 @@ void Span::note(::std::function<void(::std::ostream&)> msg) const {
     print_span_message(*this, [](auto& os){os << "note";}, msg);
 }
 
+void Span_SetStopHook(void (*hook)())
+{
+    s_stop_hook = hook;
+}
+
+void SpanMessageBuffer::flush()
+{
+    ::std::cerr << text;
+    text.clear();
+    if( is_fatal )
+    {
+        ::std::cerr.flush();
+        stop_on_error();
+    }
+}
+SpanMessageCapture::SpanMessageCapture(SpanMessageBuffer& buf):
+    m_prev(t_message_buffer)
+{
+    t_message_buffer = &buf;
+}
+SpanMessageCapture::~SpanMessageCapture()
+{
+    t_message_buffer = m_prev;
+}
+
 ::std::ostream& operator<<(::std::ostream& os, const Span& sp)
 {
     os << sp.filename << ":" << sp.start_line;
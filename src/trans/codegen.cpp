@@ -11,14 +11,26 @@
 #include <mir/mir.hpp>
 #include <mir/operations.hpp>
 #include <algorithm>
+#include <parallel.hpp>
 
 #include "codegen.hpp"
 #include "monomorphise.hpp"
 
+namespace {
+    /// Rough estimate of the amount of C that will be generated for a function (used to balance codegen units)
+    size_t Trans_Codegen_EstimateCost(const ::MIR::Function& fcn)
+    {
+        size_t  rv = 0;
+        for(const auto& bb : fcn.blocks)
+            rv += bb.statements.size() + 1;
+        return rv;
+    }
+}
+
 void Trans_Codegen(const ::std::string& outfile, const TransOptions& opt, const ::HIR::Crate& crate, const TransList& list, bool is_executable)
 {
     static Span sp;
-    auto codegen = Trans_Codegen_GetGeneratorC(crate, outfile);
+    auto codegen = Trans_Codegen_GetGeneratorC(crate, outfile, opt);
 
     // 1. Emit structure/type definitions.
     // - Emit in the order they're needed.
@@ -89,7 +101,7 @@ void Trans_Codegen(const ::std::string& outfile, const TransOptions& opt, const
         const auto& fcn = *ent.second->ptr;
         // Extern if there isn't any HIR
         bool is_extern = ! static_cast<bool>(fcn.m_code);
-        if( fcn.m_code.m_mir ) {
+        if( fcn.m_code.m_mir && !ent.second->is_upstream ) {
             codegen->emit_function_proto(ent.first, fcn, ent.second->pp, is_extern);
         }
     }
@@ -99,7 +111,7 @@ void Trans_Codegen(const ::std::string& outfile, const TransOptions& opt, const
         //DEBUG("FUNCTION " << ent.first);
         assert( ent.second->ptr );
         const auto& fcn = *ent.second->ptr;
-        if( fcn.m_code.m_mir ) {
+        if( fcn.m_code.m_mir && !ent.second->is_upstream ) {
         }
         else {
             // TODO: Why would an intrinsic be in the queue?
@@ -150,43 +162,88 @@ void Trans_Codegen(const ::std::string& outfile, const TransOptions& opt, const
 
 
     // 4. Emit function code
+    // - Bodies are spread across the codegen units, each placed in the currently least-loaded unit
+    ::std::vector<size_t>   unit_costs( ::std::max(opt.codegen_units, 1u), 0 );
+    auto select_unit = [&](const ::MIR::Function& fcn) {
+        if( unit_costs.size() > 1 )
+        {
+            auto it = ::std::min_element(unit_costs.begin(), unit_costs.end());
+            *it += Trans_Codegen_EstimateCost(fcn);
+            codegen->set_codegen_unit( static_cast<unsigned int>(it - unit_costs.begin()) );
+        }
+        };
+    // - Generic functions (and provided trait methods) are monomorphised and re-optimised on worker threads (the HIR
+    //   is read-only by now), with the results handed to the emitter in list order.
+    struct FunctionJob {
+        const ::HIR::Path*  path;
+        const TransList_Function*   ent;
+        bool    needs_monomorph;
+        ::MIR::FunctionPointer  mir;
+    };
+    ::std::vector<FunctionJob>  jobs;
     for(const auto& ent : list.m_functions)
     {
-        if( ent.second->ptr && ent.second->ptr->m_code.m_mir )
+        if( ent.second->ptr && ent.second->ptr->m_code.m_mir && !ent.second->is_upstream )
         {
-            const auto& path = ent.first;
             const auto& fcn = *ent.second->ptr;
-            const auto& pp = ent.second->pp;
+            // If this is a provided trait method, it needs to be monomorphised too.
+            bool is_method = ( fcn.m_args.size() > 0 && visit_ty_with(fcn.m_args[0].second, [&](const auto& x){return x == ::HIR::TypeRef("Self",0xFFFF);}) );
+            jobs.push_back(FunctionJob { &ent.first, ent.second.get(), ent.second->pp.has_types() || is_method, {} });
+        }
+    }
+    // One resolver per thread, re-used for every function that thread handles
+    ::std::vector< ::std::unique_ptr< ::StaticTraitResolve> >  resolvers( opt.num_jobs + 1 );
+    Parallel_Pipeline(opt.num_jobs, jobs.size(),
+        [&](size_t idx) {
+            auto& job = jobs[idx];
+            if( !job.needs_monomorph )
+                return ;
+            const auto& path = *job.path;
+            const auto& fcn = *job.ent->ptr;
+            const auto& pp = job.ent->pp;
+            TRACE_FUNCTION_F(path);
+            auto& resolve_ptr = resolvers.at( Parallel_WorkerIndex() );
+            if( !resolve_ptr )
+                resolve_ptr.reset(new ::StaticTraitResolve(crate));
+            const auto& resolve = *resolve_ptr;
+
+            auto ret_type = pp.monomorph(resolve, fcn.m_return);
+            ::HIR::Function::args_t args;
+            for(const auto& a : fcn.m_args)
+                args.push_back(::std::make_pair( ::HIR::Pattern{}, pp.monomorph(resolve, a.second) ));
+            auto mir = Trans_Monomorphise(resolve, pp, fcn.m_code.m_mir);
+            ::std::string s = FMT(path);
+            ::HIR::ItemPath ip(s);
+            MIR_Validate(resolve, ip, *mir, args, ret_type);
+            MIR_Cleanup(resolve, ip, *mir, args, ret_type);
+            MIR_Optimise(resolve, ip, *mir, args, ret_type);
+            MIR_Validate(resolve, ip, *mir, args, ret_type);
+            job.mir = mv$(mir);
+        },
+        [&](size_t idx) {
+            auto& job = jobs[idx];
+            const auto& path = *job.path;
+            const auto& fcn = *job.ent->ptr;
+            const auto& pp = job.ent->pp;
             TRACE_FUNCTION_F(path);
             DEBUG("FUNCTION CODE " << path);
             bool is_extern = ! static_cast<bool>(fcn.m_code);
-            // If this is a provided trait method, it needs to be monomorphised too.
-            bool is_method = ( fcn.m_args.size() > 0 && visit_ty_with(fcn.m_args[0].second, [&](const auto& x){return x == ::HIR::TypeRef("Self",0xFFFF);}) );
-            if( pp.has_types() || is_method )
+            if( job.needs_monomorph )
             {
-                ::StaticTraitResolve    resolve { crate };
-                auto ret_type = pp.monomorph(resolve, fcn.m_return);
-                ::HIR::Function::args_t args;
-                for(const auto& a : fcn.m_args)
-                    args.push_back(::std::make_pair( ::HIR::Pattern{}, pp.monomorph(resolve, a.second) ));
-                auto mir = Trans_Monomorphise(resolve, pp, fcn.m_code.m_mir);
-                ::std::string s = FMT(path);
-                ::HIR::ItemPath ip(s);
-                MIR_Validate(resolve, ip, *mir, args, ret_type);
-                MIR_Cleanup(resolve, ip, *mir, args, ret_type);
-                MIR_Optimise(resolve, ip, *mir, args, ret_type);
-                MIR_Validate(resolve, ip, *mir, args, ret_type);
                 // TODO: Flag that this should be a weak (or weak-er) symbol?
                 // - If it's from an external crate, it should be weak
-                codegen->emit_function_code(path, fcn, ent.second->pp, is_extern,  mir);
+                select_unit(*job.mir);
+                codegen->emit_function_code(path, fcn, pp, is_extern,  job.mir);
+                // Release the monomorphised MIR as soon as it's been emitted
+                job.mir.reset();
             }
             // TODO: Detect if the function was a #[inline] function from another crate, and don't emit if that is the case?
             // - Emiting is nice, but it should be emitted as a weak symbol
             else {
+                select_unit(*fcn.m_code.m_mir);
                 codegen->emit_function_code(path, fcn, pp, is_extern,  fcn.m_code.m_mir);
             }
-        }
-    }
+        });
 
     codegen->finalise(is_executable, opt);
 }
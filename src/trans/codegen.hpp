@@ -29,6 +29,9 @@ public:
     virtual ~CodeGenerator() {}
     virtual void finalise(bool is_executable, const TransOptions& opt) {}
 
+    // Select the codegen unit that the following `emit_function_code` calls are written to
+    virtual void set_codegen_unit(unsigned int idx) {}
+
     // Called on all types directly mentioned (e.g. variables, arguments, and fields)
     // - Inner-most types are visited first.
     virtual void emit_type_proto(const ::HIR::TypeRef& ) {}
@@ -55,5 +58,5 @@ public:
 };
 
 
-extern ::std::unique_ptr<CodeGenerator> Trans_Codegen_GetGeneratorC(const ::HIR::Crate& crate, const ::std::string& outfile);
+extern ::std::unique_ptr<CodeGenerator> Trans_Codegen_GetGeneratorC(const ::HIR::Crate& crate, const ::std::string& outfile, const TransOptions& opt);
 
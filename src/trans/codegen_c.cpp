@@ -10,13 +10,21 @@
 #include <fstream>
 #include <algorithm>
 #include <cmath>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <cstring>
+#include <cstdio>
 #include <hir/hir.hpp>
 #include <mir/mir.hpp>
 #include <hir_typeck/static.hpp>
 #include <mir/helpers.hpp>
 #include "codegen_c.hpp"
+#include <hir_expand/main_bindings.hpp>   // ConvertHIR_ConstantEvaluateFull_Monomorph
 #include "target.hpp"
 #include "allocator.hpp"
+#include "object_cache.hpp"
+#include <jobserver.hpp>
 
 namespace {
     struct FmtShell
@@ -133,6 +141,64 @@ namespace {
 }
 
 namespace {
+    ::std::string format_command(const StringList& args, bool is_windows)
+    {
+        ::std::stringstream cmd_ss;
+        if (is_windows)
+        {
+            cmd_ss << "echo \"\" & ";
+        }
+        for(const auto& arg : args.get_vec())
+        {
+            if(strcmp(arg, "&") == 0 && is_windows) {
+                cmd_ss << "&";
+            }
+            else {
+                if( is_windows && strchr(arg, ' ') == nullptr ) {
+                    cmd_ss << arg << " ";
+                    continue ;
+                }
+                cmd_ss << "\"" << FmtShell(arg, is_windows) << "\" ";
+            }
+        }
+        return cmd_ss.str();
+    }
+
+    /// Run a set of shell commands concurrently (at most one per hardware thread), returns false if any failed
+    /// - If a jobserver is passed in `MAKEFLAGS` (by make, or by minicargo), each command needs a token from it.
+    bool run_commands_parallel(const ::std::vector< ::std::string>& commands)
+    {
+        auto jobserver = Jobserver::from_environment();
+        ::std::atomic<size_t>   next_idx { 0 };
+        ::std::atomic<bool> failed { false };
+        auto worker = [&](bool needs_token) {
+            for(;;)
+            {
+                Jobserver::Token    token;
+                if( needs_token && !jobserver->acquire(token, [&](){ return next_idx >= commands.size(); }) )
+                    break;
+                size_t idx = next_idx ++;
+                if( idx < commands.size() && system(commands[idx].c_str()) != 0 )
+                {
+                    ::std::cerr << "Failed: " << commands[idx] << ::std::endl;
+                    failed = true;
+                }
+                if( needs_token )
+                    jobserver->release(token);
+                if( idx >= commands.size() )
+                    break;
+            }
+            };
+
+        size_t  num_jobs = ::std::min<size_t>( ::std::max(::std::thread::hardware_concurrency(), 1u), commands.size() );
+        ::std::vector< ::std::thread>   threads;
+        for(size_t i = 0; i < num_jobs; i ++)
+            threads.push_back( ::std::thread(worker, jobserver != nullptr) );
+        for(auto& t : threads)
+            t.join();
+        return !failed;
+    }
+
     struct MsvcDetection
     {
         ::std::string   path_vcvarsall;
@@ -183,27 +249,38 @@ namespace {
         const ::HIR::Crate& m_crate;
         ::StaticTraitResolve    m_resolve;
 
+        unsigned int    m_codegen_units;
+        // Instances of generics are linked to by downstream crates (`-Z share-generics`)
+        bool    m_share_generics;
         ::std::string   m_outfile_path;
         ::std::string   m_outfile_path_c;
 
         ::std::ofstream m_of;
         const ::MIR::TypeResolve* m_mir_res;
 
+        // Split codegen units (only populated when `m_codegen_units > 1`)
+        // - `m_outfile_path_c` is then a common header included by every unit
+        ::std::vector< ::std::string>   m_unit_paths_c;
+        ::std::vector< ::std::ofstream> m_unit_of;
+        unsigned int    m_cur_unit = 0;
+        unsigned int    m_next_glue_unit = 0;
+
         Compiler    m_compiler = Compiler::Gcc;
         struct {
             bool emulated_i128 = false;
             bool disallow_empty_structs = false;
         } m_options;
 
-        ::std::map<::HIR::GenericPath, ::std::vector<unsigned>> m_enum_repr_cache;
-
         ::std::vector< ::std::pair< ::HIR::GenericPath, const ::HIR::Struct*> >   m_box_glue_todo;
     public:
-        CodeGenerator_C(const ::HIR::Crate& crate, const ::std::string& outfile):
+        CodeGenerator_C(const ::HIR::Crate& crate, const ::std::string& outfile, const TransOptions& opt):
             m_crate(crate),
             m_resolve(crate),
+            // TODO: Support splitting with MSVC (needs an alternative to weak hidden functions)
+            m_codegen_units( Target_GetCurSpec().m_codegen_mode == CodegenMode::Msvc ? 1 : ::std::max(opt.codegen_units, 1u) ),
+            m_share_generics( Target_GetCurSpec().m_codegen_mode != CodegenMode::Msvc && opt.share_generics ),
             m_outfile_path(outfile),
-            m_outfile_path_c(outfile + ".c"),
+            m_outfile_path_c(outfile + (m_codegen_units > 1 ? ".h" : ".c")),
             m_of(m_outfile_path_c)
         {
             switch(Target_GetCurSpec().m_codegen_mode)
@@ -388,10 +465,97 @@ namespace {
                 << "\treturn SIZE_MAX;\n"
                 << "}\n"
                 ;
+
+            if( m_codegen_units > 1 )
+            {
+                auto slash_pos = m_outfile_path_c.find_last_of("/\\");
+                auto header_name = (slash_pos == ::std::string::npos ? m_outfile_path_c : m_outfile_path_c.substr(slash_pos+1));
+                for(unsigned int i = 0; i < m_codegen_units; i ++)
+                {
+                    m_unit_paths_c.push_back( FMT(m_outfile_path << "." << i << ".c") );
+                    m_unit_of.push_back( ::std::ofstream(m_unit_paths_c.back()) );
+                    m_unit_of.back()
+                        << "/*\n"
+                        << " * AUTOGENERATED by mrustc - codegen unit " << i << "\n"
+                        << " */\n"
+                        << "#include \"" << header_name << "\"\n"
+                        ;
+                }
+            }
         }
 
         ~CodeGenerator_C() {}
 
+        void set_codegen_unit(unsigned int idx) override
+        {
+            m_cur_unit = idx % m_codegen_units;
+        }
+
+        /// Redirects `m_of` into a codegen unit for the lifetime of the handle (no-op if not splitting)
+        struct UnitOutput
+        {
+            CodeGenerator_C&    self;
+            ::std::ofstream*    unit_of;
+
+            UnitOutput(CodeGenerator_C& self, unsigned int idx):
+                self(self),
+                unit_of(self.m_codegen_units > 1 ? &self.m_unit_of.at(idx) : nullptr)
+            {
+                if( unit_of )
+                    self.m_of.swap(*unit_of);
+            }
+            UnitOutput(const UnitOutput&) = delete;
+            ~UnitOutput()
+            {
+                if( unit_of )
+                    self.m_of.swap(*unit_of);
+            }
+        };
+
+        /// Linkage for functions that are defined by this crate's object but not exported from it
+        /// (e.g. monomorphised functions from other crates)
+        /// - With `-Z share-generics` these are exported (still weak), so downstream crates can link to them
+        void emit_local_linkage()
+        {
+            if( m_share_generics )
+            {
+                m_of << "__attribute__((weak)) ";
+            }
+            else if( m_codegen_units > 1 )
+            {
+                // Has to be visible to the other units, weak so multiple crates can each define it
+                m_of << "__attribute__((weak,visibility(\"hidden\"))) ";
+            }
+            else
+            {
+                m_of << "static ";
+            }
+        }
+
+        /// Linkage for per-type helpers (drop glue, fn pointer thunks)
+        void emit_glue_linkage()
+        {
+            if( m_codegen_units > 1 )
+                emit_local_linkage();
+            else
+                m_of << "static ";
+        }
+        /// Start the definition of a per-type helper, `emit_sig` writes the signature (without linkage)
+        /// - When split into codegen units, the prototype goes in the shared header and the returned handle redirects
+        ///   the definition into a single unit (round-robin)
+        ::std::unique_ptr<UnitOutput> begin_glue(const ::std::function<void()>& emit_sig)
+        {
+            ::std::unique_ptr<UnitOutput>   rv;
+            if( m_codegen_units > 1 )
+            {
+                emit_glue_linkage(); emit_sig(); m_of << ";\n";
+                rv.reset(new UnitOutput(*this, m_next_glue_unit));
+                m_next_glue_unit = (m_next_glue_unit + 1) % m_codegen_units;
+            }
+            emit_glue_linkage(); emit_sig();
+            return rv;
+        }
+
         void finalise(bool is_executable, const TransOptions& opt) override
         {
             // Emit box drop glue after everything else to avoid definition ordering issues
@@ -402,6 +566,7 @@ namespace {
 
             if( is_executable )
             {
+                UnitOutput  uo(*this, 0);
                 m_of << "int main(int argc, const char* argv[]) {\n";
                 auto c_start_path = m_resolve.m_crate.get_lang_item_path_opt("mrustc-start");
                 if( c_start_path == ::HIR::SimplePath() )
@@ -419,6 +584,11 @@ namespace {
 
             m_of.flush();
             m_of.close();
+            for(auto& of : m_unit_of)
+            {
+                of.flush();
+                of.close();
+            }
 
             ::std::vector<const char*> link_dirs;
             auto add_link_dir = [&link_dirs](const char* d) {
@@ -439,12 +609,7 @@ namespace {
                 }
             }
 
-            // Execute $CC with the required libraries
-            StringList  args;
-            bool is_windows = false;
-            switch( m_compiler )
-            {
-            case Compiler::Gcc:
+            auto push_gcc_args = [&](StringList& args) {
                 if( getenv("CC") )
                     args.push_back( getenv("CC") );
                 else
@@ -465,9 +630,81 @@ namespace {
                 {
                     args.push_back("-g");
                 }
+                };
+
+            // Objects are reused from the cache when the same C source is compiled with the same options
+            // - Not when only emitting the build commands (they're run elsewhere)
+            // - The key includes the compiler versions, so a shared cache isn't stale after an upgrade
+            ObjectCache obj_cache( m_compiler == Compiler::Gcc && opt.build_command_file == "" ? opt.object_cache_dir : "", opt.object_cache_size );
+            ObjectCacheKey  base_cache_key;
+            if( obj_cache.is_enabled() )
+            {
+                StringList  args;
+                push_gcc_args(args);
+                args.push_back("-c");
+                base_cache_key.update( format_command(args, false) );
+                if( !base_cache_key.update_compiler_identity(args.get_vec()[0]) )
+                {
+                    ::std::cerr << "Warning: Unable to identify the C compiler, not using the object cache" << ::std::endl;
+                    obj_cache = ObjectCache("");
+                }
+            }
+
+            // Split codegen units are each compiled to an object (concurrently), then linked/combined below
+            ::std::vector< ::std::string>   unit_objects;
+            ::std::vector< ::std::string>   unit_commands;
+            ::std::vector< ::std::pair<size_t, ObjectCacheKey> >    unit_cache_misses;
+            if( obj_cache.is_enabled() && !m_unit_paths_c.empty() )
+            {
+                // Every unit includes the common header
+                if( !base_cache_key.update_file(m_outfile_path_c) )
+                    obj_cache = ObjectCache("");
+            }
+            for(const auto& unit_path : m_unit_paths_c)
+            {
+                unit_objects.push_back( unit_path.substr(0, unit_path.size() - 2) + ".o" );
+
+                if( obj_cache.is_enabled() )
+                {
+                    auto key = base_cache_key;
+                    if( key.update_file(unit_path) )
+                    {
+                        if( obj_cache.fetch(key, unit_objects.back()) )
+                        {
+                            ::std::cout << "Using cached object for " << unit_path << ::std::endl;
+                            continue ;
+                        }
+                        unit_cache_misses.push_back(::std::make_pair( unit_objects.size() - 1, mv$(key) ));
+                    }
+                }
+
+                StringList  args;
+                push_gcc_args(args);
+                args.push_back("-c");
+                args.push_back("-o");
+                args.push_back(unit_objects.back());
+                args.push_back(unit_path.c_str());
+                unit_commands.push_back( format_command(args, false) );
+            }
+
+            // Execute $CC with the required libraries
+            StringList  args;
+            bool is_windows = false;
+            switch( m_compiler )
+            {
+            case Compiler::Gcc:
+                push_gcc_args(args);
                 args.push_back("-o");
                 args.push_back(m_outfile_path.c_str());
-                args.push_back(m_outfile_path_c.c_str());
+                if( m_unit_paths_c.empty() )
+                {
+                    args.push_back(m_outfile_path_c.c_str());
+                }
+                else
+                {
+                    for(const auto& obj : unit_objects)
+                        args.push_back(obj.c_str());
+                }
                 if( is_executable )
                 {
                     for( const auto& crate : m_crate.m_ext_crates )
@@ -495,10 +732,16 @@ namespace {
                     }
                     args.push_back("-Wl,--gc-sections");
                 }
-                else
+                else if( m_unit_paths_c.empty() )
                 {
                     args.push_back("-c");
                 }
+                else
+                {
+                    // Combine the unit objects into the single object expected by downstream crates
+                    args.push_back("-r");
+                    args.push_back("-nostdlib");
+                }
                 break;
             case Compiler::Msvc:
                 is_windows = true;
@@ -561,35 +804,62 @@ namespace {
                 break;
             }
 
-            ::std::stringstream cmd_ss;
-            if (is_windows)
+            // A library built from a single C file is one object, so can also come from the cache
+            bool use_cached_output = false;
+            ObjectCacheKey  output_cache_key = base_cache_key;
+            bool store_output = obj_cache.is_enabled() && !is_executable && m_unit_paths_c.empty() && output_cache_key.update_file(m_outfile_path_c);
+            if( store_output && obj_cache.fetch(output_cache_key, m_outfile_path) )
             {
-                cmd_ss << "echo \"\" & ";
+                use_cached_output = true;
+                store_output = false;
             }
-            for(const auto& arg : args.get_vec())
+
+            auto cmd = format_command(args, is_windows);
+            //DEBUG("- " << cmd);
+            for(const auto& unit_cmd : unit_commands)
             {
-                if(strcmp(arg, "&") == 0 && is_windows) {
-                    cmd_ss << "&";
-                }
-                else {
-                    if( is_windows && strchr(arg, ' ') == nullptr ) {
-                        cmd_ss << arg << " ";
-                        continue ;
-                    }
-                    cmd_ss << "\"" << FmtShell(arg, is_windows) << "\" ";
-                }
+                ::std::cout << "Running comamnd - " << unit_cmd << ::std::endl;
+            }
+            if( !use_cached_output )
+            {
+                ::std::cout << "Running comamnd - " << cmd << ::std::endl;
             }
-            //DEBUG("- " << cmd_ss.str());
-            ::std::cout << "Running comamnd - " << cmd_ss.str() << ::std::endl;
             if( opt.build_command_file != "" )
             {
-                ::std::cerr << "INVOKE CC: " << cmd_ss.str() << ::std::endl;
-                ::std::ofstream(opt.build_command_file) << cmd_ss.str() << ::std::endl;
+                ::std::ofstream cmd_file(opt.build_command_file);
+                for(const auto& unit_cmd : unit_commands)
+                {
+                    ::std::cerr << "INVOKE CC: " << unit_cmd << ::std::endl;
+                    cmd_file << unit_cmd << ::std::endl;
+                }
+                ::std::cerr << "INVOKE CC: " << cmd << ::std::endl;
+                cmd_file << cmd << ::std::endl;
             }
-            else if( system(cmd_ss.str().c_str()) != 0 )
+            else
             {
-                ::std::cerr << "C Compiler failed to execute" << ::std::endl;
-                abort();
+                if( !run_commands_parallel(unit_commands) )
+                {
+                    ::std::cerr << "C Compiler failed to execute" << ::std::endl;
+                    abort();
+                }
+                for(const auto& e : unit_cache_misses)
+                {
+                    obj_cache.store(e.second, unit_objects[e.first]);
+                }
+                if( use_cached_output )
+                {
+                    ::std::cout << "Using cached object for " << m_outfile_path_c << ::std::endl;
+                }
+                else if( system(cmd.c_str()) != 0 )
+                {
+                    ::std::cerr << "C Compiler failed to execute" << ::std::endl;
+                    abort();
+                }
+                if( store_output )
+                {
+                    obj_cache.store(output_cache_key, m_outfile_path);
+                }
+                obj_cache.prune();
             }
         }
 
@@ -610,7 +880,8 @@ namespace {
             ::MIR::Function empty_fcn;
             ::MIR::TypeResolve  mir_res { sp, m_resolve, FMT_CB(ss, ss << drop_glue_path;), struct_ty_ptr, args, empty_fcn };
             m_mir_res = &mir_res;
-            m_of << "static void " << Trans_Mangle(drop_glue_path) << "(struct s_" << Trans_Mangle(p) << "* rv) {\n";
+            auto uo = begin_glue([&]{ m_of << "void " << Trans_Mangle(drop_glue_path) << "(struct s_" << Trans_Mangle(p) << "* rv)"; });
+            m_of << " {\n";
 
             // Obtain inner pointer
             // TODO: This is very specific to the structure of the official liballoc's Box.
@@ -735,7 +1006,8 @@ namespace {
                 auto ty_ptr = ::HIR::TypeRef::new_pointer(::HIR::BorrowType::Owned, ty.clone());
                 ::MIR::TypeResolve  mir_res { sp, m_resolve, FMT_CB(ss, ss << drop_glue_path;), ty_ptr, args, empty_fcn };
                 m_mir_res = &mir_res;
-                m_of << "static void " << Trans_Mangle(drop_glue_path) << "("; emit_ctype(ty); m_of << "* rv) {";
+                auto uo = begin_glue([&]{ m_of << "void " << Trans_Mangle(drop_glue_path) << "("; emit_ctype(ty); m_of << "* rv)"; });
+                m_of << " {";
                 auto self = ::MIR::LValue::make_Deref({ box$(::MIR::LValue::make_Return({})) });
                 auto fld_lv = ::MIR::LValue::make_Field({ box$(self), 0 });
                 for(const auto& ity : te)
@@ -803,6 +1075,27 @@ namespace {
                     emit_ctype( ty, inner );
                 }
                 };
+            auto struct_ty = ::HIR::TypeRef(p.clone(), &item);
+            // Field emit order, taken from the target repr (which can reorder fields to remove padding)
+            // - Only if the repr is known, otherwise declaration order is used
+            auto field_order = [&](size_t n) {
+                ::std::vector<unsigned int> rv;
+                const StructRepr* repr = nullptr;
+                if( !is_vtable && item.m_repr == ::HIR::Struct::Repr::Rust && m_resolve.type_is_sized(sp, struct_ty) )
+                    repr = Target_GetStructRepr(sp, m_resolve, struct_ty);
+                if( repr )
+                {
+                    for(const auto& ent : repr->ents)
+                        if( ent.field_idx != ~0u )
+                            rv.push_back(ent.field_idx);
+                }
+                else
+                {
+                    for(unsigned int i = 0; i < n; i ++)
+                        rv.push_back(i);
+                }
+                return rv;
+                };
             m_of << "// struct " << p << "\n";
             m_of << "struct s_" << Trans_Mangle(p) << " {\n";
 
@@ -829,7 +1122,7 @@ namespace {
                 }
                 else
                 {
-                    for(unsigned int i = 0; i < e.size(); i ++)
+                    for(unsigned int i : field_order(e.size()))
                     {
                         const auto& fld = e[i];
                         m_of << "\t";
@@ -848,7 +1141,7 @@ namespace {
                 }
                 else
                 {
-                    for(unsigned int i = 0; i < e.size(); i ++)
+                    for(unsigned int i : field_order(e.size()))
                     {
                         const auto& fld = e[i].second;
                         m_of << "\t";
@@ -860,7 +1153,6 @@ namespace {
             )
             m_of << "};\n";
 
-            auto struct_ty = ::HIR::TypeRef(p.clone(), &item);
             auto drop_glue_path = ::HIR::Path(struct_ty.clone(), "#drop_glue");
             auto struct_ty_ptr = ::HIR::TypeRef::new_borrow(::HIR::BorrowType::Owned, struct_ty.clone());
             // - Drop Glue
@@ -871,7 +1163,7 @@ namespace {
                 if( p.m_path.m_crate_name != m_crate.m_crate_name )
                 {
                     if( item.m_params.m_types.size() > 0 ) {
-                        m_of << "static ";
+                        emit_local_linkage();
                     }
                     else {
                         m_of << "extern ";
@@ -882,13 +1174,15 @@ namespace {
             else if( m_resolve.is_type_owned_box(struct_ty) )
             {
                 m_box_glue_todo.push_back( ::std::make_pair( mv$(struct_ty.m_data.as_Path().path.m_data.as_Generic()), &item ) );
-                m_of << "static void " << Trans_Mangle(drop_glue_path) << "("; emit_ctype(struct_ty_ptr, FMT_CB(ss, ss << "rv";)); m_of << ");\n";
+                emit_glue_linkage();
+                m_of << "void " << Trans_Mangle(drop_glue_path) << "("; emit_ctype(struct_ty_ptr, FMT_CB(ss, ss << "rv";)); m_of << ");\n";
                 return ;
             }
 
             ::MIR::TypeResolve  mir_res { sp, m_resolve, FMT_CB(ss, ss << drop_glue_path;), struct_ty_ptr, args, empty_fcn };
             m_mir_res = &mir_res;
-            m_of << "static void " << Trans_Mangle(drop_glue_path) << "("; emit_ctype(struct_ty_ptr, FMT_CB(ss, ss << "rv";)); m_of << ") {\n";
+            auto uo = begin_glue([&]{ m_of << "void " << Trans_Mangle(drop_glue_path) << "("; emit_ctype(struct_ty_ptr, FMT_CB(ss, ss << "rv";)); m_of << ")"; });
+            m_of << " {\n";
 
             // If this type has an impl of Drop, call that impl
             if( item.m_markings.has_drop_impl ) {
@@ -961,7 +1255,8 @@ namespace {
                 m_of << "tUNIT " << Trans_Mangle(drop_impl_path) << "(union u_" << Trans_Mangle(p) << "*rv);\n";
             }
 
-            m_of << "static void " << Trans_Mangle(drop_glue_path) << "(union u_" << Trans_Mangle(p) << "* rv) {\n";
+            auto uo = begin_glue([&]{ m_of << "void " << Trans_Mangle(drop_glue_path) << "(union u_" << Trans_Mangle(p) << "* rv)"; });
+            m_of << " {\n";
             if( item.m_markings.has_drop_impl )
             {
                 m_of << "\t" << Trans_Mangle(drop_impl_path) << "(rv);\n";
@@ -969,69 +1264,6 @@ namespace {
             m_of << "}\n";
         }
 
-        // TODO: Move this to codegen.cpp?
-        bool get_nonzero_path(const Span& sp, const ::HIR::TypeRef& ty, ::std::vector<unsigned int>& out) const
-        {
-            TU_MATCH_DEF( ::HIR::TypeRef::Data, (ty.m_data), (te),
-            (
-                return false;
-                ),
-            (Path,
-                if( te.binding.is_Struct() )
-                {
-                    const auto& str = *te.binding.as_Struct();
-                    const auto& p = te.path.m_data.as_Generic();
-                    ::HIR::TypeRef  tmp;
-                    auto monomorph = [&](const auto& ty)->const auto& {
-                        if( monomorphise_type_needed(ty) ) {
-                            tmp = monomorphise_type(sp, str.m_params, p.m_params, ty);
-                            m_resolve.expand_associated_types(sp, tmp);
-                            return tmp;
-                        }
-                        else {
-                            return ty;
-                        }
-                        };
-                    TU_MATCHA( (str.m_data), (se),
-                    (Unit,
-                        ),
-                    (Tuple,
-                        for(size_t i = 0; i < se.size(); i ++)
-                        {
-                            if( get_nonzero_path(sp, monomorph(se[i].ent), out) )
-                            {
-                                out.push_back(i);
-                                return true;
-                            }
-                        }
-                        ),
-                    (Named,
-                        for(size_t i = 0; i < se.size(); i ++)
-                        {
-                            if( get_nonzero_path(sp, monomorph(se[i].second.ent), out) )
-                            {
-                                out.push_back(i);
-                                return true;
-                            }
-                        }
-                        )
-                    )
-                }
-                return false;
-                ),
-            (Borrow,
-                if( metadata_type(*te.inner) != MetadataType::None )
-                {
-                    // HACK: If the inner is a DST, emit ~0 as a marker
-                    out.push_back(~0u);
-                }
-                return true;
-                ),
-            (Function,
-                return true;
-                )
-            )
-        }
         void emit_nonzero_path(const ::std::vector<unsigned int>& nonzero_path) {
             for(const auto v : nonzero_path)
             {
@@ -1044,6 +1276,33 @@ namespace {
                 }
             }
         }
+        /// Emit the niche field of a niche-filled enum value
+        void emit_enum_niche(const EnumRepr& repr, ::FmtLambda val) {
+            m_of << val << "._1"; emit_nonzero_path(repr.field_path);
+        }
+        /// Emit the niche value used for a dataless variant of a niche-filled enum
+        void emit_enum_niche_value(const EnumRepr& repr, unsigned int var_idx) {
+            if( repr.niche_start == 0 ) {
+                // Pointer/NonZero niche (can be a pointer, so no suffix)
+                m_of << "0";
+            }
+            else {
+                m_of << repr.niche_value(var_idx) << "u";
+            }
+        }
+        /// Emit a condition that is true when a niche-filled enum holds the data variant
+        void emit_enum_is_data_variant(const EnumRepr& repr, size_t num_variants, ::FmtLambda val) {
+            if( repr.niche_start == 0 )
+            {
+                // Pointer/NonZero niche, there's only one dataless variant
+                emit_enum_niche(repr, val); m_of << " != 0";
+            }
+            else
+            {
+                // Values below the niche wrap around to be larger than the niche count
+                m_of << "("; emit_enum_niche(repr, val); m_of << " - " << repr.niche_start << "u) >= " << (num_variants - 1) << "u";
+            }
+        }
 
         void emit_enum(const Span& sp, const ::HIR::GenericPath& p, const ::HIR::Enum& item) override
         {
@@ -1064,40 +1323,14 @@ namespace {
                 }
                 };
 
-            // TODO: Cache repr info elsewhere (and have core codegen be responsible instead)
-            // TODO: Do more complex nonzero relations.
-            ::std::vector<unsigned> nonzero_path;
-            {
-                // Detect Option (and similar enums)
-                // - Matches two-variant enums where the first variant is unit-like, and the second is not
-                if( item.m_data.is_Data() && item.m_data.as_Data().size() == 2
-                 && item.m_data.as_Data()[0].type == ::HIR::TypeRef::new_unit()
-                 && item.m_data.as_Data()[1].type != ::HIR::TypeRef::new_unit()
-                    )
-                {
-                    const auto& data_type = monomorph(item.m_data.as_Data()[1].type);
-                    if( get_nonzero_path(sp, data_type, nonzero_path) )
-                    {
-                        ::std::reverse( nonzero_path.begin(), nonzero_path.end() );
-                        DEBUG("Correct format for NonZero to apply, and field found at " << nonzero_path);
-                    }
-                    else
-                    {
-                        DEBUG("Correct format for NonZero to apply, but no field");
-                        assert(nonzero_path.size() == 0);
-                    }
-                }
-            }
+            auto enum_ty = ::HIR::TypeRef(p.clone(), &item);
+            const auto* repr = Target_GetEnumRepr(sp, m_resolve, enum_ty);
 
             m_of << "// enum " << p << "\n";
-            if( nonzero_path.size() > 0 )
+            if( repr )
             {
-                //MIR_ASSERT(*m_mir_res, item.num_variants() == 2, "");
-                //MIR_ASSERT(*m_mir_res, item.m_variants[0].second.is_Unit(), "");
-                //const auto& data_var = item.m_variants[1];
-                //MIR_ASSERT(*m_mir_res, data_var.second.is_Tuple(), "");
-                //MIR_ASSERT(*m_mir_res, data_var.second.as_Tuple().size() == 1, "");
-                const auto& data_type = monomorph(item.m_data.as_Data()[1].type);
+                // Niche-filled, only the data variant is stored
+                const auto& data_type = monomorph(item.m_data.as_Data()[repr->data_variant].type);
                 m_of << "struct e_" << Trans_Mangle(p) << " {\n";
                 m_of << "\t"; emit_ctype(data_type, FMT_CB(s, s << "_1";)); m_of << ";\n";
                 m_of << "};\n";
@@ -1151,10 +1384,9 @@ namespace {
             // ---
             // - Drop Glue
             // ---
-            auto struct_ty = ::HIR::TypeRef(p.clone(), &item);
-            auto drop_glue_path = ::HIR::Path(struct_ty.clone(), "#drop_glue");
-            auto struct_ty_ptr = ::HIR::TypeRef::new_borrow(::HIR::BorrowType::Owned, struct_ty.clone());
-            auto drop_impl_path = (item.m_markings.has_drop_impl ? ::HIR::Path(struct_ty.clone(), m_resolve.m_lang_Drop, "drop") : ::HIR::Path(::HIR::SimplePath()));
+            auto drop_glue_path = ::HIR::Path(enum_ty.clone(), "#drop_glue");
+            auto struct_ty_ptr = ::HIR::TypeRef::new_borrow(::HIR::BorrowType::Owned, enum_ty.clone());
+            auto drop_impl_path = (item.m_markings.has_drop_impl ? ::HIR::Path(enum_ty.clone(), m_resolve.m_lang_Drop, "drop") : ::HIR::Path(::HIR::SimplePath()));
             ::MIR::TypeResolve  mir_res { sp, m_resolve, FMT_CB(ss, ss << drop_glue_path;), struct_ty_ptr, {}, empty_fcn };
             m_mir_res = &mir_res;
 
@@ -1163,7 +1395,8 @@ namespace {
                 m_of << "tUNIT " << Trans_Mangle(drop_impl_path) << "(struct e_" << Trans_Mangle(p) << "*rv);\n";
             }
 
-            m_of << "static void " << Trans_Mangle(drop_glue_path) << "(struct e_" << Trans_Mangle(p) << "* rv) {\n";
+            auto uo = begin_glue([&]{ m_of << "void " << Trans_Mangle(drop_glue_path) << "(struct e_" << Trans_Mangle(p) << "* rv)"; });
+            m_of << " {\n";
 
             // If this type has an impl of Drop, call that impl
             if( item.m_markings.has_drop_impl )
@@ -1172,11 +1405,10 @@ namespace {
             }
             auto self = ::MIR::LValue::make_Deref({ box$(::MIR::LValue::make_Return({})) });
 
-            if( nonzero_path.size() > 0 )
+            if( repr )
             {
-                // TODO: Fat pointers?
-                m_of << "\tif( (*rv)._1"; emit_nonzero_path(nonzero_path); m_of << " ) {\n";
-                emit_destructor_call( ::MIR::LValue::make_Field({ box$(self), 1 }), monomorph(item.m_data.as_Data()[1].type), false, 2 );
+                m_of << "\tif( "; emit_enum_is_data_variant(*repr, item.num_variants(), FMT_CB(ss, ss << "(*rv)";)); m_of << " ) {\n";
+                emit_destructor_call( ::MIR::LValue::make_Field({ box$(self), 1 }), monomorph(item.m_data.as_Data()[repr->data_variant].type), false, 2 );
                 m_of << "\t}\n";
             }
             else if( const auto* e = item.m_data.opt_Data() )
@@ -1200,11 +1432,6 @@ namespace {
             }
             m_of << "}\n";
             m_mir_res = nullptr;
-
-            if( nonzero_path.size() )
-            {
-                m_enum_repr_cache.insert( ::std::make_pair( p.clone(), mv$(nonzero_path) ) );
-            }
         }
 
         void emit_constructor_enum(const Span& sp, const ::HIR::GenericPath& path, const ::HIR::Enum& item, size_t var_idx) override
@@ -1241,10 +1468,17 @@ namespace {
                 emit_ctype( monomorph(e[i].ent), FMT_CB(ss, ss << "_" << i;) );
             }
             m_of << ") {\n";
-            auto it = m_enum_repr_cache.find(p);
-            if( it != m_enum_repr_cache.end() )
+            if( Target_GetEnumRepr(sp, m_resolve, ::HIR::TypeRef(p.clone(), &item)) )
             {
-                m_of << "\tstruct e_" << Trans_Mangle(p) << " rv = { _0 };\n";
+                // Niche-filled, tuple variants with data are always the data variant
+                m_of << "\tstruct e_" << Trans_Mangle(p) << " rv = { ._1 = {";
+                for(unsigned int i = 0; i < e.size(); i ++)
+                {
+                    if(i != 0)
+                        m_of << ",";
+                    m_of << " ._" << i << " = _" << i;
+                }
+                m_of << " } };\n";
             }
             else
             {
@@ -1268,7 +1502,7 @@ namespace {
                     {
                         if(i != 0)
                         m_of << ",";
-                        m_of << "\n\t\t_" << i;
+                        m_of << "\n\t\t._" << i << " = _" << i;
                     }
                     m_of << "\n\t\t}";
                 }
@@ -1306,7 +1540,7 @@ namespace {
             {
                 if(i != 0)
                     m_of << ",";
-                m_of << "\n\t\t_" << i;
+                m_of << "\n\t\t._" << i << " = _" << i;
             }
             m_of << "\n\t\t};\n";
             m_of << "\treturn rv;\n";
@@ -1358,6 +1592,11 @@ namespace {
 
             TRACE_FUNCTION_F(p);
             auto type = params.monomorph(m_resolve, item.m_type);
+            if( m_codegen_units > 1 )
+            {
+                // Tentative definitions would be duplicated in each unit
+                m_of << "extern ";
+            }
             emit_ctype( type, FMT_CB(ss, ss << Trans_Mangle(p);) );
             m_of << ";";
             m_of << "\t// static " << p << " : " << type;
@@ -1373,6 +1612,8 @@ namespace {
 
             TRACE_FUNCTION_F(p);
 
+            // Definitions live in the first codegen unit
+            UnitOutput  uo(*this, 0);
             auto type = params.monomorph(m_resolve, item.m_type);
             emit_ctype( type, FMT_CB(ss, ss << Trans_Mangle(p);) );
             m_of << " = ";
@@ -1457,6 +1698,9 @@ namespace {
                 for(unsigned int i = 0; i < e.size(); i ++) {
                     if(i != 0)  m_of << ",";
                     m_of << " ";
+                    // Struct fields can be reordered, so use designated initialisers
+                    if( ty.m_data.is_Path() )
+                        m_of << "._" << i << " = ";
                     emit_literal(get_inner_type(0, i), e[i], params);
                 }
                 if( (ty.m_data.is_Path() || ty.m_data.is_Tuple()) && e.size() == 0 && m_options.disallow_empty_structs )
@@ -1469,14 +1713,15 @@ namespace {
                 MIR_ASSERT(*m_mir_res, ty.m_data.is_Path(), "");
                 MIR_ASSERT(*m_mir_res, ty.m_data.as_Path().binding.is_Enum(), "");
                 const auto& enm = *ty.m_data.as_Path().binding.as_Enum();
-                auto it = m_enum_repr_cache.find(ty.m_data.as_Path().path.m_data.as_Generic());
-                if( it != m_enum_repr_cache.end() )
+                if( const auto* repr = Target_GetEnumRepr(sp, m_resolve, ty) )
                 {
-                    if( e.idx == 0 ) {
-                        m_of << "{0}";
+                    if( e.idx != repr->data_variant ) {
+                        m_of << "{ "; emit_enum_niche(*repr, FMT_CB(ss, )); m_of << " = "; emit_enum_niche_value(*repr, e.idx); m_of << " }";
                     }
                     else {
+                        m_of << "{ ._1 = ";
                         emit_literal(get_inner_type(e.idx, 0), *e.val, params);
+                        m_of << " }";
                     }
                 }
                 else if( enm.is_value() )
@@ -1703,9 +1948,11 @@ namespace {
                     for(const auto& ty : te->m_arg_types)
                         arg_ty.m_data.as_Tuple().push_back( ty.clone() );
 
-                    m_of << "static ";
-                    emit_ctype(*te->m_rettype);
-                    m_of << " " << Trans_Mangle(fcn_p) << "("; emit_ctype(type, FMT_CB(ss, ss << "*ptr";)); m_of << ", "; emit_ctype(arg_ty, FMT_CB(ss, ss << "args";)); m_of << ") {\n";
+                    auto uo = begin_glue([&]{
+                        emit_ctype(*te->m_rettype);
+                        m_of << " " << Trans_Mangle(fcn_p) << "("; emit_ctype(type, FMT_CB(ss, ss << "*ptr";)); m_of << ", "; emit_ctype(arg_ty, FMT_CB(ss, ss << "args";)); m_of << ")";
+                        });
+                    m_of << " {\n";
                     m_of << "\treturn (*ptr)(";
                         for(unsigned int i = 0; i < te->m_arg_types.size(); i++)
                         {
@@ -1719,7 +1966,7 @@ namespace {
 
             {
                 auto vtable_sp = trait_path.m_path;
-                vtable_sp.m_components.back() += "#vtable";
+                vtable_sp.m_components.back() = vtable_sp.m_components.back() + "#vtable";
                 auto vtable_params = trait_path.m_params.clone();
                 for(const auto& ty : trait.m_type_indexes) {
                     auto aty = ::HIR::TypeRef( ::HIR::Path( type.clone(), trait_path.clone(), ty.first ) );
@@ -1841,7 +2088,7 @@ namespace {
             }
             if( is_extern_def )
             {
-                m_of << "static ";
+                emit_local_linkage();
             }
             emit_function_header(p, item, params);
             m_of << ";\n";
@@ -1862,9 +2109,10 @@ namespace {
             ::MIR::TypeResolve  mir_res { sp, m_resolve, FMT_CB(ss, ss << p;), ret_type, arg_types, *code };
             m_mir_res = &mir_res;
 
+            UnitOutput  uo(*this, m_cur_unit);
             m_of << "// " << p << "\n";
             if( is_extern_def ) {
-                m_of << "static ";
+                emit_local_linkage();
             }
             emit_function_header(p, item, params);
             m_of << "\n";
@@ -2533,21 +2781,17 @@ namespace {
                         ::HIR::TypeRef  tmp;
                         const auto& ty = mir_res.get_lvalue_type(tmp, e.dst);
 
-                        auto it = m_enum_repr_cache.find(ty.m_data.as_Path().path.m_data.as_Generic());
-                        if( it != m_enum_repr_cache.end() )
+                        if( const auto* repr = Target_GetEnumRepr(sp, m_resolve, ty) )
                         {
-                            if( ve.index == 0 ) {
-                                // TODO: Use nonzero_path
-                                m_of << "memset(&"; emit_lvalue(e.dst); m_of << ", 0, sizeof("; emit_ctype(ty); m_of << "))";
-                            }
-                            else if( ve.index == 1 ) {
+                            if( ve.index == repr->data_variant ) {
                                 emit_lvalue(e.dst);
                                 m_of << "._1 = ";
                                 emit_param(ve.val);
                             }
                             else {
+                                emit_enum_niche(*repr, FMT_CB(ss, emit_lvalue(e.dst);));
+                                m_of << " = "; emit_enum_niche_value(*repr, ve.index);
                             }
-                            break;
                         }
                         else if( enm_p->is_value() )
                         {
@@ -2766,19 +3010,36 @@ namespace {
             MIR_ASSERT(mir_res, ty.m_data.as_Path().binding.is_Enum(), "Switch over non-enum");
             const auto* enm = ty.m_data.as_Path().binding.as_Enum();
 
-            auto it = m_enum_repr_cache.find( ty.m_data.as_Path().path.m_data.as_Generic() );
-            if( it != m_enum_repr_cache.end() )
+            if( const auto* repr = Target_GetEnumRepr(mir_res.sp, m_resolve, ty) )
             {
-                //MIR_ASSERT(mir_res, e.targets.size() == 2, "NonZero optimised representation for an enum without two variants");
-                MIR_ASSERT(mir_res, n_arms == 2, "NonZero optimised switch without two arms");
-                m_of << indent << "if("; emit_lvalue(val); m_of << "._1"; emit_nonzero_path(it->second); m_of << ")\n";
-                m_of << indent;
-                cb(1);
-                m_of << "\n";
-                m_of << indent << "else\n";
-                m_of << indent;
-                cb(0);
-                m_of << "\n";
+                MIR_ASSERT(mir_res, n_arms == enm->num_variants(), "Niche-filled enum switch with " << n_arms << " arms, expected " << enm->num_variants());
+                if( n_arms == 2 )
+                {
+                    m_of << indent << "if("; emit_enum_is_data_variant(*repr, n_arms, FMT_CB(ss, emit_lvalue(val);)); m_of << ")\n";
+                    m_of << indent;
+                    cb(repr->data_variant);
+                    m_of << "\n";
+                    m_of << indent << "else\n";
+                    m_of << indent;
+                    cb(1 - repr->data_variant);
+                    m_of << "\n";
+                }
+                else
+                {
+                    m_of << indent << "switch("; emit_enum_niche(*repr, FMT_CB(ss, emit_lvalue(val);)); m_of << ") {\n";
+                    for(size_t j = 0; j < n_arms; j ++)
+                    {
+                        if( j == repr->data_variant )
+                            continue ;
+                        m_of << indent << "case "; emit_enum_niche_value(*repr, j); m_of << ": ";
+                        cb(j);
+                        m_of << "\n";
+                    }
+                    m_of << indent << "default: ";
+                    cb(repr->data_variant);
+                    m_of << "\n";
+                    m_of << indent << "}\n";
+                }
             }
             else if( enm->is_value() )
             {
@@ -3544,10 +3805,20 @@ namespace {
                 const auto& ty = params.m_types.at(0);
                 emit_lvalue(e.ret_val); m_of << " = ";
                 if( ty.m_data.is_Path() && ty.m_data.as_Path().binding.is_Enum() ) {
-                    auto it = m_enum_repr_cache.find( ty.m_data.as_Path().path.m_data.as_Generic() );
-                    if( it != m_enum_repr_cache.end() )
+                    if( const auto* repr = Target_GetEnumRepr(mir_res.sp, m_resolve, ty) )
                     {
-                        emit_param(e.args.at(0)); m_of << "->_1"; emit_nonzero_path(it->second); m_of << " != 0";
+                        auto n_vars = ty.m_data.as_Path().binding.as_Enum()->num_variants();
+                        auto val = FMT_CB(ss, ss << "(*"; emit_param(e.args.at(0)); ss << ")";);
+                        m_of << "("; emit_enum_is_data_variant(*repr, n_vars, val); m_of << " ? " << repr->data_variant << " : ";
+                        if( repr->niche_start == 0 ) {
+                            m_of << 1 - repr->data_variant;
+                        }
+                        else {
+                            // Niche values are the variant indexes (skipping the data variant) offset by `niche_start`
+                            m_of << "("; emit_enum_niche(*repr, val); m_of << " - " << repr->niche_start << "u)";
+                            m_of << " + ("; emit_enum_niche(*repr, val); m_of << " - " << repr->niche_start << "u >= " << repr->data_variant << "u)";
+                        }
+                        m_of << ")";
                     }
                     else
                     {
@@ -4056,6 +4327,9 @@ namespace {
             if( const auto* e = v.opt_Constant() )
             {
                 ty = params.monomorph(m_mir_res->sp, (*e)->m_type);
+                // Constants from generic impls are only evaluated once used with concrete parameters
+                if( (*e)->m_value_res.is_Invalid() )
+                    return ConvertHIR_ConstantEvaluateFull_Monomorph(m_crate, m_mir_res->sp, path);
                 return (*e)->m_value_res;
             }
             else
@@ -4143,15 +4417,14 @@ namespace {
                 MIR_ASSERT(*m_mir_res, ty.m_data.is_Path(), "");
                 MIR_ASSERT(*m_mir_res, ty.m_data.as_Path().binding.is_Enum(), "");
                 const auto& enm = *ty.m_data.as_Path().binding.as_Enum();
-                auto it = m_enum_repr_cache.find(ty.m_data.as_Path().path.m_data.as_Generic());
-                if( it != m_enum_repr_cache.end() )
+                if( const auto* repr = Target_GetEnumRepr(sp, m_resolve, ty) )
                 {
-                    if( e.idx == 0 ) {
-                        emit_nonzero_path(it->second);
-                        m_of << " = 0";
+                    if( e.idx != repr->data_variant ) {
+                        emit_enum_niche(*repr, FMT_CB(ss, emit_dst();));
+                        m_of << " = "; emit_enum_niche_value(*repr, e.idx);
                     }
                     else {
-                        assign_from_literal([&](){ emit_dst(); }, get_inner_type(e.idx, 0), *e.val);
+                        assign_from_literal([&](){ emit_dst(); m_of << "._1"; }, get_inner_type(e.idx, 0), *e.val);
                     }
                 }
                 else if( enm.is_value() )
@@ -4326,10 +4599,9 @@ namespace {
                 MIR_ASSERT(*m_mir_res, ty.m_data.is_Path(), "Downcast on non-Path type - " << ty);
                 if( ty.m_data.as_Path().binding.is_Enum() )
                 {
-                    auto it = m_enum_repr_cache.find(ty.m_data.as_Path().path.m_data.as_Generic());
-                    if( it != m_enum_repr_cache.end() )
+                    if( const auto* repr = Target_GetEnumRepr(m_mir_res->sp, m_resolve, ty) )
                     {
-                        MIR_ASSERT(*m_mir_res, e.variant_index == 1, "");
+                        MIR_ASSERT(*m_mir_res, e.variant_index == repr->data_variant, "Downcast of niche-filled enum to dataless variant " << e.variant_index);
                         // NOTE: Downcast returns a magic tuple
                         m_of << "._1";
                         break ;
@@ -4735,7 +5007,7 @@ namespace {
     Span CodeGenerator_C::sp;
 }
 
-::std::unique_ptr<CodeGenerator> Trans_Codegen_GetGeneratorC(const ::HIR::Crate& crate, const ::std::string& outfile)
+::std::unique_ptr<CodeGenerator> Trans_Codegen_GetGeneratorC(const ::HIR::Crate& crate, const ::std::string& outfile, const TransOptions& opt)
 {
-    return ::std::unique_ptr<CodeGenerator>(new CodeGenerator_C(crate, outfile));
+    return ::std::unique_ptr<CodeGenerator>(new CodeGenerator_C(crate, outfile, opt));
 }
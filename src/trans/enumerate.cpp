@@ -18,27 +18,51 @@
 #include <algorithm>
 
 namespace {
+    /// Check if every crate using this function would emit its own copy of it (a monomorphised generic, or a body
+    /// from another crate)
+    bool is_shareable_instance(const ::HIR::Function& fcn, const Trans_Params& pp)
+    {
+        return fcn.m_code.m_mir && (pp.has_types() || !fcn.m_code);
+    }
+
     struct EnumState
     {
         const ::HIR::Crate& crate;
         TransList   rv;
+        // Use instances provided by loaded crates instead of emitting them again (`-Z share-generics`)
+        bool    share_generics;
 
         // Queue of items to enumerate
         ::std::deque<TransList_Function*>  fcn_queue;
         ::std::vector<TransList_Function*> fcns_to_type_visit;
 
-        EnumState(const ::HIR::Crate& crate):
-            crate(crate)
+        EnumState(const ::HIR::Crate& crate, const TransOptions& opt):
+            crate(crate),
+            share_generics(opt.share_generics)
         {}
 
+        bool is_upstream_instance(const ::HIR::Path& p) const
+        {
+            for(const auto& ec : crate.m_ext_crates)
+            {
+                if( ec.second.m_data->m_shared_instances.count(p) )
+                    return true;
+            }
+            return false;
+        }
+
         void enum_fcn(::HIR::Path p, const ::HIR::Function& fcn, Trans_Params pp)
         {
+            bool is_upstream = share_generics && is_shareable_instance(fcn, pp) && is_upstream_instance(p);
             if(auto* e = rv.add_function(mv$(p)))
             {
                 fcns_to_type_visit.push_back(e);
                 e->ptr = &fcn;
                 e->pp = mv$(pp);
-                fcn_queue.push_back(e);
+                e->is_upstream = is_upstream;
+                // The body of an upstream instance is already in that crate's object, so doesn't need enumerating
+                if( !is_upstream )
+                    fcn_queue.push_back(e);
             }
         }
     };
@@ -54,11 +78,11 @@ void Trans_Enumerate_FillFrom_Literal(EnumState& state, const ::HIR::Literal& li
 void Trans_Enumerate_FillFrom_MIR(EnumState& state, const ::MIR::Function& code, const Trans_Params& pp);
 
 /// Enumerate trans items starting from `::main` (binary crate)
-TransList Trans_Enumerate_Main(const ::HIR::Crate& crate)
+TransList Trans_Enumerate_Main(const ::HIR::Crate& crate, const TransOptions& opt)
 {
     static Span sp;
 
-    EnumState   state { crate };
+    EnumState   state { crate, opt };
 
     auto c_start_path = crate.get_lang_item_path_opt("mrustc-start");
     if( c_start_path == ::HIR::SimplePath() )
@@ -151,10 +175,10 @@ namespace {
 }
 
 /// Enumerate trans items for all public non-generic items (library crate)
-TransList Trans_Enumerate_Public(::HIR::Crate& crate)
+TransList Trans_Enumerate_Public(::HIR::Crate& crate, const TransOptions& opt)
 {
     static Span sp;
-    EnumState   state { crate };
+    EnumState   state { crate, opt };
 
     Trans_Enumerate_Public_Mod(state, crate.m_root_module,  ::HIR::SimplePath(crate.m_crate_name,{}), true);
 
@@ -318,6 +342,19 @@ TransList Trans_Enumerate_Public(::HIR::Crate& crate)
             ++ it;
         }
     }
+
+    // Record the instances this crate's object will provide, so downstream crates can link to them
+    if( opt.share_generics )
+    {
+        for(const auto& ent : rv.m_functions)
+        {
+            if( !ent.second->is_upstream && is_shareable_instance(*ent.second->ptr, ent.second->pp) )
+            {
+                crate.m_shared_instances.insert( ent.first.clone() );
+            }
+        }
+        DEBUG(crate.m_shared_instances.size() << " shared instances");
+    }
     return rv;
 }
 
@@ -523,7 +560,7 @@ namespace {
 
                     ASSERT_BUG(Span(), ! te.m_trait.m_path.m_path.m_components.empty(), "TODO: Data trait is empty, what can be done?");
                     auto vtable_ty_spath = te.m_trait.m_path.m_path;
-                    vtable_ty_spath.m_components.back() += "#vtable";
+                    vtable_ty_spath.m_components.back() = vtable_ty_spath.m_components.back() + "#vtable";
                     const auto& vtable_ref = m_crate.get_struct_by_path(sp, vtable_ty_spath);
                     // Copy the param set from the trait in the trait object
                     ::HIR::PathParams   vtable_params = te.m_trait.m_path.m_params.clone();
@@ -626,7 +663,8 @@ void Trans_Enumerate_Types(EnumState& state)
             for(const auto& arg : fcn.m_args)
                 tv.visit_type( monomorph(arg.second) );
 
-            if( fcn.m_code.m_mir )
+            // NOTE: Upstream instances only need the types used in the signature
+            if( fcn.m_code.m_mir && !p->is_upstream )
             {
                 const auto& mir = *fcn.m_code.m_mir;
                 for(const auto& ty : mir.locals)
@@ -964,7 +1002,7 @@ void Trans_Enumerate_Types(EnumState& state)
             const auto& trait = state.crate.get_trait_by_path(sp, gpath.m_path);
 
             auto vtable_ty_spath = gpath.m_path;
-            vtable_ty_spath.m_components.back() += "#vtable";
+            vtable_ty_spath.m_components.back() = vtable_ty_spath.m_components.back() + "#vtable";
             const auto& vtable_ref = state.crate.get_struct_by_path(sp, vtable_ty_spath);
             // Copy the param set from the trait in the trait object
             ::HIR::PathParams   vtable_params = gpath.m_params.clone();
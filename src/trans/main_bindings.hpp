@@ -18,14 +18,24 @@ struct TransOptions
     unsigned int opt_level = 0;
     bool emit_debug_info = false;
     ::std::string   build_command_file;
+    /// Number of C translation units to split function bodies across (compiled concurrently)
+    unsigned int codegen_units = 1;
+    /// Number of worker threads used to monomorphise/optimise functions
+    unsigned int num_jobs = 1;
+    /// Export monomorphised functions for use by downstream crates, and use those exported by loaded crates
+    bool share_generics = false;
+    /// Directory of previously compiled C objects to reuse (empty to disable)
+    ::std::string   object_cache_dir;
+    /// Size limit of the object cache (in bytes)
+    uint64_t    object_cache_size = 1024ull*1024*1024;
 
     ::std::vector< ::std::string>   library_search_dirs;
     ::std::vector< ::std::string>   libraries;
 };
 
-extern TransList Trans_Enumerate_Main(const ::HIR::Crate& crate);
+extern TransList Trans_Enumerate_Main(const ::HIR::Crate& crate, const TransOptions& opt);
 extern TransList Trans_Enumerate_Test(const ::HIR::Crate& crate);
-// NOTE: This also sets the saveout flags
-extern TransList Trans_Enumerate_Public(::HIR::Crate& crate);
+// NOTE: This also sets the saveout flags (and records the shared instances)
+extern TransList Trans_Enumerate_Public(::HIR::Crate& crate, const TransOptions& opt);
 
 extern void Trans_Codegen(const ::std::string& outfile, const TransOptions& opt, const ::HIR::Crate& crate, const TransList& list, bool is_executable);
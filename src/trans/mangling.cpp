@@ -21,7 +21,8 @@
 #include <hir/path.hpp>
 
 namespace {
-    ::std::string   escape_str(const ::std::string& s) {
+    template<typename S>
+    ::std::string   escape_str(const S& s) {
         ::std::string   output;
         output.reserve(s.size() + 1);
         for(auto v : s)
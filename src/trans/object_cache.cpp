@@ -0,0 +1,232 @@
+/*
+ * MRustC - Rust Compiler
+ * - By John Hodge (Mutabah/thePowersGang)
+ *
+ * trans/object_cache.cpp
+ * - On-disk cache of compiled C objects, keyed by a hash of their inputs
+ */
+#include "object_cache.hpp"
+#include <debug.hpp>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+#include <algorithm>
+#include <sys/stat.h>
+#ifdef _WIN32
+# include <direct.h>
+# include <sys/utime.h>
+# include <Windows.h>
+# define popen _popen
+# define pclose _pclose
+#else
+# include <dirent.h>
+# include <utime.h>
+#endif
+
+ObjectCacheKey::ObjectCacheKey():
+    m_h1(0xcbf29ce484222325ull),
+    m_h2(0x6a09e667f3bcc909ull),
+    m_len(0)
+{
+}
+void ObjectCacheKey::update(const char* data, size_t len)
+{
+    // Two independent 64-bit hashes (FNV-1a, and a multiply/xor-shift mix) to keep accidental collisions out of reach
+    uint64_t    h1 = m_h1;
+    uint64_t    h2 = m_h2;
+    for(size_t i = 0; i < len; i ++)
+    {
+        uint8_t c = static_cast<uint8_t>(data[i]);
+        h1 = (h1 ^ c) * 0x100000001b3ull;
+        h2 = (h2 + c) * 0xff51afd7ed558ccdull;
+        h2 ^= h2 >> 29;
+    }
+    m_h1 = h1;
+    m_h2 = h2;
+    m_len += len;
+}
+bool ObjectCacheKey::update_file(const ::std::string& path)
+{
+    ::std::ifstream is(path, ::std::ios::binary);
+    if( !is.is_open() )
+        return false;
+    char    buf[64*1024];
+    while( is )
+    {
+        is.read(buf, sizeof(buf));
+        this->update(buf, static_cast<size_t>(is.gcount()));
+    }
+    return !is.bad();
+}
+bool ObjectCacheKey::update_compiler_identity(const ::std::string& cc)
+{
+    // This executable: size and modification time are enough to notice an upgrade/rebuild
+    ::std::string   self_path;
+#ifdef _WIN32
+    char    buf[MAX_PATH];
+    DWORD   len = GetModuleFileNameA(NULL, buf, sizeof(buf));
+    if( len > 0 && len < sizeof(buf) )
+        self_path = ::std::string(buf, len);
+#else
+    self_path = "/proc/self/exe";
+#endif
+    struct stat st;
+    if( self_path == "" || stat(self_path.c_str(), &st) != 0 )
+        return false;
+    this->update(::std::to_string(st.st_size));
+    this->update(::std::to_string(st.st_mtime));
+
+    // The C compiler: its version banner
+    auto* fp = popen((cc + " --version").c_str(), "r");
+    if( !fp )
+        return false;
+    char    line[256];
+    size_t  n;
+    while( (n = fread(line, 1, sizeof(line), fp)) > 0 )
+    {
+        this->update(line, n);
+    }
+    return pclose(fp) == 0;
+}
+::std::string ObjectCacheKey::to_string() const
+{
+    ::std::stringstream ss;
+    ss << ::std::hex << ::std::setfill('0')
+        << ::std::setw(16) << m_h1
+        << ::std::setw(16) << m_h2
+        << "-" << m_len;
+    return ss.str();
+}
+
+namespace {
+    bool copy_file(const ::std::string& src, const ::std::string& dst)
+    {
+        ::std::ifstream is(src, ::std::ios::binary);
+        if( !is.is_open() )
+            return false;
+        ::std::ofstream os(dst, ::std::ios::binary);
+        if( !os.is_open() )
+            return false;
+        os << is.rdbuf();
+        return static_cast<bool>(os);
+    }
+
+    struct CacheEntry {
+        ::std::string   path;
+        uint64_t    size;
+        time_t  mtime;
+    };
+    /// List the objects in the cache directory
+    ::std::vector<CacheEntry> list_objects(const ::std::string& dir)
+    {
+        ::std::vector<CacheEntry>   rv;
+        auto add = [&](const char* name) {
+            size_t len = strlen(name);
+            if( len < 3 || strcmp(name + len - 2, ".o") != 0 )
+                return ;
+            auto path = dir + "/" + name;
+            struct stat st;
+            if( stat(path.c_str(), &st) == 0 )
+                rv.push_back(CacheEntry { path, static_cast<uint64_t>(st.st_size), st.st_mtime });
+            };
+#ifdef _WIN32
+        WIN32_FIND_DATA find_data;
+        HANDLE find_handle = FindFirstFile( (dir + "/*").c_str(), &find_data );
+        if( find_handle == INVALID_HANDLE_VALUE )
+            return rv;
+        do
+        {
+            add(find_data.cFileName);
+        } while( FindNextFile(find_handle, &find_data) );
+        FindClose(find_handle);
+#else
+        auto* dp = opendir(dir.c_str());
+        if( !dp )
+            return rv;
+        struct dirent* ent;
+        while( (ent = readdir(dp)) != nullptr )
+        {
+            add(ent->d_name);
+        }
+        closedir(dp);
+#endif
+        return rv;
+    }
+}
+
+ObjectCache::ObjectCache(::std::string dir, uint64_t max_size):
+    m_dir(::std::move(dir)),
+    m_max_size(max_size)
+{
+    if( m_dir != "" )
+    {
+        // Only creates the last component, an error here shows up as every lookup missing
+#ifdef _WIN32
+        _mkdir(m_dir.c_str());
+#else
+        mkdir(m_dir.c_str(), 0777);
+#endif
+    }
+}
+
+bool ObjectCache::fetch(const ObjectCacheKey& key, const ::std::string& out_path) const
+{
+    if( !this->is_enabled() )
+        return false;
+    auto cache_path = m_dir + "/" + key.to_string() + ".o";
+    if( !::std::ifstream(cache_path).is_open() )
+        return false;
+    if( !copy_file(cache_path, out_path) )
+    {
+        ::std::remove(out_path.c_str());
+        return false;
+    }
+    // Mark as recently used (for `prune`)
+    utime(cache_path.c_str(), nullptr);
+    DEBUG("Hit " << cache_path << " for " << out_path);
+    return true;
+}
+void ObjectCache::store(const ObjectCacheKey& key, const ::std::string& obj_path) const
+{
+    if( !this->is_enabled() )
+        return ;
+    auto cache_path = m_dir + "/" + key.to_string() + ".o";
+    // Copy to a temporary then rename, so other compiler instances sharing the cache never see a partial object
+    auto tmp_path = cache_path + ".tmp" + ::std::to_string(::std::chrono::steady_clock::now().time_since_epoch().count());
+    if( copy_file(obj_path, tmp_path) && ::std::rename(tmp_path.c_str(), cache_path.c_str()) == 0 )
+    {
+        DEBUG("Stored " << obj_path << " as " << cache_path);
+    }
+    else
+    {
+        ::std::remove(tmp_path.c_str());
+    }
+}
+void ObjectCache::prune() const
+{
+    if( !this->is_enabled() )
+        return ;
+    auto entries = list_objects(m_dir);
+    uint64_t    total = 0;
+    for(const auto& e : entries)
+        total += e.size;
+    if( total <= m_max_size )
+        return ;
+
+    // Oldest first (fetches refresh the modification time), stop once back under the limit
+    ::std::sort(entries.begin(), entries.end(), [](const CacheEntry& a, const CacheEntry& b){ return a.mtime < b.mtime; });
+    for(const auto& e : entries)
+    {
+        if( total <= m_max_size )
+            break;
+        if( ::std::remove(e.path.c_str()) == 0 )
+        {
+            DEBUG("Evicted " << e.path);
+            total -= e.size;
+        }
+    }
+}
@@ -0,0 +1,59 @@
+/*
+ * MRustC - Rust Compiler
+ * - By John Hodge (Mutabah/thePowersGang)
+ *
+ * trans/object_cache.hpp
+ * - On-disk cache of compiled C objects, keyed by a hash of their inputs
+ */
+#pragma once
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+/// Hash of everything that affects a C compiler's output (command line and source text)
+class ObjectCacheKey
+{
+    uint64_t    m_h1;
+    uint64_t    m_h2;
+    uint64_t    m_len;
+public:
+    ObjectCacheKey();
+
+    void update(const char* data, size_t len);
+    void update(const ::std::string& s) {
+        // Include the length, so adjacent strings can't be re-split to give the same key
+        uint64_t    len = s.size();
+        this->update(reinterpret_cast<const char*>(&len), sizeof(len));
+        this->update(s.data(), s.size());
+    }
+    /// Hash the contents of a file, returns false if it couldn't be read
+    bool update_file(const ::std::string& path);
+    /// Hash the identity of the tools that produce an object: this compiler's executable, and the C compiler's
+    /// `--version` output. Returns false if the C compiler couldn't be queried.
+    bool update_compiler_identity(const ::std::string& cc);
+
+    ::std::string to_string() const;
+};
+
+/// Directory of objects named by the key of the compile that produced them (`-C object-cache=<dir>`)
+/// - Limited to `max_size` bytes (`-C object-cache-size=<MiB>`), least recently used objects are removed first.
+class ObjectCache
+{
+    ::std::string   m_dir;
+    uint64_t    m_max_size;
+public:
+    /// An empty path disables the cache
+    ObjectCache(::std::string dir, uint64_t max_size=DEFAULT_MAX_SIZE);
+
+    static const uint64_t DEFAULT_MAX_SIZE = 1024ull*1024*1024;
+
+    bool is_enabled() const { return m_dir != ""; }
+
+    /// Copy the cached object for `key` to `out_path`, returns false on a miss
+    bool fetch(const ObjectCacheKey& key, const ::std::string& out_path) const;
+    /// Add a freshly compiled object to the cache
+    /// - Failures are ignored (the cache is only an optimisation)
+    void store(const ObjectCacheKey& key, const ::std::string& obj_path) const;
+    /// Remove the least recently used objects until the cache is within its size limit
+    void prune() const;
+};
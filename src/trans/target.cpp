@@ -10,6 +10,7 @@
 #include "../expand/cfg.hpp"
 #include <fstream>
 #include <map>
+#include <sharded_cache.hpp>
 #include <hir/hir.hpp>
 #include <hir_typeck/helpers.hpp>
 
@@ -185,7 +186,8 @@ namespace {
                 // No sorting, no packing
                 break;
             case ::HIR::Struct::Repr::Rust:
-                allow_sort = true;
+                // NOTE: If the last field could be unsized, the fields can't move (as unsizing can't change the layout)
+                allow_sort = ::std::none_of(str.m_params.m_types.begin(), str.m_params.m_types.end(), [](const auto& p){ return !p.m_is_sized; });
                 break;
             }
         }
@@ -208,8 +210,9 @@ namespace {
 
         if( allow_sort )
         {
-            // TODO: Sort by alignment then size (largest first)
-            // - Requires codegen to use this information
+            // Sort by alignment (largest first), which removes all padding between fields
+            // - Stable, so fields with the same alignment stay in declaration order
+            ::std::stable_sort(ents.begin(), ents.end(), [](const auto& a, const auto& b){ return a.align > b.align; });
         }
 
         StructRepr  rv;
@@ -244,21 +247,149 @@ namespace {
 }
 const StructRepr* Target_GetStructRepr(const Span& sp, const StaticTraitResolve& resolve, const ::HIR::TypeRef& ty)
 {
-    // TODO: Thread safety
-    // Map of generic paths to struct representations.
-    static ::std::map<::HIR::TypeRef, ::std::unique_ptr<StructRepr>>  s_cache;
+    static ShardedCache<::HIR::TypeRef, ::std::unique_ptr<StructRepr>>  s_cache;
 
-    auto it = s_cache.find(ty);
-    if( it != s_cache.end() )
+    if( const auto* repr = s_cache.find(ty) )
     {
-        return it->second.get();
+        return repr->get();
     }
 
-    auto ires = s_cache.insert(::std::make_pair( ty.clone(), make_struct_repr(sp, resolve, ty) ));
-    return ires.first->second.get();
+    // NOTE: Generated outside of the cache lock, as this can recurse (and another thread may race to insert the same type)
+    return s_cache.insert( ty.clone(), make_struct_repr(sp, resolve, ty) ).get();
 }
 
-// TODO: Include NonZero and other repr optimisations here
+namespace {
+    /// Find a field within `ty` that has at least `count` invalid values (a niche)
+    /// - `out_path` is filled in reverse order (innermost field first)
+    bool find_niche(const Span& sp, const StaticTraitResolve& resolve, const ::HIR::TypeRef& ty, uint64_t count, ::std::vector<unsigned int>& out_path, uint64_t& out_start)
+    {
+        TU_MATCH_DEF( ::HIR::TypeRef::Data, (ty.m_data), (te),
+        (
+            return false;
+            ),
+        (Primitive,
+            // NOTE: `bool` isn't used, a C `bool` can't hold any other values
+            if( te == ::HIR::CoreType::Char && count <= UINT32_MAX - 0x110000 + 1 )
+            {
+                out_start = 0x110000;
+                return true;
+            }
+            return false;
+            ),
+        (Path,
+            if( !te.binding.is_Struct() )
+                return false;
+            const auto& str = *te.binding.as_Struct();
+            const auto& params = te.path.m_data.as_Generic().m_params;
+            auto monomorph = [&](const auto& tpl) {
+                auto rv = monomorphise_type_with(sp, tpl, monomorphise_type_get_cb(sp, nullptr, &params, nullptr));
+                resolve.expand_associated_types(sp, rv);
+                return rv;
+                };
+            // `NonZero<T>` - The inner value (an integer or raw pointer) is never zero
+            if( te.path.m_data.as_Generic().m_path == resolve.m_crate.get_lang_item_path_opt("non_zero") )
+            {
+                ASSERT_BUG(sp, str.m_data.is_Tuple() && str.m_data.as_Tuple().size() == 1, "NonZero should be a single-field tuple struct");
+                if( count > 1 )
+                    return false;
+                auto inner = monomorph(str.m_data.as_Tuple()[0].ent);
+                if( inner.m_data.is_Pointer() && !resolve.type_is_sized(sp, *inner.m_data.as_Pointer().inner) )
+                    out_path.push_back(~0u);
+                out_path.push_back(0);
+                out_start = 0;
+                return true;
+            }
+            TU_MATCHA( (str.m_data), (se),
+            (Unit,
+                ),
+            (Tuple,
+                for(size_t i = 0; i < se.size(); i ++)
+                {
+                    if( find_niche(sp, resolve, monomorph(se[i].ent), count, out_path, out_start) )
+                    {
+                        out_path.push_back(i);
+                        return true;
+                    }
+                }
+                ),
+            (Named,
+                for(size_t i = 0; i < se.size(); i ++)
+                {
+                    if( find_niche(sp, resolve, monomorph(se[i].second.ent), count, out_path, out_start) )
+                    {
+                        out_path.push_back(i);
+                        return true;
+                    }
+                }
+                )
+            )
+            return false;
+            ),
+        (Borrow,
+            if( count > 1 )
+                return false;
+            if( !resolve.type_is_sized(sp, *te.inner) )
+                out_path.push_back(~0u);
+            out_start = 0;
+            return true;
+            ),
+        (Function,
+            if( count > 1 )
+                return false;
+            out_start = 0;
+            return true;
+            )
+        )
+    }
+
+    // Returns NULL when the enum needs a tag
+    ::std::unique_ptr<EnumRepr> make_enum_repr(const Span& sp, const StaticTraitResolve& resolve, const ::HIR::TypeRef& ty)
+    {
+        const auto& te = ty.m_data.as_Path();
+        const auto& enm = *te.binding.as_Enum();
+        if( !enm.m_data.is_Data() )
+            return nullptr;
+        const auto& variants = enm.m_data.as_Data();
+        const auto& params = te.path.m_data.as_Generic().m_params;
+        if( variants.size() < 2 )
+            return nullptr;
+
+        // Niche filling applies when exactly one variant has data
+        unsigned int data_variant = ~0u;
+        for(unsigned int i = 0; i < variants.size(); i ++)
+        {
+            if( variants[i].type != ::HIR::TypeRef::new_unit() )
+            {
+                if( data_variant != ~0u )
+                    return nullptr;
+                data_variant = i;
+            }
+        }
+        if( data_variant == ~0u )
+            return nullptr;
+
+        auto data_ty = monomorphise_type_with(sp, variants[data_variant].type, monomorphise_type_get_cb(sp, nullptr, &params, nullptr));
+        resolve.expand_associated_types(sp, data_ty);
+        EnumRepr    rv;
+        rv.data_variant = data_variant;
+        if( !find_niche(sp, resolve, data_ty, variants.size() - 1, rv.field_path, rv.niche_start) )
+            return nullptr;
+        ::std::reverse(rv.field_path.begin(), rv.field_path.end());
+        DEBUG(ty << " - niche in variant " << data_variant << " at " << rv.field_path << " from " << rv.niche_start);
+        return box$(rv);
+    }
+}
+const EnumRepr* Target_GetEnumRepr(const Span& sp, const StaticTraitResolve& resolve, const ::HIR::TypeRef& ty)
+{
+    static ShardedCache<::HIR::TypeRef, ::std::unique_ptr<EnumRepr>>  s_cache;
+
+    if( const auto* repr = s_cache.find(ty) )
+    {
+        return repr->get();
+    }
+
+    return s_cache.insert( ty.clone(), make_enum_repr(sp, resolve, ty) ).get();
+}
 
 bool Target_GetSizeAndAlignOf(const Span& sp, const StaticTraitResolve& resolve, const ::HIR::TypeRef& ty, size_t& out_size, size_t& out_align)
 {
@@ -345,14 +476,78 @@ bool Target_GetSizeAndAlignOf(const Span& sp, const StaticTraitResolve& resolve,
             }
             ),
         (Enum,
-            // Search for alternate repr
-            // If not found, determine the variant size
-            // Get data size and alignment.
-            return false;
+            if( const auto* e = be->m_data.opt_Value() )
+            {
+                // Just the tag (see codegen_c)
+                switch(e->repr)
+                {
+                case ::HIR::Enum::Repr::Rust:
+                case ::HIR::Enum::Repr::C:
+                case ::HIR::Enum::Repr::U32:
+                    out_size = out_align = 4;
+                    break;
+                case ::HIR::Enum::Repr::Usize:
+                    out_size = out_align = g_target.m_arch.m_pointer_bits / 8;
+                    break;
+                case ::HIR::Enum::Repr::U8:
+                    out_size = out_align = 1;
+                    break;
+                case ::HIR::Enum::Repr::U16:
+                    out_size = out_align = 2;
+                    break;
+                case ::HIR::Enum::Repr::U64:
+                    out_size = out_align = 8;
+                    break;
+                }
+                return true;
+            }
+            const auto& variants = be->m_data.as_Data();
+            const auto& params = te.path.m_data.as_Generic().m_params;
+            auto variant_ty = [&](unsigned int idx) {
+                auto rv = monomorphise_type_with(sp, variants[idx].type, monomorphise_type_get_cb(sp, nullptr, &params, nullptr));
+                resolve.expand_associated_types(sp, rv);
+                return rv;
+                };
+            // Niche-filled, just the data variant
+            if( const auto* repr = Target_GetEnumRepr(sp, resolve, ty) )
+            {
+                return Target_GetSizeAndAlignOf(sp, resolve, variant_ty(repr->data_variant), out_size, out_align);
+            }
+            // Tagged, `unsigned int` tag followed by a union of the variants
+            size_t  data_size = 0;
+            size_t  data_align = 1;
+            for(unsigned int i = 0; i < variants.size(); i ++)
+            {
+                size_t  size, align;
+                if( !Target_GetSizeAndAlignOf(sp, resolve, variant_ty(i), size, align) )
+                    return false;
+                data_size = ::std::max(data_size, size);
+                data_align = ::std::max(data_align, align);
+            }
+            data_size = (data_size + data_align - 1) / data_align * data_align;
+            out_align = ::std::max<size_t>(4, data_align);
+            out_size = (4 + data_align - 1) / data_align * data_align + data_size;
+            out_size = (out_size + out_align - 1) / out_align * out_align;
+            return true;
             ),
         (Union,
             // Max alignment and max data size
-            return false;
+            const auto& params = te.path.m_data.as_Generic().m_params;
+            size_t  data_size = 0;
+            size_t  data_align = 1;
+            for(const auto& var : be->m_variants)
+            {
+                auto var_ty = monomorphise_type_with(sp, var.second.ent, monomorphise_type_get_cb(sp, nullptr, &params, nullptr));
+                resolve.expand_associated_types(sp, var_ty);
+                size_t  size, align;
+                if( !Target_GetSizeAndAlignOf(sp, resolve, var_ty, size, align) )
+                    return false;
+                data_size = ::std::max(data_size, size);
+                data_align = ::std::max(data_align, align);
+            }
+            out_align = data_align;
+            out_size = (data_size + data_align - 1) / data_align * data_align;
+            return true;
             )
         )
         ),
@@ -370,7 +565,8 @@ bool Target_GetSizeAndAlignOf(const Span& sp, const StaticTraitResolve& resolve,
         size_t  size;
         if( !Target_GetSizeAndAlignOf(sp, resolve, *te.inner, size,out_align) )
             return false;
-        size *= te.size_val;
+        out_size = size * te.size_val;
+        return true;
         ),
     (Slice,
         BUG(sp, "sizeof on a slice - unsized");
@@ -8,6 +8,8 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
+#include <cassert>
 #include <hir/type.hpp>
 #include <hir_typeck/static.hpp>
 
@@ -55,9 +57,29 @@ struct StructRepr
     ::std::vector<Ent>  ents;
 };
 
+/// Niche-filled representation of an enum (e.g. `Option<&T>`)
+/// - The enum is stored as the data of `data_variant` (emitted as a field named `_1`). All other variants have no data,
+///   and are stored as values of the field at `field_path` (within that data) that are invalid for its type.
+struct EnumRepr
+{
+    unsigned int    data_variant;
+    // Field indexes from the variant data to the niche field, a final UINT_MAX selects the pointer of a fat pointer
+    ::std::vector<unsigned int> field_path;
+    // Niche value used by the first dataless variant (the rest follow on in variant order)
+    uint64_t    niche_start;
+
+    uint64_t niche_value(unsigned int var_idx) const {
+        assert(var_idx != data_variant);
+        return niche_start + (var_idx < data_variant ? var_idx : var_idx - 1);
+    }
+};
+
 extern const TargetSpec& Target_GetCurSpec();
 extern void Target_SetCfg(const ::std::string& target_name);
+extern bool Target_GetSizeAndAlignOf(const Span& sp, const StaticTraitResolve& resolve, const ::HIR::TypeRef& ty, size_t& out_size, size_t& out_align);
 extern bool Target_GetSizeOf(const Span& sp, const StaticTraitResolve& resolve, const ::HIR::TypeRef& ty, size_t& out_size);
 extern bool Target_GetAlignOf(const Span& sp, const StaticTraitResolve& resolve, const ::HIR::TypeRef& ty, size_t& out_align);
 extern const StructRepr* Target_GetStructRepr(const Span& sp, const StaticTraitResolve& resolve, const ::HIR::TypeRef& struct_ty);
+/// Returns nullptr if the enum uses a tagged representation
+extern const EnumRepr* Target_GetEnumRepr(const Span& sp, const StaticTraitResolve& resolve, const ::HIR::TypeRef& enum_ty);
 
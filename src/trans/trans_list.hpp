@@ -45,6 +45,8 @@ struct TransList_Function
 {
     const ::HIR::Function*  ptr;
     Trans_Params    pp;
+    /// This instance is provided by a loaded crate (`-Z share-generics`), so only needs a declaration
+    bool    is_upstream = false;
 };
 struct TransList_Static
 {
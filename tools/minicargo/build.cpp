@@ -12,14 +12,20 @@
 #include "build.h"
 #include "debug.h"
 #include "stringlist.h"
+#include <jobserver.hpp>
 #include <vector>
 #include <algorithm>
 #include <sstream>  // stringstream
 #include <cstdlib>  // setenv
 #include <thread>
+#include <chrono>
+#include <functional>
 #include <mutex>
 #include <condition_variable>
 #include <climits>
+#include <cstring>
+#include <fstream>
+#include <map>
 #include <cassert>
 #ifdef _WIN32
 # include <Windows.h>
@@ -30,6 +36,8 @@
 # include <sys/stat.h>
 # include <sys/wait.h>
 # include <fcntl.h>
+# include <dirent.h>
+# include <cerrno>
 #endif
 
 #ifdef _WIN32
@@ -40,26 +48,61 @@
 # define HOST_TARGET "x86_64-unknown-linux-gnu"
 #endif
 
+typedef ::std::function<void()>  ReadyCallback;
+
+/// Durations of previous builds of each package (stored in `<output_dir>/build_times.txt`)
+/// - Used to estimate which packages are on the critical path of the build.
+class BuildTimes
+{
+    ::helpers::path m_path;
+    mutable ::std::mutex    m_lock;
+    ::std::map<::std::string, double>   m_seconds;
+public:
+    BuildTimes(::helpers::path output_dir);
+
+    static ::std::string key_for(const PackageManifest& manifest) {
+        return ::format(manifest.name(), " ", manifest.version());
+    }
+
+    /// Returns a negative value if the package hasn't been built before
+    double get(const PackageManifest& manifest) const;
+    void record(const PackageManifest& manifest, double seconds);
+    void save() const;
+};
+
 /// Class abstracting access to the compiler
 class Builder
 {
     BuildOptions    m_opts;
     ::helpers::path m_compiler_path;
+    /// Shared with spawned processes (if non-null)
+    const Jobserver*    m_jobserver;
+    unsigned    m_num_jobs;
+    BuildTimes* m_build_times;
 
 public:
-    Builder(BuildOptions opts);
+    Builder(BuildOptions opts, const Jobserver* jobserver, unsigned num_jobs, BuildTimes* build_times);
 
-    bool build_target(const PackageManifest& manifest, const PackageTarget& target, bool is_for_host) const;
-    bool build_library(const PackageManifest& manifest, bool is_for_host) const;
+    /// `on_metadata_ready` is called once the crate's metadata is written (before the C code is compiled) - which
+    /// may not happen at all, e.g. if the output is up to date.
+    bool build_target(const PackageManifest& manifest, const PackageTarget& target, bool is_for_host, const ReadyCallback& on_metadata_ready={}) const;
+    bool build_library(const PackageManifest& manifest, bool is_for_host, const ReadyCallback& on_metadata_ready={}) const;
     ::helpers::path build_build_script(const PackageManifest& manifest, bool is_for_host, bool* out_is_rebuilt) const;
 
 private:
     ::helpers::path get_crate_path(const PackageManifest& manifest, const PackageTarget& target, bool is_for_host, const char** crate_type, ::std::string* out_crate_suffix) const;
-    bool spawn_process_mrustc(const StringList& args, StringListKV env, const ::helpers::path& logfile) const;
-    bool spawn_process(const char* exe_name, const StringList& args, const StringListKV& env, const ::helpers::path& logfile) const;
+    bool spawn_process_mrustc(const StringList& args, StringListKV env, const ::helpers::path& logfile, const ::helpers::path& ready_marker={}, const ReadyCallback& on_ready={}) const;
+    /// If `on_ready` is set, it's called when `ready_marker` is created by the child
+    bool spawn_process(const char* exe_name, const StringList& args, StringListKV env, const ::helpers::path& logfile, const ::helpers::path& ready_marker={}, const ReadyCallback& on_ready={}) const;
 
     ::helpers::path build_and_run_script(const PackageManifest& manifest, bool is_for_host) const;
 
+    /// Check the inputs listed in `outfile`'s depfile (`<outfile>.d`, written by mrustc) against the output
+    /// - If `content_hash` is enabled, inputs that are newer but have the same contents as last time don't count
+    bool inputs_unchanged(const ::helpers::path& outfile, const Timestamp& output_ts) const;
+    /// Record the content hash of each input (if `content_hash` is enabled)
+    void save_input_hashes(const ::helpers::path& outfile) const;
+
     // If `is_for_host` and cross compiling, use a different directory
     // - TODO: Include the target arch in the output dir too?
     ::helpers::path get_output_dir(bool is_for_host) const {
@@ -114,6 +157,155 @@ public:
     }
 };
 
+BuildTimes::BuildTimes(::helpers::path output_dir):
+    m_path(output_dir / "build_times.txt")
+{
+    ::std::ifstream is(m_path.str());
+    ::std::string   name, version;
+    double  seconds;
+    while( is >> name >> version >> seconds )
+    {
+        m_seconds[name + " " + version] = seconds;
+    }
+}
+double BuildTimes::get(const PackageManifest& manifest) const
+{
+    ::std::lock_guard<::std::mutex> lh { m_lock };
+    auto it = m_seconds.find(key_for(manifest));
+    return it != m_seconds.end() ? it->second : -1.0;
+}
+void BuildTimes::record(const PackageManifest& manifest, double seconds)
+{
+    ::std::lock_guard<::std::mutex> lh { m_lock };
+    DEBUG("Built " << manifest.name() << " in " << seconds << "s");
+    m_seconds[key_for(manifest)] = seconds;
+}
+void BuildTimes::save() const
+{
+    ::std::lock_guard<::std::mutex> lh { m_lock };
+    if( m_seconds.empty() )
+        return ;
+    // Write to a temporary then rename, so an interrupted build doesn't lose the history
+    auto tmp_path = m_path + ".tmp";
+    {
+        ::std::ofstream os(tmp_path.str());
+        if( !os.is_open() )
+            return ;
+        for(const auto& e : m_seconds)
+        {
+            os << e.first << " " << e.second << "\n";
+        }
+    }
+    remove(m_path.str().c_str());
+    rename(tmp_path.str().c_str(), m_path.str().c_str());
+}
+
+namespace {
+    /// Total size of the rust source files in a directory tree
+    uint64_t get_source_size(const ::helpers::path& dir)
+    {
+        uint64_t    rv = 0;
+#if _WIN32
+        WIN32_FIND_DATA find_data;
+        HANDLE find_handle = FindFirstFile( (dir / "*").str().c_str(), &find_data );
+        if( find_handle == INVALID_HANDLE_VALUE )
+            return 0;
+        do
+        {
+            const char* name = find_data.cFileName;
+            bool is_dir = (find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+            uint64_t size = (static_cast<uint64_t>(find_data.nFileSizeHigh) << 32) | find_data.nFileSizeLow;
+#else
+        auto* dp = opendir(dir.str().c_str());
+        if( dp == nullptr )
+            return 0;
+        while( const auto* dent = readdir(dp) )
+        {
+            const char* name = dent->d_name;
+            struct stat s;
+            if( stat((dir / name).str().c_str(), &s) != 0 )
+                continue ;
+            bool is_dir = S_ISDIR(s.st_mode);
+            uint64_t size = s.st_size;
+#endif
+            // Skip `.`, `..`, and hidden directories
+            if( name[0] == '.' )
+                continue ;
+            if( is_dir )
+            {
+                rv += get_source_size(dir / name);
+            }
+            else
+            {
+                size_t len = strlen(name);
+                if( len > 3 && strcmp(name + len - 3, ".rs") == 0 )
+                    rv += size;
+            }
+#if _WIN32
+        } while( FindNextFile(find_handle, &find_data) );
+        FindClose(find_handle);
+#else
+        }
+        closedir(dp);
+#endif
+        return rv;
+    }
+}
+
+::std::vector<double> BuildList::get_priorities(const BuildTimes& build_times) const
+{
+    // Estimate the cost of each package (in seconds)
+    // - Packages that haven't been built before are estimated from the size of their source, scaled by the average
+    //   build speed of the packages that have.
+    ::std::vector<double>   cost(m_list.size());
+    ::std::vector<uint64_t> source_size(m_list.size());
+    double  known_seconds = 0;
+    double  known_bytes = 0;
+    for(size_t i = 0; i < m_list.size(); i ++)
+    {
+        const auto& p = *m_list[i].package;
+        if( p.has_library() )
+        {
+            auto lib_path = p.directory() / ::helpers::path(p.get_library().m_path);
+            source_size[i] = get_source_size(lib_path.parent());
+        }
+        cost[i] = build_times.get(p);
+        if( cost[i] >= 0 && source_size[i] > 0 )
+        {
+            known_seconds += cost[i];
+            known_bytes += source_size[i];
+        }
+    }
+    // With no history, guess ~10s per 100KB (only the relative costs matter)
+    double  seconds_per_byte = known_bytes > 0 ? known_seconds / known_bytes : 1e-4;
+    for(size_t i = 0; i < m_list.size(); i ++)
+    {
+        if( cost[i] < 0 )
+            cost[i] = source_size[i] * seconds_per_byte;
+    }
+
+    // Priority is the length of the longest chain of builds that starts with this package
+    // - Dependents are always later in the list (it's sorted into build order)
+    ::std::vector<double>   rv(m_list.size());
+    for(size_t i = m_list.size(); i --; )
+    {
+        double  longest_tail = 0;
+        for(auto d : m_list[i].dependents)
+        {
+            assert(d > i);
+            longest_tail = ::std::max(longest_tail, rv[d]);
+        }
+        for(auto d : m_list[i].link_dependents)
+        {
+            assert(d > i);
+            longest_tail = ::std::max(longest_tail, rv[d]);
+        }
+        rv[i] = cost[i] + longest_tail;
+        DEBUG(m_list[i].package->name() << ": cost " << cost[i] << "s, critical path " << rv[i] << "s");
+    }
+    return rv;
+}
+
 BuildList::BuildList(const PackageManifest& manifest, const BuildOptions& opts):
     m_root_manifest(manifest)
 {
@@ -207,41 +399,120 @@ BuildList::BuildList(const PackageManifest& manifest, const BuildOptions& opts):
     m_list.reserve(b.m_list.size());
     for(const auto& e : b.m_list)
     {
-        m_list.push_back({ e.package, e.native, {} });
+        m_list.push_back({ e.package, e.native, {}, {}, 0 });
     }
     // Fill in all of the dependents (i.e. packages that will be closer to being buildable when the package is built)
-    for(size_t i = 0; i < m_list.size(); i++)
+    // - Libraries only need the metadata of their dependencies, but anything that is linked (proc macros and
+    //   build scripts) needs every crate below it to be fully built.
+    bool include_build = !opts.build_script_overrides.is_valid();
+    auto get_index = [&](const PackageManifest& p)->unsigned {
+        auto it = ::std::find_if(m_list.begin(), m_list.end(), [&](const Entry& e){ return e.package == &p; });
+        assert(it != m_list.end());
+        return static_cast<unsigned>(it - m_list.begin());
+        };
+    // Add `p` and all of its (normal) dependencies to `out`
+    ::std::function<void(const PackageManifest&, ::std::vector<unsigned>&)> add_closure;
+    add_closure = [&](const PackageManifest& p, ::std::vector<unsigned>& out) {
+        auto idx = get_index(p);
+        if( ::std::find(out.begin(), out.end(), idx) != out.end() )
+            return ;
+        out.push_back(idx);
+        for(const auto& dep : p.dependencies())
+        {
+            if( !dep.is_disabled() )
+                add_closure(dep.get_package(), out);
+        }
+        };
+    for(size_t j = 0; j < m_list.size(); j ++)
     {
-        const auto* cur = m_list[i].package;
-        for(size_t j = i+1; j < m_list.size(); j ++)
+        const auto& p = *m_list[j].package;
+        ::std::vector<unsigned> meta_deps;
+        ::std::vector<unsigned> link_deps;
+        bool is_proc_macro = p.has_library() && p.get_library().m_is_proc_macro;
+        for(const auto& dep : p.dependencies())
+        {
+            if( dep.is_disabled() )
+                continue ;
+            const auto& dp = dep.get_package();
+            if( is_proc_macro || dp.get_library().m_is_proc_macro )
+                add_closure(dp, link_deps);
+            else
+                meta_deps.push_back(get_index(dp));
+        }
+        if( p.build_script() != "" && include_build )
         {
-            for( const auto& dep : m_list[j].package->dependencies() )
+            for(const auto& dep : p.build_dependencies())
             {
-                if( !dep.is_disabled() && &dep.get_package() == cur )
-                {
-                    m_list[i].dependents.push_back(j);
-                }
+                if( !dep.is_disabled() )
+                    add_closure(dep.get_package(), link_deps);
             }
         }
+
+        for(auto i : link_deps)
+        {
+            m_list[i].link_dependents.push_back(j);
+            m_list[j].num_deps ++;
+        }
+        for(auto i : meta_deps)
+        {
+            // Already waiting on the full build
+            if( ::std::find(link_deps.begin(), link_deps.end(), i) != link_deps.end() )
+                continue ;
+            if( ::std::find(m_list[i].dependents.begin(), m_list[i].dependents.end(), j) != m_list[i].dependents.end() )
+                continue ;
+            m_list[i].dependents.push_back(j);
+            m_list[j].num_deps ++;
+        }
     }
 }
 bool BuildList::build(BuildOptions opts, unsigned num_jobs)
 {
-    bool include_build = !opts.build_script_overrides.is_valid();
-    Builder builder { ::std::move(opts) };
+    // Limit the number of concurrent jobs using a jobserver, shared with mrustc/build scripts (and any make above us)
+    // - If invoked from make, use its pool instead of creating a new one.
+    ::std::unique_ptr<Jobserver>    jobserver;
+    if( num_jobs > 0 )
+    {
+        jobserver = Jobserver::from_environment();
+        if( !jobserver )
+            jobserver = Jobserver::create(num_jobs);
+    }
+    BuildTimes  build_times { opts.output_dir };
+    auto priorities = this->get_priorities(build_times);
+    Builder builder { ::std::move(opts), jobserver.get(), num_jobs, &build_times };
+    // Record the durations even if the build fails (the next one will be scheduled better)
+    struct SaveTimes {
+        const BuildTimes& t;
+        ~SaveTimes() { t.save(); }
+    } save_times { build_times };
 
     // Pre-count how many dependencies are remaining for each package
     struct BuildState
     {
         ::std::vector<unsigned> num_deps_remaining;
+        ::std::vector<bool> metadata_ready;
         ::std::vector<unsigned> build_queue;
+        ::std::vector<double>   priority;
 
+        // Library metadata is available (dependent libraries can start), returns the number of newly queued packages
+        int package_metadata_ready(unsigned index, const ::std::vector<Entry>& list)
+        {
+            if( this->metadata_ready[index] )
+                return 0;
+            this->metadata_ready[index] = true;
+            DEBUG("Metadata ready for " << list[index].package->name());
+            return this->release(list[index].dependents, list);
+        }
         int complete_package(unsigned index, const ::std::vector<Entry>& list)
         {
-            int rv = 0;
+            int rv = this->package_metadata_ready(index, list);
             DEBUG("Completed " << list[index].package->name());
+            return rv + this->release(list[index].link_dependents, list);
+        }
 
-            for(auto d : list[index].dependents)
+        int release(const ::std::vector<unsigned>& dependents, const ::std::vector<Entry>& list)
+        {
+            int rv = 0;
+            for(auto d : dependents)
             {
                 assert(this->num_deps_remaining[d] > 0);
                 this->num_deps_remaining[d] --;
@@ -252,50 +523,33 @@ bool BuildList::build(BuildOptions opts, unsigned num_jobs)
                     this->build_queue.push_back(d);
                 }
             }
-
             return rv;
         }
 
+        // Take the ready package with the longest path to the end of the build
         unsigned get_next()
         {
             assert(!this->build_queue.empty());
-            unsigned rv = this->build_queue.back();
-            this->build_queue.pop_back();
+            auto it = ::std::max_element(this->build_queue.begin(), this->build_queue.end(), [&](unsigned a, unsigned b){
+                return this->priority[a] < this->priority[b];
+                });
+            unsigned rv = *it;
+            this->build_queue.erase(it);
             return rv;
         }
     };
     BuildState  state;
     state.num_deps_remaining.reserve(m_list.size());
+    state.metadata_ready.resize(m_list.size());
+    state.priority = ::std::move(priorities);
     for(const auto& e : m_list)
     {
-        const auto& p = *e.package;
-        unsigned n_deps = 0;
-        for (const auto& dep : p.dependencies())
-        {
-            if( dep.is_disabled() )
-            {
-                continue ;
-            }
-            n_deps ++;
-        }
-
-        if( p.build_script() != "" && include_build )
-        {
-            for(const auto& dep : p.build_dependencies())
-            {
-                if( dep.is_disabled() )
-                {
-                    continue ;
-                }
-                n_deps ++;
-            }
-        }
         // If there's no dependencies for this package, add it to the build queue
-        if( n_deps == 0 )
+        if( e.num_deps == 0 )
         {
             state.build_queue.push_back(state.num_deps_remaining.size());
         }
-        state.num_deps_remaining.push_back( n_deps );
+        state.num_deps_remaining.push_back( e.num_deps );
     }
 
     // Actually do the build
@@ -355,7 +609,7 @@ bool BuildList::build(BuildOptions opts, unsigned num_jobs)
             }
         };
         struct H {
-            static void thread_body(unsigned my_idx, const ::std::vector<Entry>* list_p, Queue* queue_p, const Builder* builder)
+            static void thread_body(unsigned my_idx, const ::std::vector<Entry>* list_p, Queue* queue_p, const Builder* builder, Jobserver* jobserver)
             {
                 const auto& list = *list_p;
                 auto& queue = *queue_p;
@@ -377,8 +631,29 @@ bool BuildList::build(BuildOptions opts, unsigned num_jobs)
                         queue.num_active ++;
                     }
 
+                    // Wait for a token before starting (the thread count is only an upper bound)
+                    Jobserver::Token    token { true, 0 };
+                    if( jobserver )
+                    {
+                        DEBUG("Thread " << my_idx << ": waiting for a job token");
+                        token = jobserver->acquire();
+                    }
                     DEBUG("Thread " << my_idx << ": Starting " << cur << " - " << list[cur].package->name());
-                    if( ! builder->build_library(*list[cur].package, list[cur].is_host) )
+                    // Pipelined builds: Release the dependent libraries as soon as the metadata is written
+                    auto on_metadata_ready = [&]() {
+                        ::std::lock_guard<::std::mutex> sl { queue.mutex };
+                        int v = queue.state.package_metadata_ready(cur, list);
+                        while(v--)
+                        {
+                            queue.avaliable_tasks.notify();
+                        }
+                        };
+                    bool ok = builder->build_library(*list[cur].package, list[cur].is_host, on_metadata_ready);
+                    if( jobserver )
+                    {
+                        jobserver->release(token);
+                    }
+                    if( !ok )
                     {
                         queue.failure = true;
                         queue.signal_all();
@@ -413,7 +688,7 @@ bool BuildList::build(BuildOptions opts, unsigned num_jobs)
         DEBUG("Spawning " << num_jobs << " worker threads");
         for(unsigned i = 0; i < num_jobs; i++)
         {
-            threads.push_back(::std::thread(H::thread_body, i, &this->m_list, &queue, &builder));
+            threads.push_back(::std::thread(H::thread_body, i, &this->m_list, &queue, &builder, jobserver.get()));
         }
 
         DEBUG("Poking jobs");
@@ -429,7 +704,7 @@ bool BuildList::build(BuildOptions opts, unsigned num_jobs)
             DEBUG("> Thread " << i << " complete");
         }
 
-        if( queue.failue )
+        if( queue.failure )
         {
             return false;
         }
@@ -474,8 +749,11 @@ bool BuildList::build(BuildOptions opts, unsigned num_jobs)
 }
 
 
-Builder::Builder(BuildOptions opts):
-    m_opts(::std::move(opts))
+Builder::Builder(BuildOptions opts, const Jobserver* jobserver, unsigned num_jobs, BuildTimes* build_times):
+    m_opts(::std::move(opts)),
+    m_jobserver(jobserver),
+    m_num_jobs(num_jobs),
+    m_build_times(build_times)
 {
 #ifdef _WIN32
     char buf[1024];
@@ -531,18 +809,17 @@ Builder::Builder(BuildOptions opts):
     return outfile;
 }
 
-bool Builder::build_target(const PackageManifest& manifest, const PackageTarget& target, bool is_for_host) const
+bool Builder::build_target(const PackageManifest& manifest, const PackageTarget& target, bool is_for_host, const ReadyCallback& on_metadata_ready) const
 {
     const char* crate_type;
     ::std::string   crate_suffix;
     auto outfile = this->get_crate_path(manifest, target, is_for_host,  &crate_type, &crate_suffix);
 
-    // TODO: Determine if it needs re-running
     // Rerun if:
     // > `outfile` is missing
     // > mrustc/minicargo is newer than `outfile`
-    // > build script has changed
-    // > any input file has changed (requires depfile from mrustc)
+    // > any input file (source, included file, or extern crate) has changed - from mrustc's depfile
+    // TODO: > build script has changed
     bool force_rebuild = false;
     auto ts_result = Timestamp::for_file(outfile);
     if( force_rebuild ) {
@@ -556,8 +833,10 @@ bool Builder::build_target(const PackageManifest& manifest, const PackageTarget&
         // Rebuild (older than mrustc/minicargo)
         DEBUG("Building " << outfile << " - Older than mrustc ( " << ts_result << " < " << Timestamp::for_file(m_compiler_path) << ")");
     }
+    else if( !this->inputs_unchanged(outfile, ts_result) ) {
+        // Rebuild (inputs changed)
+    }
     else {
-        // TODO: Check dependencies. (from depfile)
         // Don't rebuild (no need to)
         DEBUG("Not building " << outfile << " - not out of date");
         return true;
@@ -594,6 +873,7 @@ bool Builder::build_target(const PackageManifest& manifest, const PackageTarget&
         }
     }
     args.push_back("-o"); args.push_back(outfile);
+    args.push_back("-C"); args.push_back(format("emit-depfile=",outfile,".d"));
     args.push_back("-L"); args.push_back(this->get_output_dir(is_for_host).str());
     for(const auto& dir : manifest.build_script_output().rustc_link_search) {
         args.push_back("-L"); args.push_back(dir.second.c_str());
@@ -659,7 +939,36 @@ bool Builder::build_target(const PackageManifest& manifest, const PackageTarget&
     // TODO: If emitting command files (i.e. cross-compiling), concatenate the contents of `outfile + ".sh"` onto a
     // master file.
     // - Will probably want to do this as a final stage after building everything.
-    return this->spawn_process_mrustc(args, ::std::move(env), outfile + "_dbg.txt");
+    auto start_time = ::std::chrono::steady_clock::now();
+    bool rv;
+    if( on_metadata_ready && m_opts.pipelined && target.m_type == PackageTarget::Type::Lib && !target.m_is_proc_macro )
+    {
+        // Pipelined: mrustc creates the marker once the .hir is written, then goes on to compile the C code
+        auto marker = outfile + ".ready";
+        remove(marker.str().c_str());
+        args.push_back("--metadata-ready"); args.push_back(marker);
+        rv = this->spawn_process_mrustc(args, ::std::move(env), outfile + "_dbg.txt", marker, on_metadata_ready);
+        remove(marker.str().c_str());
+        if( !rv )
+        {
+            // The metadata may have been written, remove it so the next build doesn't consider this crate up to date
+            remove(outfile.str().c_str());
+        }
+    }
+    else
+    {
+        rv = this->spawn_process_mrustc(args, ::std::move(env), outfile + "_dbg.txt");
+    }
+    if( rv )
+    {
+        this->save_input_hashes(outfile);
+    }
+    if( rv && m_build_times && target.m_type == PackageTarget::Type::Lib )
+    {
+        ::std::chrono::duration<double> elapsed = ::std::chrono::steady_clock::now() - start_time;
+        m_build_times->record(manifest, elapsed.count());
+    }
+    return rv;
 }
 ::helpers::path Builder::build_build_script(const PackageManifest& manifest, bool is_for_host, bool* out_is_rebuilt) const
 {
@@ -674,19 +983,22 @@ bool Builder::build_target(const PackageManifest& manifest, const PackageTarget&
         // Rebuild (older than mrustc/minicargo)
         DEBUG("Building " << outfile << " - Older than mrustc ( " << ts_result << " < " << Timestamp::for_file(m_compiler_path) << ")");
     }
+    else if( !this->inputs_unchanged(outfile, ts_result) )
+    {
+        // Rebuild (inputs changed)
+    }
     else
     {
         *out_is_rebuilt = false;
         return outfile;
     }
 
-    // TODO: Load+check a depfile (requires mrustc to emit one)
-
     StringList  args;
     args.push_back( ::helpers::path(manifest.manifest_path()).parent() / ::helpers::path(manifest.build_script()) );
     args.push_back("--crate-name"); args.push_back("build");
     args.push_back("--crate-type"); args.push_back("bin");
     args.push_back("-o"); args.push_back(outfile);
+    args.push_back("-C"); args.push_back(format("emit-depfile=",outfile,".d"));
     args.push_back("-L"); args.push_back(this->get_output_dir(true).str().c_str()); // NOTE: Forces `is_for_host` to true here.
     for(const auto& d : m_opts.lib_search_dirs)
     {
@@ -717,6 +1029,7 @@ bool Builder::build_target(const PackageManifest& manifest, const PackageTarget&
 
     if( this->spawn_process_mrustc(args, ::std::move(env), outfile + "_dbg.txt") )
     {
+        this->save_input_hashes(outfile);
         *out_is_rebuilt = true;
         return outfile;
     }
@@ -767,7 +1080,7 @@ bool Builder::build_target(const PackageManifest& manifest, const PackageTarget&
         env.push_back("OUT_DIR", out_dir);
         env.push_back("TARGET", m_opts.target_name ? m_opts.target_name : HOST_TARGET);
         env.push_back("HOST", HOST_TARGET);
-        env.push_back("NUM_JOBS", "1");
+        env.push_back("NUM_JOBS", ::std::to_string(m_num_jobs));
         env.push_back("OPT_LEVEL", "2");
         env.push_back("DEBUG", "0");
         env.push_back("PROFILE", "release");
@@ -789,7 +1102,7 @@ bool Builder::build_target(const PackageManifest& manifest, const PackageTarget&
         auto fd_cwd = open(".", O_DIRECTORY);
         chdir(manifest.directory().str().c_str());
         #endif
-        if( !this->spawn_process(script_exe_abs.str().c_str(), {}, env, out_file) )
+        if( !this->spawn_process(script_exe_abs.str().c_str(), {}, ::std::move(env), out_file) )
         {
             rename(out_file.str().c_str(), (out_file+"_failed").str().c_str());
             // Build failed, return an invalid path
@@ -803,7 +1116,7 @@ bool Builder::build_target(const PackageManifest& manifest, const PackageTarget&
     
     return out_file;
 }
-bool Builder::build_library(const PackageManifest& manifest, bool is_for_host) const
+bool Builder::build_library(const PackageManifest& manifest, bool is_for_host, const ReadyCallback& on_metadata_ready) const
 {
     if( manifest.build_script() != "" )
     {
@@ -829,15 +1142,21 @@ bool Builder::build_library(const PackageManifest& manifest, bool is_for_host) c
         }
     }
 
-    return this->build_target(manifest, manifest.get_library(), is_for_host);
+    return this->build_target(manifest, manifest.get_library(), is_for_host, on_metadata_ready);
 }
-bool Builder::spawn_process_mrustc(const StringList& args, StringListKV env, const ::helpers::path& logfile) const
+bool Builder::spawn_process_mrustc(const StringList& args, StringListKV env, const ::helpers::path& logfile, const ::helpers::path& ready_marker, const ReadyCallback& on_ready) const
 {
     //env.push_back("MRUSTC_DEBUG", "");
-    return spawn_process(m_compiler_path.str().c_str(), args, env, logfile);
+    return spawn_process(m_compiler_path.str().c_str(), args, ::std::move(env), logfile, ready_marker, on_ready);
 }
-bool Builder::spawn_process(const char* exe_name, const StringList& args, const StringListKV& env, const ::helpers::path& logfile) const
+bool Builder::spawn_process(const char* exe_name, const StringList& args, StringListKV env, const ::helpers::path& logfile, const ::helpers::path& ready_marker, const ReadyCallback& on_ready) const
 {
+    // Hand the jobserver to the child (mrustc limits its C compiler invocations, build scripts can run `make`)
+    if( m_jobserver )
+    {
+        env.push_back("MAKEFLAGS", m_jobserver->makeflags());
+        env.push_back("CARGO_MAKEFLAGS", m_jobserver->makeflags());
+    }
 #ifdef _WIN32
     ::std::stringstream cmdline;
     cmdline << exe_name;
@@ -882,7 +1201,24 @@ bool Builder::spawn_process(const char* exe_name, const StringList& args, const
     PROCESS_INFORMATION pi = { 0 };
     CreateProcessA(exe_name, (LPSTR)cmdline_str.c_str(), NULL, NULL, TRUE, 0, NULL, NULL, &si, &pi);
     CloseHandle(si.hStdOutput);
-    WaitForSingleObject(pi.hProcess, INFINITE);
+    if( on_ready )
+    {
+        // Poll for the marker while waiting for the process to exit
+        bool is_ready = false;
+        while( WaitForSingleObject(pi.hProcess, 20) == WAIT_TIMEOUT )
+        {
+            if( !is_ready && !(Timestamp::for_file(ready_marker) == Timestamp::infinite_past()) )
+            {
+                DEBUG("Ready marker " << ready_marker << " created");
+                is_ready = true;
+                on_ready();
+            }
+        }
+    }
+    else
+    {
+        WaitForSingleObject(pi.hProcess, INFINITE);
+    }
     DWORD status = 1;
     GetExitCodeProcess(pi.hProcess, &status);
     if (status != 0)
@@ -921,7 +1257,21 @@ bool Builder::spawn_process(const char* exe_name, const StringList& args, const
     extern char **environ;
     for(auto p = environ; *p; p++)
     {
-        envp.push_back(*p);
+        // Skip variables that are being overridden
+        bool is_overridden = false;
+        for(auto kv : env)
+        {
+            size_t len = strlen(kv.first);
+            if( strncmp(*p, kv.first, len) == 0 && (*p)[len] == '=' )
+            {
+                is_overridden = true;
+                break;
+            }
+        }
+        if( !is_overridden )
+        {
+            envp.push_back(*p);
+        }
     }
     for(auto kv : env)
     {
@@ -943,7 +1293,34 @@ bool Builder::spawn_process(const char* exe_name, const StringList& args, const
     }
     posix_spawn_file_actions_destroy(&fa);
     int status = -1;
-    waitpid(pid, &status, 0);
+    if( on_ready )
+    {
+        // Poll for the marker while waiting for the process to exit
+        bool is_ready = false;
+        for(;;)
+        {
+            auto rv = waitpid(pid, &status, WNOHANG);
+            if( rv == pid )
+                break;
+            if( rv < 0 && errno != EINTR )
+            {
+                perror("waitpid");
+                status = -1;
+                break;
+            }
+            if( !is_ready && !(Timestamp::for_file(ready_marker) == Timestamp::infinite_past()) )
+            {
+                DEBUG("Ready marker " << ready_marker << " created");
+                is_ready = true;
+                on_ready();
+            }
+            ::std::this_thread::sleep_for(::std::chrono::milliseconds(20));
+        }
+    }
+    else
+    {
+        waitpid(pid, &status, 0);
+    }
     if( status != 0 )
     {
         if( WIFEXITED(status) )
@@ -959,6 +1336,153 @@ bool Builder::spawn_process(const char* exe_name, const StringList& args, const
     return true;
 }
 
+namespace {
+    /// Load the prerequisites of the first rule in a makefile-style dependency file
+    bool load_depfile(const ::helpers::path& path, ::std::vector<::std::string>& out_inputs)
+    {
+        ::std::ifstream is(path.str());
+        if( !is.is_open() )
+            return false;
+        ::std::vector<::std::string>   words;
+        ::std::string   cur;
+        bool seen_colon = false;
+        for(int c; (c = is.get()) != EOF; )
+        {
+            if( c == '\\' )
+            {
+                int next = is.get();
+                if( next == '\n' || next == '\r' )
+                {
+                    // Line continuation (treated as whitespace)
+                    if( next == '\r' && is.peek() == '\n' )
+                        is.get();
+                    c = ' ';
+                }
+                else if( next == ' ' || next == '#' )
+                {
+                    cur += static_cast<char>(next);
+                    continue ;
+                }
+                else
+                {
+                    cur += '\\';
+                    if( next == EOF )
+                        break;
+                    is.putback(static_cast<char>(next));
+                    continue ;
+                }
+            }
+            else if( c == '$' && is.peek() == '$' )
+            {
+                is.get();
+                cur += '$';
+                continue ;
+            }
+
+            if( c == ' ' || c == '\t' || c == '\n' || c == '\r' )
+            {
+                if( !cur.empty() )
+                {
+                    if( !seen_colon && cur.back() == ':' ) {
+                        seen_colon = true;
+                    }
+                    else if( seen_colon ) {
+                        out_inputs.push_back(::std::move(cur));
+                    }
+                    cur.clear();
+                }
+                // Only the first rule (the rest are empty rules for each input)
+                if( c == '\n' && seen_colon )
+                    break;
+            }
+            else
+            {
+                cur += static_cast<char>(c);
+            }
+        }
+        if( seen_colon && !cur.empty() )
+            out_inputs.push_back(::std::move(cur));
+        return seen_colon;
+    }
+
+    /// 64-bit FNV-1a hash of a file's contents
+    bool hash_file(const ::std::string& path, uint64_t& out_hash)
+    {
+        ::std::ifstream is(path, ::std::ios::binary);
+        if( !is.is_open() )
+            return false;
+        uint64_t    h = 0xcbf29ce484222325ull;
+        char    buf[64*1024];
+        while( is )
+        {
+            is.read(buf, sizeof(buf));
+            for(::std::streamsize i = 0; i < is.gcount(); i ++)
+                h = (h ^ static_cast<uint8_t>(buf[i])) * 0x100000001b3ull;
+        }
+        out_hash = h;
+        return !is.bad();
+    }
+}
+
+bool Builder::inputs_unchanged(const ::helpers::path& outfile, const Timestamp& output_ts) const
+{
+    ::std::vector<::std::string>   inputs;
+    if( !load_depfile(outfile + ".d", inputs) )
+    {
+        DEBUG("Building " << outfile << " - No depfile");
+        return false;
+    }
+
+    // Hashes recorded after the last build (`<hash> <path>` per line)
+    ::std::map<::std::string, uint64_t>   old_hashes;
+    if( m_opts.content_hash )
+    {
+        ::std::ifstream is((outfile + ".d.hash").str());
+        uint64_t    h;
+        ::std::string   p;
+        while( is >> ::std::hex >> h && ::std::getline(is >> ::std::ws, p) )
+            old_hashes[p] = h;
+    }
+
+    for(const auto& input : inputs)
+    {
+        auto ts = Timestamp::for_file(input);
+        if( ts == Timestamp::infinite_past() )
+        {
+            DEBUG("Building " << outfile << " - " << input << " is missing");
+            return false;
+        }
+        if( output_ts < ts )
+        {
+            auto it = old_hashes.find(input);
+            uint64_t    h;
+            if( it != old_hashes.end() && hash_file(input, h) && h == it->second )
+            {
+                DEBUG(input << " is newer than " << outfile << " but its contents are unchanged");
+                continue ;
+            }
+            DEBUG("Building " << outfile << " - " << input << " has changed (" << output_ts << " < " << ts << ")");
+            return false;
+        }
+    }
+    return true;
+}
+void Builder::save_input_hashes(const ::helpers::path& outfile) const
+{
+    if( !m_opts.content_hash )
+        return ;
+    ::std::vector<::std::string>   inputs;
+    if( !load_depfile(outfile + ".d", inputs) )
+        return ;
+    ::std::ofstream os((outfile + ".d.hash").str());
+    for(const auto& input : inputs)
+    {
+        uint64_t    h;
+        if( hash_file(input, h) )
+            os << ::std::hex << h << ::std::dec << " " << input << "\n";
+    }
+}
+
 Timestamp Timestamp::for_file(const ::helpers::path& path)
 {
 #if _WIN32
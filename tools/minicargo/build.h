@@ -6,6 +6,7 @@
 class StringList;
 class StringListKV;
 struct Timestamp;
+class BuildTimes;
 
 struct BuildOptions
 {
@@ -13,6 +14,10 @@ struct BuildOptions
     ::helpers::path build_script_overrides;
     ::std::vector<::helpers::path>  lib_search_dirs;
     const char* target_name = nullptr;	// if null, host is used
+    // Start dependent libraries once a library's metadata has been written, instead of waiting for its C code to compile
+    bool pipelined = true;
+    // Compare the contents of input files (not just their timestamps) when checking if a crate is up to date
+    bool content_hash = false;
 };
 
 class BuildList
@@ -22,11 +27,19 @@ class BuildList
         const PackageManifest*  package;
 	bool	is_host;
         ::std::vector<unsigned> dependents;   // Indexes into the list
+        // Packages that link against this package's object (proc macros and build scripts), and so must wait for
+        // this build to finish instead of just the metadata
+        ::std::vector<unsigned> link_dependents;
+        unsigned    num_deps;   // Number of packages (entries) that list this one as a dependent
     };
     const PackageManifest&  m_root_manifest;
     // List is sorted by build order
     ::std::vector<Entry>    m_list;
 public:
     BuildList(const PackageManifest& manifest, const BuildOptions& opts);
+private:
+    // Estimated remaining build time (in seconds) along the longest chain starting at each package
+    ::std::vector<double> get_priorities(const BuildTimes& build_times) const;
+public:
     bool build(BuildOptions opts, unsigned num_jobs);  // 0 = 1 job
 };
@@ -12,6 +12,13 @@
 #include "helpers.h"
 #include "repository.h"
 #include "build.h"
+#include <thread>   // hardware_concurrency
+
+static unsigned default_job_count()
+{
+    auto rv = ::std::thread::hardware_concurrency();
+    return rv > 0 ? rv : 1;
+}
 
 struct ProgramOptions
 {
@@ -33,8 +40,14 @@ struct ProgramOptions
     // Library search directories
     ::std::vector<const char*>  lib_search_dirs;
 
-    // Number of build jobs to run at a time
-    unsigned build_jobs = 1;
+    // Number of build jobs to run at a time (defaults to the number of CPU cores)
+    unsigned build_jobs = default_job_count();
+
+    // Start dependent crates once a crate's metadata is written (instead of after its C code is compiled)
+    bool pipelined = true;
+
+    // Don't rebuild crates when the changed inputs have the same contents as before (e.g. only touched)
+    bool content_hash = false;
 
     // Pause for user input before quitting (useful for MSVC debugging)
     bool pause_before_quit = false;
@@ -85,6 +98,8 @@ int main(int argc, const char* argv[])
         build_opts.output_dir = opts.output_directory ? ::helpers::path(opts.output_directory) : ::helpers::path("output");
         build_opts.lib_search_dirs.reserve(opts.lib_search_dirs.size());
 	build_opts.target_name = opts.target;
+        build_opts.pipelined = opts.pipelined;
+        build_opts.content_hash = opts.content_hash;
         for(const auto* d : opts.lib_search_dirs)
             build_opts.lib_search_dirs.push_back( ::helpers::path(d) );
         Debug_SetPhase("Enumerate Build");
@@ -153,7 +168,7 @@ int ProgramOptions::parse(int argc, const char* argv[])
                 break;
             case 'j':
                 if( i+1 == argc || argv[i+1][0] == '-' ) {
-                    // TODO: Detect number of CPU cores and use that many jobs
+                    this->build_jobs = default_job_count();
                     break;
                 }
                 this->build_jobs = ::std::strtol(argv[++i], nullptr, 10);
@@ -208,6 +223,12 @@ int ProgramOptions::parse(int argc, const char* argv[])
                 }
                 this->target = argv[++i];
             }
+            else if( ::std::strcmp(arg, "--no-pipelining") == 0 ) {
+                this->pipelined = false;
+            }
+            else if( ::std::strcmp(arg, "--content-hash") == 0 ) {
+                this->content_hash = true;
+            }
             else {
                 ::std::cerr << "Unknown flag " << arg << ::std::endl;
                 return 1;
@@ -243,7 +264,10 @@ void ProgramOptions::help() const
         << "--vendor-dir <dir>       : Directory containing vendored packages (from `cargo vendor`)\n"
         << "--output-dir,-o <dir>    : Specify the compiler output directory\n"
         << "-L <dir>                 : Search for pre-built crates (e.g. libstd) in the specified directory\n"
-        << "-j <count>               : Run at most <count> build tasks at once (default is to run only one)\n"
+        << "-j <count>               : Run at most <count> build tasks at once (default is the number of CPU cores)\n"
+        << "                           When run from make, its jobserver is used to limit the job count\n"
         << "-n                       : Don't build any packages, just list the packages that would be built\n"
+        << "--no-pipelining          : Wait for each crate to be fully compiled before starting crates that depend on it\n"
+        << "--content-hash           : Only rebuild when the contents of an input file change (not just its timestamp)\n"
         ;
 }
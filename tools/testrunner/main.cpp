@@ -21,6 +21,9 @@
 # define MRUSTC_PATH    "./bin/mrustc"
 #endif
 #include <algorithm>
+#include <thread>
+#include <mutex>
+#include <atomic>
 
 struct Options
 {
@@ -29,6 +32,10 @@ struct Options
 
     const char* exceptions_file = nullptr;
     bool fail_fast = false;
+    /// Number of tests to build/run at once
+    unsigned int num_jobs = 1;
+    /// Re-run tests that have already passed with the current compiler
+    bool ignore_cache = false;
 
     int parse(int argc, const char* argv[]);
 
@@ -44,6 +51,14 @@ struct TestDesc
     ::std::vector<::std::string>    m_extra_flags;
     bool ignore;
 };
+enum class TestResult
+{
+    Pass,
+    /// Passed previously, and nothing has changed since
+    Cached,
+    Fail,
+    CompileFail,
+};
 struct Timestamp
 {
     static Timestamp for_file(const ::helpers::path& p);
@@ -83,6 +98,7 @@ struct Timestamp
 };
 
 bool run_executable(const ::helpers::path& file, const ::std::vector<const char*>& args, const ::helpers::path& outfile);
+void Debug_SetCapture(::std::ostream* os);
 
 bool run_compiler(const ::helpers::path& source_file, const ::helpers::path& output, const ::std::vector<::std::string>& extra_flags, ::helpers::path libdir={}, bool is_dep=false)
 {
@@ -119,6 +135,64 @@ bool run_compiler(const ::helpers::path& source_file, const ::helpers::path& out
     return run_executable(MRUSTC_PATH, args, logfile);
 }
 
+/// Build (if out of date) and run a single test
+TestResult run_test(const Options& opts, const TestDesc& test, const ::helpers::path& input_path, const ::helpers::path& outdir)
+{
+    DEBUG(">> " << test.m_name);
+    auto depdir = outdir / "deps-" + test.m_name.c_str();
+    auto outfile = outdir / test.m_name + ".exe";
+    // Created when the test passes, so it's skipped until the compiler or the test changes
+    auto pass_stamp = outdir / test.m_name + ".pass";
+
+    // Newest of the compiler and the test's sources
+    auto input_ts = Timestamp::for_file(MRUSTC_PATH);
+    auto add_input = [&](const ::helpers::path& p) {
+        auto ts = Timestamp::for_file(p);
+        if( input_ts < ts )
+            input_ts = ts;
+        };
+    add_input(test.m_path);
+    for(const auto& file : test.m_pre_build)
+        add_input(input_path / "auxiliary" / file);
+
+    if( !opts.ignore_cache && !(Timestamp::for_file(pass_stamp) < input_ts) )
+    {
+        DEBUG(">> CACHED " << test.m_name);
+        return TestResult::Cached;
+    }
+    remove(pass_stamp.str().c_str());
+
+    auto test_output_ts = Timestamp::for_file(outfile);
+    if( test_output_ts < input_ts )
+    {
+        for(const auto& file : test.m_pre_build)
+        {
+            mkdir(depdir.str().c_str(), 0755);
+            auto infile = input_path / "auxiliary" / file;
+            if( !run_compiler(infile, depdir, {}, depdir, true) )
+            {
+                DEBUG("COMPILE FAIL " << infile << " (dep of " << test.m_name << ")");
+                return TestResult::CompileFail;
+            }
+        }
+
+        if( !run_compiler(test.m_path, outfile, test.m_extra_flags, depdir) )
+        {
+            DEBUG("COMPILE FAIL " << test.m_name);
+            return TestResult::CompileFail;
+        }
+    }
+    // - Run the test
+    if( !run_executable(outfile, { outfile.str().c_str() }, outdir / test.m_name + ".out") )
+    {
+        DEBUG("RUN FAIL " << test.m_name);
+        return TestResult::Fail;
+    }
+
+    ::std::ofstream(pass_stamp.str()) << test.m_name << ::std::endl;
+    return TestResult::Pass;
+}
+
 int main(int argc, const char* argv[])
 {
     Options opts;
@@ -272,6 +346,8 @@ int main(int argc, const char* argv[])
         unsigned n_cfail = 0;
         unsigned n_fail = 0;
         unsigned n_ok = 0;
+        unsigned n_cached = 0;
+        ::std::vector<const TestDesc*>  to_run;
         for(const auto& test : tests)
         {
             if( test.ignore )
@@ -285,62 +361,59 @@ int main(int argc, const char* argv[])
                 n_skip ++;
                 continue ;
             }
+            to_run.push_back(&test);
+        }
 
-            DEBUG(">> " << test.m_name);
-            auto depdir = outdir / "deps-" + test.m_name.c_str();
-            auto outfile = outdir / test.m_name + ".exe";
-
-            auto test_output_ts = Timestamp::for_file(outfile);
-            if( test_output_ts < Timestamp::for_file(MRUSTC_PATH) )
+        // Tests are handed out to `num_jobs` threads, each test's log is printed as one block once it completes
+        ::std::mutex    output_lock;
+        ::std::atomic<size_t>   next_idx { 0 };
+        ::std::atomic<bool> stop { false };
+        auto worker = [&]() {
+            while( !stop )
             {
-                bool pre_build_failed = false;
-                for(const auto& file : test.m_pre_build)
-                {
-                    mkdir(depdir.str().c_str(), 0755);
-                    auto infile = input_path / "auxiliary" / file;
-                    if( !run_compiler(infile, depdir, {}, depdir, true) )
-                    {
-                        DEBUG("COMPILE FAIL " << infile << " (dep of " << test.m_name << ")");
-                        n_cfail ++;
-                        pre_build_failed = true;
-                        break;
-                    }
-                }
-                if( pre_build_failed )
-                {
-                    if( opts.fail_fast )
-                        return 1;
-                    else
-                        continue;
-                }
-
-                auto compile_logfile = outdir / test.m_name + "-build.log";
-                if( !run_compiler(test.m_path, outfile, test.m_extra_flags, depdir) )
+                size_t idx = next_idx ++;
+                if( idx >= to_run.size() )
+                    break;
+                const auto& test = *to_run[idx];
+
+                ::std::stringstream log;
+                if( opts.num_jobs > 1 )
+                    Debug_SetCapture(&log);
+                auto res = run_test(opts, test, input_path, outdir);
+                Debug_SetCapture(nullptr);
+
+                ::std::lock_guard<::std::mutex> lh { output_lock };
+                ::std::cout << log.str();
+                switch(res)
                 {
-                    DEBUG("COMPILE FAIL " << test.m_name);
+                case TestResult::Cached:
+                    n_cached ++;
+                    // Fall through
+                case TestResult::Pass:
+                    n_ok ++;
+                    break;
+                case TestResult::Fail:
+                    n_fail ++;
+                    break;
+                case TestResult::CompileFail:
                     n_cfail ++;
-                    if( opts.fail_fast )
-                        return 1;
-                    else
-                        continue;
+                    break;
                 }
+                if( opts.fail_fast && (res == TestResult::Fail || res == TestResult::CompileFail) )
+                    stop = true;
             }
-            // - Run the test
-            if( !run_executable(outfile, { outfile.str().c_str() }, outdir / test.m_name + ".out") )
-            {
-                DEBUG("RUN FAIL " << test.m_name);
-                n_fail ++;
-                if( opts.fail_fast )
-                    return 1;
-                else
-                    continue;
-            }
-
-            n_ok ++;
-        }
+            };
+        ::std::vector<::std::thread>    threads;
+        for(unsigned int i = 1; i < opts.num_jobs && i < to_run.size(); i ++)
+            threads.push_back(::std::thread(worker));
+        worker();
+        for(auto& t : threads)
+            t.join();
+        if( stop )
+            return 1;
 
         ::std::cout << "TESTS COMPLETED" << ::std::endl;
-        ::std::cout << n_ok << " passed, " << n_fail << " failed, " << n_cfail << " errored, " << n_skip << " skipped" << ::std::endl;
+        ::std::cout << n_ok << " passed (" << n_cached << " cached), " << n_fail << " failed, " << n_cfail << " errored, " << n_skip << " skipped" << ::std::endl;
 
         if( n_fail > 0 || n_cfail > 0 )
             return 1;
@@ -380,6 +453,25 @@ int Options::parse(int argc, const char* argv[])
                 }
                 this->output_dir = argv[++i];
                 break;
+            case 'j': {
+                const char* val;
+                if( arg[2] != '\0' ) {
+                    val = arg + 2;
+                }
+                else if( i+1 == argc ) {
+                    this->usage_short();
+                    return 1;
+                }
+                else {
+                    val = argv[++i];
+                }
+                int n = ::std::atoi(val);
+                if( n <= 0 ) {
+                    this->usage_short();
+                    return 1;
+                }
+                this->num_jobs = n;
+                } break;
 
             default:
                 this->usage_short();
@@ -421,6 +513,10 @@ int Options::parse(int argc, const char* argv[])
             {
                 this->fail_fast = true;
             }
+            else if( 0 == ::std::strcmp(arg, "--no-cache") )
+            {
+                this->ignore_cache = true;
+            }
             else
             {
                 this->usage_short();
@@ -540,27 +636,40 @@ Timestamp Timestamp::for_file(const ::helpers::path& path)
 }
 
 
-static int giIndentLevel = 0;
+static thread_local int giIndentLevel = 0;
+// Per-thread destination for debug output (when running tests in parallel)
+static thread_local ::std::ostream* gpCaptureStream = nullptr;
+void Debug_SetCapture(::std::ostream* os)
+{
+    gpCaptureStream = os;
+}
+static ::std::ostream& debug_stream()
+{
+    return gpCaptureStream ? *gpCaptureStream : ::std::cout;
+}
 void Debug_Print(::std::function<void(::std::ostream& os)> cb)
 {
+    auto& os = debug_stream();
     for(auto i = giIndentLevel; i --; )
-        ::std::cout << " ";
-    cb(::std::cout);
-    ::std::cout << ::std::endl;
+        os << " ";
+    cb(os);
+    os << ::std::endl;
 }
 void Debug_EnterScope(const char* name, dbg_cb_t cb)
 {
+    auto& os = debug_stream();
     for(auto i = giIndentLevel; i --; )
-        ::std::cout << " ";
-    ::std::cout << ">>> " << name << "(";
-    cb(::std::cout);
-    ::std::cout << ")" << ::std::endl;
+        os << " ";
+    os << ">>> " << name << "(";
+    cb(os);
+    os << ")" << ::std::endl;
     giIndentLevel ++;
 }
 void Debug_LeaveScope(const char* name, dbg_cb_t cb)
 {
+    auto& os = debug_stream();
     giIndentLevel --;
     for(auto i = giIndentLevel; i --; )
-        ::std::cout << " ";
-    ::std::cout << "<<< " << name << ::std::endl;
+        os << " ";
+    os << "<<< " << name << ::std::endl;
 }